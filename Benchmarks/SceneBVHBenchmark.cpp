@@ -0,0 +1,132 @@
+// Times building, refitting and frustum culling a SceneBVH over 100k
+// instances, compared to testing every instance's box individually.
+//
+// Usage: SceneBVHBenchmark [instance count]
+
+#include "Frustum.h"
+#include "SceneBVH.h"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+using namespace AltheaEngine;
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+double getMilliseconds(Clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - start)
+      .count();
+}
+
+// Instances of a few sizes spread over a large level, so a typical view sees
+// a small fraction of them
+std::vector<AABB> createInstances(uint32_t count, std::mt19937& rng) {
+  std::uniform_real_distribution<float> horizontal(-2000.0f, 2000.0f);
+  std::uniform_real_distribution<float> vertical(0.0f, 100.0f);
+  std::uniform_real_distribution<float> size(0.5f, 10.0f);
+
+  std::vector<AABB> instances(count);
+  for (AABB& instance : instances) {
+    glm::vec3 center(horizontal(rng), vertical(rng), horizontal(rng));
+    glm::vec3 halfExtent(size(rng), size(rng), size(rng));
+    instance.min = center - halfExtent;
+    instance.max = center + halfExtent;
+  }
+
+  return instances;
+}
+
+// A camera walking through the level, looking around
+std::vector<Frustum> createViews(uint32_t count) {
+  std::vector<Frustum> views;
+  glm::mat4 projection =
+      glm::perspective(glm::radians(70.0f), 16.0f / 9.0f, 0.1f, 1000.0f);
+  for (uint32_t i = 0; i < count; ++i) {
+    float t = static_cast<float>(i) / static_cast<float>(count);
+    glm::vec3 eye(
+        1500.0f * std::cos(6.2831853f * t),
+        20.0f,
+        1500.0f * std::sin(6.2831853f * t));
+    float yaw = 12.0f * t;
+    glm::vec3 target = eye + glm::vec3(std::cos(yaw), -0.1f, std::sin(yaw));
+    views.push_back(Frustum::fromViewProjection(
+        projection * glm::lookAt(eye, target, glm::vec3(0.0f, 1.0f, 0.0f))));
+  }
+
+  return views;
+}
+} // namespace
+
+int main(int argc, char** argv) {
+  uint32_t instanceCount = 100000;
+  if (argc > 1)
+    instanceCount = static_cast<uint32_t>(std::strtoul(argv[1], nullptr, 10));
+
+  constexpr uint32_t VIEW_COUNT = 500;
+  constexpr uint32_t REFIT_COUNT = 20;
+
+  std::mt19937 rng(1);
+  std::vector<AABB> instances = createInstances(instanceCount, rng);
+  std::vector<Frustum> views = createViews(VIEW_COUNT);
+
+  SceneBVH bvh;
+  Clock::time_point start = Clock::now();
+  bvh.build(instances);
+  double buildTime = getMilliseconds(start);
+
+  std::uniform_real_distribution<float> offset(-1.0f, 1.0f);
+  double refitTime = 0.0;
+  for (uint32_t i = 0; i < REFIT_COUNT; ++i) {
+    for (AABB& instance : instances) {
+      glm::vec3 translation(offset(rng), 0.0f, offset(rng));
+      instance.min += translation;
+      instance.max += translation;
+    }
+
+    start = Clock::now();
+    bvh.refit(instances);
+    refitTime += getMilliseconds(start);
+  }
+
+  std::vector<uint32_t> visibleItems;
+  size_t bvhVisibleCount = 0;
+  start = Clock::now();
+  for (const Frustum& view : views) {
+    bvh.cullFrustum(view, visibleItems);
+    bvhVisibleCount += visibleItems.size();
+  }
+  double bvhCullTime = getMilliseconds(start);
+
+  size_t bruteForceVisibleCount = 0;
+  start = Clock::now();
+  for (const Frustum& view : views) {
+    visibleItems.clear();
+    for (uint32_t i = 0; i < instanceCount; ++i) {
+      if (view.intersectsAABB(instances[i].min, instances[i].max))
+        visibleItems.push_back(i);
+    }
+    bruteForceVisibleCount += visibleItems.size();
+  }
+  double bruteForceCullTime = getMilliseconds(start);
+
+  std::cout << instanceCount << " instances, " << VIEW_COUNT << " views\n"
+            << "  build:              " << buildTime << " ms\n"
+            << "  refit:              " << refitTime / REFIT_COUNT << " ms\n"
+            << "  BVH cull:           " << bvhCullTime / VIEW_COUNT
+            << " ms per view, " << bvhVisibleCount / VIEW_COUNT
+            << " visible\n"
+            << "  Brute force cull:   " << bruteForceCullTime / VIEW_COUNT
+            << " ms per view, " << bruteForceVisibleCount / VIEW_COUNT
+            << " visible\n";
+
+  return 0;
+}
@@ -0,0 +1,188 @@
+// Compares running work on the ThreadPool with starting a detached
+// std::thread per task, the way systems did before the pool existed.
+//
+// Throughput: many short tasks of a fixed amount of work, submitted at once.
+// Latency: single tasks submitted while the workers are idle, timed from
+// submission until the task starts running.
+//
+// Usage: ThreadPoolBenchmark [task count]
+
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace AltheaEngine;
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+double getMilliseconds(Clock::duration duration) {
+  return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+// Roughly the cost of a small unit of engine work, e.g., decoding a chunk
+uint32_t doWork(uint32_t seed) {
+  uint32_t value = seed;
+  for (uint32_t i = 0; i < 2000; ++i)
+    value = value * 1664525u + 1013904223u;
+  return value;
+}
+
+std::atomic<uint32_t> s_sink{0};
+
+// Counts finished tasks, lets the calling thread block until all are done
+class Completion {
+public:
+  explicit Completion(uint32_t count) : m_remaining(count) {}
+
+  void finishOne() {
+    if (m_remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_condition.notify_all();
+    }
+  }
+
+  bool isDone() const {
+    return m_remaining.load(std::memory_order_acquire) == 0;
+  }
+
+  void wait() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_condition.wait(lock, [this]() { return isDone(); });
+  }
+
+private:
+  std::atomic<uint32_t> m_remaining;
+  std::mutex m_mutex;
+  std::condition_variable m_condition;
+};
+
+// The completion is shared with the tasks, the last one may still be
+// signalling it when the waiting thread returns
+double runPoolThroughput(ThreadPool& pool, uint32_t taskCount) {
+  auto pCompletion = std::make_shared<Completion>(taskCount);
+  Clock::time_point start = Clock::now();
+  for (uint32_t i = 0; i < taskCount; ++i) {
+    pool.submit([i, pCompletion]() {
+      s_sink.fetch_add(doWork(i), std::memory_order_relaxed);
+      pCompletion->finishOne();
+    });
+  }
+  pool.waitUntil([&pCompletion]() { return pCompletion->isDone(); });
+  return getMilliseconds(Clock::now() - start);
+}
+
+double runDetachedThroughput(uint32_t taskCount) {
+  auto pCompletion = std::make_shared<Completion>(taskCount);
+  Clock::time_point start = Clock::now();
+  for (uint32_t i = 0; i < taskCount; ++i) {
+    std::thread([i, pCompletion]() {
+      s_sink.fetch_add(doWork(i), std::memory_order_relaxed);
+      pCompletion->finishOne();
+    }).detach();
+  }
+  pCompletion->wait();
+  return getMilliseconds(Clock::now() - start);
+}
+
+struct LatencySummary {
+  double median;
+  double p99;
+  double max;
+};
+
+LatencySummary summarize(std::vector<double>& latencies) {
+  std::sort(latencies.begin(), latencies.end());
+  size_t count = latencies.size();
+  return {latencies[count / 2], latencies[count * 99 / 100], latencies.back()};
+}
+
+// Submits one task at a time, only after the previous one ran and the
+// workers had a moment to go back to sleep
+template <typename Launch>
+LatencySummary measureLatency(uint32_t sampleCount, Launch launch) {
+  std::vector<double> latencies;
+  latencies.reserve(sampleCount);
+  for (uint32_t i = 0; i < sampleCount; ++i) {
+    std::this_thread::sleep_for(std::chrono::microseconds(200));
+
+    auto pStarted = std::make_shared<std::atomic<int64_t>>(0);
+    auto pCompletion = std::make_shared<Completion>(1);
+    Clock::time_point submitted = Clock::now();
+    launch([pStarted, pCompletion]() {
+      pStarted->store(
+          Clock::now().time_since_epoch().count(),
+          std::memory_order_release);
+      pCompletion->finishOne();
+    });
+    pCompletion->wait();
+
+    Clock::duration startDelay =
+        Clock::duration(pStarted->load(std::memory_order_acquire)) -
+        submitted.time_since_epoch();
+    latencies.push_back(getMilliseconds(startDelay) * 1000.0);
+  }
+
+  return summarize(latencies);
+}
+
+void printLatency(const char* name, const LatencySummary& latency) {
+  std::cout << "  " << name << " median " << latency.median << " us, p99 "
+            << latency.p99 << " us, max " << latency.max << " us\n";
+}
+} // namespace
+
+int main(int argc, char** argv) {
+  uint32_t taskCount = 2000;
+  if (argc > 1)
+    taskCount = static_cast<uint32_t>(std::strtoul(argv[1], nullptr, 10));
+
+  constexpr uint32_t ROUND_COUNT = 5;
+  constexpr uint32_t LATENCY_SAMPLE_COUNT = 500;
+
+  ThreadPool& pool = ThreadPool::getShared();
+
+  // Warm up the pool's workers and the allocator
+  runPoolThroughput(pool, taskCount);
+
+  double poolTime = 0.0;
+  double detachedTime = 0.0;
+  for (uint32_t round = 0; round < ROUND_COUNT; ++round) {
+    poolTime += runPoolThroughput(pool, taskCount);
+    detachedTime += runDetachedThroughput(taskCount);
+  }
+  poolTime /= ROUND_COUNT;
+  detachedTime /= ROUND_COUNT;
+
+  std::cout << "Throughput, " << taskCount << " tasks on "
+            << pool.getThreadCount() << " workers\n"
+            << "  ThreadPool:       " << poolTime << " ms, "
+            << taskCount / poolTime << " tasks/ms\n"
+            << "  Detached threads: " << detachedTime << " ms, "
+            << taskCount / detachedTime << " tasks/ms\n";
+
+  std::cout << "Latency from submission to start, idle workers\n";
+  printLatency(
+      "ThreadPool:      ",
+      measureLatency(LATENCY_SAMPLE_COUNT, [&pool](ThreadPool::Task&& task) {
+        pool.submit(std::move(task));
+      }));
+  printLatency(
+      "Detached threads:",
+      measureLatency(LATENCY_SAMPLE_COUNT, [](ThreadPool::Task&& task) {
+        std::thread(std::move(task)).detach();
+      }));
+
+  return 0;
+}
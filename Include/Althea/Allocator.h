@@ -107,6 +107,31 @@ private:
   VmaAllocationInfo _info{};
 };
 
+/**
+ * @brief Raw device memory that resources can be bound into at arbitrary
+ * offsets, e.g., for aliasing several images in the same memory.
+ */
+class ALTHEA_API MemoryAllocation {
+public:
+  MemoryAllocation() = default;
+  ~MemoryAllocation();
+
+  MemoryAllocation(MemoryAllocation&& rhs);
+  MemoryAllocation& operator=(MemoryAllocation&& rhs);
+  MemoryAllocation(const MemoryAllocation& rhs) = delete;
+  MemoryAllocation& operator=(const MemoryAllocation& rhs) = delete;
+
+  const VmaAllocationInfo& getInfo() const { return this->_info; }
+
+private:
+  friend class Allocator;
+
+  VmaAllocator _allocator = VK_NULL_HANDLE;
+  VmaAllocation _allocation = VK_NULL_HANDLE;
+
+  VmaAllocationInfo _info{};
+};
+
 enum class ALTHEA_API AllocationType { CPU_GPU, CPU_GPU_STAGING, GPU_ONLY };
 
 class ALTHEA_API Allocator {
@@ -124,6 +149,18 @@ public:
       const VkImageCreateInfo& imageInfo,
       const VmaAllocationCreateInfo& allocInfo) const;
 
+  MemoryAllocation allocateMemory(
+      const VkMemoryRequirements& requirements,
+      const VmaAllocationCreateInfo& allocInfo) const;
+
+  /**
+   * @brief Bind an image at the given offset within a memory allocation.
+   */
+  void bindImageMemory(
+      const MemoryAllocation& allocation,
+      VkDeviceSize offset,
+      VkImage image) const;
+
 private:
   VmaAllocator _allocator;
 };
@@ -9,7 +9,11 @@
 #include "ImageResource.h"
 #include "ImageView.h"
 #include "InputManager.h"
+#include "LayoutCache.h"
 #include "Library.h"
+#include "ParallelCommandRecorder.h"
+#include "PipelineCache.h"
+#include "UploadRing.h"
 
 #define GLFW_INCLUDE_VULKAN
 #include "vk_mem_alloc.h"
@@ -98,7 +102,11 @@ private:
 
   const std::vector<const char*> deviceExtensions = {
       VK_KHR_SWAPCHAIN_EXTENSION_NAME,
-      VK_KHR_MULTIVIEW_EXTENSION_NAME,
+      VK_KHR_MULTIVIEW_EXTENSION_NAME};
+
+  // Enabled when the device supports them, e.g., not on software
+  // rasterizers like lavapipe
+  const std::vector<const char*> rayTracingExtensions = {
       VK_KHR_ACCELERATION_STRUCTURE_EXTENSION_NAME,
       VK_KHR_RAY_TRACING_PIPELINE_EXTENSION_NAME,
       VK_KHR_DEFERRED_HOST_OPERATIONS_EXTENSION_NAME,
@@ -112,6 +120,10 @@ private:
 
   std::unique_ptr<Allocator> pAllocator;
   std::unique_ptr<IGameInstance> gameInstance;
+  std::unique_ptr<ParallelCommandRecorder> pParallelCommandRecorder;
+  std::unique_ptr<PipelineCache> pPipelineCache;
+  std::unique_ptr<LayoutCache> pLayoutCache;
+  std::unique_ptr<UploadRing> pUploadRing;
   DeletionTasks deletionTasks;
 
   GLFWwindow* window;
@@ -127,6 +139,7 @@ private:
 
   VkPhysicalDeviceProperties physicalDeviceProperties{};
   VkPhysicalDeviceRayTracingPipelinePropertiesKHR rayTracingProperties{};
+  bool rayTracingSupported = false;
 
   VkSwapchainKHR swapChain;
   std::vector<VkImage> swapChainImages;
@@ -170,8 +183,11 @@ private:
   bool checkValidationLayerSupport();
   void createInstance();
   void createSurface();
-  bool checkDeviceExtensionSupport(const VkPhysicalDevice& device) const;
+  bool checkDeviceExtensionSupport(
+      const VkPhysicalDevice& device,
+      const std::vector<const char*>& extensions) const;
   bool isDeviceSuitable(const VkPhysicalDevice& device) const;
+  bool checkRayTracingSupport(const VkPhysicalDevice& device) const;
   void pickPhysicalDevice();
   void createLogicalDevice();
   SwapChainSupportDetails
@@ -223,13 +239,35 @@ public:
     return physicalDeviceProperties;
   }
 
+  /**
+   * @brief Only filled in when isRayTracingSupported(), zeroed otherwise.
+   */
   const VkPhysicalDeviceRayTracingPipelinePropertiesKHR&
   getRayTracingProperties() const {
     return rayTracingProperties;
   }
 
+  /**
+   * @brief Whether the ray tracing pipeline, ray queries and acceleration
+   * structures are enabled. Devices without them are still used, but ray
+   * traced passes must not be created on them, their constructors throw.
+   * The global heap then has no acceleration structure binding and geometry
+   * buffers can't be used to build acceleration structures.
+   */
+  bool isRayTracingSupported() const { return rayTracingSupported; }
+
   const VkCommandPool& getCommandPool() const { return commandPool; }
 
+  VkPipelineCache getPipelineCache() const { return *this->pPipelineCache; }
+
+  LayoutCache& getLayoutCache() const { return *this->pLayoutCache; }
+
+  ParallelCommandRecorder& getParallelCommandRecorder() const {
+    return *this->pParallelCommandRecorder;
+  }
+
+  UploadRing& getUploadRing() const { return *this->pUploadRing; }
+
   const VkExtent2D& getSwapChainExtent() const { return swapChainExtent; }
 
   VkSwapchainKHR getSwapChain() const { return swapChain; }
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "FileBufferPool.h"
+#include "Library.h"
+
+#include <functional>
+#include <optional>
+#include <string>
+
+namespace AltheaEngine {
+/**
+ * @brief Reads whole files without blocking the calling thread.
+ *
+ * On Linux, reads are queued to the kernel through io_uring, so any number
+ * of files can be in flight at once without tying up threads on blocking
+ * reads. A single I/O thread waits for completions. Where io_uring isn't
+ * available, e.g. on older kernels, when it is disabled or once too many
+ * reads are in flight, files are read with pread on the shared ThreadPool
+ * instead.
+ *
+ * All functions are safe to call from any thread.
+ */
+class ALTHEA_API AsyncFileReader {
+public:
+  /**
+   * @brief Called with the contents of the file, in a buffer from the
+   * FileBufferPool, or std::nullopt if it couldn't be read. May be called on
+   * the I/O thread, a worker thread or the calling thread, so it should hand
+   * off any heavy work.
+   */
+  typedef std::function<void(std::optional<FileBuffer>&& data)> Callback;
+
+  /**
+   * @brief Start reading the whole file at the given path.
+   */
+  static void read(const std::string& path, Callback&& callback);
+
+  /**
+   * @brief Whether reads go through io_uring, rather than the fallback.
+   */
+  static bool isUsingIoUring();
+};
+} // namespace AltheaEngine
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "Frustum.h"
 #include "Library.h"
 
 #include <glm/glm.hpp>
@@ -24,8 +25,16 @@ public:
   float computePitchDegrees() const;
   glm::mat4 computeView() const;
 
+  /**
+   * @brief Compute the world-space view frustum of the camera.
+   */
+  Frustum computeFrustum() const;
+
   const glm::mat4& getProjection() const { return this->_projection; }
 
+  float getNearPlane() const { return this->_nearPlane; }
+  float getFarPlane() const { return this->_farPlane; }
+
 private:
   void _recomputeProjection();
 
@@ -0,0 +1,40 @@
+#ifndef _INDIRECTDRAWCOMMON_
+#define _INDIRECTDRAWCOMMON_
+
+#include <../Include/Althea/Common/CommonTranslations.h>
+
+#define INDIRECT_CULL_GROUP_SIZE 64
+
+// One instance of a primitive considered for drawing by the indirect path.
+// The bounds are in the primitive's local space and are transformed by the
+// instance's node matrix before culling.
+struct IndirectDrawItem {
+  vec3 boundsMin;
+  // Index into the shared primitive constants buffer
+  uint primitiveIdx;
+
+  vec3 boundsMax;
+  uint matrixBufferHandle;
+
+  uint nodeIdx;
+  // Skinned primitives are deformed by joints, so their bounds are not
+  // reliable and they are never culled
+  uint isSkinned;
+  // The batch the item is drawn in, along with the start of the batch's
+  // range in the command buffer. Batches group items sharing the same
+  // geometry buffers and front face, each is drawn with one indirect call.
+  uint batchIdx;
+  uint firstCommand;
+};
+
+// Matches VkDrawIndexedIndirectCommand. firstInstance holds the index of the
+// item being drawn, so the vertex shader can find it from gl_InstanceIndex.
+struct IndirectDrawCommand {
+  uint indexCount;
+  uint instanceCount;
+  uint firstIndex;
+  int vertexOffset;
+  uint firstInstance;
+};
+
+#endif // _INDIRECTDRAWCOMMON_
@@ -38,8 +38,51 @@ struct PrimitiveConstants {
 
   uint nodeIdx;
   uint isSkinned; // TODO: turn this into a flag bitmask
+  uint meshletBufferHandle;
+  uint meshletOffset;
+
+  // The vertex / index buffers are shared between primitives, these locate
+  // the ranges belonging to this primitive. Indices are relative to
+  // vertexOffset.
+  uint vertexOffset;
+  uint firstIndex;
+  uint indexCount;
+  uint meshletCount;
+
+  // Primitives of meshes referenced by several nodes are drawn instanced,
+  // instance i uses the node at instanceNodes[firstInstance + i]. The
+  // handle is invalid when the primitive has a single instance at nodeIdx.
+  uint instanceNodesHandle;
+  uint firstInstance;
+  uint instanceCount;
+  uint padding;
+};
+
+#define MESHLET_MAX_VERTICES 64
+#define MESHLET_MAX_TRIANGLES 124
+
+// A cluster of up to MESHLET_MAX_TRIANGLES triangles, referencing up to
+// MESHLET_MAX_VERTICES vertices of its primitive. The vertices are stored as
+// primitive vertex indices starting at vertexOffset in the meshlet data. The
+// triangles start at triangleOffset in the same data, one uint per triangle
+// with the three local vertex indices packed into the low 24 bits. On the GPU
+// the meshlet data lives in the primitive's index buffer.
+struct Meshlet {
+  vec3 center;
+  float radius;
+
+  // Normal cone, the meshlet is backfacing when viewed from a position p
+  // where dot(normalize(coneApex - p), coneAxis) >= coneCutoff
+  vec3 coneAxis;
+  float coneCutoff;
+
+  vec3 coneApex;
+  uint vertexOffset;
+
+  uint triangleOffset;
+  uint vertexCount;
+  uint triangleCount;
   uint padding;
-  uint padding2;
 };
 
 struct Vertex {
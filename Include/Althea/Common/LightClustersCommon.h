@@ -0,0 +1,41 @@
+#ifndef _LIGHTCLUSTERSCOMMON_
+#define _LIGHTCLUSTERSCOMMON_
+
+#include <../Include/Althea/Common/CommonTranslations.h>
+
+// Dimensions of the cluster (froxel) grid. X and Y are screen-space tiles,
+// Z is exponentially distributed slices of view depth.
+#define LIGHT_CLUSTERS_X 16
+#define LIGHT_CLUSTERS_Y 9
+#define LIGHT_CLUSTERS_Z 24
+#define LIGHT_CLUSTER_COUNT                                                    \
+  (LIGHT_CLUSTERS_X * LIGHT_CLUSTERS_Y * LIGHT_CLUSTERS_Z)
+
+// Lights past this limit are dropped from a cluster
+#define MAX_LIGHTS_PER_CLUSTER 128
+
+#define LIGHT_CLUSTERS_GROUP_SIZE 64
+
+// View-space bounds of a single cluster
+struct LightClusterBounds {
+  vec4 boundsMin;
+  vec4 boundsMax;
+};
+
+// A point light transformed into view space, along with its radius of
+// influence
+struct LightClusterLight {
+  vec3 viewPosition;
+  float radius;
+};
+
+// The light grid buffer starts with this header, followed by the light count
+// of every cluster and then a fixed-size list of light indices per cluster.
+struct LightGridHeader {
+  float zNear;
+  float zFar;
+  uint lightCount;
+  uint padding;
+};
+
+#endif // _LIGHTCLUSTERSCOMMON_
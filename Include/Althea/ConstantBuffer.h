@@ -28,7 +28,7 @@ public:
     allocInfo.flags = 0;
     allocInfo.usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
 
-    VkBuffer staging = commandBuffer.createStagingBuffer(
+    StagingRange staging = commandBuffer.createStagingBuffer(
         app,
         gsl::span((const std::byte*)&this->_constants, sizeof(TConstants)));
 
@@ -40,8 +40,8 @@ public:
 
     BufferUtilities::copyBuffer(
         commandBuffer,
-        staging,
-        0,
+        staging.buffer,
+        staging.offset,
         this->_allocation.getBuffer(),
         0,
         sizeof(TConstants));
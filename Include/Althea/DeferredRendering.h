@@ -10,6 +10,7 @@
 #include "IntrusivePtr.h"
 #include "Library.h"
 #include "Material.h"
+#include "RenderGraph.h"
 #include "RenderPass.h"
 #include "ResourcesAssignment.h"
 #include "SingleTimeCommandBuffer.h"
@@ -33,6 +34,17 @@ struct ALTHEA_API GBufferHandles {
   uint32_t stencilBHandle;
 };
 
+/**
+ * @brief The GBuffer images once imported into a render graph.
+ */
+struct ALTHEA_API GBufferGraphHandles {
+  RenderGraphHandle depthA;
+  RenderGraphHandle depthB;
+  RenderGraphHandle normal;
+  RenderGraphHandle albedo;
+  RenderGraphHandle metallicRoughnessOcclusion;
+};
+
 class SubpassBuilder;
 
 class ALTHEA_API GBufferResources {
@@ -50,6 +62,22 @@ public:
 
   void registerToHeap(GlobalHeap& heap);
 
+  /**
+   * @brief Import the GBuffer images into a render graph. Between executions
+   * of the graph they are left as textures, so transitionToTextures must be
+   * called once before the graph first executes.
+   */
+  GBufferGraphHandles importToRenderGraph(RenderGraph& graph) const;
+
+  /**
+   * @brief Declare that a pass samples the GBuffer, e.g., lighting or
+   * reflections.
+   */
+  static void readTextures(
+      RenderGraphPassBuilder& pass,
+      const GBufferGraphHandles& handles,
+      VkPipelineStageFlags stageMask);
+
   const std::vector<Attachment>& getAttachmentDescriptions() const {
     return this->_attachmentDescriptions;
   }
@@ -146,6 +174,19 @@ public:
       BufferHandle globalResourcesHandle,
       UniformHandle globalUniformsHandle);
 
+  /**
+   * @brief Add the pass rendering the scene into the GBuffer to a render
+   * graph, in place of calling begin() every frame. The graph must not
+   * outlive the app or this pass.
+   */
+  void addToRenderGraph(
+      const Application& app,
+      RenderGraph& graph,
+      const GBufferGraphHandles& gBuffer,
+      VkDescriptorSet heapSet,
+      BufferHandle globalResourcesHandle,
+      UniformHandle globalUniformsHandle);
+
   void tryRecompileShaders(Application& app) { _pass.tryRecompile(app); }
 
 private:
@@ -348,10 +348,6 @@ public:
   }
 
 private:
-  struct DescriptorSetLayoutDeleter {
-    void operator()(VkDevice device, VkDescriptorSetLayout layout);
-  };
-
   struct DescriptorPoolDeleter {
     void operator()(VkDevice device, VkDescriptorPool pool);
   };
@@ -361,7 +357,8 @@ private:
   // Each pool will have this many descriptor sets of the given layout.
   uint32_t _setsPerPool;
 
-  UniqueVkHandle<VkDescriptorSetLayout, DescriptorSetLayoutDeleter> _layout;
+  // Owned by the application's LayoutCache
+  VkDescriptorSetLayout _layout = VK_NULL_HANDLE;
   bool _hasInlineUniformBlock = false;
 
   // Keep this around to check validity when binding resources to a
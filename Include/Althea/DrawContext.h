@@ -23,6 +23,10 @@ class Subpass;
  * This object should only ever be managed by an ActiveRenderPass. References
  * used in this class ALTHEA_API may be invalid if a DrawContext object is used
  * outside the lifetime of an ActiveRenderPass.
+ *
+ * A DrawContext only records into its own command buffer and is never
+ * mutated while drawing, so worker threads may each draw with their own
+ * context, see ActiveRenderPass::recordParallel.
  */
 class ALTHEA_API DrawContext {
 public:
@@ -53,6 +57,15 @@ public:
     this->_updatePushConstants(&pushConstants, sizeof(TPushConstants), index);
   }
 
+  /**
+   * @brief Update a push constant range by index from raw bytes, e.g., push
+   * constants stored by a DrawList.
+   */
+  void updatePushConstants(const void* pSrc, uint32_t size, uint32_t index)
+      const {
+    this->_updatePushConstants(pSrc, size, index);
+  }
+
   /**
    * @brief Set the front face mode for this draw call. This feature is only
    * available when it was enabled in the pipeline creation.
@@ -61,6 +74,12 @@ public:
    */
   void setFrontFaceDynamic(VkFrontFace frontFace) const;
 
+  /**
+   * @brief Whether the current pipeline allows setting the front face
+   * dynamically.
+   */
+  bool isDynamicFrontFaceEnabled() const;
+
   // dynamic stencil state
   void setStencilCompareMask(VkStencilFaceFlags flags, uint32_t cmpMask) const;
   void setStencilWriteMask(VkStencilFaceFlags flags, uint32_t writeMask) const;
@@ -83,6 +102,15 @@ public:
     vkCmdBindVertexBuffers(this->_commandBuffer, 0, 1, &vkBuffer, &offset);
   }
 
+  /**
+   * @brief Bind a raw vertex buffer for drawing, e.g., a shared geometry
+   * arena block.
+   *
+   * @param buffer The vertex buffer to bind.
+   * @param offset The byte offset into the buffer.
+   */
+  void bindVertexBuffer(VkBuffer buffer, VkDeviceSize offset = 0) const;
+
   /**
    * @brief Bind this index buffer for drawing.
    *
@@ -90,13 +118,30 @@ public:
    */
   void bindIndexBuffer(const IndexBuffer& indexBuffer) const;
 
+  /**
+   * @brief Bind a raw uint32 index buffer for drawing.
+   *
+   * @param buffer The index buffer to bind.
+   * @param offset The byte offset into the buffer.
+   */
+  void bindIndexBuffer(VkBuffer buffer, VkDeviceSize offset = 0) const;
+
   /**
    * @brief Execute an indexed draw call.
    *
    * @param indexCount The number of indices in the indexed draw.
    * @param instanceCount The number of instances to draw.
+   * @param firstIndex The first index within the bound index buffer.
+   * @param vertexOffset The value added to each index before fetching
+   * vertices.
+   * @param firstInstance The instance index of the first instance.
    */
-  void drawIndexed(uint32_t indexCount, uint32_t instanceCount = 1) const;
+  void drawIndexed(
+      uint32_t indexCount,
+      uint32_t instanceCount = 1,
+      uint32_t firstIndex = 0,
+      int32_t vertexOffset = 0,
+      uint32_t firstInstance = 0) const;
 
   /**
    * @brief Binds the given vertex and index buffers and executes an indexed
@@ -154,12 +199,10 @@ private:
   // The number of global descriptor sets there are in the _descriptorSets
   // array (max 3).
   uint32_t _globalDescriptorSetCount = 0;
-  // The global descriptor sets, optionally followed by a material descriptor
-  // set.
-  // Note this is mutable so we can temporarily add the material descriptor
-  // set from a const function. It needs to be contiguous in memory to the
-  // rest. This "scratch-space" usage should not be visible externally.
-  mutable VkDescriptorSet _descriptorSets[4];
+  // The global descriptor sets, with room for one more. The extra descriptor
+  // set is appended in a copy when binding, so the context stays read-only
+  // while drawing.
+  VkDescriptorSet _descriptorSets[4];
 
   const Subpass* _pCurrentSubpass;
 
@@ -0,0 +1,211 @@
+#pragma once
+
+#include "DrawContext.h"
+#include "Library.h"
+
+#include <vulkan/vulkan.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace AltheaEngine {
+class ActiveRenderPass;
+class ParallelCommandRecorder;
+class Primitive;
+
+/**
+ * @brief A single draw call along with all the state it needs, recorded
+ * later by a DrawList.
+ */
+struct ALTHEA_API DrawPacket {
+  uint64_t sortKey = 0;
+
+  VkBuffer vertexBuffer = VK_NULL_HANDLE;
+  VkBuffer indexBuffer = VK_NULL_HANDLE;
+  // An optional descriptor set bound after the global sets, e.g., a material
+  // descriptor set. When null, the currently bound sets are kept.
+  VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+  VkFrontFace frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+
+  uint32_t indexCount = 0;
+  uint32_t instanceCount = 1;
+  uint32_t firstIndex = 0;
+  int32_t vertexOffset = 0;
+  uint32_t firstInstance = 0;
+
+  // The range of this packet's push constants within the list's push
+  // constant storage, pushed to range 0 of the pipeline layout.
+  uint32_t pushConstantsOffset = 0;
+  uint32_t pushConstantsSize = 0;
+};
+
+/**
+ * @brief Counters describing how much state was recorded by a DrawList and
+ * how much was elided as redundant, accumulated until they are reset.
+ */
+struct ALTHEA_API DrawListStats {
+  uint32_t packetCount = 0;
+
+  // Draw calls recorded, and draw calls saved by merging consecutive packets
+  // into a single instanced draw.
+  uint32_t drawCount = 0;
+  uint32_t drawsSaved = 0;
+
+  // Vertex buffer, index buffer and descriptor set binds, as well as
+  // dynamic front face changes.
+  uint32_t bindCount = 0;
+  uint32_t bindsSaved = 0;
+
+  uint32_t pushConstantCount = 0;
+  uint32_t pushConstantsSaved = 0;
+};
+
+/**
+ * @brief Collects draw packets over a frame, sorts them by a 64-bit key and
+ * records them through a DrawContext, skipping any state that is already
+ * bound.
+ *
+ * The sort key is laid out from the most to the least significant bits as
+ * pipeline (8 bits), material (20 bits), front face (1 bit) and depth bucket
+ * (16 bits), see makeSortKey. Since the pipeline is in the top bits, the
+ * packets of each pipeline are contiguous once sorted and can be recorded
+ * one subpass at a time.
+ */
+class ALTHEA_API DrawList {
+public:
+  static constexpr uint32_t PIPELINE_BITS = 8;
+  static constexpr uint32_t MATERIAL_BITS = 20;
+  static constexpr uint32_t DEPTH_BITS = 16;
+
+  // The fewest packets worth handing to a worker in recordParallel
+  static constexpr size_t MIN_PACKETS_PER_TASK = 256;
+
+  /**
+   * @brief Build a sort key.
+   *
+   * @param pipeline An id for the pipeline the packet is drawn with, only the
+   * low PIPELINE_BITS bits are kept.
+   * @param material An id for the material, e.g., its bindless handle. Only
+   * the low MATERIAL_BITS bits are kept.
+   * @param frontFace The front face mode of the packet.
+   * @param depth The normalized depth of the packet in [0, 1], packets with
+   * equal state are drawn front to back. Pass 1 - depth to draw back to
+   * front instead.
+   */
+  static uint64_t makeSortKey(
+      uint32_t pipeline,
+      uint32_t material,
+      VkFrontFace frontFace,
+      float depth);
+
+  static uint32_t getPipelineFromSortKey(uint64_t sortKey) {
+    return static_cast<uint32_t>(sortKey >> (64 - PIPELINE_BITS));
+  }
+
+  /**
+   * @brief Remove all packets, e.g., once per frame or render pass. The stats
+   * keep accumulating until resetStats() is called.
+   */
+  void clear();
+
+  void resetStats() { m_stats = {}; }
+
+  /**
+   * @brief Add a packet. Its push constants offset and size are overwritten.
+   */
+  template <typename TPushConstants>
+  void addPacket(DrawPacket packet, const TPushConstants& pushConstants) {
+    this->_addPacket(packet, &pushConstants, sizeof(TPushConstants));
+  }
+
+  /**
+   * @brief Add a packet without push constants.
+   */
+  void addPacket(const DrawPacket& packet) {
+    this->_addPacket(packet, nullptr, 0);
+  }
+
+  /**
+   * @brief Add a packet drawing all instances of a primitive's LOD.
+   */
+  template <typename TPushConstants>
+  void addPrimitive(
+      uint64_t sortKey,
+      const Primitive& primitive,
+      uint32_t lodIdx,
+      const TPushConstants& pushConstants) {
+    this->_addPacket(
+        _makePrimitivePacket(sortKey, primitive, lodIdx),
+        &pushConstants,
+        sizeof(TPushConstants));
+  }
+
+  /**
+   * @brief Sort the packets by their keys with a radix sort. Must be called
+   * after the last packet is added and before recording.
+   */
+  void sort();
+
+  /**
+   * @brief Record all the packets, in sorted order, with the pipeline bound
+   * by the current subpass.
+   */
+  void record(const DrawContext& context);
+
+  /**
+   * @brief Record only the packets with the given pipeline id, in sorted
+   * order.
+   */
+  void record(const DrawContext& context, uint32_t pipeline);
+
+  /**
+   * @brief Record all the packets, in sorted order, split into contiguous
+   * chunks recorded by worker threads into secondary command buffers. The
+   * current subpass of the pass must have been started with
+   * VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS.
+   *
+   * @param taskCount The most chunks to split the packets into, fewer are
+   * used for small lists, see MIN_PACKETS_PER_TASK.
+   */
+  void recordParallel(
+      ActiveRenderPass& pass,
+      ParallelCommandRecorder& recorder,
+      uint32_t taskCount);
+
+  const std::vector<DrawPacket>& getPackets() const { return m_packets; }
+
+  size_t getPacketCount() const { return m_packets.size(); }
+
+  const DrawListStats& getStats() const { return m_stats; }
+
+private:
+  struct SortEntry {
+    uint64_t key;
+    uint32_t packetIdx;
+  };
+
+  static DrawPacket _makePrimitivePacket(
+      uint64_t sortKey,
+      const Primitive& primitive,
+      uint32_t lodIdx);
+
+  void _addPacket(DrawPacket packet, const void* pPushConstants, size_t size);
+  void _record(
+      const DrawContext& context,
+      size_t begin,
+      size_t end,
+      DrawListStats& stats) const;
+  bool _canMerge(const DrawPacket& a, const DrawPacket& b) const;
+
+  std::vector<DrawPacket> m_packets;
+  std::vector<std::byte> m_pushConstants;
+
+  // The packet order after sorting, along with scratch space for the sort
+  std::vector<SortEntry> m_sorted;
+  std::vector<SortEntry> m_sortScratch;
+  bool m_isSorted = false;
+
+  DrawListStats m_stats{};
+};
+} // namespace AltheaEngine
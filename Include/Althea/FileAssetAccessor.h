@@ -1,21 +1,49 @@
 #pragma once
 
+#include "FileBufferPool.h"
 #include "Library.h"
+#include "MappedFile.h"
+#include "PackFile.h"
 
 #include <CesiumAsync/IAssetAccessor.h>
 #include <CesiumAsync/IAssetRequest.h>
 #include <CesiumAsync/IAssetResponse.h>
 
+#include <memory>
+
 namespace AltheaEngine {
 class ALTHEA_API FileResponse : public CesiumAsync::IAssetResponse {
 private:
   uint16_t _statusCode;
   CesiumAsync::HttpHeaders _headers;
-  std::vector<char> _data;
+  FileBuffer _data;
+  std::unique_ptr<MappedFile> _pMappedFile;
+  std::shared_ptr<const PackFile> _pPackFile;
+  gsl::span<const std::byte> _packedData;
 
 public:
   FileResponse(std::vector<char>&& data);
 
+  /**
+   * @brief A response owning a pooled buffer, which goes back to the
+   * FileBufferPool once the response is destroyed.
+   */
+  FileResponse(FileBuffer&& data);
+
+  /**
+   * @brief A response viewing a memory mapped file, the data is never copied
+   * into the response.
+   */
+  FileResponse(std::unique_ptr<MappedFile>&& pMappedFile);
+
+  /**
+   * @brief A response viewing an uncompressed entry of a pack file, the pack
+   * is kept open for as long as the response is alive.
+   */
+  FileResponse(
+      std::shared_ptr<const PackFile>&& pPackFile,
+      gsl::span<const std::byte> packedData);
+
   /**
    * @brief Returns the HTTP response code.
    */
@@ -73,8 +101,27 @@ public:
   const CesiumAsync::IAssetResponse* response() const override;
 };
 
+/**
+ * @brief Serves requests from the local file system.
+ *
+ * Files in a pack mounted with the PackFileSystem are served from the pack,
+ * uncompressed ones as views of its mapping. Large loose files are memory
+ * mapped, their responses are views of the OS page cache and only get copied
+ * by whoever consumes them. Smaller files, where setting up a mapping costs
+ * more than it saves, are read with AsyncFileReader so many of them can be
+ * in flight at once.
+ */
 class ALTHEA_API FileAssetAccessor : public CesiumAsync::IAssetAccessor {
 public:
+  /**
+   * @brief Files of at least this size are memory mapped.
+   */
+  static constexpr size_t MAPPED_FILE_THRESHOLD = 256 * 1024;
+
+  /**
+   * @brief Get the file at the given path. Files that can't be read result
+   * in an empty response with an error status code.
+   */
   CesiumAsync::Future<std::shared_ptr<CesiumAsync::IAssetRequest>>
   get(const CesiumAsync::AsyncSystem& asyncSystem,
       const std::string& url,
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "Library.h"
+
+#include <gsl/span>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace AltheaEngine {
+/**
+ * @brief A buffer holding file contents, handed out by the FileBufferPool.
+ * The buffer goes back to the pool when the handle is destroyed.
+ */
+class ALTHEA_API FileBuffer {
+public:
+  FileBuffer() = default;
+  ~FileBuffer() { _release(); }
+
+  FileBuffer(FileBuffer&& rhs);
+  FileBuffer& operator=(FileBuffer&& rhs);
+  FileBuffer(const FileBuffer& rhs) = delete;
+  FileBuffer& operator=(const FileBuffer& rhs) = delete;
+
+  char* getData() { return m_pData.get(); }
+  const char* getData() const { return m_pData.get(); }
+  size_t getSize() const { return m_size; }
+  bool isEmpty() const { return m_size == 0; }
+
+  /**
+   * @brief Resize the buffer, keeping its contents. Only reallocates if it
+   * grows beyond the size class it came from, any new bytes are unspecified.
+   */
+  void resize(size_t size);
+
+  gsl::span<const std::byte> getBytes() const {
+    return gsl::span<const std::byte>(
+        reinterpret_cast<const std::byte*>(m_pData.get()),
+        m_size);
+  }
+
+private:
+  friend class FileBufferPool;
+
+  FileBuffer(std::unique_ptr<char[]>&& pData, size_t size, size_t capacity)
+      : m_pData(std::move(pData)), m_size(size), m_capacity(capacity) {}
+
+  void _release();
+
+  // Left uninitialized when allocated, the pool never zeroes memory
+  std::unique_ptr<char[]> m_pData;
+  size_t m_size = 0;
+  size_t m_capacity = 0;
+};
+
+struct ALTHEA_API FileBufferPoolStats {
+  // Buffers handed out from the calling thread's own cache
+  uint64_t threadCacheHits = 0;
+  // Buffers handed out from the pool shared by all threads
+  uint64_t sharedHits = 0;
+  // Buffers that had to be newly allocated
+  uint64_t misses = 0;
+  // Buffers freed instead of being pooled, because they were too large or
+  // the pool was full
+  uint64_t discards = 0;
+  // Memory currently held by the pool across all threads
+  uint64_t pooledBytes = 0;
+};
+
+/**
+ * @brief Recycles the buffers that files are read into, so loading many
+ * assets doesn't keep allocating and zeroing large blocks of memory.
+ *
+ * Buffers are sorted into power-of-two size classes, from 4KB up to 64MB.
+ * Each thread keeps a small cache of its own, which is used without any
+ * locking, and overflows into a shared pool with a lock per size class. The
+ * shared pool holds at most 256MB in total. Buffers larger than the largest
+ * class are never pooled.
+ *
+ * All functions are safe to call from any thread.
+ */
+class ALTHEA_API FileBufferPool {
+public:
+  /**
+   * @brief Get a buffer of exactly the given size. Its contents are
+   * unspecified, they are neither zeroed nor cleared when recycled.
+   */
+  static FileBuffer acquire(size_t size);
+
+  /**
+   * @brief Free all buffers held by the shared pool and the calling
+   * thread's cache.
+   */
+  static void trim();
+
+  static FileBufferPoolStats getStats();
+  static void resetStats();
+
+private:
+  friend class FileBuffer;
+
+  // Called by FileBuffer when it is destroyed
+  static void _recycle(std::unique_ptr<char[]>&& pData, size_t capacity);
+};
+} // namespace AltheaEngine
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "Library.h"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+
+namespace AltheaEngine {
+/**
+ * @brief A view frustum represented by six inward-facing, normalized planes.
+ * Each plane is stored as (normal, d), a point p is on the inner side of the
+ * plane when dot(normal, p) + d >= 0.
+ */
+struct ALTHEA_API Frustum {
+  enum Plane : uint32_t {
+    PLANE_LEFT = 0,
+    PLANE_RIGHT,
+    PLANE_BOTTOM,
+    PLANE_TOP,
+    PLANE_NEAR,
+    PLANE_FAR,
+    PLANE_COUNT
+  };
+
+  glm::vec4 planes[PLANE_COUNT];
+
+  /**
+   * @brief Extract the frustum planes from a view-projection matrix. Assumes
+   * the Vulkan clip-space conventions used by the engine (zero-to-one depth).
+   *
+   * @param viewProjection The combined projection * view matrix, the
+   * resulting planes are in the space the view matrix transforms from.
+   */
+  static Frustum fromViewProjection(const glm::mat4& viewProjection);
+
+  /**
+   * @brief Conservatively test whether a sphere touches the frustum.
+   */
+  bool intersectsSphere(const glm::vec3& center, float radius) const;
+
+  /**
+   * @brief Conservatively test whether an axis-aligned box touches the
+   * frustum.
+   */
+  bool intersectsAABB(const glm::vec3& min, const glm::vec3& max) const;
+};
+} // namespace AltheaEngine
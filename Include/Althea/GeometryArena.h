@@ -0,0 +1,210 @@
+#pragma once
+
+#include "Allocator.h"
+#include "BindlessHandle.h"
+#include "Library.h"
+#include "SingleTimeCommandBuffer.h"
+
+#include <gsl/span>
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <optional>
+#include <vector>
+
+namespace AltheaEngine {
+class Application;
+class GlobalHeap;
+
+/**
+ * @brief Best-fit allocator of element ranges within a fixed capacity.
+ * Freed ranges are coalesced with their free neighbors.
+ */
+class ALTHEA_API FreeListAllocator {
+public:
+  FreeListAllocator() = default;
+  FreeListAllocator(uint32_t capacity);
+
+  /**
+   * @brief Allocate a range of elements.
+   *
+   * @param count The number of elements to allocate.
+   * @param alignment The offset of the range will be a multiple of this.
+   * @return The offset of the allocated range, or nothing if there is no
+   * free range large enough.
+   */
+  std::optional<uint32_t> allocate(uint32_t count, uint32_t alignment = 1);
+
+  /**
+   * @brief Return a previously allocated range to the free list.
+   */
+  void free(uint32_t offset, uint32_t count);
+
+  uint32_t getCapacity() const { return m_capacity; }
+  uint32_t getFreeCount() const { return m_freeCount; }
+
+private:
+  void _insertFreeRange(uint32_t offset, uint32_t count);
+  void _eraseFreeRange(std::map<uint32_t, uint32_t>::iterator it);
+
+  uint32_t m_capacity = 0;
+  uint32_t m_freeCount = 0;
+
+  // offset -> count
+  std::map<uint32_t, uint32_t> m_freeByOffset;
+  // count -> offset
+  std::multimap<uint32_t, uint32_t> m_freeBySize;
+};
+
+/**
+ * @brief A range of elements sub-allocated from one of the blocks of a
+ * GeometryPool.
+ */
+struct ALTHEA_API GeometryRange {
+  uint32_t blockIdx = INVALID_BINDLESS_HANDLE;
+  uint32_t offset = 0;
+  uint32_t count = 0;
+
+  bool isValid() const { return blockIdx != INVALID_BINDLESS_HANDLE; }
+};
+
+/**
+ * @brief A growable set of large device buffers holding elements of a single
+ * size. Each block is registered once in the global heap, and ranges of
+ * elements are sub-allocated from the blocks.
+ */
+class ALTHEA_API GeometryPool
+    : public std::enable_shared_from_this<GeometryPool> {
+public:
+  struct Block {
+    BufferAllocation allocation;
+    BufferHandle handle;
+    FreeListAllocator allocator;
+  };
+
+  GeometryPool() = default;
+  GeometryPool(
+      uint32_t elementSize,
+      uint32_t elementsPerBlock,
+      VkBufferUsageFlags usage);
+
+  /**
+   * @brief Sub-allocate a range and upload the given elements into it.
+   * Allocations larger than the block size get a dedicated block.
+   */
+  GeometryRange allocate(
+      const Application& app,
+      SingleTimeCommandBuffer& commandBuffer,
+      GlobalHeap& heap,
+      gsl::span<const std::byte> elements);
+
+  /**
+   * @brief Return the range to its block. The range is immediately available
+   * for reuse, the caller must ensure the GPU is no longer reading from it.
+   * GeometryAllocation defers this until the frames in flight are done.
+   */
+  void free(const GeometryRange& range);
+
+  const Block& getBlock(uint32_t blockIdx) const { return m_blocks[blockIdx]; }
+  uint32_t getBlockCount() const {
+    return static_cast<uint32_t>(m_blocks.size());
+  }
+  uint32_t getElementSize() const { return m_elementSize; }
+
+  size_t getAllocatedElementCount() const { return m_allocatedCount; }
+
+private:
+  uint32_t _createBlock(
+      const Application& app,
+      GlobalHeap& heap,
+      uint32_t capacity);
+
+  uint32_t m_elementSize = 0;
+  uint32_t m_elementsPerBlock = 0;
+  // Alignment of allocated ranges, in elements. Keeps every range usable as a
+  // standalone storage buffer descriptor.
+  uint32_t m_alignment = 0;
+  VkBufferUsageFlags m_usage = 0;
+
+  size_t m_allocatedCount = 0;
+
+  // Blocks are never destroyed or reordered while the pool is alive, so
+  // GeometryRange::blockIdx stays valid.
+  std::vector<Block> m_blocks;
+};
+
+/**
+ * @brief The shared vertex, index and meshlet buffers all primitives are
+ * sub-allocated from.
+ */
+class ALTHEA_API GeometryArena {
+public:
+  GeometryArena();
+
+  GeometryPool& getVertexPool() { return *m_pVertexPool; }
+  const GeometryPool& getVertexPool() const { return *m_pVertexPool; }
+
+  // Indices and other uint32 data, e.g., meshlet vertices and triangles.
+  GeometryPool& getIndexPool() { return *m_pIndexPool; }
+  const GeometryPool& getIndexPool() const { return *m_pIndexPool; }
+
+  GeometryPool& getMeshletPool() { return *m_pMeshletPool; }
+  const GeometryPool& getMeshletPool() const { return *m_pMeshletPool; }
+
+private:
+  // The pools are heap allocated so their addresses stay stable when the
+  // owning GlobalHeap is moved. They are shared so deferred frees can tell
+  // whether the pool still exists.
+  std::shared_ptr<GeometryPool> m_pVertexPool;
+  std::shared_ptr<GeometryPool> m_pIndexPool;
+  std::shared_ptr<GeometryPool> m_pMeshletPool;
+};
+
+/**
+ * @brief Owns a range within a GeometryPool. On destruction the range is
+ * returned to the pool through the application's deletion tasks, so it is not
+ * reused while frames in flight may still be reading from it.
+ */
+class ALTHEA_API GeometryAllocation {
+public:
+  GeometryAllocation() = default;
+  GeometryAllocation(
+      Application& app,
+      GeometryPool& pool,
+      const GeometryRange& range)
+      : m_pApp(&app), m_pPool(&pool), m_range(range) {}
+  GeometryAllocation(GeometryAllocation&& rhs);
+  GeometryAllocation& operator=(GeometryAllocation&& rhs);
+  GeometryAllocation(const GeometryAllocation& rhs) = delete;
+  GeometryAllocation& operator=(const GeometryAllocation& rhs) = delete;
+  ~GeometryAllocation();
+
+  const GeometryRange& getRange() const { return m_range; }
+  uint32_t getOffset() const { return m_range.offset; }
+  uint32_t getCount() const { return m_range.count; }
+  bool isValid() const { return m_pPool && m_range.isValid(); }
+
+  VkBuffer getBuffer() const {
+    return m_pPool->getBlock(m_range.blockIdx).allocation.getBuffer();
+  }
+
+  BufferHandle getHandle() const {
+    return m_pPool->getBlock(m_range.blockIdx).handle;
+  }
+
+  // Byte offset of the range within its block
+  VkDeviceSize getByteOffset() const {
+    return static_cast<VkDeviceSize>(m_range.offset) *
+           m_pPool->getElementSize();
+  }
+
+private:
+  void _release();
+
+  Application* m_pApp = nullptr;
+  GeometryPool* m_pPool = nullptr;
+  GeometryRange m_range;
+};
+} // namespace AltheaEngine
@@ -2,6 +2,7 @@
 
 #include "BindlessHandle.h"
 #include "DescriptorSet.h"
+#include "GeometryArena.h"
 
 #include <vulkan/vulkan.h>
 
@@ -44,6 +45,13 @@ public:
   
   VkDescriptorSet getDescriptorSet() const { return this->_set; }
 
+  // Shared vertex / index buffers that primitives are sub-allocated from,
+  // each block of the arena takes a single buffer slot.
+  GeometryArena& getGeometryArena() { return this->_geometryArena; }
+  const GeometryArena& getGeometryArena() const {
+    return this->_geometryArena;
+  }
+
   VkDescriptorSetLayout getDescriptorSetLayout() const {
     return this->_setAllocator.getLayout();
   }
@@ -53,11 +61,14 @@ private:
 
   DescriptorSetAllocator _setAllocator;
   VkDescriptorSet _set;
+  bool _rayTracingSupported = false;
 
   uint32_t _usedBufferSlots = 0;
   uint32_t _usedUniformSlots = 0;
   uint32_t _usedTextureSlots = 0;
   uint32_t _usedImageSlots = 0;
   uint32_t _usedTlasSlots = 0;
+
+  GeometryArena _geometryArena;
 };
 } // namespace AltheaEngine
\ No newline at end of file
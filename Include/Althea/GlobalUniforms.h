@@ -28,6 +28,11 @@ struct GlobalUniforms {
   float exposure;
   uint32_t inputMask;
   uint32_t frameCount;
+
+  // LightClusters::getGridHandle(), point lights are shaded per light cluster
+  // when set and all at once otherwise. The light fields are filled in by
+  // PointLightCollection::setGlobalUniforms().
+  uint32_t lightClusterGridHandle = INVALID_BINDLESS_HANDLE;
 };
 
 class Application;
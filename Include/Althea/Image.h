@@ -110,6 +110,10 @@ public:
 
   void clearLayout();
 
+  VkImageLayout getLayout() const { return this->_layout; }
+  VkAccessFlags getAccessMask() const { return this->_accessMask; }
+  VkPipelineStageFlags getStage() const { return this->_stage; }
+
   /**
    * @brief Populate all the layers at the specified mip level in the image from
    * the given source buffer.
@@ -0,0 +1,160 @@
+#pragma once
+
+#include "Allocator.h"
+#include "BindlessHandle.h"
+#include "Common/IndirectDrawCommon.h"
+#include "Common/InstanceDataCommon.h"
+#include "ComputePipeline.h"
+#include "DeferredRendering.h"
+#include "FrameContext.h"
+#include "Library.h"
+
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace AltheaEngine {
+class Application;
+class GlobalHeap;
+class Model;
+struct Frustum;
+
+/**
+ * @brief A GPU-driven path for drawing models into the GBuffer.
+ *
+ * Every frame, the constants of all primitives are gathered into one buffer
+ * along with a list of items, one per primitive instance. A compute pass
+ * culls the items against the view frustum and appends an indexed indirect
+ * draw command for each visible item, counting them as it goes. The GBuffer
+ * subpass then draws everything with vkCmdDrawIndexedIndirectCount, without
+ * the CPU touching individual primitives.
+ *
+ * Items are grouped into batches sharing the same geometry arena blocks and
+ * front face, each batch takes one indirect call. With a single arena block
+ * and no mirrored primitives, the whole scene is one call.
+ *
+ * cullCpu() mirrors the compute pass on the CPU for validation. The GPU
+ * appends commands within a batch in an unspecified order, so the two should
+ * be compared after sorting each batch's commands by firstInstance, which
+ * validateGpuCull() does.
+ *
+ * The draw item index is passed to the vertex shader as the first instance,
+ * which needs the drawIndirectFirstInstance feature.
+ */
+class ALTHEA_API IndirectDraws : public IGBufferSubpass {
+public:
+  IndirectDraws() = default;
+  IndirectDraws(const Application& app, GlobalHeap& heap);
+
+  /**
+   * @brief Gather and upload the primitive constants and draw items of the
+   * given models for the current frame.
+   */
+  void update(
+      GlobalHeap& heap,
+      const FrameContext& frame,
+      const std::vector<Model>& models);
+
+  /**
+   * @brief Reset the draw counts and dispatch the culling compute pass. Must
+   * be recorded after update() and outside of the GBuffer render pass.
+   */
+  void cull(
+      VkCommandBuffer commandBuffer,
+      GlobalHeap& heap,
+      const FrameContext& frame,
+      const Frustum& frustum) const;
+
+  /**
+   * @brief A CPU reference of the culling compute pass, using the items
+   * gathered by the last update().
+   *
+   * @param models The same models passed to the last update().
+   * @param frustum The frustum to cull against.
+   * @param commands The output draw commands, laid out the same way as the
+   * GPU command buffer.
+   * @param counts The output number of commands in each batch.
+   */
+  void cullCpu(
+      const std::vector<Model>& models,
+      const Frustum& frustum,
+      std::vector<IndirectDrawCommand>& commands,
+      std::vector<uint32_t>& counts) const;
+
+  /**
+   * @brief Run the culling compute pass right away, read its commands back
+   * and compare them with cullCpu(). Meant for testing the GPU path, e.g.,
+   * on lavapipe, since it waits for the GPU to finish.
+   *
+   * Must be called after update() and before the current frame's cull() is
+   * recorded, while the frame's buffers are not in use by the GPU.
+   *
+   * @return The number of batches whose commands don't match, each of them
+   * is also printed.
+   */
+  uint32_t validateGpuCull(
+      const Application& app,
+      GlobalHeap& heap,
+      const FrameContext& frame,
+      const std::vector<Model>& models,
+      const Frustum& frustum) const;
+
+  uint32_t getItemCount() const {
+    return static_cast<uint32_t>(m_items.size());
+  }
+
+  uint32_t getBatchCount() const {
+    return static_cast<uint32_t>(m_batches.size());
+  }
+
+  BufferHandle getPrimitiveConstantsHandle(const FrameContext& frame) const {
+    return m_primitiveBuffers[frame.frameRingBufferIndex].handle;
+  }
+
+  // IGBufferSubpass impl
+  void registerGBufferSubpass(GraphicsPipelineBuilder& builder) const override;
+  void beginGBufferSubpass(
+      const DrawContext& context,
+      BufferHandle globalResourcesHandle,
+      UniformHandle globalUniformsHandle) override;
+
+private:
+  struct DrawBuffer {
+    BufferHandle handle{};
+    BufferAllocation allocation{};
+    size_t size = 0;
+  };
+
+  static void _allocateBuffer(
+      GlobalHeap& heap,
+      DrawBuffer& buffer,
+      size_t size,
+      VkBufferUsageFlags usage,
+      bool hostVisible);
+
+  struct Batch {
+    VkBuffer vertexBuffer;
+    VkBuffer indexBuffer;
+    VkFrontFace frontFace;
+    uint32_t firstCommand;
+    uint32_t itemCount;
+  };
+
+  std::array<DrawBuffer, MAX_FRAMES_IN_FLIGHT> m_primitiveBuffers{};
+  std::array<DrawBuffer, MAX_FRAMES_IN_FLIGHT> m_itemBuffers{};
+  // Each batch appends to its own range of the command buffer, sized for all
+  // of its items, and has its own count
+  std::array<DrawBuffer, MAX_FRAMES_IN_FLIGHT> m_commandBuffers{};
+  std::array<DrawBuffer, MAX_FRAMES_IN_FLIGHT> m_countBuffers{};
+
+  std::vector<PrimitiveConstants> m_primitiveConstants;
+  std::vector<IndirectDrawItem> m_items;
+  std::vector<Batch> m_batches;
+  // The model each item belongs to, for the CPU reference
+  std::vector<uint32_t> m_itemModels;
+
+  ComputePipeline m_cullCompute{};
+};
+} // namespace AltheaEngine
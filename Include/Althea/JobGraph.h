@@ -0,0 +1,102 @@
+#pragma once
+
+#include "Library.h"
+#include "ThreadPool.h"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace AltheaEngine {
+/**
+ * @brief A set of jobs with dependencies between them, run on a ThreadPool.
+ *
+ * Every job keeps a counter of its unfinished dependencies. Only jobs
+ * without dependencies are queued up front, when a job finishes it counts
+ * down its continuations and starts the ones that became ready, so no
+ * thread ever blocks on a dependency.
+ *
+ * A graph is built once and may be executed any number of times, e.g. once
+ * per frame. The timings of the last execution can be dumped as a Chrome
+ * trace for profiling.
+ */
+class ALTHEA_API JobGraph {
+public:
+  typedef uint32_t JobId;
+
+  /**
+   * @brief Add a job that runs once all of its dependencies have finished.
+   *
+   * @param name The name shown in the trace.
+   * @param fn The work to do, must not throw.
+   * @param dependencies Jobs that must finish before this one starts.
+   */
+  JobId addJob(
+      const std::string& name,
+      std::function<void()>&& fn,
+      const std::vector<JobId>& dependencies = {});
+
+  /**
+   * @brief Add a job that processes the range [0, count) with
+   * ThreadPool::parallelFor, see there for the parameters.
+   */
+  JobId addParallelFor(
+      const std::string& name,
+      uint32_t count,
+      std::function<void(uint32_t begin, uint32_t end)>&& fn,
+      const std::vector<JobId>& dependencies = {},
+      uint32_t minChunkSize = 1);
+
+  /**
+   * @brief Make the second job wait for the first one to finish.
+   */
+  void addDependency(JobId before, JobId after);
+
+  uint32_t getJobCount() const {
+    return static_cast<uint32_t>(m_jobs.size());
+  }
+
+  /**
+   * @brief Run every job, returns once all of them have finished. The
+   * calling thread runs queued tasks while it waits. Throws if the
+   * dependencies form a cycle.
+   */
+  void execute(ThreadPool& pool = ThreadPool::getShared());
+
+  /**
+   * @brief Write the jobs of the last execution, along with the threads they
+   * ran on and their dependencies, in the Chrome trace event format. The
+   * file can be opened in chrome://tracing or Perfetto. Throws if the file
+   * can't be written.
+   */
+  void writeChromeTrace(const std::string& path) const;
+
+private:
+  struct Job {
+    std::string name;
+    std::function<void()> fn;
+    std::vector<JobId> continuations;
+    uint32_t dependencyCount = 0;
+
+    // Timings of the last execution, relative to its start
+    uint64_t startNs = 0;
+    uint64_t endNs = 0;
+    uint32_t threadIdx = 0;
+  };
+
+  void _validateAcyclic() const;
+  void _runJob(JobId jobId);
+
+  std::vector<Job> m_jobs;
+
+  // Only valid while executing
+  ThreadPool* m_pPool = nullptr;
+  std::unique_ptr<std::atomic<uint32_t>[]> m_remainingDependencies;
+  std::atomic<uint32_t> m_pendingJobCount{0};
+  uint64_t m_executeStartNs = 0;
+  uint32_t m_traceThreadCount = 0;
+};
+} // namespace AltheaEngine
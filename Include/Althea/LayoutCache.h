@@ -0,0 +1,60 @@
+#pragma once
+
+#include "Library.h"
+
+#include <gsl/span>
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace AltheaEngine {
+/**
+ * @brief Deduplicates descriptor set layouts and pipeline layouts.
+ *
+ * Descriptor set layouts are keyed by their full definition, so identical
+ * layouts declared by different passes share one handle. That makes the
+ * handles a faithful key for pipeline layouts, which are in turn shared by
+ * every pipeline with the same sets and push constant ranges. Fewer distinct
+ * layouts means descriptor sets stay bound across more pipeline switches.
+ *
+ * Layouts are owned by the cache and live until it is destroyed, so a handle
+ * is never reused for a different definition. All functions are safe to call
+ * from multiple threads.
+ */
+class ALTHEA_API LayoutCache {
+public:
+  LayoutCache(VkDevice device);
+  ~LayoutCache();
+
+  LayoutCache(LayoutCache&& rhs) = delete;
+  LayoutCache& operator=(LayoutCache&& rhs) = delete;
+  LayoutCache(const LayoutCache& rhs) = delete;
+  LayoutCache& operator=(const LayoutCache& rhs) = delete;
+
+  VkDescriptorSetLayout
+  getDescriptorSetLayout(const VkDescriptorSetLayoutCreateInfo& createInfo);
+
+  VkPipelineLayout getPipelineLayout(
+      gsl::span<const VkDescriptorSetLayout> descriptorSetLayouts,
+      gsl::span<const VkPushConstantRange> pushConstantRanges);
+
+  uint32_t getDescriptorSetLayoutCount() const;
+  uint32_t getPipelineLayoutCount() const;
+
+  /**
+   * @brief The number of requests served by an existing layout.
+   */
+  uint32_t getHitCount() const;
+
+private:
+  VkDevice m_device;
+
+  mutable std::mutex m_mutex;
+  std::unordered_map<std::string, VkDescriptorSetLayout> m_setLayouts;
+  std::unordered_map<std::string, VkPipelineLayout> m_pipelineLayouts;
+  uint32_t m_hitCount = 0;
+};
+} // namespace AltheaEngine
@@ -0,0 +1,149 @@
+#pragma once
+
+#include "Allocator.h"
+#include "BindlessHandle.h"
+#include "Common/LightClustersCommon.h"
+#include "ComputePipeline.h"
+#include "FrameContext.h"
+#include "Library.h"
+
+#include <glm/glm.hpp>
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace AltheaEngine {
+class Application;
+class Camera;
+class GlobalHeap;
+class PointLightCollection;
+
+/**
+ * @brief Assigns point lights to a grid of view-space clusters (froxels), so
+ * shading only needs to consider the lights overlapping its cluster.
+ *
+ * The grid can either be built on the CPU and uploaded, or built on the GPU
+ * with a compute pass. Both builders consume the same view-space cluster
+ * bounds and lights, prepared on the CPU, and evaluate the same intersection
+ * test in the same order, so they produce the same grid. Either way, the
+ * result is bound to shaders through getGridHandle(), see
+ * Shaders/LightClusters.glsl. PBR shading uses the grid set in
+ * GlobalUniforms::lightClusterGridHandle.
+ */
+class ALTHEA_API LightClusters {
+public:
+  LightClusters() = default;
+  LightClusters(const Application& app, GlobalHeap& heap);
+
+  /**
+   * @brief Build the light grid on the CPU, spread over multiple threads, and
+   * upload it for the current frame.
+   */
+  void build(
+      const FrameContext& frame,
+      const Camera& camera,
+      const PointLightCollection& lights);
+
+  /**
+   * @brief Build the light grid for the current frame with a compute pass.
+   * The grid is ready to be read by any subsequent compute or fragment
+   * shaders in the command buffer.
+   */
+  void dispatch(
+      VkCommandBuffer commandBuffer,
+      GlobalHeap& heap,
+      const FrameContext& frame,
+      const Camera& camera,
+      const PointLightCollection& lights);
+
+  /**
+   * @brief Build the grid on the CPU, then run the compute pass right away,
+   * read its grid back and compare the two. Meant for testing the GPU path,
+   * e.g., on lavapipe, since it waits for the GPU to finish.
+   *
+   * Must be called while the current frame's buffers are not in use by the
+   * GPU. Leaves the GPU grid bound, as if dispatch() was called last.
+   *
+   * @return The number of clusters whose light lists don't match, plus one
+   * if the headers don't match. Each mismatch is also printed.
+   */
+  uint32_t validateGpuBuild(
+      const Application& app,
+      GlobalHeap& heap,
+      const FrameContext& frame,
+      const Camera& camera,
+      const PointLightCollection& lights);
+
+  /**
+   * @brief The grid built by the last call to build() or dispatch(), to be
+   * bound as GlobalUniforms::lightClusterGridHandle.
+   */
+  BufferHandle getGridHandle(const FrameContext& frame) const {
+    uint32_t ringIdx = frame.frameRingBufferIndex;
+    return m_builtOnDevice ? m_deviceGridBuffers[ringIdx].handle
+                           : m_gridBuffers[ringIdx].handle;
+  }
+
+  /**
+   * @brief The grid produced by the last call to build(), laid out the same
+   * way as the GPU buffer.
+   */
+  const std::vector<uint32_t>& getCpuGrid() const { return m_cpuGrid; }
+
+  static size_t getGridByteSize();
+
+private:
+  void _prepareInputs(
+      const Camera& camera,
+      const PointLightCollection& lights);
+  void _computeClusterBounds(const Camera& camera);
+  void _buildSlices(uint32_t firstSlice, uint32_t sliceCount);
+  void _uploadInputs(GlobalHeap& heap, const FrameContext& frame);
+
+  struct ClusterBuffer {
+    BufferHandle handle{};
+    BufferAllocation allocation{};
+    size_t size = 0;
+  };
+
+  static void _allocateBuffer(
+      GlobalHeap& heap,
+      ClusterBuffer& buffer,
+      size_t size,
+      bool hostWritable = true);
+
+  // Written by the CPU builder
+  std::array<ClusterBuffer, MAX_FRAMES_IN_FLIGHT> m_gridBuffers{};
+  // Written by the GPU builder, allocated on first use
+  std::array<ClusterBuffer, MAX_FRAMES_IN_FLIGHT> m_deviceGridBuffers{};
+  bool m_builtOnDevice = false;
+  std::array<ClusterBuffer, MAX_FRAMES_IN_FLIGHT> m_boundsBuffers{};
+  std::array<ClusterBuffer, MAX_FRAMES_IN_FLIGHT> m_lightBuffers{};
+
+  // Bumped whenever the cluster bounds are recomputed, so each per-frame
+  // bounds buffer is only re-uploaded when it is stale.
+  uint32_t m_boundsVersion = 0;
+  std::array<uint32_t, MAX_FRAMES_IN_FLIGHT> m_uploadedBoundsVersions{};
+
+  // Projection parameters the cluster bounds were computed with
+  glm::mat4 m_projection{};
+  float m_zNear = 0.0f;
+  float m_zFar = 0.0f;
+
+  std::vector<LightClusterBounds> m_clusterBounds;
+  std::vector<LightClusterLight> m_lights;
+
+  // The lights in SoA layout, padded to a multiple of four, for the SIMD
+  // CPU builder
+  std::vector<float> m_lightX;
+  std::vector<float> m_lightY;
+  std::vector<float> m_lightZ;
+  std::vector<float> m_lightRadiusSq;
+
+  std::vector<uint32_t> m_cpuGrid;
+
+  ComputePipeline m_buildCompute{};
+};
+} // namespace AltheaEngine
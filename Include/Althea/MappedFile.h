@@ -0,0 +1,62 @@
+#pragma once
+
+#include "Library.h"
+
+#include <gsl/span>
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace AltheaEngine {
+/**
+ * @brief A read-only view of a whole file, mapped into memory.
+ *
+ * Pages are only read from disk when first touched, and come straight from
+ * the OS page cache, so reading a large file through the mapping costs no
+ * copies beyond what the consumer makes. The mapping stays valid for the
+ * lifetime of the object, even if the file is deleted or replaced.
+ *
+ * Files are read into memory instead on platforms without mmap.
+ */
+class ALTHEA_API MappedFile {
+public:
+  /**
+   * @brief Map the file at the given path. Returns nullptr if the file can't
+   * be opened or mapped, or is empty.
+   */
+  static std::unique_ptr<MappedFile> open(const std::string& path);
+
+  ~MappedFile();
+
+  MappedFile(MappedFile&& rhs) = delete;
+  MappedFile& operator=(MappedFile&& rhs) = delete;
+  MappedFile(const MappedFile& rhs) = delete;
+  MappedFile& operator=(const MappedFile& rhs) = delete;
+
+  const char* getData() const { return m_pData; }
+  size_t getSize() const { return m_size; }
+
+  gsl::span<const std::byte> getBytes() const {
+    return gsl::span<const std::byte>(
+        reinterpret_cast<const std::byte*>(m_pData),
+        m_size);
+  }
+
+  /**
+   * @brief Hint that the whole file is about to be read, so the OS starts
+   * reading it in ahead of the first access.
+   */
+  void prefetch() const;
+
+private:
+  MappedFile() = default;
+
+  const char* m_pData = nullptr;
+  size_t m_size = 0;
+#ifdef _WIN32
+  std::vector<char> m_data;
+#endif
+};
+} // namespace AltheaEngine
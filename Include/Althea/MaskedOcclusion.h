@@ -0,0 +1,152 @@
+#pragma once
+
+#include "Library.h"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <future>
+#include <vector>
+
+namespace AltheaEngine {
+class Model;
+class SceneBVH;
+
+/**
+ * @brief A triangle mesh drawn into the occlusion buffer. The mesh data is
+ * referenced, not copied, and must outlive any render that uses it.
+ */
+struct ALTHEA_API OccluderMesh {
+  // Object-space positions, vertexStride bytes apart
+  const glm::vec3* pPositions = nullptr;
+  uint32_t vertexStride = sizeof(glm::vec3);
+  uint32_t vertexCount = 0;
+
+  const uint32_t* pIndices = nullptr;
+  uint32_t indexCount = 0;
+
+  glm::mat4 transform{1.0f};
+};
+
+/**
+ * @brief A low-resolution software depth buffer for occlusion culling on the
+ * CPU, in the style of masked occlusion culling.
+ *
+ * The screen is split into 8x4 pixel tiles. Instead of per-pixel depths,
+ * each tile stores a 32-bit coverage mask and two depth layers: a
+ * conservative farthest depth for the whole tile, and the farthest depth of
+ * the pixels covered so far in the mask. Once the mask fills the tile, the
+ * second layer replaces the first. Coverage masks are computed for a whole
+ * row of tile pixels at a time with SIMD edge functions.
+ *
+ * Occluders are rasterized in parallel, each thread owning a horizontal band
+ * of tiles. Nothing here touches the GPU, depth uses the [0, 1] Vulkan clip
+ * space convention with larger values further away.
+ */
+class ALTHEA_API MaskedOcclusionBuffer {
+public:
+  static constexpr uint32_t TILE_WIDTH = 8;
+  static constexpr uint32_t TILE_HEIGHT = 4;
+
+  MaskedOcclusionBuffer() = default;
+
+  /**
+   * @brief Create an occlusion buffer with the given resolution, rounded up
+   * to a whole number of tiles.
+   */
+  MaskedOcclusionBuffer(uint32_t width, uint32_t height);
+
+  /**
+   * @brief Clear the buffer and rasterize the occluders from the given view.
+   *
+   * @param viewProjection The view-projection matrix of the camera.
+   * @param occluders The meshes to rasterize.
+   * @param threadCount The number of tasks to split the work into, run on the
+   * shared ThreadPool. 0 uses one per thread of the pool.
+   */
+  void render(
+      const glm::mat4& viewProjection,
+      const std::vector<OccluderMesh>& occluders,
+      uint32_t threadCount = 0);
+
+  /**
+   * @brief Start rendering on the shared ThreadPool, so it can overlap with
+   * other frame work. The buffer must not be queried or rendered again until the
+   * returned future completes.
+   */
+  std::future<void> renderAsync(
+      const glm::mat4& viewProjection,
+      const std::vector<OccluderMesh>& occluders,
+      uint32_t threadCount = 0);
+
+  /**
+   * @brief Whether a world-space box is guaranteed to be hidden behind the
+   * rasterized occluders. Boxes crossing the near plane are never occluded.
+   */
+  bool isOccluded(const glm::vec3& min, const glm::vec3& max) const;
+
+  /**
+   * @brief Remove the items of the scene BVH that are occluded from a list
+   * of visible items, e.g., the output of frustum culling.
+   */
+  void removeOccluded(const SceneBVH& bvh, std::vector<uint32_t>& items) const;
+
+  /**
+   * @brief Collect an occluder mesh for every instance of the primitives
+   * marked as occluders in the given models.
+   */
+  static void gatherOccluders(
+      const std::vector<Model>& models,
+      std::vector<OccluderMesh>& occluders);
+
+  uint32_t getWidth() const { return m_width; }
+  uint32_t getHeight() const { return m_height; }
+  uint32_t getTilesX() const { return m_tilesX; }
+  uint32_t getTilesY() const { return m_tilesY; }
+
+  /**
+   * @brief The conservative farthest depth of a tile.
+   */
+  float getTileDepth(uint32_t tileX, uint32_t tileY) const {
+    return m_tileDepths[tileY * m_tilesX + tileX];
+  }
+
+private:
+  // A screen-space triangle, x and y in pixels and z in [0, 1]
+  struct ScreenTriangle {
+    glm::vec3 v[3];
+  };
+
+  void _setupTriangles(
+      const std::vector<OccluderMesh>& occluders,
+      size_t firstOccluder,
+      size_t occluderCount,
+      std::vector<ScreenTriangle>& triangles) const;
+  void _emitTriangle(
+      const glm::vec4& a,
+      const glm::vec4& b,
+      const glm::vec4& c,
+      std::vector<ScreenTriangle>& triangles) const;
+  void _rasterizeBand(uint32_t firstTileRow, uint32_t tileRowCount);
+  void _rasterizeTriangle(
+      const ScreenTriangle& triangle,
+      uint32_t firstTileRow,
+      uint32_t tileRowCount);
+
+  uint32_t m_width = 0;
+  uint32_t m_height = 0;
+  uint32_t m_tilesX = 0;
+  uint32_t m_tilesY = 0;
+
+  glm::mat4 m_viewProjection{1.0f};
+
+  // Per tile: the conservative farthest depth of the whole tile, the
+  // farthest depth of the covered pixels and the coverage mask
+  std::vector<float> m_tileDepths;
+  std::vector<float> m_workingDepths;
+  std::vector<uint32_t> m_coverageMasks;
+
+  // Screen-space triangles from each setup task
+  std::vector<std::vector<ScreenTriangle>> m_triangleBins;
+};
+} // namespace AltheaEngine
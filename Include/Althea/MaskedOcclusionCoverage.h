@@ -0,0 +1,60 @@
+#pragma once
+
+#include "Library.h"
+
+#include <cstdint>
+
+namespace AltheaEngine {
+/**
+ * @brief The coverage kernel of the masked occlusion rasterizer, computing
+ * which pixels of an 8x4 tile are inside a triangle.
+ *
+ * The AVX2 variant is built separately with AVX2 enabled and only used once
+ * the CPU has been checked to support it, so the engine itself doesn't need
+ * to be built for AVX2.
+ */
+class ALTHEA_API MaskedOcclusionCoverage {
+public:
+  /**
+   * @brief Computes the coverage mask of a tile, one bit per pixel, row by
+   * row from the lowest bit.
+   *
+   * @param edgeA The x coefficient of each of the three edge functions.
+   * @param rowC The constant term of each edge function for each of the four
+   * rows, evaluated at the row's pixel centers.
+   * @param tileMinX The x coordinate of the tile's left edge.
+   */
+  typedef uint32_t (*TileCoverageFunction)(
+      const float edgeA[3],
+      const float rowC[4][3],
+      float tileMinX);
+
+  /**
+   * @brief The SSE2 variant, or the scalar variant where SSE2 isn't
+   * available.
+   */
+  static uint32_t computeTileCoverage(
+      const float edgeA[3],
+      const float rowC[4][3],
+      float tileMinX);
+
+  /**
+   * @brief The AVX2 variant, must only be called if isAVX2Supported().
+   */
+  static uint32_t computeTileCoverageAVX2(
+      const float edgeA[3],
+      const float rowC[4][3],
+      float tileMinX);
+
+  /**
+   * @brief Whether the CPU and OS support AVX2 and the AVX2 variant was
+   * built.
+   */
+  static bool isAVX2Supported();
+
+  /**
+   * @brief The fastest variant the CPU supports, chosen once.
+   */
+  static TileCoverageFunction getTileCoverageFunction();
+};
+} // namespace AltheaEngine
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "Common/InstanceDataCommon.h"
+#include "Library.h"
+
+#include <gsl/span>
+
+#include <cstdint>
+#include <vector>
+
+namespace AltheaEngine {
+
+/**
+ * @brief A contiguous range of indices making up one level of detail of a
+ * mesh. All LODs of a mesh reference the same vertex buffer.
+ */
+struct ALTHEA_API MeshLod {
+  uint32_t firstIndex = 0;
+  uint32_t indexCount = 0;
+
+  // Approximate object-space distance between this LOD and the full-detail
+  // mesh.
+  float error = 0.0f;
+};
+
+class ALTHEA_API MeshSimplification {
+public:
+  /**
+   * @brief Simplify an indexed triangle mesh by collapsing edges in order of
+   * increasing quadric error.
+   *
+   * Vertices on UV / normal seams and on open borders are locked, so the
+   * simplified mesh has the same attribute discontinuities as the source.
+   * Edge collapses always move a vertex onto one of its existing neighbors,
+   * so no vertex data is ever interpolated - joints and weights of skinned
+   * meshes stay valid. Collapses across vertices bound to different dominant
+   * joints are rejected.
+   *
+   * @param vertices The vertex buffer, it is not modified.
+   * @param indices The triangle list to simplify.
+   * @param targetIndexCount The index count to stop simplifying at.
+   * @param maxError The largest error allowed, relative to the extent of the
+   * mesh.
+   * @param pResultError Optionally returns the object-space error of the
+   * result.
+   * @return The simplified triangle list, referencing the original vertices.
+   */
+  static std::vector<uint32_t> simplify(
+      gsl::span<const Vertex> vertices,
+      gsl::span<const uint32_t> indices,
+      size_t targetIndexCount,
+      float maxError,
+      float* pResultError = nullptr);
+
+  /**
+   * @brief Generate a chain of LODs, each one independently simplified from
+   * the full-detail mesh. The LODs are simplified in parallel.
+   *
+   * @param vertices The vertex buffer shared by all LODs.
+   * @param indices The full-detail triangle list.
+   * @param lodCount The number of LODs to generate, not including the
+   * full-detail mesh.
+   * @param reductionPerLod The fraction of triangles to keep from one LOD to
+   * the next.
+   * @param maxError The largest error allowed, relative to the extent of the
+   * mesh.
+   * @param lodIndices The concatenated indices of the generated LODs.
+   * @return The generated LODs, indexing into lodIndices. Generation stops
+   * early once simplification no longer makes progress, so fewer than
+   * lodCount LODs may be returned.
+   */
+  static std::vector<MeshLod> generateLods(
+      gsl::span<const Vertex> vertices,
+      gsl::span<const uint32_t> indices,
+      uint32_t lodCount,
+      float reductionPerLod,
+      float maxError,
+      std::vector<uint32_t>& lodIndices);
+};
+} // namespace AltheaEngine
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "Common/InstanceDataCommon.h"
+#include "Frustum.h"
+#include "Library.h"
+
+#include <glm/glm.hpp>
+#include <gsl/span>
+
+#include <cstdint>
+#include <vector>
+
+namespace AltheaEngine {
+class ALTHEA_API MeshletUtilities {
+public:
+  /**
+   * @brief Split an indexed triangle mesh into meshlets of at most
+   * MESHLET_MAX_VERTICES vertices and MESHLET_MAX_TRIANGLES triangles.
+   *
+   * Meshlets are grown greedily across neighboring triangles, preferring
+   * triangles that add the fewest new vertices, so each meshlet stays
+   * spatially compact and its bounds are useful for culling.
+   *
+   * @param vertices The vertex buffer of the mesh.
+   * @param indices The triangle list of the mesh.
+   * @param meshlets The generated meshlets, including their bounds.
+   * @param meshletData The packed vertex indices and triangles referenced by
+   * the meshlets, see Meshlet.
+   */
+  static void buildMeshlets(
+      gsl::span<const Vertex> vertices,
+      gsl::span<const uint32_t> indices,
+      std::vector<Meshlet>& meshlets,
+      std::vector<uint32_t>& meshletData);
+
+  /**
+   * @brief Compute the bounding sphere and normal cone of a meshlet whose
+   * vertex and triangle ranges are already filled in.
+   */
+  static void computeMeshletBounds(
+      gsl::span<const Vertex> vertices,
+      gsl::span<const uint32_t> meshletData,
+      Meshlet& meshlet);
+
+  /**
+   * @brief CPU reference implementation of per-meshlet culling, tests each
+   * meshlet against the frustum and its normal cone against the viewer.
+   *
+   * @param meshlets The meshlets of a primitive.
+   * @param transform The object-to-world transform of the primitive.
+   * @param frustum The world-space view frustum.
+   * @param cameraPosition The world-space position of the viewer.
+   * @param visibleMeshlets The indices of the meshlets that survive culling.
+   * @return The number of visible meshlets.
+   */
+  static uint32_t cullMeshlets(
+      gsl::span<const Meshlet> meshlets,
+      const glm::mat4& transform,
+      const Frustum& frustum,
+      const glm::vec3& cameraPosition,
+      std::vector<uint32_t>& visibleMeshlets);
+
+  /**
+   * @brief Whether the given world-space meshlet bounds are visible.
+   */
+  static bool isMeshletVisible(
+      const Meshlet& meshlet,
+      const Frustum& frustum,
+      const glm::vec3& cameraPosition);
+};
+} // namespace AltheaEngine
@@ -10,19 +10,23 @@
 #include "SingleTimeCommandBuffer.h"
 #include "StructuredBuffer.h"
 
+#include <CesiumAsync/Future.h>
 #include <CesiumGltf/Model.h>
+#include <CesiumGltfReader/GltfReader.h>
 #include <glm/glm.hpp>
 #include <vulkan/vulkan.h>
 
 #include <array>
 #include <memory>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 namespace AltheaEngine {
 class Application;
 class GraphicsPipeline;
 class DescriptorSetAllocator;
+class ModelLoadHandle;
 
 struct Skin {
   StructuredBuffer<uint32_t> jointMap;
@@ -34,9 +38,21 @@ struct Node {
   int32_t meshIdx = -1;
 };
 
+// A unique glTF mesh / skin pair, shared by every node that references it.
 struct Mesh {
   uint32_t primitiveStartIdx = 0;
   uint32_t primitiveCount = 0;
+
+  int32_t gltfMeshIdx = -1;
+  int32_t skinIdx = -1;
+
+  // The nodes instancing this mesh, and where their indices start in the
+  // model's instance node buffer
+  std::vector<uint32_t> instanceNodes;
+  uint32_t firstInstance = 0;
+
+  // Union of the local bounds of the mesh's primitives
+  AABB localBounds = AABB::createEmpty();
 };
 
 class ALTHEA_API Model {
@@ -46,12 +62,50 @@ public:
 
   // TODO: Create version that can take regular VkCommandBuffer
   Model(
-      const Application& app,
+      Application& app,
       SingleTimeCommandBuffer& commandBuffer,
       GlobalHeap& heap,
       const std::string& path,
       const glm::mat4& transform = glm::mat4(1.0f));
 
+  /**
+   * @brief Set up everything that doesn't touch the GPU: the node hierarchy,
+   * mesh instancing, texture color spaces and the geometry of every
+   * primitive, including meshlets and LODs. Safe to call from a worker
+   * thread. The model can't be used until every upload step has been run.
+   */
+  Model(CesiumGltf::Model&& gltfModel, const glm::mat4& transform);
+
+  /**
+   * @brief Read and parse a glTF file on a worker thread, then fetch and
+   * decode the external buffers and images it references in parallel.
+   *
+   * @param path The glTF or glb file to read.
+   * @param pHandle If given, is told about the progress of the external
+   * fetches, and the remaining work is skipped once it is cancelled.
+   */
+  static CesiumAsync::Future<CesiumGltfReader::GltfReaderResult> readGltfAsync(
+      const std::string& path,
+      const std::shared_ptr<ModelLoadHandle>& pHandle = nullptr);
+
+  /**
+   * @brief The number of steps the GPU resources are created in, see
+   * runUploadStep.
+   */
+  uint32_t getUploadStepCount() const;
+
+  /**
+   * @brief Create and upload one step's worth of GPU resources: all skins,
+   * a single texture, all materials, a single mesh's primitives or the node
+   * transforms. Steps must be run in order, from the main thread, and may be
+   * spread over several frames and command buffers.
+   */
+  void runUploadStep(
+      uint32_t stepIdx,
+      Application& app,
+      SingleTimeCommandBuffer& commandBuffer,
+      GlobalHeap& heap);
+
   void setNodeRelativeTransform(uint32_t nodeIdx, const glm::mat4& transform);
   void recomputeTransforms();
   void uploadTransforms(const FrameContext& frame) {
@@ -79,6 +133,21 @@ public:
     return -1;
   }
 
+  /**
+   * @brief The world-space bounds of everything under the given node,
+   * including the node's own mesh. Updated by recomputeTransforms. Skinned
+   * meshes are bounded in their bind pose.
+   */
+  const AABB& getNodeBounds(uint32_t nodeIdx) const {
+    return _nodeBounds[nodeIdx];
+  }
+
+  /**
+   * @brief The world-space bounds of the whole model, updated by
+   * recomputeTransforms.
+   */
+  const AABB& getBounds() const { return _bounds; }
+
   const CesiumGltf::Model& getGltfModel() const { return _model; }
 
   const std::vector<Primitive>& getPrimitives() const {
@@ -94,18 +163,45 @@ private:
 
   std::vector<Skin> _skins;
   DynamicVertexBuffer<glm::mat4> _nodeTransforms;
+  StructuredBuffer<uint32_t> _instanceNodes;
   std::vector<Primitive> _primitives;
+  // Built by the CPU-side constructor, in the order the mesh upload steps
+  // create the primitives, and moved into them as they are created
+  std::vector<PrimitiveGeometry> _primitiveGeometry;
   std::vector<Material> _materials;
   std::vector<Texture> _textures;
 
   glm::mat4 _modelTransform;
 
+  // Whether each texture holds colors, inferred from the materials
+  std::vector<bool> _isTextureSrgb;
+
+  // Subtree bounds per node, and the bounds of the whole model
+  std::vector<AABB> _nodeBounds;
+  AABB _bounds = AABB::createEmpty();
+
   void _updateTransforms(int32_t nodeIdx, const glm::mat4& transform);
   void _loadNode(
+      int32_t nodeIdx,
+      const glm::mat4& parentTransform,
+      std::unordered_map<uint64_t, uint32_t>& meshLookup);
+  bool _hasNodes() const;
+  uint32_t _getMeshStepCount() const;
+  const CesiumGltf::Mesh& _getMeshStepGltfMesh(uint32_t meshIdx) const;
+  void _buildPrimitiveGeometry();
+  void _createSkins(
       const Application& app,
       SingleTimeCommandBuffer& commandBuffer,
-      GlobalHeap& heap,
-      int32_t nodeIdx,
-      const glm::mat4& parentTransform);
+      GlobalHeap& heap);
+  void _createMaterials(
+      const Application& app,
+      SingleTimeCommandBuffer& commandBuffer,
+      GlobalHeap& heap);
+  void _createPrimitives(
+      uint32_t meshIdx,
+      Application& app,
+      SingleTimeCommandBuffer& commandBuffer,
+      GlobalHeap& heap);
+  void _createTransforms(const Application& app, GlobalHeap& heap);
 };
 } // namespace AltheaEngine
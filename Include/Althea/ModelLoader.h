@@ -0,0 +1,147 @@
+#pragma once
+
+#include "GlobalHeap.h"
+#include "Library.h"
+#include "Model.h"
+
+#include <glm/glm.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace AltheaEngine {
+class Application;
+
+enum class ALTHEA_API ModelLoadState {
+  // Reading, fetching and decoding on worker threads
+  LOADING,
+  // Creating GPU resources on the main thread, a few each frame
+  UPLOADING,
+  READY,
+  FAILED,
+  CANCELLED
+};
+
+/**
+ * @brief Tracks a model being loaded by a ModelLoader. Safe to query and
+ * cancel from any thread.
+ */
+class ALTHEA_API ModelLoadHandle {
+public:
+  ModelLoadHandle(const std::string& path, const glm::mat4& transform);
+
+  const std::string& getPath() const { return m_path; }
+
+  ModelLoadState getState() const { return m_state; }
+
+  /**
+   * @brief Whether the load has finished, successfully or not.
+   */
+  bool isDone() const;
+
+  /**
+   * @brief Roughly how far along the load is, from 0 to 1. Loading on the
+   * workers and uploading each make up half.
+   */
+  float getProgress() const;
+
+  /**
+   * @brief Stop loading as soon as possible. Work already running on the
+   * workers is skipped where possible, and any resources created so far are
+   * released once the GPU is done uploading to them.
+   */
+  void cancel() { m_cancelled = true; }
+
+  bool isCancelled() const { return m_cancelled; }
+
+  /**
+   * @brief The reason the load failed, only valid once FAILED.
+   */
+  std::string getError() const;
+
+  /**
+   * @brief Take ownership of the loaded model. Returns nullptr unless the
+   * load is READY, or if the model was already taken.
+   */
+  std::unique_ptr<Model> takeModel();
+
+  /**
+   * @brief Progress reported by Model::readGltfAsync from the workers, as
+   * external buffers and images are queued and fetched.
+   */
+  void addExternalDataCount(uint32_t count) { m_externalDataCount += count; }
+  void onExternalDataLoaded() { ++m_externalDataLoaded; }
+
+private:
+  friend class ModelLoader;
+
+  void _onParsed(std::unique_ptr<Model>&& pModel);
+  void _fail(const std::string& error);
+
+  std::string m_path;
+  glm::mat4 m_transform;
+
+  std::atomic<ModelLoadState> m_state{ModelLoadState::LOADING};
+  std::atomic<bool> m_cancelled{false};
+
+  std::atomic<uint32_t> m_externalDataCount{0};
+  std::atomic<uint32_t> m_externalDataLoaded{0};
+  std::atomic<uint32_t> m_uploadStepCount{0};
+  std::atomic<uint32_t> m_uploadStepsDone{0};
+
+  // Written by the workers before the state leaves LOADING, only touched by
+  // the main thread after that
+  mutable std::mutex m_mutex;
+  std::unique_ptr<Model> m_pModel;
+  std::string m_error;
+};
+
+/**
+ * @brief Streams models in without stalling the main thread.
+ *
+ * Reading the file, parsing it, fetching external buffers and images and
+ * decoding them all run on the shared ThreadPool, as does setting up the
+ * node hierarchy. Once that's done, update() creates the model's GPU
+ * resources a few at a time, recording them into command buffers that are
+ * submitted through the application's UploadRing. It stops for the frame as
+ * soon as the ring's per-frame upload budget is used up, so loading a large
+ * level is spread over many frames instead of causing a hitch.
+ *
+ * Loads are uploaded in the order they were started. A model is READY once
+ * all of its uploads are submitted, and can be drawn right away.
+ */
+class ALTHEA_API ModelLoader {
+public:
+  ModelLoader() = default;
+  ~ModelLoader();
+
+  ModelLoader(ModelLoader&& rhs) = default;
+  ModelLoader& operator=(ModelLoader&& rhs) = default;
+  ModelLoader(const ModelLoader& rhs) = delete;
+  ModelLoader& operator=(const ModelLoader& rhs) = delete;
+
+  /**
+   * @brief Start loading a model in the background.
+   */
+  std::shared_ptr<ModelLoadHandle>
+  load(const std::string& path, const glm::mat4& transform = glm::mat4(1.0f));
+
+  /**
+   * @brief Make progress on the pending loads' uploads, within the upload
+   * ring's budget. Must be called from the main thread, once per frame.
+   */
+  void update(Application& app, GlobalHeap& heap);
+
+  /**
+   * @brief The number of loads that are not done yet.
+   */
+  size_t getPendingCount() const { return m_pending.size(); }
+
+private:
+  std::vector<std::shared_ptr<ModelLoadHandle>> m_pending;
+};
+} // namespace AltheaEngine
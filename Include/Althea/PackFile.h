@@ -0,0 +1,103 @@
+#pragma once
+
+#include "FileBufferPool.h"
+#include "Library.h"
+#include "MappedFile.h"
+
+#include <gsl/span>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace AltheaEngine {
+enum class ALTHEA_API PackCompression : uint32_t {
+  // Stored as is, can be viewed in place in the mapping
+  NONE = 0,
+  // LZ4 block format, decompressed on every read
+  LZ4 = 1
+};
+
+/**
+ * @brief A single file packing many assets, built offline by
+ * Tools/AssetPacker.
+ *
+ * The pack starts with an index of fixed-size entries sorted by the hash of
+ * their names, followed by the names and the aligned contents of every
+ * entry. It is memory mapped where supported, so a lookup is a binary search
+ * of the index and uncompressed entries are read straight out of the
+ * mapping.
+ *
+ * Entry names are paths relative to the packed directory, with '/'
+ * separators.
+ *
+ * A pack is immutable once opened, all functions are safe to call from
+ * multiple threads.
+ */
+class ALTHEA_API PackFile {
+public:
+  struct Source {
+    // The name the file is stored under in the pack
+    std::string name;
+    // Where the file is read from when packing
+    std::string path;
+  };
+
+  /**
+   * @brief Open the pack at the given path. Returns nullptr if it doesn't
+   * exist or isn't a valid pack.
+   */
+  static std::unique_ptr<PackFile> open(const std::string& path);
+
+  /**
+   * @brief Pack the given files into a pack at the given path, replacing any
+   * existing pack. Entries are only stored compressed when that makes them
+   * meaningfully smaller. Throws if a file can't be read or the pack can't
+   * be written.
+   */
+  static void write(
+      const std::string& path,
+      const std::vector<Source>& sources,
+      PackCompression compression);
+
+  uint32_t getEntryCount() const { return m_entryCount; }
+
+  bool contains(const std::string& name) const;
+
+  /**
+   * @brief The contents of an entry stored uncompressed, in place in the
+   * mapping. Only valid while the pack is alive.
+   *
+   * @return std::nullopt if there is no such entry or it is compressed.
+   */
+  std::optional<gsl::span<const std::byte>>
+  view(const std::string& name) const;
+
+  /**
+   * @brief Copy the contents of an entry into result, decompressing them if
+   * needed.
+   *
+   * @return Whether the entry exists and could be read.
+   */
+  bool read(const std::string& name, std::vector<char>& result) const;
+  bool read(const std::string& name, FileBuffer& result) const;
+
+private:
+  struct IndexEntry;
+
+  PackFile() = default;
+
+  bool _validate();
+  const IndexEntry* _find(const std::string& name) const;
+  bool _extract(const IndexEntry& entry, char* pDst) const;
+
+  std::unique_ptr<MappedFile> m_pFile;
+  const IndexEntry* m_pEntries = nullptr;
+  uint32_t m_entryCount = 0;
+  const char* m_pNames = nullptr;
+  size_t m_namesSize = 0;
+};
+} // namespace AltheaEngine
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "FileBufferPool.h"
+#include "Library.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace AltheaEngine {
+class PackFile;
+
+/**
+ * @brief Serves files from mounted PackFiles in place of the loose files on
+ * disk.
+ *
+ * Each pack is mounted over a directory, files under that directory are
+ * looked up in the pack by their path relative to it. Packs mounted later
+ * take precedence, and files that aren't in any pack are still read from
+ * disk, so loose files can be added on top of a packed directory.
+ *
+ * All functions are safe to call from any thread.
+ */
+class ALTHEA_API PackFileSystem {
+public:
+  /**
+   * @brief Mount the pack at packPath over the given directory.
+   *
+   * @return Whether the pack exists and could be opened.
+   */
+  static bool mount(const std::string& packPath, const std::string& directory);
+
+  /**
+   * @brief Unmount the pack at packPath. Reads in flight keep it open until
+   * they finish.
+   */
+  static void unmount(const std::string& packPath);
+  static void unmountAll();
+
+  /**
+   * @brief Find the mounted pack containing the file at the given path.
+   *
+   * @param name Set to the name of the file within the pack.
+   * @return The pack, or nullptr if no mounted pack contains the file.
+   */
+  static std::shared_ptr<const PackFile>
+  find(const std::string& path, std::string& name);
+
+  static bool contains(const std::string& path);
+
+  /**
+   * @brief Read the file at the given path out of a mounted pack.
+   *
+   * @return Whether a mounted pack contains the file and it could be read.
+   */
+  static bool readFile(const std::string& path, std::vector<char>& result);
+  static bool readFile(const std::string& path, FileBuffer& result);
+};
+} // namespace AltheaEngine
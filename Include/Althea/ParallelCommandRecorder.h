@@ -0,0 +1,101 @@
+#pragma once
+
+#include "FrameContext.h"
+#include "Library.h"
+
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace AltheaEngine {
+class Application;
+
+/**
+ * @brief Hands out secondary command buffers to worker threads, so draws
+ * within a render pass can be recorded in parallel.
+ *
+ * Command pools must be externally synchronized, so each worker slot owns
+ * its own pool for every frame in flight. A worker slot must only be used by
+ * one thread at a time. The pools of a frame are reset all at once in
+ * beginFrame(), once the GPU is done with that frame's command buffers.
+ *
+ * See ActiveRenderPass::recordParallel for the usual way to use this.
+ */
+class ALTHEA_API ParallelCommandRecorder {
+public:
+  ParallelCommandRecorder() = default;
+  ParallelCommandRecorder(const Application& app);
+  ~ParallelCommandRecorder();
+
+  ParallelCommandRecorder(ParallelCommandRecorder&& rhs) = delete;
+  ParallelCommandRecorder&
+  operator=(ParallelCommandRecorder&& rhs) = delete;
+  ParallelCommandRecorder(const ParallelCommandRecorder& rhs) = delete;
+  ParallelCommandRecorder&
+  operator=(const ParallelCommandRecorder& rhs) = delete;
+
+  /**
+   * @brief Recycle the command buffers of the given frame. Must be called
+   * from the main thread after the frame's fence has been waited on and
+   * before any secondary command buffers are acquired for it.
+   */
+  void beginFrame(const FrameContext& frame);
+
+  /**
+   * @brief Make sure there are at least the given number of worker slots.
+   * Must be called from the main thread while no workers are recording.
+   */
+  void reserveWorkers(uint32_t workerCount);
+
+  /**
+   * @brief Acquire a secondary command buffer from a worker's pool and begin
+   * it for use within the given subpass. Safe to call from the thread
+   * currently owning the worker slot.
+   *
+   * @param workerIdx The worker slot, see reserveWorkers.
+   * @param frame The frame being recorded.
+   * @param renderPass The render pass the commands will be executed in.
+   * @param subpass The index of the subpass within the render pass.
+   * @param frameBuffer The frame buffer, if known, which may let the driver
+   * optimize the commands.
+   */
+  VkCommandBuffer beginSecondary(
+      uint32_t workerIdx,
+      const FrameContext& frame,
+      VkRenderPass renderPass,
+      uint32_t subpass,
+      VkFramebuffer frameBuffer = VK_NULL_HANDLE);
+
+  /**
+   * @brief Finish recording a secondary command buffer.
+   */
+  void endSecondary(VkCommandBuffer commandBuffer);
+
+  uint32_t getWorkerCount() const {
+    return static_cast<uint32_t>(m_workers.size());
+  }
+
+  /**
+   * @brief The number of workers that keeps every thread of the shared
+   * ThreadPool busy, along with the recording thread.
+   */
+  static uint32_t getDefaultWorkerCount();
+
+private:
+  struct WorkerPool {
+    VkCommandPool pool = VK_NULL_HANDLE;
+    std::vector<VkCommandBuffer> commandBuffers;
+    // The number of command buffers handed out since the pool was last reset
+    uint32_t usedCount = 0;
+  };
+
+  typedef std::array<WorkerPool, MAX_FRAMES_IN_FLIGHT> Worker;
+
+  VkDevice m_device = VK_NULL_HANDLE;
+  uint32_t m_queueFamilyIndex = 0;
+
+  std::vector<Worker> m_workers;
+};
+} // namespace AltheaEngine
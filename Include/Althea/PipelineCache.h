@@ -0,0 +1,59 @@
+#pragma once
+
+#include "Library.h"
+
+#include <vulkan/vulkan.h>
+
+#include <string>
+
+namespace AltheaEngine {
+/**
+ * @brief A VkPipelineCache shared by all pipelines, persisted to disk between
+ * runs.
+ *
+ * The driver's cache data is stored behind a small header holding its size
+ * and hash, so truncated or corrupted files are detected. The driver header
+ * is then checked against the vendor, device and pipeline cache UUID of the
+ * current device, a cache from a different device or driver version is
+ * discarded and the cache starts out empty.
+ *
+ * Vulkan pipeline caches are internally synchronized, so pipelines may be
+ * created with this cache from multiple threads at once.
+ */
+class ALTHEA_API PipelineCache {
+public:
+  PipelineCache(
+      VkDevice device,
+      const VkPhysicalDeviceProperties& properties,
+      const std::string& path);
+  ~PipelineCache();
+
+  PipelineCache(PipelineCache&& rhs) = delete;
+  PipelineCache& operator=(PipelineCache&& rhs) = delete;
+  PipelineCache(const PipelineCache& rhs) = delete;
+  PipelineCache& operator=(const PipelineCache& rhs) = delete;
+
+  /**
+   * @brief Write the current contents of the cache to disk. The file is
+   * replaced atomically, so a crash while saving keeps the previous cache.
+   *
+   * @return Whether the cache was written.
+   */
+  bool save() const;
+
+  /**
+   * @brief Whether valid cache data for this device was found on disk.
+   */
+  bool wasLoadedFromDisk() const { return m_loadedFromDisk; }
+
+  operator VkPipelineCache() const { return m_pipelineCache; }
+
+private:
+  VkDevice m_device;
+  VkPhysicalDeviceProperties m_properties;
+  std::string m_path;
+
+  VkPipelineCache m_pipelineCache = VK_NULL_HANDLE;
+  bool m_loadedFromDisk = false;
+};
+} // namespace AltheaEngine
@@ -3,10 +3,11 @@
 #include "Library.h"
 
 #include "DescriptorSet.h"
-#include "UniqueVkHandle.h"
+#include "ShaderReflection.h"
 
 #include <vulkan/vulkan.h>
 
+#include <cstdint>
 #include <vector>
 
 namespace AltheaEngine {
@@ -44,11 +45,57 @@ public:
   PipelineLayoutBuilder&
   addDescriptorSet(VkDescriptorSetLayout descriptorSetLayout);
 
+  /**
+   * @brief Derive the push constant ranges from the pipeline's shaders
+   * instead of declaring them with addPushConstants.
+   *
+   * @return This builder.
+   */
+  PipelineLayoutBuilder& reflectPushConstants();
+
+  /**
+   * @brief Check that the fixed-size part of the buffer block at the given
+   * set and binding matches the size of the C++ struct when the pipeline is
+   * created.
+   *
+   * @return This builder.
+   */
+  template <typename TBlock>
+  PipelineLayoutBuilder& expectBufferBlock(uint32_t set, uint32_t binding) {
+    this->_expectedBlocks.push_back(
+        {set, binding, static_cast<uint32_t>(sizeof(TBlock)), false});
+    return *this;
+  }
+
+  /**
+   * @brief Check that the elements of the runtime sized array ending the
+   * buffer block at the given set and binding match the size of the C++
+   * struct when the pipeline is created.
+   *
+   * @return This builder.
+   */
+  template <typename TElement>
+  PipelineLayoutBuilder&
+  expectBufferArrayElement(uint32_t set, uint32_t binding) {
+    this->_expectedBlocks.push_back(
+        {set, binding, static_cast<uint32_t>(sizeof(TElement)), true});
+    return *this;
+  }
+
 private:
   friend class PipelineLayout;
 
+  struct ExpectedBlock {
+    uint32_t set;
+    uint32_t binding;
+    uint32_t size;
+    bool runtimeArrayElement;
+  };
+
   std::vector<VkDescriptorSetLayout> _descriptorSetLayouts;
   std::vector<VkPushConstantRange> _pushConstantRanges;
+  std::vector<ExpectedBlock> _expectedBlocks;
+  bool _reflectPushConstants = false;
 };
 
 class ALTHEA_API PipelineLayout {
@@ -56,6 +103,17 @@ public:
   PipelineLayout() = default;
   PipelineLayout(const Application& app, const PipelineLayoutBuilder& builder);
 
+  /**
+   * @brief Create the layout, validating it against the reflected interface
+   * of the pipeline's shaders. Throws on any mismatch, e.g., a push constant
+   * struct whose size differs from the shader's block, or a shader using a
+   * descriptor set the layout doesn't have.
+   */
+  PipelineLayout(
+      const Application& app,
+      const PipelineLayoutBuilder& builder,
+      const ShaderReflection& reflection);
+
   operator VkPipelineLayout() const { return this->_layout; }
 
   const std::vector<VkPushConstantRange>& getPushConstantRanges() const {
@@ -63,11 +121,8 @@ public:
   }
 
 private:
-  struct PipelineLayoutDeleter {
-    void operator()(VkDevice device, VkPipelineLayout pipelineLayout);
-  };
-
-  UniqueVkHandle<VkPipelineLayout, PipelineLayoutDeleter> _layout;
+  // Owned by the application's LayoutCache, shared with identical layouts
+  VkPipelineLayout _layout = VK_NULL_HANDLE;
   std::vector<VkPushConstantRange> _pushConstantRanges;
 };
 } // namespace AltheaEngine
\ No newline at end of file
@@ -4,16 +4,20 @@
 #include "BufferUtilities.h"
 #include "ConstantBuffer.h"
 #include "DrawContext.h"
+#include "DrawList.h"
 #include "DynamicBuffer.h"
 #include "FrameBuffer.h"
 #include "FrameContext.h"
 #include "GlobalHeap.h"
+#include "GlobalUniforms.h"
 #include "IndexBuffer.h"
 #include "Library.h"
+#include "LightClusters.h"
 #include "Model.h"
 #include "PerFrameResources.h"
 #include "RenderPass.h"
 #include "RenderTarget.h"
+#include "SceneBVH.h"
 #include "SingleTimeCommandBuffer.h"
 #include "StructuredBuffer.h"
 #include "VertexBuffer.h"
@@ -27,6 +31,7 @@
 
 namespace AltheaEngine {
 class Application;
+class Camera;
 
 struct ALTHEA_API PointLight {
   alignas(16) glm::vec3 position;
@@ -49,6 +54,31 @@ public:
   void setLight(uint32_t lightId, const PointLight& light);
   void updateResource(const FrameContext& frame);
 
+  /**
+   * @brief Assign the lights to view-space clusters for the current frame on
+   * the CPU, so shading only loops over the lights near each pixel. Should be
+   * called every frame, after the lights and camera are updated.
+   */
+  void buildLightClusters(const FrameContext& frame, const Camera& camera);
+
+  /**
+   * @brief Same as buildLightClusters(), but records a compute pass that
+   * builds the light clusters on the GPU.
+   */
+  void dispatchLightClusters(
+      VkCommandBuffer commandBuffer,
+      GlobalHeap& heap,
+      const FrameContext& frame,
+      const Camera& camera);
+
+  /**
+   * @brief Fill in the light count, light buffer and light cluster grid of
+   * the current frame's global uniforms. The grid is left invalid until light
+   * clusters have been built, in which case shading loops over every light.
+   */
+  void setGlobalUniforms(const FrameContext& frame, GlobalUniforms& uniforms)
+      const;
+
   void setupPointLightMeshSubpass(
       SubpassBuilder& subpassBuilder,
       uint32_t colorAttachment,
@@ -63,6 +93,35 @@ public:
       BufferHandle globalResources);
   void draw(const DrawContext& context, UniformHandle globalUniforms) const;
 
+  /**
+   * @brief The distance beyond which the light's inverse-square attenuated
+   * emission is negligible.
+   */
+  static float computeLightRadius(const PointLight& light);
+
+  /**
+   * @brief Force every shadow map to be re-rendered on the next call to
+   * drawShadowMaps(), e.g., after changes the cache can't detect such as
+   * material or geometry edits.
+   */
+  void invalidateShadowMaps() { this->_shadowCacheValid = false; }
+
+  /**
+   * @brief The number of light shadow maps that were actually re-rendered in
+   * the last call to drawShadowMaps(), the rest were reused from the cache.
+   */
+  uint32_t getRenderedShadowMapCount() const {
+    return this->_renderedShadowMapCount;
+  }
+
+  /**
+   * @brief The binds and draws recorded and saved while drawing shadow maps
+   * in the last call to drawShadowMaps().
+   */
+  const DrawListStats& getShadowDrawStats() const {
+    return this->_shadowDrawList.getStats();
+  }
+
   size_t getByteSize() const { return this->_buffer.getSize(); }
 
   const BufferAllocation& getAllocation() const {
@@ -119,6 +178,12 @@ public:
     return this->_pointLightConstants.getHandle();
   }
 
+  LightClusters& getLightClusters() { return this->_lightClusters; }
+
+  const LightClusters& getLightClusters() const {
+    return this->_lightClusters;
+  }
+
 private:
   bool _dirty;
   bool _useShadowMaps;
@@ -143,12 +208,45 @@ private:
   };
   Sphere _sphere{};
 
+  LightClusters _lightClusters;
+  bool _lightClustersBuilt = false;
+
   // Resources needed for shadow mapping, if it is enabled
   RenderTargetCollection _shadowMap;
   TextureHandle _shadowMapHandle;
   RenderPass _shadowPass;
   std::vector<FrameBuffer> _shadowFrameBuffers;
 
+  // A primitive that may cast shadows into some of the faces of a light's
+  // cube map
+  struct ShadowCaster {
+    const Primitive* pPrimitive;
+    BufferHandle transformsHandle;
+    uint32_t lodIdx;
+    uint32_t faceMask;
+    // The distance from the light to the closest instance, relative to the
+    // light's radius
+    float depth;
+  };
+  std::vector<ShadowCaster> _shadowCasters;
+  DrawList _shadowDrawList;
+
+  // Hierarchy over every primitive instance, used to find the shadow casters
+  // near each light. It is rebuilt when the primitive and instance counts in
+  // _shadowCasterLayout change, and refit otherwise.
+  SceneBVH _shadowCasterBVH;
+  std::vector<uint32_t> _shadowCasterLayout;
+  std::vector<uint32_t> _visibleItems;
+  std::vector<uint32_t> _casterItems;
+  // The cube faces each item was found in for the current light
+  std::vector<uint8_t> _itemFaceMasks;
+
+  // Hash of everything that went into each light's shadow map when it was
+  // last rendered, lights with unchanged inputs are not re-rendered.
+  std::vector<uint64_t> _shadowMapHashes;
+  bool _shadowCacheValid = false;
+  uint32_t _renderedShadowMapCount = 0;
+
   std::vector<std::byte> _scratchBytes;
 };
 } // namespace AltheaEngine
\ No newline at end of file
@@ -3,12 +3,13 @@
 #include "Common/InstanceDataCommon.h"
 #include "ConstantBuffer.h"
 #include "DrawContext.h"
+#include "GeometryArena.h"
 #include "GlobalHeap.h"
-#include "IndexBuffer.h"
 #include "Library.h"
+#include "MeshSimplification.h"
+#include "Meshlets.h"
 #include "SingleTimeCommandBuffer.h"
 #include "Texture.h"
-#include "VertexBuffer.h"
 
 #include <glm/glm.hpp>
 #include <glm/mat4x4.hpp>
@@ -36,29 +37,210 @@ class DescriptorSetAllocator;
 struct ALTHEA_API AABB {
   glm::vec3 min{};
   glm::vec3 max{};
+
+  /**
+   * @brief An inverted box that is replaced by the first box or point it is
+   * expanded by.
+   */
+  static AABB createEmpty();
+
+  bool isEmpty() const {
+    return min.x > max.x || min.y > max.y || min.z > max.z;
+  }
+
+  void expand(const glm::vec3& point) {
+    min = glm::min(min, point);
+    max = glm::max(max, point);
+  }
+
+  void expand(const AABB& other) {
+    min = glm::min(min, other.min);
+    max = glm::max(max, other.max);
+  }
+
+  /**
+   * @brief Compute the tightest axis-aligned box around this box after the
+   * given affine transform (Arvo's method).
+   */
+  AABB transform(const glm::mat4& transform) const;
+};
+
+/**
+ * @brief Controls the LOD chains generated for every primitive loaded after
+ * the settings are changed.
+ */
+struct ALTHEA_API PrimitiveLodSettings {
+  // The number of LODs to generate beyond the full-detail mesh, 0 disables
+  // LOD generation.
+  uint32_t lodCount = 4;
+  // The fraction of triangles kept from one LOD to the next.
+  float reductionPerLod = 0.5f;
+  // The largest simplification error allowed, relative to the primitive's
+  // extent.
+  float maxError = 0.05f;
+  // Primitives with fewer triangles than this do not get LODs.
+  uint32_t minTriangleCount = 64;
+};
+
+/**
+ * @brief The CPU side of a primitive: its vertices, indices, bounds,
+ * meshlets and LODs. Building it doesn't touch the GPU, so it can run on a
+ * worker thread ahead of the upload.
+ */
+struct ALTHEA_API PrimitiveGeometry {
+  std::vector<Vertex> vertices;
+  std::vector<uint32_t> indices;
+
+  // The full-detail indices, followed by the LOD indices and the meshlet
+  // data, as laid out in the shared index buffer
+  std::vector<uint32_t> packedIndices;
+  uint32_t meshletDataStart = 0;
+
+  // LODs 1..N, relative to the start of the packed indices
+  std::vector<MeshLod> lods;
+
+  std::vector<Meshlet> meshlets;
+  std::vector<uint32_t> meshletData;
+
+  AABB aabb;
+  bool isSkinned = false;
+
+  // The glTF material, or -1 if there is none
+  int32_t materialIdx = -1;
+
+  /**
+   * @brief Build the geometry of a glTF primitive, using the current LOD
+   * settings. Meshlets and LODs are built in parallel on the shared thread
+   * pool. Throws if the primitive has no valid vertices.
+   */
+  static PrimitiveGeometry build(
+      const CesiumGltf::Model& model,
+      const CesiumGltf::MeshPrimitive& primitive);
 };
 
 class ALTHEA_API Primitive {
 public:
   static void buildPipeline(GraphicsPipelineBuilder& builder);
 
+  static void setLodSettings(const PrimitiveLodSettings& settings);
+  static const PrimitiveLodSettings& getLodSettings();
+
+  /**
+   * @brief Compute the factor converting a view-space size at unit distance
+   * into pixels, for use with selectLod.
+   *
+   * @param projection The projection matrix used for rendering.
+   * @param viewportHeight The height of the render target in pixels.
+   */
+  static float
+  computeLodScale(const glm::mat4& projection, uint32_t viewportHeight);
+
   const PrimitiveConstants& getConstants() const { return m_constantBuffer.getConstants(); }
 
-  const VertexBuffer<Vertex>& getVertexBuffer() const {
-    return m_vertexBuffer;
+  const std::vector<Vertex>& getVertices() const { return m_vertices; }
+
+  const std::vector<uint32_t>& getIndices() const { return m_indices; }
+
+  /**
+   * @brief The range of this primitive's vertices within the shared vertex
+   * buffer of the geometry arena.
+   */
+  const GeometryAllocation& getVertexAllocation() const {
+    return m_vertexAllocation;
+  }
+
+  /**
+   * @brief The range of this primitive's indices within the shared index
+   * buffer of the geometry arena. The range holds the full-detail indices,
+   * followed by the LOD indices and the meshlet data. Indices are relative
+   * to the start of the vertex range.
+   */
+  const GeometryAllocation& getIndexAllocation() const {
+    return m_indexAllocation;
   }
 
-  const IndexBuffer& getIndexBuffer() const { return m_indexBuffer; }
+  /**
+   * @brief Same as getVertexAllocation(). Primitives no longer own their
+   * vertex buffer, so this returns the arena range instead: bind
+   * GeometryAllocation::getBuffer() and offset by getOffset() vertices.
+   */
+  const GeometryAllocation& getVertexBuffer() const {
+    return m_vertexAllocation;
+  }
+
+  /**
+   * @brief Same as getIndexAllocation(). Primitives no longer own their index
+   * buffer, so this returns the arena range instead, see
+   * getIndexAllocation() for its layout.
+   */
+  const GeometryAllocation& getIndexBuffer() const {
+    return m_indexAllocation;
+  }
 
-  const std::vector<Vertex>& getVertices() const {
-    return m_vertexBuffer.getVertices();
+  /**
+   * @brief Compute the world-space bounds of this primitive from its cached
+   * local bounds.
+   *
+   * @param transform The object-to-world transform of one of the instances.
+   */
+  AABB computeWorldAABB(const glm::mat4& transform) const {
+    return m_aabb.transform(transform);
   }
 
-  const std::vector<uint32_t>& getIndices() const {
-    return m_indexBuffer.getIndices();
+  const std::vector<Meshlet>& getMeshlets() const { return m_meshlets; }
+
+  const std::vector<uint32_t>& getMeshletData() const {
+    return m_meshletData;
   }
 
-  AABB computeWorldAABB() const;
+  uint32_t getMeshletCount() const {
+    return static_cast<uint32_t>(m_meshlets.size());
+  }
+
+  /**
+   * @brief The number of LODs available, including the full-detail mesh at
+   * index 0.
+   */
+  uint32_t getLodCount() const {
+    return static_cast<uint32_t>(m_lods.size()) + 1;
+  }
+
+  /**
+   * @brief Get the index range and error of the given LOD. The range is
+   * absolute within the shared index buffer.
+   */
+  MeshLod getLod(uint32_t lodIdx) const;
+
+  /**
+   * @brief Select the coarsest LOD whose projected error stays under the
+   * given number of pixels.
+   *
+   * @param transform The object-to-world transform of this primitive.
+   * @param viewPos The world-space position of the viewer.
+   * @param lodScale The factor computed by computeLodScale.
+   * @param maxPixelError The largest acceptable screen-space error.
+   * @return The selected LOD index.
+   */
+  uint32_t selectLod(
+      const glm::mat4& transform,
+      const glm::vec3& viewPos,
+      float lodScale,
+      float maxPixelError = 1.0f) const;
+
+  /**
+   * @brief Bind the shared vertex and index buffers and draw all instances of
+   * the given LOD.
+   */
+  void draw(const DrawContext& context, uint32_t lodIdx = 0) const;
+
+  /**
+   * @brief Draw a single instance of the given LOD, e.g., an instance that
+   * survived culling.
+   */
+  void drawInstance(
+      const DrawContext& context,
+      uint32_t lodIdx,
+      uint32_t instanceIdx) const;
 
   const AABB& getAABB() const { return m_aabb; }
 
@@ -67,28 +249,79 @@ public:
   }
 
   uint32_t getNodeIdx() const { return m_constantBuffer.getConstants().nodeIdx; }
+
+  /**
+   * @brief The nodes this primitive is drawn at, one per instance. The first
+   * instance is always at getNodeIdx().
+   */
+  const std::vector<uint32_t>& getInstanceNodes() const {
+    return m_instanceNodes;
+  }
+
+  uint32_t getInstanceCount() const {
+    return static_cast<uint32_t>(m_instanceNodes.size());
+  }
   bool isSkinned() const { return m_constantBuffer.getConstants().isSkinned != 0; }
 
+  /**
+   * @brief Whether this primitive is drawn into the software occlusion
+   * buffer, see MaskedOcclusionBuffer. Best suited to large, closed meshes
+   * such as walls and floors.
+   */
+  bool isOccluder() const { return m_isOccluder; }
+  void setOccluder(bool isOccluder) { m_isOccluder = isOccluder; }
+
 private:
   bool m_flipFrontFace = false;
+  bool m_isOccluder = false;
 
   ConstantBuffer<PrimitiveConstants> m_constantBuffer;
 
-  VertexBuffer<Vertex> m_vertexBuffer;
-  IndexBuffer m_indexBuffer;
+  std::vector<Vertex> m_vertices;
+  std::vector<uint32_t> m_indices;
+
+  // LODs 1..N, relative to the start of the index allocation
+  std::vector<MeshLod> m_lods;
+
+  std::vector<uint32_t> m_instanceNodes;
+
+  std::vector<Meshlet> m_meshlets;
+  std::vector<uint32_t> m_meshletData;
+
+  GeometryAllocation m_vertexAllocation;
+  GeometryAllocation m_indexAllocation;
+  GeometryAllocation m_meshletAllocation;
 
   AABB m_aabb;
 
 public:
+  /**
+   * @brief Upload geometry built beforehand, e.g., on a worker thread.
+   */
+  Primitive(
+      Application& app,
+      SingleTimeCommandBuffer& commandBuffer,
+      GlobalHeap& heap,
+      PrimitiveGeometry&& geometry,
+      const std::vector<Material>& materialMap,
+      BufferHandle jointMapHandle,
+      uint32_t nodeIdx,
+      BufferHandle instanceNodesHandle = BufferHandle(),
+      uint32_t firstInstance = 0,
+      gsl::span<const uint32_t> instanceNodes = {});
+
   Primitive(
-      const Application& app,
+      Application& app,
       SingleTimeCommandBuffer& commandBuffer,
       GlobalHeap& heap,
       const CesiumGltf::Model& model,
       const CesiumGltf::MeshPrimitive& primitive,
       const std::vector<Material>& materialMap,
       BufferHandle handle,
-      uint32_t nodeIdx);
+      uint32_t nodeIdx,
+      BufferHandle instanceNodesHandle = BufferHandle(),
+      uint32_t firstInstance = 0,
+      gsl::span<const uint32_t> instanceNodes = {});
 
   VkFrontFace getFrontFace() const {
     return m_flipFrontFace ? VK_FRONT_FACE_CLOCKWISE
@@ -81,8 +81,8 @@ public:
    * @brief Reload and attempt to recompile any stale shaders that is
    * out-of-date with the corresponding shader file on disk. Note that the
    * recompile is not guaranteed to have succeeded, check
-   * hasShaderRecompileErrors() before recreating the pipeline.
-   *
+   * hasShaderRecompileErrors() before recreating the pipeline. Shaders are
+   * recompiled in the background, hasShaderRecompileErrors() waits for them.
    *
    * @return Whether any stale shaders were detected and reloaded /
    * recompiled.
@@ -0,0 +1,392 @@
+#pragma once
+
+#include "Allocator.h"
+#include "FrameContext.h"
+#include "Image.h"
+#include "ImageView.h"
+#include "Library.h"
+#include "UniqueVkHandle.h"
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace AltheaEngine {
+class Application;
+class RenderGraph;
+
+#define INVALID_RENDER_GRAPH_HANDLE 0xFFFFFFFF
+
+/**
+ * @brief A resource, image or buffer, known to a render graph.
+ */
+struct ALTHEA_API RenderGraphHandle {
+  uint32_t index = INVALID_RENDER_GRAPH_HANDLE;
+  bool isValid() const { return index != INVALID_RENDER_GRAPH_HANDLE; }
+};
+
+/**
+ * @brief How a pass accesses a resource. The layout is ignored for buffers.
+ */
+struct ALTHEA_API RenderGraphAccess {
+  VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+  VkAccessFlags accessMask = 0;
+  VkPipelineStageFlags stageMask = 0;
+
+  /**
+   * @brief Whether any of the access bits modify the resource.
+   */
+  bool isWrite() const;
+
+  static RenderGraphAccess colorAttachment();
+  static RenderGraphAccess depthAttachment();
+  static RenderGraphAccess depthReadOnly();
+  static RenderGraphAccess sampled(VkPipelineStageFlags stageMask);
+  static RenderGraphAccess storageRead(VkPipelineStageFlags stageMask);
+  static RenderGraphAccess storageWrite(VkPipelineStageFlags stageMask);
+  static RenderGraphAccess storageReadWrite(VkPipelineStageFlags stageMask);
+  static RenderGraphAccess transferSrc();
+  static RenderGraphAccess transferDst();
+  static RenderGraphAccess indirectArgs();
+  static RenderGraphAccess present();
+};
+
+/**
+ * @brief Passed to each pass while the graph executes.
+ */
+struct ALTHEA_API RenderGraphContext {
+  VkCommandBuffer commandBuffer;
+  const FrameContext& frame;
+  const RenderGraph& graph;
+};
+
+typedef std::function<void(const RenderGraphContext& context)>
+    RenderGraphExecuteFunction;
+
+/**
+ * @brief Returns the memory requirements of a transient image, allows
+ * compiling a graph without a device.
+ */
+typedef std::function<VkMemoryRequirements(const ImageOptions& options)>
+    RenderGraphMemoryQuery;
+
+/**
+ * @brief A layout transition or memory dependency on one resource.
+ */
+struct ALTHEA_API RenderGraphBarrier {
+  uint32_t resourceIdx;
+  VkImageLayout oldLayout;
+  VkImageLayout newLayout;
+  VkAccessFlags srcAccessMask;
+  VkAccessFlags dstAccessMask;
+};
+
+/**
+ * @brief All barriers recorded together before a pass, as a single
+ * vkCmdPipelineBarrier. Buffer dependencies are merged into one global
+ * memory barrier, images keep one barrier each for their layouts.
+ */
+struct ALTHEA_API RenderGraphBarrierBatch {
+  VkPipelineStageFlags srcStageMask = 0;
+  VkPipelineStageFlags dstStageMask = 0;
+
+  std::vector<RenderGraphBarrier> imageBarriers;
+
+  bool hasMemoryBarrier = false;
+  VkAccessFlags memorySrcAccessMask = 0;
+  VkAccessFlags memoryDstAccessMask = 0;
+
+  bool isEmpty() const { return imageBarriers.empty() && !hasMemoryBarrier; }
+};
+
+struct ALTHEA_API RenderGraphStats {
+  uint32_t passCount = 0;
+  uint32_t culledPassCount = 0;
+
+  // Barriers on individual resources, and the vkCmdPipelineBarrier calls they
+  // were merged into.
+  uint32_t barrierCount = 0;
+  uint32_t barrierBatchCount = 0;
+
+  uint32_t transientImageCount = 0;
+  // Memory used by transient images with aliasing, and the memory they would
+  // use without it.
+  VkDeviceSize transientMemorySize = 0;
+  VkDeviceSize unaliasedMemorySize = 0;
+};
+
+class ALTHEA_API RenderGraphPassBuilder {
+public:
+  /**
+   * @brief Declare that the pass reads the resource.
+   */
+  RenderGraphPassBuilder&
+  read(RenderGraphHandle resource, const RenderGraphAccess& access);
+
+  /**
+   * @brief Declare that the pass overwrites the resource, previous contents
+   * are not needed by the pass.
+   */
+  RenderGraphPassBuilder&
+  write(RenderGraphHandle resource, const RenderGraphAccess& access);
+
+  /**
+   * @brief Declare that the pass modifies the resource, e.g., a loaded
+   * attachment or blending.
+   */
+  RenderGraphPassBuilder&
+  readWrite(RenderGraphHandle resource, const RenderGraphAccess& access);
+
+  /**
+   * @brief Never cull this pass, even if nothing reads what it writes.
+   */
+  RenderGraphPassBuilder& setSideEffects();
+
+private:
+  friend class RenderGraph;
+
+  RenderGraphPassBuilder(RenderGraph& graph, uint32_t passIdx)
+      : m_graph(graph), m_passIdx(passIdx) {}
+
+  RenderGraphPassBuilder& _addAccess(
+      RenderGraphHandle resource,
+      const RenderGraphAccess& access,
+      bool read,
+      bool write);
+
+  RenderGraph& m_graph;
+  uint32_t m_passIdx;
+};
+
+/**
+ * @brief Schedules passes along with the barriers between them from the
+ * resources each pass declares it reads and writes.
+ *
+ * Passes execute in the order they are added. Compiling the graph:
+ *  - culls passes whose writes are never read and that have no side effects,
+ *    walking back from the imported resources, which are the graph outputs,
+ *  - computes the lifetime of each transient image and places transient
+ *    images with disjoint lifetimes in the same memory,
+ *  - tracks the state of each resource across passes and merges all the
+ *    barriers needed before a pass into one batch. The first use of a
+ *    transient image's memory also waits for the previous execution of the
+ *    graph to be done with it.
+ *
+ * The graph is meant to be built and compiled once, e.g., at startup and
+ * whenever the swapchain is recreated, then executed every frame. Imported
+ * images must be in their initial state each time the graph executes and
+ * are left in their final state, which defaults to the initial one.
+ *
+ * compile(query) makes no Vulkan calls, so scheduling, culling, barriers and
+ * aliasing can be inspected without a device. compile(app) additionally
+ * creates and binds the transient images.
+ */
+class ALTHEA_API RenderGraph {
+public:
+  RenderGraph() = default;
+
+  RenderGraph(RenderGraph&& rhs) = default;
+  RenderGraph& operator=(RenderGraph&& rhs) = default;
+  RenderGraph(const RenderGraph& rhs) = delete;
+  RenderGraph& operator=(const RenderGraph& rhs) = delete;
+
+  /**
+   * @brief Declare an image owned by the graph, valid only while the passes
+   * using it execute. Its contents are undefined before its first write.
+   */
+  RenderGraphHandle
+  createImage(const std::string& name, const ImageOptions& options);
+
+  /**
+   * @brief Import an external image.
+   *
+   * @param name The name of the image, for debugging.
+   * @param image The image.
+   * @param view A view of the image for the passes to use, may be null.
+   * @param options The options the image was created with.
+   * @param initialAccess The state the image is in when the graph executes.
+   * @param finalAccess The state to leave the image in, defaults to the
+   * initial state.
+   */
+  RenderGraphHandle importImage(
+      const std::string& name,
+      VkImage image,
+      VkImageView view,
+      const ImageOptions& options,
+      const RenderGraphAccess& initialAccess,
+      const std::optional<RenderGraphAccess>& finalAccess = std::nullopt);
+
+  /**
+   * @brief Import an Image, starting from the layout it is currently tracked
+   * in. The image is returned to that layout at the end of the graph.
+   */
+  RenderGraphHandle
+  importImage(const std::string& name, const Image& image, VkImageView view);
+
+  /**
+   * @brief Import an external buffer. Buffers only need memory dependencies,
+   * all buffer barriers before a pass are merged into one memory barrier.
+   * Accesses made before the graph executes must already be synchronized,
+   * e.g., buffers are usually per frame in flight.
+   */
+  RenderGraphHandle importBuffer(const std::string& name, VkBuffer buffer);
+
+  /**
+   * @brief Add a pass and declare the resources it uses with the returned
+   * builder. The builder must not be kept past the next call to addPass.
+   */
+  RenderGraphPassBuilder
+  addPass(const std::string& name, RenderGraphExecuteFunction&& execute);
+
+  /**
+   * @brief Cull and schedule the passes without a device.
+   *
+   * @param memoryQuery Gives the memory requirements of each transient
+   * image, used to alias their memory.
+   */
+  void compile(const RenderGraphMemoryQuery& memoryQuery);
+
+  /**
+   * @brief Cull and schedule the passes, then create the transient images and
+   * their memory.
+   */
+  void compile(const Application& app);
+
+  /**
+   * @brief Record all the passes that survived culling, along with the
+   * barriers between them. The graph must have been compiled with a device.
+   */
+  void execute(VkCommandBuffer commandBuffer, const FrameContext& frame) const;
+
+  VkImage getImage(RenderGraphHandle resource) const;
+  VkImageView getImageView(RenderGraphHandle resource) const;
+  VkBuffer getBuffer(RenderGraphHandle resource) const;
+
+  bool isPassCulled(uint32_t passIdx) const {
+    return !m_passes[passIdx].isAlive;
+  }
+
+  /**
+   * @brief The passes that survived culling, in execution order.
+   */
+  const std::vector<uint32_t>& getExecutionOrder() const {
+    return m_executionOrder;
+  }
+
+  /**
+   * @brief The barriers recorded before the given pass in the execution
+   * order.
+   */
+  const RenderGraphBarrierBatch& getBarriers(uint32_t orderIdx) const {
+    return m_barriers[orderIdx];
+  }
+
+  /**
+   * @brief The barriers recorded after the last pass to move imported images
+   * to their final states.
+   */
+  const RenderGraphBarrierBatch& getFinalBarriers() const {
+    return m_finalBarriers;
+  }
+
+  /**
+   * @brief The offset of a transient image within the memory it shares with
+   * other transient images, along with the index of that memory.
+   */
+  VkDeviceSize getTransientOffset(RenderGraphHandle resource) const {
+    return m_resources[resource.index].memoryOffset;
+  }
+
+  uint32_t getTransientMemoryIndex(RenderGraphHandle resource) const {
+    return m_resources[resource.index].memoryIdx;
+  }
+
+  const RenderGraphStats& getStats() const { return m_stats; }
+
+private:
+  friend class RenderGraphPassBuilder;
+
+  enum class ResourceType { TRANSIENT_IMAGE, IMPORTED_IMAGE, IMPORTED_BUFFER };
+
+  struct Resource {
+    std::string name;
+    ResourceType type;
+    ImageOptions options{};
+
+    VkImage image = VK_NULL_HANDLE;
+    VkImageView view = VK_NULL_HANDLE;
+    VkBuffer buffer = VK_NULL_HANDLE;
+
+    RenderGraphAccess initialAccess{};
+    std::optional<RenderGraphAccess> finalAccess;
+
+    // The first and last passes using the resource, in execution order
+    uint32_t firstUse = UINT32_MAX;
+    uint32_t lastUse = 0;
+
+    VkMemoryRequirements memoryRequirements{};
+    uint32_t memoryIdx = UINT32_MAX;
+    VkDeviceSize memoryOffset = 0;
+  };
+
+  struct ResourceAccess {
+    uint32_t resourceIdx;
+    RenderGraphAccess access;
+    bool read;
+    bool write;
+  };
+
+  struct Pass {
+    std::string name;
+    RenderGraphExecuteFunction execute;
+    std::vector<ResourceAccess> accesses;
+    bool hasSideEffects = false;
+    bool isAlive = false;
+  };
+
+  // A block of memory shared by transient images
+  struct TransientMemory {
+    uint32_t memoryTypeBits;
+    VkDeviceSize alignment;
+    VkDeviceSize size;
+  };
+
+  struct TransientImage {
+    struct ImageDeleter {
+      void operator()(VkDevice device, VkImage image);
+    };
+
+    UniqueVkHandle<VkImage, ImageDeleter> image;
+    ImageView view;
+  };
+
+  RenderGraphHandle _addResource(Resource&& resource);
+  void _cullPasses();
+  void _computeLifetimes();
+  void _placeTransientImages(const RenderGraphMemoryQuery& memoryQuery);
+  void _computeBarriers();
+  void _createTransientImages(const Application& app);
+  static void _recordBarriers(
+      VkCommandBuffer commandBuffer,
+      const RenderGraphBarrierBatch& batch,
+      const std::vector<Resource>& resources);
+
+  std::vector<Resource> m_resources;
+  std::vector<Pass> m_passes;
+
+  std::vector<uint32_t> m_executionOrder;
+  std::vector<RenderGraphBarrierBatch> m_barriers;
+  RenderGraphBarrierBatch m_finalBarriers{};
+
+  std::vector<TransientMemory> m_transientMemory;
+  std::vector<MemoryAllocation> m_transientAllocations;
+  std::vector<TransientImage> m_transientImages;
+
+  RenderGraphStats m_stats{};
+  bool m_isCompiled = false;
+};
+} // namespace AltheaEngine
@@ -13,12 +13,14 @@
 #include <vulkan/vulkan.h>
 
 #include <cstdint>
+#include <functional>
 #include <memory>
 #include <optional>
 #include <vector>
 
 namespace AltheaEngine {
 class Application;
+class ParallelCommandRecorder;
 
 // TODO: Generalize to non-graphics pipelines
 struct ALTHEA_API SubpassBuilder {
@@ -58,11 +60,19 @@ public:
       std::vector<SubpassBuilder>&& subpasses,
       bool syncExternalBeforePass = true);
 
+  /**
+   * @brief Begin the render pass.
+   *
+   * @param contents How the first subpass will be recorded, pass
+   * VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS to record it with
+   * ActiveRenderPass::recordParallel.
+   */
   ActiveRenderPass begin(
       const Application& app,
       const VkCommandBuffer& commandBuffer,
       const FrameContext& frame,
-      VkFramebuffer frameBuffer) const;
+      VkFramebuffer frameBuffer,
+      VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE) const;
 
   operator VkRenderPass() const { return this->_renderPass; }
 
@@ -98,10 +108,33 @@ public:
       const RenderPass& renderPass,
       const VkCommandBuffer& commandBuffer,
       const FrameContext& frame,
-      VkFramebuffer frameBuffer);
+      VkFramebuffer frameBuffer,
+      VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE);
   ~ActiveRenderPass();
 
-  ActiveRenderPass& nextSubpass();
+  ActiveRenderPass&
+  nextSubpass(VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE);
+
+  /**
+   * @brief Record the current subpass in parallel, split into the given
+   * number of tasks. Each task records into its own secondary command buffer
+   * through its own DrawContext, with the subpass pipeline and the global
+   * descriptor sets already bound. The secondary command buffers are
+   * executed in task order once all tasks are done.
+   *
+   * The current subpass must have been started with
+   * VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS.
+   *
+   * @param recorder Provides the per-worker secondary command buffers.
+   * @param taskCount The number of tasks to split the subpass into.
+   * @param recordTask Records the task with the given index, called
+   * concurrently from multiple threads.
+   */
+  ActiveRenderPass& recordParallel(
+      ParallelCommandRecorder& recorder,
+      uint32_t taskCount,
+      const std::function<void(const DrawContext& context, uint32_t taskIdx)>&
+          recordTask);
 
   // TODO: create IDrawable interface instead?
   template <typename TDrawable>
@@ -129,6 +162,8 @@ private:
   const RenderPass& _renderPass;
   const VkCommandBuffer& _commandBuffer;
   const FrameContext& _frame;
+  VkFramebuffer _frameBuffer;
+  VkSubpassContents _contents;
 
   std::vector<VkClearValue> _clearValues;
 
@@ -0,0 +1,134 @@
+#pragma once
+
+#include "Frustum.h"
+#include "Library.h"
+#include "Primitive.h"
+
+#include <gsl/span>
+
+#include <cstdint>
+#include <vector>
+
+namespace AltheaEngine {
+class Model;
+
+/**
+ * @brief Identifies a single instance of a primitive within a list of models.
+ */
+struct ALTHEA_API PrimitiveInstanceRef {
+  uint32_t modelIdx;
+  uint32_t primitiveIdx;
+  uint32_t instanceIdx;
+};
+
+/**
+ * @brief A bounding volume hierarchy over world-space AABBs, with SIMD
+ * frustum culling of the leaves.
+ *
+ * The hierarchy can either be built directly from a list of boxes, or over
+ * every primitive instance of a list of models. In the latter case refit()
+ * updates the boxes after the models' transforms change, without rebuilding
+ * the tree.
+ */
+class ALTHEA_API SceneBVH {
+public:
+  SceneBVH() = default;
+
+  /**
+   * @brief Build the hierarchy over every primitive instance of the given
+   * models, using the current node transforms.
+   */
+  void build(const std::vector<Model>& models);
+
+  /**
+   * @brief Build the hierarchy over an arbitrary list of boxes. Culling
+   * results are indices into this list.
+   */
+  void build(gsl::span<const AABB> bounds);
+
+  /**
+   * @brief Recompute the instance bounds from the models' current transforms
+   * and refit the hierarchy. The models must have the same primitives as
+   * when the hierarchy was built.
+   */
+  void refit(const std::vector<Model>& models);
+
+  /**
+   * @brief Replace the item bounds and refit the hierarchy.
+   */
+  void refit(gsl::span<const AABB> bounds);
+
+  /**
+   * @brief Collect the indices of the items intersecting the frustum.
+   */
+  void cullFrustum(const Frustum& frustum, std::vector<uint32_t>& visibleItems)
+      const;
+
+  /**
+   * @brief Collect the primitive instances intersecting the frustum. Only
+   * valid when the hierarchy was built from models.
+   */
+  void cullFrustum(
+      const Frustum& frustum,
+      std::vector<PrimitiveInstanceRef>& visibleInstances) const;
+
+  const PrimitiveInstanceRef& getInstance(uint32_t itemIdx) const {
+    return m_instances[itemIdx];
+  }
+
+  uint32_t getItemCount() const { return m_itemCount; }
+
+  /**
+   * @brief The bounds of an item as of the last build or refit.
+   */
+  AABB getItemBounds(uint32_t itemIdx) const;
+
+  const AABB& getBounds() const {
+    return m_nodes.empty() ? m_emptyBounds : m_nodes[0].bounds;
+  }
+
+private:
+  struct Node {
+    AABB bounds;
+    // Internal nodes: index of the second child, the first child directly
+    // follows its parent.
+    // Leaves: index of the leaf's packet of items.
+    uint32_t index;
+    // Zero for internal nodes
+    uint32_t itemCount;
+  };
+
+  void _build(gsl::span<const AABB> bounds);
+  uint32_t _buildRecursive(
+      gsl::span<const AABB> bounds,
+      std::vector<uint32_t>& items,
+      uint32_t first,
+      uint32_t count);
+  void _writePacket(uint32_t packetIdx, uint32_t lane, const AABB& bounds);
+  void _refitNodes();
+  void _gatherInstanceBounds(
+      const std::vector<Model>& models,
+      std::vector<AABB>& bounds) const;
+
+  std::vector<Node> m_nodes;
+
+  // Item bounds in leaf order, stored as packets of four in SoA layout so
+  // a leaf can be tested against a plane in a single SIMD operation.
+  std::vector<float> m_minX;
+  std::vector<float> m_minY;
+  std::vector<float> m_minZ;
+  std::vector<float> m_maxX;
+  std::vector<float> m_maxY;
+  std::vector<float> m_maxZ;
+  // Original item index of each packet lane
+  std::vector<uint32_t> m_packetItems;
+
+  // Maps from the original item index to its packet lane
+  std::vector<uint32_t> m_itemLanes;
+
+  std::vector<PrimitiveInstanceRef> m_instances;
+  uint32_t m_itemCount = 0;
+
+  AABB m_emptyBounds = AABB::createEmpty();
+};
+} // namespace AltheaEngine
@@ -12,6 +12,7 @@
 #include "Library.h"
 #include "PerFrameResources.h"
 #include "ReflectionBuffer.h"
+#include "RenderGraph.h"
 #include "RenderPass.h"
 #include "ResourcesAssignment.h"
 #include "Sampler.h"
@@ -44,6 +45,21 @@ public:
       VkDescriptorSet heapSet,
       const FrameContext& context);
 
+  /**
+   * @brief Add the reflection capture and convolution passes to a render
+   * graph, in place of calling them every frame. The reflection buffer
+   * transitions its mips individually, so it stays outside the graph and
+   * both passes are kept as side effects. The graph must not outlive the app
+   * or this object.
+   */
+  void addToRenderGraph(
+      const Application& app,
+      RenderGraph& graph,
+      const GBufferGraphHandles& gBuffer,
+      VkDescriptorSet heapSet,
+      UniformHandle globalUniforms,
+      BufferHandle globalResources);
+
   void bindTexture(ResourcesAssignment& assignment) const;
 
   void tryRecompileShaders(Application& app) {
@@ -1,6 +1,8 @@
 #pragma once
 
 #include "Library.h"
+#include "ShaderFileWatcher.h"
+#include "ShaderReflection.h"
 #include "UniqueVkHandle.h"
 
 #include <shaderc/shaderc.hpp>
@@ -8,6 +10,8 @@
 
 #include <cstdint>
 #include <filesystem>
+#include <future>
+#include <memory>
 #include <string>
 #include <unordered_map>
 #include <vector>
@@ -24,6 +28,29 @@ enum ShaderLanguage {
   // SHADER_LANGUAGE_SLANG
 };
 
+/**
+ * @brief Everything needed to compile a single shader, captured by value so
+ * the job can run on any thread.
+ */
+struct ALTHEA_API ShaderCompileJob {
+  std::filesystem::path path;
+  shaderc_shader_kind kind;
+  ShaderLanguage language;
+  ShaderDefines defines;
+  std::vector<char> code;
+  bool generateDebugInfo = false;
+};
+
+struct ALTHEA_API ShaderCompileResult {
+  std::vector<uint32_t> spirv;
+  // Empty if the compilation succeeded
+  std::string errors;
+  // Every file transitively included by the shader
+  std::vector<std::string> includedFiles;
+
+  bool succeeded() const { return this->errors.empty(); }
+};
+
 class ShaderBuilder;
 
 class ALTHEA_API Shader {
@@ -61,11 +88,29 @@ public:
    */
   bool recompile();
 
+  /**
+   * @brief Queue this shader to be recompiled on the ShaderCompiler worker
+   * threads and return immediately. The result is picked up the next time
+   * the errors or bytecode are needed.
+   */
+  void recompileAsync();
+
+  /**
+   * @brief Block until any queued compilation has finished.
+   *
+   * @return Whether the last compilation was a success.
+   */
+  bool waitForCompile() const;
+
   /**
    * @brief Checks the shader path to determine whether the current spirv
    * bytecode is out-of-date with the corresponding glsl file. If so, the new
    * glsl code will be saved.
    *
+   * When the ShaderFileWatcher is active, the shader is only stale once it
+   * or one of its included files has changed, and nothing is read from disk
+   * otherwise.
+   *
    * @return Whether the glsl code was reloaded due to it being out-of-date
    * with the file on disk.
    */
@@ -76,19 +121,44 @@ public:
    *
    * @return The string describing any encountered errors.
    */
-  const std::string& getErrors() const { return this->_errors; }
+  const std::string& getErrors() const {
+    this->waitForCompile();
+    return this->_errors;
+  }
 
   /**
    * @brief Whether there were any compilation errors during the last
    * recompile.
    */
-  bool hasErrors() const { return !this->_errors.empty(); }
+  bool hasErrors() const { return !this->waitForCompile(); }
 
   shaderc_shader_kind getKind() const { return this->_kind; }
 
+  /**
+   * @brief The Vulkan shader stage corresponding to this shader's kind.
+   */
+  VkShaderStageFlagBits getStage() const;
+
+  /**
+   * @brief Reflect the resource interface of the compiled shader. Empty if
+   * the shader failed to compile.
+   */
+  ShaderReflection reflect() const;
+
+  /**
+   * @brief The files transitively included by this shader during the last
+   * compilation.
+   */
+  const std::vector<std::string>& getIncludedFiles() const {
+    this->waitForCompile();
+    return this->_includedFiles;
+  }
+
 private:
   friend class Shader;
 
+  ShaderCompileJob _createCompileJob() const;
+
   std::filesystem::path _path;
 
   shaderc_shader_kind _kind;
@@ -96,9 +166,15 @@ private:
 
   ShaderDefines _defines;
 
-  std::string _errors;
   std::string _fileHash;
   std::vector<char> _code;
-  std::vector<uint32_t> _spirvBytecode;
+
+  std::shared_ptr<ShaderWatchState> _pWatchState;
+
+  // Resolved lazily from the pending compile, by const accessors
+  mutable std::shared_future<ShaderCompileResult> _pendingCompile;
+  mutable std::string _errors;
+  mutable std::vector<uint32_t> _spirvBytecode;
+  mutable std::vector<std::string> _includedFiles;
 };
 } // namespace AltheaEngine
\ No newline at end of file
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "Library.h"
+
+#include <gsl/span>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace AltheaEngine {
+struct ALTHEA_API ShaderCacheStats {
+  // Lookups that skipped compilation entirely
+  uint32_t hits = 0;
+  // Lookups with no entry for the key
+  uint32_t misses = 0;
+  // Lookups that found an entry whose included files have since changed
+  uint32_t staleEntries = 0;
+  // Entries written after compiling
+  uint32_t writes = 0;
+  uint32_t writeFailures = 0;
+};
+
+/**
+ * @brief A content-addressed on-disk cache of compiled SPIR-V.
+ *
+ * Entries are keyed by a hash of the shader source and path, the shader
+ * kind, language, defines and compiler options. The files included while
+ * compiling are only known after compilation, so each entry also records
+ * the resolved path and content hash of every transitively included file.
+ * A lookup only hits if all of them are unchanged.
+ *
+ * All functions are safe to call from multiple threads. Entries are written
+ * to a temporary file and renamed into place, so concurrent writers of the
+ * same key and readers never see a partial entry.
+ */
+class ALTHEA_API ShaderCache {
+public:
+  struct IncludedFile {
+    std::string path;
+    std::string hash;
+  };
+
+  /**
+   * @brief The directory entries are stored in, defaults to
+   * <project>/Cache/Shaders.
+   */
+  static void setDirectory(const std::string& directory);
+  static std::string getDirectory();
+
+  static void setEnabled(bool enabled);
+  static bool isEnabled();
+
+  /**
+   * @brief Hash the contents of an included file, as stored in entries.
+   */
+  static std::string hashFile(gsl::span<const char> content);
+
+  /**
+   * @brief Express a path relative to the engine or project directory, so
+   * keys and archives built on one machine match on another. Paths outside
+   * of both are made absolute.
+   */
+  static std::string getPortablePath(const std::string& path);
+
+  /**
+   * @brief Turn a path from getPortablePath back into one that can be
+   * opened on this machine.
+   */
+  static std::string resolvePortablePath(const std::string& path);
+
+  /**
+   * @brief Look up compiled SPIR-V for the given key, along with the files
+   * that were included to compile it.
+   *
+   * @return Whether a valid entry was found and loaded into spirv.
+   */
+  static bool load(
+      const std::string& key,
+      std::vector<uint32_t>& spirv,
+      std::vector<IncludedFile>& includes);
+
+  /**
+   * @brief Store compiled SPIR-V along with the files included to compile
+   * it.
+   */
+  static void store(
+      const std::string& key,
+      const std::vector<IncludedFile>& includes,
+      gsl::span<const uint32_t> spirv);
+
+  static ShaderCacheStats getStats();
+  static void resetStats();
+};
+} // namespace AltheaEngine
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "Library.h"
+#include "Shader.h"
+
+#include <shaderc/shaderc.hpp>
+
+#include <cstdint>
+#include <future>
+#include <string>
+#include <vector>
+
+namespace AltheaEngine {
+/**
+ * @brief Compiles shaders on the shared ThreadPool.
+ *
+ * Each worker of the pool owns its own shaderc::Compiler, which is reused for
+ * every job that runs on that worker. Jobs are first looked up in the
+ * precompiled ShaderVariantArchive, then in the ShaderCache, and only jobs
+ * that miss both run shaderc.
+ *
+ * All functions are safe to call from multiple threads, including from
+ * within tasks running on the pool.
+ */
+class ALTHEA_API ShaderCompiler {
+public:
+  /**
+   * @brief Queue a shader to be compiled on the worker threads.
+   */
+  static std::shared_future<ShaderCompileResult> submit(ShaderCompileJob&& job);
+
+  /**
+   * @brief Queue a batch of shaders, the returned futures are in the same
+   * order as the jobs.
+   */
+  static std::vector<std::shared_future<ShaderCompileResult>>
+  submitBatch(std::vector<ShaderCompileJob>&& jobs);
+
+  /**
+   * @brief Block until the compile has finished, running queued tasks on
+   * the calling thread in the meantime, see ThreadPool::waitUntil.
+   */
+  static const ShaderCompileResult&
+  wait(const std::shared_future<ShaderCompileResult>& future);
+
+  /**
+   * @brief Compile a shader immediately on the calling thread.
+   */
+  static ShaderCompileResult compile(const ShaderCompileJob& job);
+
+  /**
+   * @brief The key the job's SPIR-V is stored under in the ShaderCache and
+   * the ShaderVariantArchive.
+   */
+  static std::string computeCacheKey(const ShaderCompileJob& job);
+};
+} // namespace AltheaEngine
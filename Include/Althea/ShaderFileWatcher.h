@@ -0,0 +1,54 @@
+#pragma once
+
+#include "Library.h"
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace AltheaEngine {
+/**
+ * @brief Shared between a ShaderBuilder and the watcher, set once any file
+ * the shader depends on changes.
+ */
+struct ALTHEA_API ShaderWatchState {
+  std::atomic<bool> dirty{false};
+};
+
+/**
+ * @brief Watches shader source files for changes on a background thread.
+ *
+ * The watcher holds the include dependency graph in reverse, from every
+ * watched file to the shaders that depend on it. When a file is written, all
+ * of its dependents are marked dirty, so polling for stale shaders costs no
+ * file I/O or hashing on frames where nothing changed.
+ *
+ * Change notifications use inotify and are only available on Linux. On other
+ * platforms, or when disabled, isActive() returns false and shaders fall back
+ * to checking the disk themselves.
+ */
+class ALTHEA_API ShaderFileWatcher {
+public:
+  /**
+   * @brief Whether to watch files at all. Only has an effect before the first
+   * file is watched.
+   */
+  static void setEnabled(bool enabled);
+
+  /**
+   * @brief Whether file changes are being tracked, starts the watcher thread
+   * on first use.
+   */
+  static bool isActive();
+
+  /**
+   * @brief Mark the state dirty whenever any of the given files changes.
+   * Watching the same file with the same state more than once is a no-op,
+   * watches are dropped once the state is destroyed.
+   */
+  static void watch(
+      const std::shared_ptr<ShaderWatchState>& pState,
+      const std::vector<std::string>& files);
+};
+} // namespace AltheaEngine
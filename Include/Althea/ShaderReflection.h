@@ -0,0 +1,96 @@
+#pragma once
+
+#include "Library.h"
+
+#include <gsl/span>
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace AltheaEngine {
+class DescriptorSetLayoutBuilder;
+
+struct ALTHEA_API ReflectedBinding {
+  std::string name;
+  uint32_t set = 0;
+  uint32_t binding = 0;
+  VkDescriptorType descriptorType = VK_DESCRIPTOR_TYPE_MAX_ENUM;
+  // Zero for runtime sized (bindless) arrays
+  uint32_t descriptorCount = 1;
+  VkShaderStageFlags stageFlags = 0;
+
+  // For buffer blocks, the size of the fixed-size part of the block
+  uint32_t blockSize = 0;
+  // For buffer blocks ending in a runtime sized array, the array stride
+  uint32_t runtimeArrayStride = 0;
+};
+
+struct ALTHEA_API ReflectedPushConstants {
+  std::string name;
+  uint32_t offset = 0;
+  uint32_t size = 0;
+  VkShaderStageFlags stageFlags = 0;
+};
+
+/**
+ * @brief The resource interface of one or more compiled shaders, read
+ * straight from their SPIR-V.
+ *
+ * Only resources statically used by the entry point are reported, which
+ * relies on the SPIR-V 1.4+ rule that entry points list every global they
+ * reference.
+ */
+class ALTHEA_API ShaderReflection {
+public:
+  ShaderReflection() = default;
+
+  /**
+   * @brief Reflect a single compiled shader.
+   *
+   * @param spirv The SPIR-V bytecode.
+   * @param stage The stage the shader will be bound to.
+   */
+  ShaderReflection(gsl::span<const uint32_t> spirv, VkShaderStageFlags stage);
+
+  /**
+   * @brief Combine the interface of another stage into this one. Throws if
+   * the stages disagree on the type of a shared binding.
+   */
+  void merge(const ShaderReflection& other);
+
+  const std::vector<ReflectedBinding>& getBindings() const {
+    return this->_bindings;
+  }
+
+  /**
+   * @brief The push constant blocks, one per stage that uses any.
+   */
+  const std::vector<ReflectedPushConstants>& getPushConstants() const {
+    return this->_pushConstants;
+  }
+
+  /**
+   * @brief The number of descriptor sets the shaders need bound, including
+   * any unused sets below the highest one.
+   */
+  uint32_t getDescriptorSetCount() const;
+
+  const ReflectedBinding* findBinding(uint32_t set, uint32_t binding) const;
+
+  /**
+   * @brief Add the bindings of the given set to a descriptor set layout
+   * builder. Throws if the bindings are not contiguous from zero, or a
+   * binding can't be expressed by the builder (e.g., an unbounded array,
+   * whose size is only known to the application).
+   */
+  void populateDescriptorSetLayout(
+      uint32_t set,
+      DescriptorSetLayoutBuilder& builder) const;
+
+private:
+  std::vector<ReflectedBinding> _bindings;
+  std::vector<ReflectedPushConstants> _pushConstants;
+};
+} // namespace AltheaEngine
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "Library.h"
+#include "ShaderCache.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace AltheaEngine {
+struct ALTHEA_API ShaderVariantArchiveStats {
+  // Variants in the currently open archive
+  uint32_t variantCount = 0;
+  // Lookups that found a variant, skipping compilation entirely
+  uint32_t hits = 0;
+  // Lookups with no variant for the key, or with no archive open
+  uint32_t misses = 0;
+  // Lookups that found a variant whose included files have since changed
+  uint32_t staleEntries = 0;
+};
+
+/**
+ * @brief A single packed file of precompiled shader variants, built offline
+ * by Tools/ShaderVariantPrecompiler.
+ *
+ * The archive is an open-addressed hash table of fixed-size index entries,
+ * keyed by the same key as the ShaderCache, followed by the included files
+ * and aligned SPIR-V of every variant. It is memory mapped where supported,
+ * so a lookup is a hash probe and a copy out of the mapping.
+ *
+ * As with the ShaderCache, each variant records the files it included and
+ * is only used if all of them are unchanged. Included files are hashed once
+ * when the archive is opened, lookups only check that they haven't been
+ * written since. Keys and included files are relative to the engine and
+ * project directories, so an archive can be built on another machine.
+ *
+ * The archive is opened on the first lookup. All functions are safe to call
+ * from multiple threads.
+ */
+class ALTHEA_API ShaderVariantArchive {
+public:
+  struct Variant {
+    std::string key;
+    std::vector<ShaderCache::IncludedFile> includes;
+    std::vector<uint32_t> spirv;
+  };
+
+  /**
+   * @brief The archive to look variants up in, defaults to
+   * <project>/Cache/ShaderVariants.asva. Any open archive is closed and the
+   * new one is opened on the next lookup.
+   */
+  static void setPath(const std::string& path);
+  static std::string getPath();
+
+  static void setEnabled(bool enabled);
+  static bool isEnabled();
+
+  /**
+   * @brief Look up a precompiled variant for the given ShaderCache key.
+   *
+   * @return Whether a valid variant was found and loaded into spirv.
+   */
+  static bool load(
+      const std::string& key,
+      std::vector<uint32_t>& spirv,
+      std::vector<ShaderCache::IncludedFile>& includes);
+
+  /**
+   * @brief Pack the given variants into an archive at the given path,
+   * replacing any existing archive. Throws if the archive can't be written.
+   */
+  static void
+  write(const std::string& path, const std::vector<Variant>& variants);
+
+  static ShaderVariantArchiveStats getStats();
+  static void resetStats();
+};
+} // namespace AltheaEngine
@@ -2,10 +2,12 @@
 
 #include "Library.h"
 #include "Allocator.h"
+#include "UploadRing.h"
 
 #include <vulkan/vulkan.h>
 #include <gsl/span>
 
+#include <cstddef>
 #include <vector>
 #include <memory>
 #include <functional>
@@ -16,12 +18,32 @@ class Application;
 class ALTHEA_API SingleTimeCommandBuffer {
 public:
   SingleTimeCommandBuffer(const Application& app);
+
+  /**
+   * @brief Record commands that are submitted without waiting for the GPU.
+   * On destruction, the command buffer, staging buffers and post-completion
+   * tasks are handed to the upload ring, which releases them once the GPU is
+   * done with them. Only one may record into a given ring at a time.
+   */
+  SingleTimeCommandBuffer(const Application& app, UploadRing& uploadRing);
   ~SingleTimeCommandBuffer();
 
-  VkBuffer createStagingBuffer(const Application& app, gsl::span<const std::byte> buffer);
+  /**
+   * @brief Copy the data somewhere the GPU can transfer it from. Comes from
+   * the upload ring's staging buffer when there is one and it has room,
+   * otherwise from a staging buffer of its own.
+   */
+  StagingRange createStagingBuffer(
+      const Application& app,
+      gsl::span<const std::byte> buffer);
 
   void addPostCompletionTask(std::function<void()>&& task);
 
+  /**
+   * @brief The total size of the staging copies made so far.
+   */
+  size_t getStagingBytes() const { return this->_stagingBytes; }
+
   operator VkCommandBuffer() const {
     return this->_commandBuffer;
   }
@@ -33,5 +55,7 @@ private:
   VkCommandBuffer _commandBuffer;
   std::vector<std::function<void()>> _postCompletionTasks;
   std::vector<BufferAllocation> _stagingBuffers;
+  size_t _stagingBytes = 0;
+  UploadRing* _pUploadRing = nullptr;
 };
 } // namespace AltheaEngine
\ No newline at end of file
@@ -78,12 +78,12 @@ public:
         reinterpret_cast<const std::byte*>(this->_structureArray.data()),
         size);
 
-    VkBuffer stagingBuffer = commandBuffer.createStagingBuffer(app, view);
+    StagingRange staging = commandBuffer.createStagingBuffer(app, view);
 
     BufferUtilities::copyBuffer(
         commandBuffer,
-        stagingBuffer,
-        0,
+        staging.buffer,
+        staging.offset,
         this->_allocation.getBuffer(),
         0,
         size);
@@ -146,6 +146,10 @@ public:
     return this->_structureArray[i];
   }
 
+  const std::vector<TElement>& getElements() const {
+    return this->_structureArray;
+  }
+
   const BufferAllocation& getAllocation() const { return this->_allocation; }
 
   size_t getCount() const { return this->_structureArray.size(); }
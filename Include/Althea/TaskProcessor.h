@@ -5,8 +5,20 @@
 #include <CesiumAsync/ITaskProcessor.h>
 
 namespace AltheaEngine {
+class ThreadPool;
+
+/**
+ * @brief Runs CesiumAsync worker tasks on a ThreadPool, by default the
+ * engine's shared pool.
+ */
 class ALTHEA_API TaskProcessor : public CesiumAsync::ITaskProcessor {
 public:
+  TaskProcessor();
+  TaskProcessor(ThreadPool& pool);
+
   void startTask(std::function<void()> f) override;
+
+private:
+  ThreadPool& m_pool;
 };
 } // namespace AltheaEngine
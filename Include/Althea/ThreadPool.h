@@ -0,0 +1,154 @@
+#pragma once
+
+#include "Library.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace AltheaEngine {
+struct ALTHEA_API ThreadPoolStats {
+  uint32_t threadCount = 0;
+  // Tasks run to completion
+  uint64_t tasksExecuted = 0;
+  // Tasks a worker took from another worker's queue
+  uint64_t tasksStolen = 0;
+  // Times a worker ran out of work and went to sleep
+  uint64_t parks = 0;
+};
+
+/**
+ * @brief A fixed set of worker threads that run tasks, balanced by work
+ * stealing.
+ *
+ * Every worker owns a queue. Tasks submitted from a worker go to the back of
+ * its own queue and it runs them newest first, which keeps a task's data hot
+ * in that worker's cache. Tasks submitted from any other thread go to a
+ * shared injection queue. A worker that runs out of tasks takes from the
+ * injection queue, then steals the oldest task of another worker, and only
+ * sleeps once there is no work left anywhere.
+ *
+ * Submitted tasks must not throw. All functions are safe to call from
+ * multiple threads, including from within tasks. On destruction, all queued
+ * tasks are run before the workers are joined.
+ */
+class ALTHEA_API ThreadPool {
+public:
+  typedef std::function<void()> Task;
+
+  /**
+   * @brief Start the given number of worker threads, at least one.
+   */
+  explicit ThreadPool(uint32_t threadCount);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool& rhs) = delete;
+  ThreadPool& operator=(const ThreadPool& rhs) = delete;
+
+  /**
+   * @brief Queue a task to be run on one of the workers.
+   */
+  void submit(Task&& task);
+
+  uint32_t getThreadCount() const {
+    return static_cast<uint32_t>(m_workers.size());
+  }
+
+  /**
+   * @brief Run a single queued task on the calling thread, if there is one.
+   *
+   * @return Whether a task was run.
+   */
+  bool runPendingTask();
+
+  /**
+   * @brief Block until the predicate returns true, running queued tasks on
+   * the calling thread in the meantime. Unlike blocking on a future, this
+   * can't deadlock when called from within a task that waits on other tasks.
+   */
+  void waitUntil(const std::function<bool()>& isDone);
+
+  /**
+   * @brief Split the range [0, count) into chunks and run them in parallel
+   * on the workers and the calling thread, returns once every index has been
+   * processed.
+   *
+   * Chunks are claimed dynamically and shrink as the range runs out, so
+   * uneven work still balances across threads while the per-chunk overhead
+   * stays low. If fn throws, the first exception is rethrown on the calling
+   * thread once every chunk has finished.
+   *
+   * @param count The number of indices to process.
+   * @param fn Called with the [begin, end) range of each chunk.
+   * @param minChunkSize The smallest number of indices worth running as one
+   * chunk.
+   */
+  void parallelFor(
+      uint32_t count,
+      const std::function<void(uint32_t begin, uint32_t end)>& fn,
+      uint32_t minChunkSize = 1);
+
+  /**
+   * @brief Whether the calling thread is one of this pool's workers.
+   */
+  bool isWorkerThread() const;
+
+  /**
+   * @brief The index of the calling worker, or getThreadCount() when called
+   * from a thread outside of the pool.
+   */
+  uint32_t getCurrentWorkerIndex() const;
+
+  ThreadPoolStats getStats() const;
+
+  /**
+   * @brief The pool shared by the whole engine, started on first use.
+   * Engine systems and asset loading should schedule their work here rather
+   * than starting threads of their own.
+   */
+  static ThreadPool& getShared();
+
+  /**
+   * @brief Set the number of workers in the shared pool. Only has an effect
+   * before the shared pool is first used, defaults to one less than the
+   * hardware concurrency.
+   */
+  static void setSharedThreadCount(uint32_t threadCount);
+
+private:
+  struct Worker {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+    std::thread thread;
+  };
+
+  void _workerLoop(uint32_t workerIdx);
+  // Pass getThreadCount() as the worker index to only take shared and
+  // stolen tasks
+  bool _tryPop(uint32_t workerIdx, Task& task);
+  void _wake();
+
+  std::vector<std::unique_ptr<Worker>> m_workers;
+
+  std::mutex m_injectionMutex;
+  std::deque<Task> m_injectionQueue;
+
+  // Tasks queued anywhere in the pool, so workers can tell whether to sleep
+  // without looking at every queue
+  std::atomic<uint64_t> m_queuedCount{0};
+  std::atomic<uint32_t> m_sleepingCount{0};
+  std::mutex m_parkMutex;
+  std::condition_variable m_parkCondition;
+  bool m_stopping = false;
+
+  std::atomic<uint64_t> m_tasksExecuted{0};
+  std::atomic<uint64_t> m_tasksStolen{0};
+  std::atomic<uint64_t> m_parks{0};
+};
+} // namespace AltheaEngine
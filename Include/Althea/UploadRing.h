@@ -0,0 +1,167 @@
+#pragma once
+
+#include "Allocator.h"
+#include "Library.h"
+
+#include <vulkan/vulkan.h>
+#include <gsl/span>
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <optional>
+#include <vector>
+
+namespace AltheaEngine {
+class Application;
+
+/**
+ * @brief Where an upload's staging copy lives, either in the upload ring's
+ * persistent staging buffer or in a dedicated staging buffer.
+ */
+struct ALTHEA_API StagingRange {
+  VkBuffer buffer = VK_NULL_HANDLE;
+  VkDeviceSize offset = 0;
+};
+
+struct ALTHEA_API UploadRingStats {
+  // Staging memory of batches the GPU hasn't finished with yet
+  size_t inFlightBytes = 0;
+  uint32_t inFlightBatches = 0;
+  // Staging memory submitted since the last call to beginFrame()
+  size_t frameBytes = 0;
+  uint64_t batchesSubmitted = 0;
+  uint64_t bytesSubmitted = 0;
+  // Part of the persistent staging buffer not yet released by the GPU
+  size_t stagingRingUsedBytes = 0;
+  // Uploads that didn't fit in the staging buffer and got their own
+  uint64_t dedicatedStagingBuffers = 0;
+};
+
+/**
+ * @brief Tracks uploads submitted without waiting on the GPU, so resources
+ * can be streamed in over many frames without stalling the main thread.
+ *
+ * A SingleTimeCommandBuffer created with an UploadRing submits its commands
+ * with a fence when it is destroyed, and the ring keeps its command buffer,
+ * staging memory and post-completion tasks alive as one batch. Batches are
+ * retired in submission order, once their fence has signaled.
+ *
+ * Staging copies are sub-allocated from one persistently mapped buffer of
+ * maxInFlightBytes, used as a ring: each batch takes the bytes after the
+ * previous one and gives them back when it retires. Uploads that don't fit
+ * while earlier batches are still in flight get a dedicated staging buffer.
+ * Only one SingleTimeCommandBuffer may record into the ring at a time.
+ *
+ * Every batch ends with a full memory barrier, so anything recorded later on
+ * the graphics queue, e.g. the frame using the uploaded resources, sees the
+ * uploaded data without any further synchronization.
+ *
+ * Streaming systems should check hasCapacity() before recording more work,
+ * which keeps both the staging memory in flight and the amount uploaded per
+ * frame bounded. Must only be used from the main thread.
+ */
+class ALTHEA_API UploadRing {
+public:
+  UploadRing() = default;
+  UploadRing(
+      const Application& app,
+      size_t frameBudgetBytes = 16 * 1024 * 1024,
+      size_t maxInFlightBytes = 128 * 1024 * 1024);
+  ~UploadRing();
+
+  UploadRing(UploadRing&& rhs) = delete;
+  UploadRing& operator=(UploadRing&& rhs) = delete;
+  UploadRing(const UploadRing& rhs) = delete;
+  UploadRing& operator=(const UploadRing& rhs) = delete;
+
+  /**
+   * @brief Retire finished batches and start a new frame's upload budget.
+   * Called by the application at the start of every frame.
+   */
+  void beginFrame();
+
+  /**
+   * @brief Retire every batch whose fence has signaled, running its
+   * post-completion tasks and releasing its staging buffers.
+   */
+  void poll();
+
+  /**
+   * @brief Block until every submitted batch has been retired.
+   */
+  void waitIdle();
+
+  /**
+   * @brief Whether more work may be recorded this frame.
+   *
+   * @param pendingBytes Staging memory recorded but not yet submitted.
+   * @return False once this frame's budget or the in-flight limit would be
+   * exceeded. Always true while nothing at all is being uploaded, so a single
+   * upload larger than the budget still makes progress.
+   */
+  bool hasCapacity(size_t pendingBytes = 0) const;
+
+  /**
+   * @brief Run a task once every batch submitted so far has been retired,
+   * e.g. to destroy resources that uploads may still be writing to. Runs
+   * immediately if nothing is in flight.
+   */
+  void releaseAfterUploads(std::function<void()>&& task);
+
+  void setFrameBudget(size_t frameBudgetBytes) {
+    m_frameBudgetBytes = frameBudgetBytes;
+  }
+
+  UploadRingStats getStats() const;
+
+private:
+  friend class SingleTimeCommandBuffer;
+
+  struct Batch {
+    VkFence fence = VK_NULL_HANDLE;
+    VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+    std::vector<BufferAllocation> stagingBuffers;
+    std::vector<std::function<void()>> postCompletionTasks;
+    size_t stagingBytes = 0;
+    // Released from the staging ring when the batch retires
+    size_t ringBytes = 0;
+  };
+
+  // Called when a SingleTimeCommandBuffer starts recording into the ring
+  void _beginRecording();
+  // Copies the data into the staging ring, nothing if it doesn't fit
+  std::optional<StagingRange> _stage(gsl::span<const std::byte> data);
+  // Ends and submits a SingleTimeCommandBuffer's commands
+  void _submit(Batch&& batch);
+  void _retire(Batch& batch);
+  VkFence _acquireFence();
+
+  VkDevice m_device = VK_NULL_HANDLE;
+  VkQueue m_queue = VK_NULL_HANDLE;
+  VkCommandPool m_commandPool = VK_NULL_HANDLE;
+
+  size_t m_frameBudgetBytes = 0;
+  size_t m_maxInFlightBytes = 0;
+
+  std::deque<Batch> m_batches;
+  std::vector<VkFence> m_freeFences;
+
+  size_t m_inFlightBytes = 0;
+  size_t m_frameBytes = 0;
+  uint64_t m_batchesSubmitted = 0;
+  uint64_t m_bytesSubmitted = 0;
+  uint64_t m_dedicatedStagingBuffers = 0;
+
+  // The persistent staging buffer, created on first use
+  BufferAllocation m_ringBuffer;
+  std::byte* m_pRingData = nullptr;
+  size_t m_ringHead = 0;
+  // Bytes of the ring used by batches in flight and by the one recording
+  size_t m_ringUsed = 0;
+  // Bytes of the ring used by the batch being recorded
+  size_t m_pendingRingBytes = 0;
+  bool m_isRecording = false;
+};
+} // namespace AltheaEngine
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "FileBufferPool.h"
 #include "Library.h"
 
 #include <gsl/span>
@@ -20,6 +21,14 @@ class ALTHEA_API Utilities {
 public:
   static std::vector<char> readFile(const char* filename);
   static std::vector<char> readFile(const std::string& filename);
+
+  /**
+   * @brief Read a file into a buffer from the FileBufferPool, for files that
+   * are only needed briefly, e.g. while decoding them. The buffer returns to
+   * the pool once the handle is dropped.
+   */
+  static FileBuffer readFilePooled(const char* filename);
+  static FileBuffer readFilePooled(const std::string& filename);
   static bool writeFile(const std::string& fileName, gsl::span<const char> data);
   static bool checkFileExists(const char* filename);
   static bool checkFileExists(const std::string& filename);
@@ -31,7 +31,7 @@ public:
         reinterpret_cast<const std::byte*>(this->_vertices.data()),
         sizeof(TVertex) * this->_vertices.size());
 
-    VkBuffer stagingBuffer =
+    StagingRange staging =
         commandBuffer.createStagingBuffer(app, verticesView);
 
     VmaAllocationCreateInfo deviceAllocInfo{};
@@ -48,8 +48,8 @@ public:
 
     BufferUtilities::copyBuffer(
         commandBuffer,
-        stagingBuffer,
-        0,
+        staging.buffer,
+        staging.offset,
         this->_allocation.getBuffer(),
         0,
         verticesView.size());
@@ -1,6 +1,8 @@
 
 #version 450
 
+// #permutation WIREFRAME
+
 layout(location=0) in vec3 inPosition;
 layout(location=1) in vec3 inNormal;
 layout(location=2) in vec3 inColor;
@@ -1,5 +1,7 @@
 #version 450
 
+// #permutation WIREFRAME
+
 // inst data
 layout(location=0) in mat4 inModel;
 layout(location=4) in vec3 inA;
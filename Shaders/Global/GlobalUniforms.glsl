@@ -21,6 +21,8 @@ UNIFORM_BUFFER(globalUniforms, GlobalUniforms{
   float exposure;
   uint inputMask;
   uint frameCount;
+
+  uint lightClusterGridHandle;
 });
 
 #endif // _GLOBALUNIFORMS_
\ No newline at end of file
@@ -44,7 +44,9 @@ void main() {
       }
     }
   } else {
-    model = getMatrix(pushConstants.matrixBufferHandle, constants.nodeIdx);
+    model = getMatrix(
+        pushConstants.matrixBufferHandle,
+        getInstanceNodeIdx(constants, gl_InstanceIndex));
   } 
 
   vec4 worldPos4 = model * vec4(position, 1.0);
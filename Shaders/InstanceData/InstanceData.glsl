@@ -24,6 +24,7 @@ DECL_BUFFER(R_PACKED, Vertex, primitiveVertices);
 DECL_BUFFER(R_PACKED, uint, primitiveIndices);
 DECL_BUFFER(R_PACKED, mat4, transformBuffer);
 DECL_BUFFER(R_PACKED, uint, jointMap);
+DECL_BUFFER(R_PACKED, uint, instanceNodes);
 
 MaterialDesc fetchMaterial(Vertex v, uint materialHandle) {
   MaterialDesc desc;
@@ -70,6 +71,15 @@ PrimitiveConstants getPrimitiveConstants(uint primitiveHandle) {
   return GET_CONSTANTS(primitiveConstants);
 }
 
+// Expects the Vulkan instance index, which already includes firstInstance
+uint getInstanceNodeIdx(PrimitiveConstants constants, uint instanceIdx) {
+  if (constants.instanceNodesHandle == INVALID_BINDLESS_HANDLE)
+    return constants.nodeIdx;
+  
+  BINDLESS(instanceNodes, constants.instanceNodesHandle);
+  return BUFFER_GET(instanceNodes, instanceIdx);
+}
+
 MaterialDesc fetchMaterialFromPrimitive(Vertex v, uint primitiveHandle) {
   BINDLESS(primitiveConstants, primitiveHandle);
   PrimitiveConstants constants = GET_CONSTANTS(primitiveConstants);
@@ -84,7 +94,7 @@ Vertex fetchVertex(uint idx, uint primitiveHandle) {
   PrimitiveConstants constants = GET_CONSTANTS(primitiveConstants);
 
   BINDLESS(primitiveVertices, constants.vertexBufferHandle);  
-  return BUFFER_GET(primitiveVertices, idx);
+  return BUFFER_GET(primitiveVertices, constants.vertexOffset + idx);
 }
 
 Vertex fetchVertexIndexed(uint i, uint primitiveHandle) {
@@ -94,8 +104,8 @@ Vertex fetchVertexIndexed(uint i, uint primitiveHandle) {
   BINDLESS(primitiveVertices, constants.vertexBufferHandle);
   BINDLESS(primitiveIndices, constants.indexBufferHandle);
     
-  uint idx = BUFFER_GET(primitiveIndices, i);
-  return BUFFER_GET(primitiveVertices, idx);
+  uint idx = BUFFER_GET(primitiveIndices, constants.firstIndex + i);
+  return BUFFER_GET(primitiveVertices, constants.vertexOffset + idx);
 }
 
 Vertex fetchInterpolatedVertexIndexed(uint triangleIdx, vec3 bc, uint primitiveHandle) {
@@ -105,13 +115,13 @@ Vertex fetchInterpolatedVertexIndexed(uint triangleIdx, vec3 bc, uint primitiveH
   BINDLESS(primitiveVertices, constants.vertexBufferHandle);
   BINDLESS(primitiveIndices, constants.indexBufferHandle);
     
-  uint idx0 = BUFFER_GET(primitiveIndices, 3*triangleIdx+0);
-  uint idx1 = BUFFER_GET(primitiveIndices, 3*triangleIdx+1);
-  uint idx2 = BUFFER_GET(primitiveIndices, 3*triangleIdx+2);
+  uint idx0 = BUFFER_GET(primitiveIndices, constants.firstIndex+3*triangleIdx+0);
+  uint idx1 = BUFFER_GET(primitiveIndices, constants.firstIndex+3*triangleIdx+1);
+  uint idx2 = BUFFER_GET(primitiveIndices, constants.firstIndex+3*triangleIdx+2);
 
-  Vertex v0 = BUFFER_GET(primitiveVertices, idx0);
-  Vertex v1 = BUFFER_GET(primitiveVertices, idx1);
-  Vertex v2 = BUFFER_GET(primitiveVertices, idx2);
+  Vertex v0 = BUFFER_GET(primitiveVertices, constants.vertexOffset+idx0);
+  Vertex v1 = BUFFER_GET(primitiveVertices, constants.vertexOffset+idx1);
+  Vertex v2 = BUFFER_GET(primitiveVertices, constants.vertexOffset+idx2);
 
   Vertex v;
   INTERPOLATE(position);
@@ -0,0 +1,38 @@
+#ifndef _LIGHTCLUSTERS_
+#define _LIGHTCLUSTERS_
+
+#include <Bindless/GlobalHeap.glsl>
+
+#define IS_SHADER
+#include <../Include/Althea/Common/LightClustersCommon.h>
+
+BUFFER_R(lightGrid, LightGrid{
+  LightGridHeader header;
+  uint counts[LIGHT_CLUSTER_COUNT];
+  uint indices[];
+});
+
+// uv is the screen-space position in [0, 1] and viewDepth is the positive
+// distance along the camera's forward axis
+uint getLightClusterIdx(uint gridHandle, vec2 uv, float viewDepth) {
+  LightGridHeader header = RESOURCE(lightGrid, gridHandle).header;
+
+  uvec2 tile = uvec2(clamp(
+      uv * vec2(LIGHT_CLUSTERS_X, LIGHT_CLUSTERS_Y), 
+      vec2(0.0), 
+      vec2(LIGHT_CLUSTERS_X - 1, LIGHT_CLUSTERS_Y - 1)));
+  float slice = 
+      log(viewDepth / header.zNear) / log(header.zFar / header.zNear) * 
+      LIGHT_CLUSTERS_Z;
+  uint z = uint(clamp(slice, 0.0, LIGHT_CLUSTERS_Z - 1));
+
+  return (z * LIGHT_CLUSTERS_Y + tile.y) * LIGHT_CLUSTERS_X + tile.x;
+}
+
+#define getClusterLightCount(gridHandle, clusterIdx) \
+  RESOURCE(lightGrid, gridHandle).counts[clusterIdx]
+#define getClusterLightIdx(gridHandle, clusterIdx, i) \
+  RESOURCE(lightGrid, gridHandle) \
+    .indices[(clusterIdx) * MAX_LIGHTS_PER_CLUSTER + (i)]
+
+#endif // _LIGHTCLUSTERS_
@@ -1,5 +1,7 @@
 #version 450
 
+// #permutation BINDLESS_SET=0
+
 layout(location=0) in vec3 inColor;
 
 layout(location=0) out vec4 outColor;
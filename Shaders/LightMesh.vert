@@ -1,5 +1,7 @@
 #version 460 core
 
+// #permutation BINDLESS_SET=0
+
 // Per-vertex attributes
 layout(location=0) in vec3 vertPos;
 
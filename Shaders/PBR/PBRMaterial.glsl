@@ -1,6 +1,8 @@
 #include <Misc/Constants.glsl>
 #include <Misc/Sampling.glsl>
 
+#include <LightClusters.glsl>
+
 vec3 sampleEnvMap(vec3 reflectedDirection, float roughness) {
   float yaw = atan(reflectedDirection.z, reflectedDirection.x);
   float pitch = -atan(reflectedDirection.y, length(reflectedDirection.xz));
@@ -113,8 +115,27 @@ vec3 pbrMaterial(
     color += (irradianceColor * diffuseColor + ambientSpecular) * ambientOcclusion;
   }
 
-  // Compute direct contribution of point lights
-  for (int i = 0; i < globals.lightCount; ++i) {
+  // Compute direct contribution of point lights, only the ones in the
+  // current light cluster if a light grid is bound
+  uint gridHandle = globals.lightClusterGridHandle;
+  bool useClusters = gridHandle != INVALID_BINDLESS_HANDLE;
+  uint clusterIdx = 0;
+  uint shadedLightCount = uint(globals.lightCount);
+  if (useClusters) {
+    vec4 clusterViewPos = globals.view * vec4(worldPos, 1.0);
+    vec4 clusterClipPos = globals.projection * clusterViewPos;
+    clusterIdx = 
+        getLightClusterIdx(
+          gridHandle, 
+          0.5 * clusterClipPos.xy / clusterClipPos.w + 0.5, 
+          -clusterViewPos.z);
+    shadedLightCount = getClusterLightCount(gridHandle, clusterIdx);
+  }
+
+  for (uint shadedLightIdx = 0; shadedLightIdx < shadedLightCount; ++shadedLightIdx) {
+    int i = useClusters ? 
+        int(getClusterLightIdx(gridHandle, clusterIdx, shadedLightIdx)) : 
+        int(shadedLightIdx);
     PointLight light = pointLightArr[i];
 
     vec3 L = light.position - worldPos;
@@ -31,15 +31,43 @@ layout(scalar, set=BINDLESS_SET, binding=BUFFER_HEAP_BINDING) readonly buffer VB
   Vertex vertices[];
 } vertexBufferHeap[];
 
+// Vertex indices are relative to the primitive's range within the shared
+// vertex buffer
 #define getVertex(primIdx, vertexIdx) \
-    vertexBufferHeap[getPrimitive(primIdx).vertexBufferHandle].vertices[vertexIdx]
+    vertexBufferHeap[getPrimitive(primIdx).vertexBufferHandle] \
+      .vertices[getPrimitive(primIdx).vertexOffset + (vertexIdx)]
 
 BUFFER_R(indexBufferHeap, IBResource{
   uint indices[];
 });
 
 #define getIndex(primIdx, idx) \
-    indexBufferHeap[getPrimitive(primIdx).indexBufferHandle].indices[idx]
+    indexBufferHeap[getPrimitive(primIdx).indexBufferHandle] \
+      .indices[getPrimitive(primIdx).firstIndex + (idx)]
+
+BUFFER_R(meshletHeap, MeshletBuffer{
+  Meshlet meshlets[];
+});
+#define getMeshlet(primIdx, meshletIdx) \
+    meshletHeap[getPrimitive(primIdx).meshletBufferHandle] \
+      .meshlets[getPrimitive(primIdx).meshletOffset + (meshletIdx)]
+
+// Meshlet data is stored in the shared index buffer, the offsets in the
+// meshlet are absolute
+#define getMeshletVertex(primIdx, meshlet, localIdx) \
+    indexBufferHeap[getPrimitive(primIdx).indexBufferHandle] \
+      .indices[meshlet.vertexOffset + (localIdx)]
+#define getMeshletTriangle(primIdx, meshlet, triIdx) \
+    unpackMeshletTriangle( \
+      indexBufferHeap[getPrimitive(primIdx).indexBufferHandle] \
+        .indices[meshlet.triangleOffset + (triIdx)])
+
+uvec3 unpackMeshletTriangle(uint packedTriangle) {
+  return uvec3(
+      packedTriangle & 0xff,
+      (packedTriangle >> 8) & 0xff,
+      (packedTriangle >> 16) & 0xff);
+}
 
 BUFFER_R(matrixHeap, MatrixBuffer{
   mat4 matrices[];
@@ -53,4 +81,14 @@ BUFFER_R(jointMapHeap, JointMapBuffer{
 #define getNodeIdxFromJointIdx(jointMapHandle, jointIdx) \
     jointMapHeap[jointMapHandle].jointToNode[jointIdx];
 
+BUFFER_R(instanceNodesHeap, InstanceNodesBuffer{
+  uint instanceNodes[];
+});
+// Expects the Vulkan instance index, which already includes firstInstance
+#define getPrimitiveInstanceNodeIdx(primIdx, instanceIdx) \
+    (getPrimitive(primIdx).instanceNodesHandle == INVALID_BINDLESS_HANDLE ? \
+      getPrimitive(primIdx).nodeIdx : \
+      instanceNodesHeap[getPrimitive(primIdx).instanceNodesHandle] \
+        .instanceNodes[instanceIdx])
+
 #endif // _PRIMITIVERESOURCES_
\ No newline at end of file
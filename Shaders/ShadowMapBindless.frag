@@ -1,40 +1,40 @@
 #version 460 core
 
+// #permutation BINDLESS_SET=0
+
 layout(location=0) in vec3 worldPosCS;
-layout(location=1) in vec2 baseColorUV;
+layout(location=1) in vec2 uvs[4];
 
 layout(depth_any) out float gl_FragDepth;
 
-#include "Global/GlobalResources.glsl"
-#include "PrimitiveResources.glsl"
-
-SAMPLER2D(textureHeap);
+#include <Bindless/GlobalHeap.glsl>
+#include <InstanceData/InstanceData.glsl>
 
 layout(push_constant) uniform PushConstants {
-  mat4 model;
-  uint primIdx;
+  uint matrixBufferHandle;
+  uint primConstantsBuffer;
   uint lightIdx;
   uint globalResourcesHandle;
   uint pointLightBufferHandle;
   uint pointLightConstantsHandle;
+  uint faceMask;
 } pushConstants;
 
-#define resources RESOURCE(globalResources, pushConstants.globalResourcesHandle)
-
 void main() {
-  PrimitiveConstants primConstants = 
-      RESOURCE(primitiveConstants, resources.primitiveConstantsBuffer)
-        .primitiveConstantsArr[pushConstants.primIdx];
-  
   // TODO: PARAMATERIZE NEAR / FAR
   float zNear = 0.01;
   float zFar = 1000.0;
 
   // Read opacity mask (alpha channel of base color)
-  float alpha = 
-      (primConstants.baseColorFactor * 
-       TEXTURE_SAMPLE(textureHeap, primConstants.baseTextureHandle, baseColorUV)).a;
-  if (alpha < primConstants.alphaCutoff) {
+  Vertex v;
+  v.position = vec3(0.0);
+  v.tangent = vec3(1.0, 0.0, 0.0);
+  v.bitangent = vec3(0.0, 1.0, 0.0);
+  v.normal = vec3(0.0, 0.0, 1.0);
+  v.uvs = uvs;
+
+  MaterialDesc material = fetchMaterialFromPrimitive(v, pushConstants.primConstantsBuffer);
+  if (material.bShouldDiscard) {
     discard;
   }
 
@@ -1,5 +1,7 @@
 #version 460 core
 
+// #permutation BINDLESS_SET=0
+
 #extension GL_EXT_multiview : enable
 
 layout(location=0) in vec3 position;
@@ -8,44 +10,67 @@ layout(location=1) in mat3 tbn;
 // layout(location = 2) in vec3 bitangent;
 // layout(location = 3) in vec3 normal;
 layout(location=4) in vec2 uvs[4];
+// ... also takes location 5, 6, 7
+layout(location=8) in vec4 weights;
+layout(location=9) in uvec4 joints;
 
 layout(location=0) out vec3 worldPosCS;
-layout(location=1) out vec2 baseColorUV;
+layout(location=1) out vec2 outUvs[4];
 
+#include <Bindless/GlobalHeap.glsl>
 #include <PointLights.glsl>
-
-#include "Global/GlobalResources.glsl"
-#include "PrimitiveResources.glsl"
+#include <InstanceData/InstanceData.glsl>
 
 layout(push_constant) uniform PushConstants {
-  mat4 model;
+  uint matrixBufferHandle;
   uint primConstantsBuffer;
   uint lightIdx;
   uint globalResourcesHandle;
   uint pointLightBufferHandle;
   uint pointLightConstantsHandle;
+  // Bit i is set if the primitive may be visible from cube face i
+  uint faceMask;
 } pushConstants;
 
-#define resources RESOURCE(globalResources,pushConstants.globalResourcesHandle)
 #define lightConstants RESOURCE(pointLightConstants,pushConstants.pointLightConstantsHandle)
 
 void main() {
+  outUvs = uvs;
+
+  // The multiview pass draws into all six faces at once, move culled
+  // faces behind the far plane so the rasterizer rejects them
+  if ((pushConstants.faceMask & (1 << gl_ViewIndex)) == 0) {
+    gl_Position = vec4(0.0, 0.0, 2.0, 1.0);
+    worldPosCS = vec3(0.0);
+    return;
+  }
+
   PointLight light = 
       RESOURCE(pointLights, pushConstants.pointLightBufferHandle)
         .pointLightArr[pushConstants.lightIdx];
 
-  // TODO: Maybe don't need this level of indirection...
-  PrimitiveConstants primConstants = 
-      RESOURCE(primitiveConstants, pushConstants.primConstantsBuffer)
-        .primitiveConstantsArr[0];
+  PrimitiveConstants constants = getPrimitiveConstants(pushConstants.primConstantsBuffer);
+
+  mat4 model = mat4(0.0);
+  if (constants.isSkinned > 0) {
+    for (int i = 0; i < 4; ++i) {
+      if (weights[i] > 0.0) {
+        uint nodeIdx = getNodeIdxFromJointIdx(constants.jointMapHandle, joints[i]);
+        model += weights[i] * getMatrix(pushConstants.matrixBufferHandle, nodeIdx);
+      }
+    }
+  } else {
+    model = getMatrix(
+        pushConstants.matrixBufferHandle,
+        getInstanceNodeIdx(constants, gl_InstanceIndex));
+  }
   
   // Note the view matrix here is centered at the origin here for re-usability, we just subtract
   // the light position from the vertex position to compensate
-  vec4 worldPos = pushConstants.model * vec4(position, 1.0);
+  vec4 worldPos = model * vec4(position, 1.0);
   vec4 csPos = lightConstants.views[gl_ViewIndex] * (worldPos - vec4(light.position, 0.0));
 
   gl_Position = lightConstants.projection * csPos;
   
   worldPosCS = csPos.xyz / csPos.w;
-  baseColorUV = uvs[primConstants.baseTextureCoordinateIndex];
-}
\ No newline at end of file
+}
@@ -12,6 +12,12 @@ AccelerationStructure::AccelerationStructure(
     const Application& app,
     SingleTimeCommandBuffer& commandBuffer,
     const std::vector<Model>& models) {
+  if (!app.isRayTracingSupported()) {
+    throw std::runtime_error(
+        "Attempting to build acceleration structures on a device without ray "
+        "tracing support!");
+  }
+
   uint32_t primCount = 0;
   for (const Model& model : models) {
     primCount += static_cast<uint32_t>(model.getPrimitivesCount());
@@ -62,19 +68,23 @@ AccelerationStructure::AccelerationStructure(
 
   for (const Model& model : models) {
     for (const Primitive& prim : model.getPrimitives()) {
-      const VertexBuffer<Vertex>& vertexBuffer = prim.getVertexBuffer();
+      // The primitive's geometry is sub-allocated from the shared arena
+      // buffers, offset the device addresses to its ranges
+      const GeometryAllocation& vertexAllocation = prim.getVertexAllocation();
       VkBufferDeviceAddressInfo vertexBufferAddrInfo{
           VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO};
-      vertexBufferAddrInfo.buffer = vertexBuffer.getAllocation().getBuffer();
+      vertexBufferAddrInfo.buffer = vertexAllocation.getBuffer();
       VkDeviceAddress vertexBufferDevAddr =
-          vkGetBufferDeviceAddress(app.getDevice(), &vertexBufferAddrInfo);
+          vkGetBufferDeviceAddress(app.getDevice(), &vertexBufferAddrInfo) +
+          vertexAllocation.getByteOffset();
 
-      const IndexBuffer& indexBuffer = prim.getIndexBuffer();
+      const GeometryAllocation& indexAllocation = prim.getIndexAllocation();
       VkBufferDeviceAddressInfo indexBufferAddrInfo{
           VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO};
-      indexBufferAddrInfo.buffer = indexBuffer.getAllocation().getBuffer();
+      indexBufferAddrInfo.buffer = indexAllocation.getBuffer();
       VkDeviceAddress indexBufferDevAddr =
-          vkGetBufferDeviceAddress(app.getDevice(), &indexBufferAddrInfo);
+          vkGetBufferDeviceAddress(app.getDevice(), &indexBufferAddrInfo) +
+          indexAllocation.getByteOffset();
 
       VkAccelerationStructureGeometryKHR geometry{VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_KHR};
 
@@ -85,7 +95,7 @@ AccelerationStructure::AccelerationStructure(
           vertexBufferDevAddr;
       geometry.geometry.triangles.vertexStride = sizeof(Vertex);
       geometry.geometry.triangles.maxVertex =
-          static_cast<uint32_t>(vertexBuffer.getVertexCount() - 1);
+          static_cast<uint32_t>(prim.getVertices().size() - 1);
       geometry.geometry.triangles.indexType = VK_INDEX_TYPE_UINT32;
       geometry.geometry.triangles.indexData.deviceAddress = indexBufferDevAddr;
 
@@ -95,7 +105,7 @@ AccelerationStructure::AccelerationStructure(
       geometry.flags = VK_GEOMETRY_OPAQUE_BIT_KHR;
       geometry.geometryType = VK_GEOMETRY_TYPE_TRIANGLES_KHR;
 
-      uint32_t triCount = indexBuffer.getIndexCount() / 3;
+      uint32_t triCount = static_cast<uint32_t>(prim.getIndices().size() / 3);
       VkAccelerationStructureBuildRangeInfoKHR buildRange{};
       buildRange.firstVertex = 0;
       buildRange.primitiveCount = triCount;
@@ -189,34 +199,38 @@ AccelerationStructure::AccelerationStructure(
               app.getDevice(),
               &blasDevAddrInfo);
 
-      VkAccelerationStructureInstanceKHR& tlasInstance =
-          instances.emplace_back();
-      const glm::mat4& primTransform = model.getTransformsBuffer().getVertex(prim.getNodeIdx());
-
-      tlasInstance.transform.matrix[0][0] = primTransform[0][0];
-      tlasInstance.transform.matrix[1][0] = primTransform[0][1];
-      tlasInstance.transform.matrix[2][0] = primTransform[0][2];
-
-      tlasInstance.transform.matrix[0][1] = primTransform[1][0];
-      tlasInstance.transform.matrix[1][1] = primTransform[1][1];
-      tlasInstance.transform.matrix[2][1] = primTransform[1][2];
-
-      tlasInstance.transform.matrix[0][2] = primTransform[2][0];
-      tlasInstance.transform.matrix[1][2] = primTransform[2][1];
-      tlasInstance.transform.matrix[2][2] = primTransform[2][2];
-
-      tlasInstance.transform.matrix[0][3] = primTransform[3][0];
-      tlasInstance.transform.matrix[1][3] = primTransform[3][1];
-      tlasInstance.transform.matrix[2][3] = primTransform[3][2];
-
-      tlasInstance.instanceCustomIndex = prim.getConstantBufferHandle().index;
-      tlasInstance.mask = 0xFF;
-      tlasInstance.instanceShaderBindingTableRecordOffset =
-          0; // For now everything uses same shader
-      tlasInstance.flags =
-          VK_GEOMETRY_INSTANCE_TRIANGLE_FRONT_COUNTERCLOCKWISE_BIT_KHR |
-          VK_GEOMETRY_INSTANCE_TRIANGLE_FACING_CULL_DISABLE_BIT_KHR;
-      tlasInstance.accelerationStructureReference = blasBufferDevAddr;
+      // Instanced primitives share a single BLAS
+      for (uint32_t instanceNodeIdx : prim.getInstanceNodes()) {
+        VkAccelerationStructureInstanceKHR& tlasInstance =
+            instances.emplace_back();
+        const glm::mat4& primTransform =
+            model.getTransformsBuffer().getVertex(instanceNodeIdx);
+
+        tlasInstance.transform.matrix[0][0] = primTransform[0][0];
+        tlasInstance.transform.matrix[1][0] = primTransform[0][1];
+        tlasInstance.transform.matrix[2][0] = primTransform[0][2];
+
+        tlasInstance.transform.matrix[0][1] = primTransform[1][0];
+        tlasInstance.transform.matrix[1][1] = primTransform[1][1];
+        tlasInstance.transform.matrix[2][1] = primTransform[1][2];
+
+        tlasInstance.transform.matrix[0][2] = primTransform[2][0];
+        tlasInstance.transform.matrix[1][2] = primTransform[2][1];
+        tlasInstance.transform.matrix[2][2] = primTransform[2][2];
+
+        tlasInstance.transform.matrix[0][3] = primTransform[3][0];
+        tlasInstance.transform.matrix[1][3] = primTransform[3][1];
+        tlasInstance.transform.matrix[2][3] = primTransform[3][2];
+
+        tlasInstance.instanceCustomIndex = prim.getConstantBufferHandle().index;
+        tlasInstance.mask = 0xFF;
+        tlasInstance.instanceShaderBindingTableRecordOffset =
+            0; // For now everything uses same shader
+        tlasInstance.flags =
+            VK_GEOMETRY_INSTANCE_TRIANGLE_FRONT_COUNTERCLOCKWISE_BIT_KHR |
+            VK_GEOMETRY_INSTANCE_TRIANGLE_FACING_CULL_DISABLE_BIT_KHR;
+        tlasInstance.accelerationStructureReference = blasBufferDevAddr;
+      }
 
       ++primIndex;
 
@@ -273,7 +287,7 @@ AccelerationStructure::AccelerationStructure(
 
   this->_tlasInstances = BufferUtilities::createBuffer(
       app,
-      sizeof(VkAccelerationStructureInstanceKHR),
+      sizeof(VkAccelerationStructureInstanceKHR) * instances.size(),
       VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR |
           VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
       instancesAllocInfo);
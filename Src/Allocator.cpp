@@ -146,6 +146,31 @@ void ImageAllocation::unmapMemory() const {
   vmaUnmapMemory(this->_allocator, this->_allocation);
 }
 
+MemoryAllocation::~MemoryAllocation() {
+  if (this->_allocation != VK_NULL_HANDLE)
+    vmaFreeMemory(this->_allocator, this->_allocation);
+}
+
+MemoryAllocation::MemoryAllocation(MemoryAllocation&& rhs)
+    : _allocator(rhs._allocator),
+      _allocation(rhs._allocation),
+      _info(rhs._info) {
+  rhs._allocation = VK_NULL_HANDLE;
+}
+
+MemoryAllocation& MemoryAllocation::operator=(MemoryAllocation&& rhs) {
+  if (this->_allocation != VK_NULL_HANDLE)
+    vmaFreeMemory(this->_allocator, this->_allocation);
+
+  this->_allocator = rhs._allocator;
+  this->_allocation = rhs._allocation;
+  this->_info = rhs._info;
+
+  rhs._allocation = VK_NULL_HANDLE;
+
+  return *this;
+}
+
 Allocator::Allocator(
     VkInstance instance,
     VkDevice device,
@@ -218,4 +243,36 @@ ImageAllocation Allocator::createImage(
 
   return result;
 }
-} // namespace AltheaEngine
\ No newline at end of file
+
+MemoryAllocation Allocator::allocateMemory(
+    const VkMemoryRequirements& requirements,
+    const VmaAllocationCreateInfo& allocInfo) const {
+  MemoryAllocation result;
+  result._allocator = this->_allocator;
+
+  if (vmaAllocateMemory(
+          this->_allocator,
+          &requirements,
+          &allocInfo,
+          &result._allocation,
+          &result._info) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to allocate memory.");
+  }
+
+  return result;
+}
+
+void Allocator::bindImageMemory(
+    const MemoryAllocation& allocation,
+    VkDeviceSize offset,
+    VkImage image) const {
+  if (vmaBindImageMemory2(
+          this->_allocator,
+          allocation._allocation,
+          offset,
+          image,
+          nullptr) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to bind image memory.");
+  }
+}
+} // namespace AltheaEngine
@@ -3,6 +3,7 @@
 
 #include "DefaultTextures.h"
 #include "IGameInstance.h"
+#include "PackFileSystem.h"
 #include "SingleTimeCommandBuffer.h"
 
 #include <glm/glm.hpp>
@@ -50,6 +51,14 @@ Application::Application(
   GProjectDirectory = projectDir;
   GEngineDirectory = engineDir;
 
+  // Content packed with Tools/AssetPacker is read from the pack instead of
+  // the loose files, when a pack has been built
+  PackFileSystem::mount(engineDir + "/Content.apak", engineDir + "/Content");
+  if (projectDir != engineDir)
+    PackFileSystem::mount(
+        projectDir + "/Content.apak",
+        projectDir + "/Content");
+
   CreateOptions defaultOptions{};
   if (!pCreateOptions)
     pCreateOptions = &defaultOptions;
@@ -112,6 +121,12 @@ void Application::initVulkan() {
   createSwapChain();
   createCommandPool();
 
+  this->pPipelineCache = std::make_unique<PipelineCache>(
+      this->device,
+      this->physicalDeviceProperties,
+      GProjectDirectory + "/Cache/PipelineCache.bin");
+  this->pLayoutCache = std::make_unique<LayoutCache>(this->device);
+
   this->pAllocator = std::make_unique<Allocator>(
       this->instance,
       this->device,
@@ -122,6 +137,9 @@ void Application::initVulkan() {
 
   initDefaultTextures(*this);
   createCommandBuffers();
+  this->pParallelCommandRecorder =
+      std::make_unique<ParallelCommandRecorder>(*this);
+  this->pUploadRing = std::make_unique<UploadRing>(*this);
   createSyncObjects();
 }
 
@@ -202,6 +220,7 @@ void Application::drawFrame() {
   FrameContext frame{time, deltaTime, currentFrame, imageIndex};
 
   this->deletionTasks.tick(frame);
+  this->pUploadRing->beginFrame();
   this->gameInstance->tick(*this, frame);
 
   vkResetFences(device, 1, &inFlightFence);
@@ -259,10 +278,20 @@ void Application::cleanup() {
     vkDestroyFence(device, inFlightFences[i], nullptr);
   }
 
+  // Frees the command buffers of any uploads still in flight
+  this->pUploadRing.reset();
   vkDestroyCommandPool(device, commandPool, nullptr);
+  this->pParallelCommandRecorder.reset();
+
+  if (!this->pPipelineCache->save())
+    std::cout << "Failed to save pipeline cache\n";
+  this->pPipelineCache.reset();
 
   this->deletionTasks.flush();
 
+  // Only safe once nothing holds on to pipeline or descriptor set layouts
+  this->pLayoutCache.reset();
+
   cleanupSwapChain();
 
   destroyDefaultTextures();
@@ -279,6 +308,9 @@ void Application::cleanup() {
 
   glfwDestroyWindow(window);
   glfwTerminate();
+
+  PackFileSystem::unmount(GEngineDirectory + "/Content.apak");
+  PackFileSystem::unmount(GProjectDirectory + "/Content.apak");
 }
 
 bool Application::checkValidationLayerSupport() {
@@ -482,7 +514,8 @@ Application::findQueueFamilies(const VkPhysicalDevice& device) const {
 }
 
 bool Application::checkDeviceExtensionSupport(
-    const VkPhysicalDevice& device) const {
+    const VkPhysicalDevice& device,
+    const std::vector<const char*>& extensions) const {
   uint32_t extensionCount;
   vkEnumerateDeviceExtensionProperties(
       device,
@@ -498,8 +531,8 @@ bool Application::checkDeviceExtensionSupport(
       availableExtensions.data());
 
   std::set<std::string> requiredExtensions(
-      deviceExtensions.begin(),
-      deviceExtensions.end());
+      extensions.begin(),
+      extensions.end());
   for (const VkExtensionProperties& extension : availableExtensions) {
     requiredExtensions.erase(extension.extensionName);
   }
@@ -510,7 +543,8 @@ bool Application::checkDeviceExtensionSupport(
 bool Application::isDeviceSuitable(const VkPhysicalDevice& device) const {
   QueueFamilyIndices indices = findQueueFamilies(device);
 
-  bool extensionsSupported = checkDeviceExtensionSupport(device);
+  bool extensionsSupported =
+      checkDeviceExtensionSupport(device, deviceExtensions);
 
   bool swapChainAdequete = false;
   if (extensionsSupported) {
@@ -519,8 +553,6 @@ bool Application::isDeviceSuitable(const VkPhysicalDevice& device) const {
                         !swapChainSupport.presentModes.empty();
   }
 
-  VkPhysicalDeviceProperties deviceProperties;
-
   VkPhysicalDeviceFeatures2 deviceFeatures{};
   deviceFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
 
@@ -532,52 +564,70 @@ bool Application::isDeviceSuitable(const VkPhysicalDevice& device) const {
   inlineBlockFeatures.sType =
       VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_INLINE_UNIFORM_BLOCK_FEATURES;
 
-  VkPhysicalDeviceAccelerationStructureFeaturesKHR accelFeature{
-      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ACCELERATION_STRUCTURE_FEATURES_KHR};
-
-  VkPhysicalDeviceRayTracingPipelineFeaturesKHR rtPipelineFeature{
-      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_TRACING_PIPELINE_FEATURES_KHR};
-
-  VkPhysicalDeviceRayQueryFeaturesKHR rayQueriesFeature{
-      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_QUERY_FEATURES_KHR};
-
   VkPhysicalDeviceVulkan12Features vulkan12Features{
       VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES};
 
   deviceFeatures.pNext = &multiviewFeatures;
   multiviewFeatures.pNext = &inlineBlockFeatures;
-  inlineBlockFeatures.pNext = &accelFeature;
-  accelFeature.pNext = &rtPipelineFeature;
-  rtPipelineFeature.pNext = &rayQueriesFeature;
-  rayQueriesFeature.pNext = &vulkan12Features;
+  inlineBlockFeatures.pNext = &vulkan12Features;
 
-  vkGetPhysicalDeviceProperties(device, &deviceProperties);
   vkGetPhysicalDeviceFeatures2(device, &deviceFeatures);
 
+  // Integrated and software devices are accepted as well, the discrete GPU
+  // is preferred by pickPhysicalDevice()
   return indices.isComplete() && extensionsSupported && swapChainAdequete &&
-         deviceProperties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU &&
          deviceFeatures.features.geometryShader &&
          deviceFeatures.features.samplerAnisotropy &&
          deviceFeatures.features.fillModeNonSolid &&
          deviceFeatures.features.imageCubeArray &&
          deviceFeatures.features.wideLines &&
          deviceFeatures.features.shaderFloat64 &&
+         deviceFeatures.features.multiDrawIndirect &&
+         // IndirectDraws passes the draw item index as the first instance
+         deviceFeatures.features.drawIndirectFirstInstance &&
          inlineBlockFeatures.inlineUniformBlock &&
-         multiviewFeatures.multiview && accelFeature.accelerationStructure &&
-         // accelFeature.accelerationStructureHostCommands &&
-         //  accelFeature.accelerationStructureIndirectBuild && ??
-         rtPipelineFeature.rayTracingPipeline && rayQueriesFeature.rayQuery &&
+         multiviewFeatures.multiview &&
          vulkan12Features.bufferDeviceAddress &&
          vulkan12Features.scalarBlockLayout &&
          vulkan12Features.runtimeDescriptorArray &&
          vulkan12Features.descriptorIndexing &&
          vulkan12Features.descriptorBindingPartiallyBound &&
-         vulkan12Features.descriptorBindingUpdateUnusedWhilePending;
-  //  rtPipelineFeature.rayTraversalPrimitiveCulling ??
-  //  rtPipelineFeature.rayTracingPipelineTraceRaysIndirect ??; // &&
+         vulkan12Features.descriptorBindingUpdateUnusedWhilePending &&
+         vulkan12Features.drawIndirectCount;
   // inlineBlockFeatures.descriptorBindingInlineUniformBlockUpdateAfterBind;
 }
 
+bool Application::checkRayTracingSupport(
+    const VkPhysicalDevice& device) const {
+  if (!checkDeviceExtensionSupport(device, rayTracingExtensions))
+    return false;
+
+  VkPhysicalDeviceFeatures2 deviceFeatures{};
+  deviceFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+
+  VkPhysicalDeviceAccelerationStructureFeaturesKHR accelFeature{
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ACCELERATION_STRUCTURE_FEATURES_KHR};
+
+  VkPhysicalDeviceRayTracingPipelineFeaturesKHR rtPipelineFeature{
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_TRACING_PIPELINE_FEATURES_KHR};
+
+  VkPhysicalDeviceRayQueryFeaturesKHR rayQueriesFeature{
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_QUERY_FEATURES_KHR};
+
+  deviceFeatures.pNext = &accelFeature;
+  accelFeature.pNext = &rtPipelineFeature;
+  rtPipelineFeature.pNext = &rayQueriesFeature;
+
+  vkGetPhysicalDeviceFeatures2(device, &deviceFeatures);
+
+  // accelFeature.accelerationStructureHostCommands &&
+  //  accelFeature.accelerationStructureIndirectBuild && ??
+  //  rtPipelineFeature.rayTraversalPrimitiveCulling ??
+  //  rtPipelineFeature.rayTracingPipelineTraceRaysIndirect ??
+  return accelFeature.accelerationStructure &&
+         rtPipelineFeature.rayTracingPipeline && rayQueriesFeature.rayQuery;
+}
+
 void Application::pickPhysicalDevice() {
   uint32_t deviceCount = 0;
   vkEnumeratePhysicalDevices(instance, &deviceCount, nullptr);
@@ -588,10 +638,26 @@ void Application::pickPhysicalDevice() {
 
   std::vector<VkPhysicalDevice> devices(deviceCount);
   vkEnumeratePhysicalDevices(instance, &deviceCount, devices.data());
+
+  // Prefer ray tracing support first, then a discrete GPU
+  int bestScore = -1;
   for (const VkPhysicalDevice& device : devices) {
-    if (isDeviceSuitable(device)) {
+    if (!isDeviceSuitable(device))
+      continue;
+
+    VkPhysicalDeviceProperties deviceProperties;
+    vkGetPhysicalDeviceProperties(device, &deviceProperties);
+
+    bool supportsRayTracing = checkRayTracingSupport(device);
+    int score = (supportsRayTracing ? 2 : 0) +
+                (deviceProperties.deviceType ==
+                         VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU
+                     ? 1
+                     : 0);
+    if (score > bestScore) {
+      bestScore = score;
       physicalDevice = device;
-      break;
+      rayTracingSupported = supportsRayTracing;
     }
   }
 
@@ -601,13 +667,20 @@ void Application::pickPhysicalDevice() {
 
   vkGetPhysicalDeviceProperties(physicalDevice, &physicalDeviceProperties);
 
-  rayTracingProperties.sType =
-      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_TRACING_PIPELINE_PROPERTIES_KHR;
+  if (rayTracingSupported) {
+    rayTracingProperties.sType =
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_TRACING_PIPELINE_PROPERTIES_KHR;
 
-  VkPhysicalDeviceProperties2 prop2{
-      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2};
-  prop2.pNext = &rayTracingProperties;
-  vkGetPhysicalDeviceProperties2(physicalDevice, &prop2);
+    VkPhysicalDeviceProperties2 prop2{
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2};
+    prop2.pNext = &rayTracingProperties;
+    vkGetPhysicalDeviceProperties2(physicalDevice, &prop2);
+  } else {
+    // The properties stay zeroed, nothing reads them without ray tracing
+    std::cout << "Ray tracing is not supported by "
+              << physicalDeviceProperties.deviceName
+              << ", ray traced passes are unavailable\n";
+  }
 }
 
 void Application::createLogicalDevice() {
@@ -634,6 +707,8 @@ void Application::createLogicalDevice() {
   deviceFeatures.imageCubeArray = VK_TRUE;
   deviceFeatures.wideLines = VK_TRUE;
   deviceFeatures.shaderFloat64 = VK_TRUE;
+  deviceFeatures.multiDrawIndirect = VK_TRUE;
+  deviceFeatures.drawIndirectFirstInstance = VK_TRUE;
 
   VkPhysicalDeviceInlineUniformBlockFeatures inlineBlockFeatures{};
   inlineBlockFeatures.sType =
@@ -648,6 +723,7 @@ void Application::createLogicalDevice() {
   multiviewFeatures.multiview = VK_TRUE;
   multiviewFeatures.pNext = &inlineBlockFeatures;
 
+  // The ray tracing features are only chained in when supported
   VkPhysicalDeviceAccelerationStructureFeaturesKHR accelFeature{
       VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ACCELERATION_STRUCTURE_FEATURES_KHR};
   accelFeature.accelerationStructure = VK_TRUE;
@@ -671,7 +747,19 @@ void Application::createLogicalDevice() {
   vulkan12Features.descriptorIndexing = VK_TRUE;
   vulkan12Features.descriptorBindingPartiallyBound = VK_TRUE;
   vulkan12Features.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
-  vulkan12Features.pNext = &rayQueryFeature;
+  vulkan12Features.drawIndirectCount = VK_TRUE;
+  if (rayTracingSupported)
+    vulkan12Features.pNext = &rayQueryFeature;
+  else
+    vulkan12Features.pNext = &multiviewFeatures;
+
+  std::vector<const char*> enabledExtensions = deviceExtensions;
+  if (rayTracingSupported) {
+    enabledExtensions.insert(
+        enabledExtensions.end(),
+        rayTracingExtensions.begin(),
+        rayTracingExtensions.end());
+  }
 
   VkDeviceCreateInfo createInfo{};
   createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -682,8 +770,8 @@ void Application::createLogicalDevice() {
   createInfo.pEnabledFeatures = &deviceFeatures;
 
   createInfo.enabledExtensionCount =
-      static_cast<uint32_t>(deviceExtensions.size());
-  createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+      static_cast<uint32_t>(enabledExtensions.size());
+  createInfo.ppEnabledExtensionNames = enabledExtensions.data();
 
   createInfo.pNext = &vulkan12Features;
 
@@ -1021,6 +1109,10 @@ void Application::recordCommandBuffer(
     throw std::runtime_error("Failed to begin recording command buffer!");
   }
 
+  // The frame's fence has been waited on, so the secondary command buffers
+  // recorded for it last time can be recycled
+  this->pParallelCommandRecorder->beginFrame(frame);
+
   this->gameInstance->draw(*this, commandBuffer, frame);
 
   isRecordingCommandBuffer = false;
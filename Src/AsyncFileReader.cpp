@@ -0,0 +1,456 @@
+#include "AsyncFileReader.h"
+
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#define ALTHEA_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+namespace AltheaEngine {
+namespace {
+struct ReadRequest {
+  std::string path;
+  int fd = -1;
+  FileBuffer data;
+  size_t bytesRead = 0;
+  AsyncFileReader::Callback callback;
+};
+
+void finishRead(ReadRequest& request, bool succeeded) {
+#ifndef _WIN32
+  if (request.fd >= 0)
+    close(request.fd);
+  request.fd = -1;
+#endif
+
+  if (succeeded)
+    request.callback(std::move(request.data));
+  else
+    request.callback(std::nullopt);
+}
+
+// Blocking read of the rest of the file
+bool readRemaining(ReadRequest& request) {
+#ifdef _WIN32
+  std::ifstream file(request.path, std::ios::binary);
+  if (!file.is_open())
+    return false;
+
+  file.read(request.data.getData(), request.data.getSize());
+  return file.good();
+#else
+  while (request.bytesRead < request.data.getSize()) {
+    ssize_t result = pread(
+        request.fd,
+        request.data.getData() + request.bytesRead,
+        request.data.getSize() - request.bytesRead,
+        static_cast<off_t>(request.bytesRead));
+    if (result < 0 && errno == EINTR)
+      continue;
+    if (result < 0)
+      return false;
+
+    // The file shrank since it was opened
+    if (result == 0) {
+      request.data.resize(request.bytesRead);
+      break;
+    }
+
+    request.bytesRead += static_cast<size_t>(result);
+  }
+
+  return true;
+#endif
+}
+
+void readOnThreadPool(std::unique_ptr<ReadRequest>&& pRequest) {
+  std::shared_ptr<ReadRequest> pShared = std::move(pRequest);
+  ThreadPool::getShared().submit([pShared]() {
+    finishRead(*pShared, readRemaining(*pShared));
+  });
+}
+
+#ifdef ALTHEA_IO_URING
+// Plenty for the number of files an asset load has in flight, further reads
+// fall back to the thread pool
+constexpr uint32_t RING_ENTRIES = 256;
+// Reads are split into chunks of at most this size, the kernel caps a
+// single read anyways
+constexpr size_t MAX_READ_SIZE = 1 << 30;
+
+// A minimal io_uring without liburing, only issuing reads. Requests are
+// submitted from any thread under a lock, completions are reaped by a
+// single I/O thread.
+class IoUring {
+public:
+  IoUring() {
+    io_uring_params params{};
+    int ringFd =
+        static_cast<int>(syscall(__NR_io_uring_setup, RING_ENTRIES, &params));
+    // Not supported by the kernel, or disabled e.g. by a seccomp filter
+    if (ringFd < 0)
+      return;
+    m_ringFd = ringFd;
+
+    m_sqRingSize = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+    m_cqRingSize =
+        params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool singleMapping = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (singleMapping)
+      m_sqRingSize = m_cqRingSize = std::max(m_sqRingSize, m_cqRingSize);
+
+    m_pSqRing = mmap(
+        nullptr,
+        m_sqRingSize,
+        PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_POPULATE,
+        m_ringFd,
+        IORING_OFF_SQ_RING);
+    if (m_pSqRing == MAP_FAILED) {
+      m_pSqRing = nullptr;
+      _destroy();
+      return;
+    }
+
+    if (singleMapping) {
+      m_pCqRing = m_pSqRing;
+    } else {
+      m_pCqRing = mmap(
+          nullptr,
+          m_cqRingSize,
+          PROT_READ | PROT_WRITE,
+          MAP_SHARED | MAP_POPULATE,
+          m_ringFd,
+          IORING_OFF_CQ_RING);
+      if (m_pCqRing == MAP_FAILED) {
+        m_pCqRing = nullptr;
+        _destroy();
+        return;
+      }
+    }
+
+    m_sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    void* pSqes = mmap(
+        nullptr,
+        m_sqesSize,
+        PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_POPULATE,
+        m_ringFd,
+        IORING_OFF_SQES);
+    if (pSqes == MAP_FAILED) {
+      _destroy();
+      return;
+    }
+    m_pSqes = static_cast<io_uring_sqe*>(pSqes);
+
+    char* pSq = static_cast<char*>(m_pSqRing);
+    m_pSqTail = reinterpret_cast<uint32_t*>(pSq + params.sq_off.tail);
+    m_sqMask = *reinterpret_cast<uint32_t*>(pSq + params.sq_off.ring_mask);
+    m_pSqArray = reinterpret_cast<uint32_t*>(pSq + params.sq_off.array);
+    m_sqEntries = params.sq_entries;
+
+    char* pCq = static_cast<char*>(m_pCqRing);
+    m_pCqHead = reinterpret_cast<uint32_t*>(pCq + params.cq_off.head);
+    m_pCqTail = reinterpret_cast<uint32_t*>(pCq + params.cq_off.tail);
+    m_cqMask = *reinterpret_cast<uint32_t*>(pCq + params.cq_off.ring_mask);
+    m_pCqes = reinterpret_cast<io_uring_cqe*>(pCq + params.cq_off.cqes);
+
+    m_completionThread = std::thread([this]() { _completionLoop(); });
+  }
+
+  ~IoUring() {
+    if (m_ringFd < 0)
+      return;
+
+    {
+      std::lock_guard<std::mutex> lock(m_submitMutex);
+      m_stopping = true;
+    }
+
+    // Wakes the I/O thread, which exits once every read has completed
+    while (true) {
+      {
+        std::lock_guard<std::mutex> lock(m_submitMutex);
+        if (_submit(IORING_OP_NOP, -1, nullptr, 0, 0, 0))
+          break;
+      }
+      std::this_thread::yield();
+    }
+    m_completionThread.join();
+
+    _destroy();
+  }
+
+  bool isValid() const { return m_ringFd >= 0; }
+
+  /**
+   * @brief Queue a read of the rest of the file, returns false if the ring
+   * is full or stopping.
+   */
+  bool submitRead(ReadRequest* pRequest) {
+    std::lock_guard<std::mutex> lock(m_submitMutex);
+    if (m_stopping)
+      return false;
+
+    size_t size = std::min(
+        pRequest->data.getSize() - pRequest->bytesRead,
+        MAX_READ_SIZE);
+    return _submit(
+        IORING_OP_READ,
+        pRequest->fd,
+        pRequest->data.getData() + pRequest->bytesRead,
+        static_cast<uint32_t>(size),
+        pRequest->bytesRead,
+        reinterpret_cast<uint64_t>(pRequest));
+  }
+
+private:
+  // Must hold the submit lock
+  bool _submit(
+      uint8_t opcode,
+      int fd,
+      void* pBuffer,
+      uint32_t size,
+      uint64_t offset,
+      uint64_t userData) {
+    // Keeps the completion queue, which is twice as large, from overflowing
+    if (m_inFlightCount >= m_sqEntries)
+      return false;
+
+    // Only submitting threads write the tail, and the kernel consumes
+    // every entry during io_uring_enter, so the slot is always free
+    uint32_t tail = *m_pSqTail;
+    uint32_t index = tail & m_sqMask;
+    io_uring_sqe& sqe = m_pSqes[index];
+    std::memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode = opcode;
+    sqe.fd = fd;
+    sqe.addr = reinterpret_cast<uint64_t>(pBuffer);
+    sqe.len = size;
+    sqe.off = offset;
+    sqe.user_data = userData;
+    m_pSqArray[index] = index;
+    __atomic_store_n(m_pSqTail, tail + 1, __ATOMIC_RELEASE);
+    ++m_inFlightCount;
+
+    long submitted;
+    do {
+      submitted = syscall(__NR_io_uring_enter, m_ringFd, 1, 0, 0, nullptr, 0);
+    } while (submitted < 0 && errno == EINTR);
+
+    if (submitted != 1) {
+      __atomic_store_n(m_pSqTail, tail, __ATOMIC_RELEASE);
+      --m_inFlightCount;
+      return false;
+    }
+
+    return true;
+  }
+
+  void _completionLoop() {
+    while (true) {
+      // Only this thread writes the head
+      uint32_t head = *m_pCqHead;
+      if (head == __atomic_load_n(m_pCqTail, __ATOMIC_ACQUIRE)) {
+        if (m_inFlightCount == 0) {
+          std::lock_guard<std::mutex> lock(m_submitMutex);
+          if (m_stopping && m_inFlightCount == 0)
+            return;
+        }
+
+        syscall(
+            __NR_io_uring_enter,
+            m_ringFd,
+            0,
+            1,
+            IORING_ENTER_GETEVENTS,
+            nullptr,
+            0);
+        continue;
+      }
+
+      io_uring_cqe cqe = m_pCqes[head & m_cqMask];
+      __atomic_store_n(m_pCqHead, head + 1, __ATOMIC_RELEASE);
+      --m_inFlightCount;
+
+      _onCompletion(cqe);
+    }
+  }
+
+  void _onCompletion(const io_uring_cqe& cqe) {
+    // The wake-up on shutdown
+    if (cqe.user_data == 0)
+      return;
+
+    std::unique_ptr<ReadRequest> pRequest(
+        reinterpret_cast<ReadRequest*>(cqe.user_data));
+
+    if (cqe.res == -EINTR || cqe.res == -EAGAIN) {
+      _continue(std::move(pRequest));
+      return;
+    }
+
+    if (cqe.res == -EINVAL || cqe.res == -EOPNOTSUPP) {
+      // Kernels before 5.6 don't support plain reads
+      readOnThreadPool(std::move(pRequest));
+      return;
+    }
+
+    if (cqe.res < 0) {
+      finishRead(*pRequest, false);
+      return;
+    }
+
+    if (cqe.res == 0) {
+      // The file shrank since it was opened
+      pRequest->data.resize(pRequest->bytesRead);
+    } else {
+      pRequest->bytesRead += static_cast<size_t>(cqe.res);
+    }
+
+    if (pRequest->bytesRead == pRequest->data.getSize()) {
+      finishRead(*pRequest, true);
+      return;
+    }
+
+    // Short read, queue the rest
+    _continue(std::move(pRequest));
+  }
+
+  void _continue(std::unique_ptr<ReadRequest>&& pRequest) {
+    if (submitRead(pRequest.get())) {
+      pRequest.release();
+      return;
+    }
+
+    readOnThreadPool(std::move(pRequest));
+  }
+
+  void _destroy() {
+    if (m_pSqes)
+      munmap(m_pSqes, m_sqesSize);
+    if (m_pCqRing && m_pCqRing != m_pSqRing)
+      munmap(m_pCqRing, m_cqRingSize);
+    if (m_pSqRing)
+      munmap(m_pSqRing, m_sqRingSize);
+    m_pSqes = nullptr;
+    m_pCqRing = nullptr;
+    m_pSqRing = nullptr;
+
+    close(m_ringFd);
+    m_ringFd = -1;
+  }
+
+  int m_ringFd = -1;
+
+  void* m_pSqRing = nullptr;
+  size_t m_sqRingSize = 0;
+  void* m_pCqRing = nullptr;
+  size_t m_cqRingSize = 0;
+  io_uring_sqe* m_pSqes = nullptr;
+  size_t m_sqesSize = 0;
+
+  uint32_t* m_pSqTail = nullptr;
+  uint32_t* m_pSqArray = nullptr;
+  uint32_t m_sqMask = 0;
+  uint32_t m_sqEntries = 0;
+
+  uint32_t* m_pCqHead = nullptr;
+  uint32_t* m_pCqTail = nullptr;
+  uint32_t m_cqMask = 0;
+  io_uring_cqe* m_pCqes = nullptr;
+
+  std::mutex m_submitMutex;
+  bool m_stopping = false;
+  std::atomic<uint32_t> m_inFlightCount{0};
+
+  std::thread m_completionThread;
+};
+
+IoUring& getIoUring() {
+  static IoUring ring;
+  return ring;
+}
+#endif
+} // namespace
+
+/*static*/
+void AsyncFileReader::read(const std::string& path, Callback&& callback) {
+  std::unique_ptr<ReadRequest> pRequest = std::make_unique<ReadRequest>();
+  pRequest->path = path;
+  pRequest->callback = std::move(callback);
+
+#ifdef _WIN32
+  // The size is only known once the file is opened on the worker
+  ThreadPool::getShared().submit(
+      [pShared = std::shared_ptr<ReadRequest>(std::move(pRequest))]() {
+        std::ifstream file(pShared->path, std::ios::ate | std::ios::binary);
+        if (!file.is_open()) {
+          finishRead(*pShared, false);
+          return;
+        }
+
+        pShared->data =
+            FileBufferPool::acquire(static_cast<size_t>(file.tellg()));
+        finishRead(*pShared, readRemaining(*pShared));
+      });
+#else
+  pRequest->fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (pRequest->fd < 0) {
+    finishRead(*pRequest, false);
+    return;
+  }
+
+  struct stat fileStat;
+  if (fstat(pRequest->fd, &fileStat) != 0) {
+    finishRead(*pRequest, false);
+    return;
+  }
+
+  pRequest->data =
+      FileBufferPool::acquire(static_cast<size_t>(fileStat.st_size));
+  if (pRequest->data.isEmpty()) {
+    finishRead(*pRequest, true);
+    return;
+  }
+
+#ifdef ALTHEA_IO_URING
+  IoUring& ring = getIoUring();
+  if (ring.isValid() && ring.submitRead(pRequest.get())) {
+    // Owned by the ring until the read completes
+    pRequest.release();
+    return;
+  }
+#endif
+
+  readOnThreadPool(std::move(pRequest));
+#endif
+}
+
+/*static*/
+bool AsyncFileReader::isUsingIoUring() {
+#ifdef ALTHEA_IO_URING
+  return getIoUring().isValid();
+#else
+  return false;
+#endif
+}
+} // namespace AltheaEngine
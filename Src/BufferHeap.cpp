@@ -28,11 +28,11 @@ BufferHeap::CreateVertexBufferHeap(const std::vector<Model>& models) {
   uint32_t bufferSlotIdx = 0;
   for (const Model& model : models) {
     for (const Primitive& prim : model.getPrimitives()) {
-      const VertexBuffer<Vertex>& buffer = prim.getVertexBuffer();
+      const GeometryAllocation& allocation = prim.getVertexAllocation();
       heap._initBufferInfo(
-          buffer.getAllocation().getBuffer(),
-          0,
-          buffer.getVertexCount() * sizeof(Vertex),
+          allocation.getBuffer(),
+          allocation.getByteOffset(),
+          prim.getVertices().size() * sizeof(Vertex),
           bufferSlotIdx++);
     }
   }
@@ -56,11 +56,11 @@ BufferHeap BufferHeap::CreateIndexBufferHeap(const std::vector<Model>& models) {
   uint32_t bufferSlotIdx = 0;
   for (const Model& model : models) {
     for (const Primitive& prim : model.getPrimitives()) {
-      const IndexBuffer& buffer = prim.getIndexBuffer();
+      const GeometryAllocation& allocation = prim.getIndexAllocation();
       heap._initBufferInfo(
-          buffer.getAllocation().getBuffer(),
-          0,
-          buffer.getIndexCount() * sizeof(uint32_t),
+          allocation.getBuffer(),
+          allocation.getByteOffset(),
+          prim.getIndices().size() * sizeof(uint32_t),
           bufferSlotIdx++);
     }
   }
@@ -91,6 +91,10 @@ glm::mat4 Camera::computeView() const {
   return glm::affineInverse(this->_transform);
 }
 
+Frustum Camera::computeFrustum() const {
+  return Frustum::fromViewProjection(this->_projection * this->computeView());
+}
+
 void Camera::_recomputeProjection() {
   this->_projection = glm::perspective(
       this->_fov,
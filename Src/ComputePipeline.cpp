@@ -24,7 +24,10 @@ std::string ComputePipelineBuilder::compileShadersGetErrors() {
 ComputePipeline::ComputePipeline(
     const Application& app,
     ComputePipelineBuilder&& builder)
-    : _pipelineLayout(app, builder.layoutBuilder),
+    : _pipelineLayout(
+          app,
+          builder.layoutBuilder,
+          builder._shaderBuilder.reflect()),
       _shader(app, builder._shaderBuilder),
       _builder(std::move(builder)) {
   VkComputePipelineCreateInfo pipelineInfo{};
@@ -41,7 +44,7 @@ ComputePipeline::ComputePipeline(
   VkPipeline computePipeline;
   if (vkCreateComputePipelines(
           device,
-          VK_NULL_HANDLE,
+          app.getPipelineCache(),
           1,
           &pipelineInfo,
           nullptr,
@@ -104,7 +107,7 @@ bool ComputePipeline::recompileStaleShaders() {
   bool stale = false;
   if (this->_builder._shaderBuilder.reloadIfStale()) {
     stale = true;
-    this->_builder._shaderBuilder.recompile();
+    this->_builder._shaderBuilder.recompileAsync();
   }
 
   return stale;
@@ -265,6 +265,47 @@ void GBufferResources::registerToHeap(GlobalHeap& heap) {
   heap.updateTexture(_stencilBHandle, _stencilBView, _depthB.sampler);
 }
 
+GBufferGraphHandles
+GBufferResources::importToRenderGraph(RenderGraph& graph) const {
+  RenderGraphAccess textureAccess = RenderGraphAccess::sampled(
+      VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT |
+      VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+  auto importResource = [&](const std::string& name,
+                            const ImageResource& resource) {
+    return graph.importImage(
+        name,
+        resource.image,
+        resource.view,
+        resource.image.getOptions(),
+        textureAccess);
+  };
+
+  GBufferGraphHandles handles{};
+  handles.depthA = importResource("GBuffer Depth A", this->_depthA);
+  handles.depthB = importResource("GBuffer Depth B", this->_depthB);
+  handles.normal = importResource("GBuffer Normal", this->_normal);
+  handles.albedo = importResource("GBuffer Albedo", this->_albedo);
+  handles.metallicRoughnessOcclusion = importResource(
+      "GBuffer Metallic-Roughness-Occlusion",
+      this->_metallicRoughnessOcclusion);
+
+  return handles;
+}
+
+/*static*/
+void GBufferResources::readTextures(
+    RenderGraphPassBuilder& pass,
+    const GBufferGraphHandles& handles,
+    VkPipelineStageFlags stageMask) {
+  RenderGraphAccess access = RenderGraphAccess::sampled(stageMask);
+  pass.read(handles.depthA, access)
+      .read(handles.depthB, access)
+      .read(handles.normal, access)
+      .read(handles.albedo, access)
+      .read(handles.metallicRoughnessOcclusion, access);
+}
+
 SceneToGBufferPass::SceneToGBufferPass(
     const Application& app,
     GBufferResources& gBuffer,
@@ -330,4 +371,38 @@ void SceneToGBufferPass::begin(
     _phase = !_phase;
   }
 }
-} // namespace AltheaEngine
\ No newline at end of file
+
+void SceneToGBufferPass::addToRenderGraph(
+    const Application& app,
+    RenderGraph& graph,
+    const GBufferGraphHandles& gBuffer,
+    VkDescriptorSet heapSet,
+    BufferHandle globalResourcesHandle,
+    UniformHandle globalUniformsHandle) {
+  RenderGraphPassBuilder pass = graph.addPass(
+      "Scene to GBuffer",
+      [this, &app, heapSet, globalResourcesHandle, globalUniformsHandle](
+          const RenderGraphContext& context) {
+        this->begin(
+            app,
+            context.commandBuffer,
+            context.frame,
+            heapSet,
+            globalResourcesHandle,
+            globalUniformsHandle);
+      });
+
+  pass.write(gBuffer.normal, RenderGraphAccess::colorAttachment())
+      .write(gBuffer.albedo, RenderGraphAccess::colorAttachment())
+      .write(
+          gBuffer.metallicRoughnessOcclusion,
+          RenderGraphAccess::colorAttachment());
+
+  // The graph is compiled once, while the depth buffer rendered to alternates
+  // every frame. Both are declared, the other one keeps the previous frame's
+  // depth.
+  pass.readWrite(gBuffer.depthA, RenderGraphAccess::depthAttachment());
+  if (_builder._doubleBufferDepth)
+    pass.readWrite(gBuffer.depthB, RenderGraphAccess::depthAttachment());
+}
+} // namespace AltheaEngine
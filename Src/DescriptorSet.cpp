@@ -452,16 +452,9 @@ DescriptorSetAllocator::DescriptorSetAllocator(
       VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
   descriptorSetLayoutInfo.pNext = &bindingFlagsInfo;
 
-  VkDescriptorSetLayout layout;
-  if (vkCreateDescriptorSetLayout(
-          this->_device,
-          &descriptorSetLayoutInfo,
-          nullptr,
-          &layout) != VK_SUCCESS) {
-    throw std::runtime_error("Failed to create descriptor set layout!");
-  }
-
-  this->_layout.set(this->_device, layout);
+  // Owned by the cache, so identical layouts are shared across allocators
+  this->_layout =
+      app.getLayoutCache().getDescriptorSetLayout(descriptorSetLayoutInfo);
 
   // Create descriptor pool sizes according to the descriptor set layout.
   // This will be used later when creating new pools.
@@ -473,12 +466,6 @@ DescriptorSetAllocator::DescriptorSetAllocator(
   }
 }
 
-void DescriptorSetAllocator::DescriptorSetLayoutDeleter::operator()(
-    VkDevice device,
-    VkDescriptorSetLayout layout) {
-  vkDestroyDescriptorSetLayout(device, layout, nullptr);
-}
-
 void DescriptorSetAllocator::DescriptorPoolDeleter::operator()(
     VkDevice device,
     VkDescriptorPool pool) {
@@ -10,9 +10,13 @@ void DrawContext::bindDescriptorSets(VkDescriptorSet set) const {
 
   uint32_t descriptorSetCount = this->_globalDescriptorSetCount + 1;
 
-  // Mutate _descriptorSets so that all the descriptor sets are
-  // contiguous in memory for the binding operation.
-  this->_descriptorSets[this->_globalDescriptorSetCount] = set;
+  // Copy the descriptor sets to the stack so that they are contiguous in
+  // memory for the binding operation, without mutating this context. Worker
+  // threads may be drawing with copies of the same context.
+  VkDescriptorSet descriptorSets[4];
+  for (uint32_t i = 0; i < this->_globalDescriptorSetCount; ++i)
+    descriptorSets[i] = this->_descriptorSets[i];
+  descriptorSets[this->_globalDescriptorSetCount] = set;
 
   vkCmdBindDescriptorSets(
       this->_commandBuffer,
@@ -20,7 +24,7 @@ void DrawContext::bindDescriptorSets(VkDescriptorSet set) const {
       this->_pCurrentSubpass->getPipeline().getLayout(),
       0,
       descriptorSetCount,
-      this->_descriptorSets,
+      descriptorSets,
       0,
       nullptr);
 }
@@ -77,6 +81,11 @@ void DrawContext::setFrontFaceDynamic(VkFrontFace frontFace) const {
   vkCmdSetFrontFace(this->_commandBuffer, frontFace);
 }
 
+bool DrawContext::isDynamicFrontFaceEnabled() const {
+  assert(this->_pCurrentSubpass != nullptr);
+  return this->_pCurrentSubpass->getPipeline().isDynamicFrontFaceEnabled();
+}
+
 void DrawContext::setStencilCompareMask(
     VkStencilFaceFlags flags,
     uint32_t cmpMask) const {
@@ -103,6 +112,11 @@ void DrawContext::setStencilReference(
   vkCmdSetStencilReference(_commandBuffer, flags, reference);
 }
 
+void DrawContext::bindVertexBuffer(VkBuffer buffer, VkDeviceSize offset)
+    const {
+  vkCmdBindVertexBuffers(this->_commandBuffer, 0, 1, &buffer, &offset);
+}
+
 void DrawContext::bindIndexBuffer(const IndexBuffer& indexBuffer) const {
   const BufferAllocation& allocation = indexBuffer.getAllocation();
   vkCmdBindIndexBuffer(
@@ -112,11 +126,27 @@ void DrawContext::bindIndexBuffer(const IndexBuffer& indexBuffer) const {
       VK_INDEX_TYPE_UINT32);
 }
 
-void DrawContext::drawIndexed(uint32_t indexCount, uint32_t instanceCount)
-    const {
-  // TODO: Expose more flexible draw commands, index offset, vertex offset,
-  // instance count, etc.
-  vkCmdDrawIndexed(this->_commandBuffer, indexCount, instanceCount, 0, 0, 0);
+void DrawContext::bindIndexBuffer(VkBuffer buffer, VkDeviceSize offset) const {
+  vkCmdBindIndexBuffer(
+      this->_commandBuffer,
+      buffer,
+      offset,
+      VK_INDEX_TYPE_UINT32);
+}
+
+void DrawContext::drawIndexed(
+    uint32_t indexCount,
+    uint32_t instanceCount,
+    uint32_t firstIndex,
+    int32_t vertexOffset,
+    uint32_t firstInstance) const {
+  vkCmdDrawIndexed(
+      this->_commandBuffer,
+      indexCount,
+      instanceCount,
+      firstIndex,
+      vertexOffset,
+      firstInstance);
 }
 
 void DrawContext::draw(uint32_t vertexCount, uint32_t instanceCount) const {
@@ -0,0 +1,307 @@
+#include "DrawList.h"
+
+#include "Primitive.h"
+#include "RenderPass.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace AltheaEngine {
+
+/*static*/
+uint64_t DrawList::makeSortKey(
+    uint32_t pipeline,
+    uint32_t material,
+    VkFrontFace frontFace,
+    float depth) {
+  constexpr uint32_t depthBuckets = (1u << DEPTH_BITS) - 1;
+  depth = std::clamp(depth, 0.0f, 1.0f);
+  uint64_t depthBucket =
+      static_cast<uint64_t>(depth * static_cast<float>(depthBuckets));
+
+  uint64_t pipelineBits = pipeline & ((1u << PIPELINE_BITS) - 1);
+  uint64_t materialBits = material & ((1u << MATERIAL_BITS) - 1);
+  uint64_t frontFaceBits = frontFace == VK_FRONT_FACE_CLOCKWISE ? 1 : 0;
+
+  // The lowest bits are left unused
+  uint32_t depthShift = 64 - PIPELINE_BITS - MATERIAL_BITS - 1 - DEPTH_BITS;
+  return (pipelineBits << (64 - PIPELINE_BITS)) |
+         (materialBits << (64 - PIPELINE_BITS - MATERIAL_BITS)) |
+         (frontFaceBits << (depthShift + DEPTH_BITS)) |
+         (depthBucket << depthShift);
+}
+
+void DrawList::clear() {
+  m_packets.clear();
+  m_pushConstants.clear();
+  m_sorted.clear();
+  m_isSorted = false;
+}
+
+/*static*/
+DrawPacket DrawList::_makePrimitivePacket(
+    uint64_t sortKey,
+    const Primitive& primitive,
+    uint32_t lodIdx) {
+  MeshLod lod = primitive.getLod(lodIdx);
+  const PrimitiveConstants& constants = primitive.getConstants();
+
+  DrawPacket packet{};
+  packet.sortKey = sortKey;
+  packet.vertexBuffer = primitive.getVertexAllocation().getBuffer();
+  packet.indexBuffer = primitive.getIndexAllocation().getBuffer();
+  packet.frontFace = primitive.getFrontFace();
+  packet.indexCount = lod.indexCount;
+  packet.instanceCount = constants.instanceCount;
+  packet.firstIndex = lod.firstIndex;
+  packet.vertexOffset =
+      static_cast<int32_t>(primitive.getVertexAllocation().getOffset());
+  packet.firstInstance = constants.firstInstance;
+
+  return packet;
+}
+
+void DrawList::_addPacket(
+    DrawPacket packet,
+    const void* pPushConstants,
+    size_t size) {
+  packet.pushConstantsOffset = static_cast<uint32_t>(m_pushConstants.size());
+  packet.pushConstantsSize = static_cast<uint32_t>(size);
+
+  if (size > 0) {
+    m_pushConstants.resize(m_pushConstants.size() + size);
+    std::memcpy(
+        &m_pushConstants[packet.pushConstantsOffset],
+        pPushConstants,
+        size);
+  }
+
+  m_packets.push_back(packet);
+  m_isSorted = false;
+  ++m_stats.packetCount;
+}
+
+void DrawList::sort() {
+  size_t count = m_packets.size();
+  m_sorted.resize(count);
+  m_sortScratch.resize(count);
+  for (size_t i = 0; i < count; ++i)
+    m_sorted[i] = {m_packets[i].sortKey, static_cast<uint32_t>(i)};
+
+  // LSD radix sort, one byte per pass. The histograms of all passes are
+  // gathered up front, which also reveals the passes where every key has the
+  // same byte, e.g., unused key bits, so those can be skipped.
+  constexpr uint32_t passCount = 8;
+  uint32_t histograms[passCount][256] = {};
+  for (const SortEntry& entry : m_sorted) {
+    for (uint32_t pass = 0; pass < passCount; ++pass)
+      ++histograms[pass][(entry.key >> (8 * pass)) & 0xff];
+  }
+
+  for (uint32_t pass = 0; pass < passCount; ++pass) {
+    uint32_t* histogram = histograms[pass];
+    uint32_t shift = 8 * pass;
+
+    if (count == 0 || histogram[(m_sorted[0].key >> shift) & 0xff] == count)
+      continue;
+
+    uint32_t offset = 0;
+    for (uint32_t i = 0; i < 256; ++i) {
+      uint32_t bucketCount = histogram[i];
+      histogram[i] = offset;
+      offset += bucketCount;
+    }
+
+    for (const SortEntry& entry : m_sorted)
+      m_sortScratch[histogram[(entry.key >> shift) & 0xff]++] = entry;
+
+    std::swap(m_sorted, m_sortScratch);
+  }
+
+  m_isSorted = true;
+}
+
+void DrawList::record(const DrawContext& context) {
+  if (!m_isSorted)
+    sort();
+
+  _record(context, 0, m_sorted.size(), m_stats);
+}
+
+void DrawList::record(const DrawContext& context, uint32_t pipeline) {
+  if (!m_isSorted)
+    sort();
+
+  auto pipelineLess = [](const SortEntry& entry, uint32_t pipeline) {
+    return getPipelineFromSortKey(entry.key) < pipeline;
+  };
+  auto begin = std::lower_bound(
+      m_sorted.begin(),
+      m_sorted.end(),
+      pipeline,
+      pipelineLess);
+  auto end = begin;
+  while (end != m_sorted.end() && getPipelineFromSortKey(end->key) == pipeline)
+    ++end;
+
+  _record(
+      context,
+      static_cast<size_t>(begin - m_sorted.begin()),
+      static_cast<size_t>(end - m_sorted.begin()),
+      m_stats);
+}
+
+void DrawList::recordParallel(
+    ActiveRenderPass& pass,
+    ParallelCommandRecorder& recorder,
+    uint32_t taskCount) {
+  if (!m_isSorted)
+    sort();
+
+  // Don't bother spinning up tasks for tiny chunks
+  size_t maxTaskCount =
+      (m_sorted.size() + MIN_PACKETS_PER_TASK - 1) / MIN_PACKETS_PER_TASK;
+  taskCount = static_cast<uint32_t>(
+      std::min(static_cast<size_t>(taskCount), maxTaskCount));
+  if (taskCount == 0)
+    return;
+
+  // Each task records a contiguous range of the sorted packets, the state
+  // elision restarts at the start of each range. Stats are gathered per task
+  // and merged afterwards.
+  std::vector<DrawListStats> taskStats(taskCount);
+  size_t packetsPerTask = (m_sorted.size() + taskCount - 1) / taskCount;
+  pass.recordParallel(
+      recorder,
+      taskCount,
+      [&](const DrawContext& context, uint32_t taskIdx) {
+        size_t begin = std::min(taskIdx * packetsPerTask, m_sorted.size());
+        size_t end = std::min(begin + packetsPerTask, m_sorted.size());
+        _record(context, begin, end, taskStats[taskIdx]);
+      });
+
+  for (const DrawListStats& stats : taskStats) {
+    m_stats.drawCount += stats.drawCount;
+    m_stats.drawsSaved += stats.drawsSaved;
+    m_stats.bindCount += stats.bindCount;
+    m_stats.bindsSaved += stats.bindsSaved;
+    m_stats.pushConstantCount += stats.pushConstantCount;
+    m_stats.pushConstantsSaved += stats.pushConstantsSaved;
+  }
+}
+
+bool DrawList::_canMerge(const DrawPacket& a, const DrawPacket& b) const {
+  if (a.vertexBuffer != b.vertexBuffer || a.indexBuffer != b.indexBuffer ||
+      a.descriptorSet != b.descriptorSet || a.frontFace != b.frontFace ||
+      a.indexCount != b.indexCount || a.firstIndex != b.firstIndex ||
+      a.vertexOffset != b.vertexOffset ||
+      a.firstInstance + a.instanceCount != b.firstInstance ||
+      a.pushConstantsSize != b.pushConstantsSize)
+    return false;
+
+  return a.pushConstantsSize == 0 ||
+         std::memcmp(
+             &m_pushConstants[a.pushConstantsOffset],
+             &m_pushConstants[b.pushConstantsOffset],
+             a.pushConstantsSize) == 0;
+}
+
+void DrawList::_record(
+    const DrawContext& context,
+    size_t begin,
+    size_t end,
+    DrawListStats& stats) const {
+  if (begin == end)
+    return;
+
+  // The state bound so far within this range, nothing is assumed about the
+  // state bound before recording started.
+  VkBuffer boundVertexBuffer = VK_NULL_HANDLE;
+  VkBuffer boundIndexBuffer = VK_NULL_HANDLE;
+  VkDescriptorSet boundDescriptorSet = VK_NULL_HANDLE;
+  VkFrontFace boundFrontFace = VK_FRONT_FACE_MAX_ENUM;
+  const std::byte* pBoundPushConstants = nullptr;
+  uint32_t boundPushConstantsSize = 0;
+
+  bool dynamicFrontFace = context.isDynamicFrontFaceEnabled();
+
+  size_t i = begin;
+  while (i < end) {
+    DrawPacket draw = m_packets[m_sorted[i].packetIdx];
+    ++i;
+
+    // Fold following packets into this draw while they only differ by the
+    // next range of instances
+    while (i < end) {
+      const DrawPacket& next = m_packets[m_sorted[i].packetIdx];
+      if (!_canMerge(draw, next))
+        break;
+
+      draw.instanceCount += next.instanceCount;
+      ++stats.drawsSaved;
+      ++i;
+    }
+
+    if (boundVertexBuffer != draw.vertexBuffer) {
+      context.bindVertexBuffer(draw.vertexBuffer);
+      boundVertexBuffer = draw.vertexBuffer;
+      ++stats.bindCount;
+    } else {
+      ++stats.bindsSaved;
+    }
+
+    if (boundIndexBuffer != draw.indexBuffer) {
+      context.bindIndexBuffer(draw.indexBuffer);
+      boundIndexBuffer = draw.indexBuffer;
+      ++stats.bindCount;
+    } else {
+      ++stats.bindsSaved;
+    }
+
+    if (draw.descriptorSet != VK_NULL_HANDLE) {
+      if (boundDescriptorSet != draw.descriptorSet) {
+        context.bindDescriptorSets(draw.descriptorSet);
+        boundDescriptorSet = draw.descriptorSet;
+        ++stats.bindCount;
+      } else {
+        ++stats.bindsSaved;
+      }
+    }
+
+    if (dynamicFrontFace) {
+      if (boundFrontFace != draw.frontFace) {
+        context.setFrontFaceDynamic(draw.frontFace);
+        boundFrontFace = draw.frontFace;
+        ++stats.bindCount;
+      } else {
+        ++stats.bindsSaved;
+      }
+    }
+
+    if (draw.pushConstantsSize > 0) {
+      const std::byte* pPushConstants =
+          &m_pushConstants[draw.pushConstantsOffset];
+      if (boundPushConstantsSize != draw.pushConstantsSize ||
+          std::memcmp(
+              pBoundPushConstants,
+              pPushConstants,
+              draw.pushConstantsSize) != 0) {
+        context.updatePushConstants(pPushConstants, draw.pushConstantsSize, 0);
+        pBoundPushConstants = pPushConstants;
+        boundPushConstantsSize = draw.pushConstantsSize;
+        ++stats.pushConstantCount;
+      } else {
+        ++stats.pushConstantsSaved;
+      }
+    }
+
+    context.drawIndexed(
+        draw.indexCount,
+        draw.instanceCount,
+        draw.firstIndex,
+        draw.vertexOffset,
+        draw.firstInstance);
+    ++stats.drawCount;
+  }
+}
+} // namespace AltheaEngine
@@ -1,15 +1,45 @@
 #include "FileAssetAccessor.h"
 
-#include "Utilities.h"
+#include "AsyncFileReader.h"
+#include "PackFileSystem.h"
 
+#include <CesiumAsync/AsyncSystem.h>
+
+#include <cstring>
+#include <filesystem>
+#include <optional>
+#include <system_error>
 
 namespace AltheaEngine {
+namespace {
+FileBuffer copyToPooledBuffer(const std::vector<char>& data) {
+  FileBuffer buffer = FileBufferPool::acquire(data.size());
+  if (!data.empty())
+    std::memcpy(buffer.getData(), data.data(), data.size());
+  return buffer;
+}
+} // namespace
+
 FileResponse::FileResponse(std::vector<char>&& data)
-    : _statusCode(data.empty() ? 400 : 200),
+    : FileResponse(copyToPooledBuffer(data)) {}
+
+FileResponse::FileResponse(FileBuffer&& data)
+    : _statusCode(data.isEmpty() ? 400 : 200),
       _headers(),
       _data(std::move(data)) {}
 
-uint16_t FileResponse::statusCode() const { return 200; }
+FileResponse::FileResponse(std::unique_ptr<MappedFile>&& pMappedFile)
+    : _statusCode(200), _headers(), _pMappedFile(std::move(pMappedFile)) {}
+
+FileResponse::FileResponse(
+    std::shared_ptr<const PackFile>&& pPackFile,
+    gsl::span<const std::byte> packedData)
+    : _statusCode(200),
+      _headers(),
+      _pPackFile(std::move(pPackFile)),
+      _packedData(packedData) {}
+
+uint16_t FileResponse::statusCode() const { return this->_statusCode; }
 
 std::string FileResponse::contentType() const { return ""; }
 
@@ -18,9 +48,12 @@ const CesiumAsync::HttpHeaders& FileResponse::headers() const {
 }
 
 gsl::span<const std::byte> FileResponse::data() const {
-  return gsl::span<const std::byte>(
-      reinterpret_cast<const std::byte*>(this->_data.data()),
-      this->_data.size());
+  if (this->_pMappedFile)
+    return this->_pMappedFile->getBytes();
+  if (this->_pPackFile)
+    return this->_packedData;
+
+  return this->_data.getBytes();
 }
 
 FileRequest::FileRequest(
@@ -45,12 +78,63 @@ FileAssetAccessor::get(
     const CesiumAsync::AsyncSystem& asyncSystem,
     const std::string& url,
     const std::vector<THeader>& headers) {
-  // TODO: support async file reads?
-  return asyncSystem
-      .createResolvedFuture<std::shared_ptr<CesiumAsync::IAssetRequest>>(
+  typedef std::shared_ptr<CesiumAsync::IAssetRequest> RequestPtr;
+
+  std::string packedName;
+  std::shared_ptr<const PackFile> pPackFile =
+      PackFileSystem::find(url, packedName);
+  if (pPackFile) {
+    std::optional<gsl::span<const std::byte>> packedData =
+        pPackFile->view(packedName);
+    if (packedData) {
+      return asyncSystem.createResolvedFuture<RequestPtr>(
           std::make_shared<FileRequest>(
               url,
-              std::make_shared<FileResponse>(Utilities::readFile(url))));
+              std::make_shared<FileResponse>(
+                  std::move(pPackFile),
+                  *packedData)));
+    }
+
+    // Compressed entries are decompressed off the calling thread
+    return asyncSystem.runInWorkerThread(
+        [url, pPackFile = std::move(pPackFile), packedName]() -> RequestPtr {
+          // A corrupt entry results in an empty, failed response
+          FileBuffer data;
+          if (!pPackFile->read(packedName, data))
+            data = FileBuffer();
+          return std::make_shared<FileRequest>(
+              url,
+              std::make_shared<FileResponse>(std::move(data)));
+        });
+  }
+
+  std::error_code error;
+  uintmax_t fileSize = std::filesystem::file_size(url, error);
+  if (!error && fileSize >= MAPPED_FILE_THRESHOLD) {
+    std::unique_ptr<MappedFile> pMappedFile = MappedFile::open(url);
+    if (pMappedFile) {
+      // The consumer is about to copy the whole file out of the mapping
+      pMappedFile->prefetch();
+      return asyncSystem.createResolvedFuture<RequestPtr>(
+          std::make_shared<FileRequest>(
+              url,
+              std::make_shared<FileResponse>(std::move(pMappedFile))));
+    }
+  }
+
+  CesiumAsync::Promise<RequestPtr> promise =
+      asyncSystem.createPromise<RequestPtr>();
+  CesiumAsync::Future<RequestPtr> future = promise.getFuture();
+  AsyncFileReader::read(
+      url,
+      [url, promise](std::optional<FileBuffer>&& data) {
+        promise.resolve(std::make_shared<FileRequest>(
+            url,
+            std::make_shared<FileResponse>(
+                data ? std::move(*data) : FileBuffer())));
+      });
+
+  return future;
 }
 
 CesiumAsync::Future<std::shared_ptr<CesiumAsync::IAssetRequest>>
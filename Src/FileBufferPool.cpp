@@ -0,0 +1,287 @@
+#include "FileBufferPool.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+namespace AltheaEngine {
+namespace {
+// Size classes are powers of two from 4KB to 64MB, anything larger is rare
+// enough to not be worth keeping around
+constexpr uint32_t MIN_CLASS_SHIFT = 12;
+constexpr uint32_t CLASS_COUNT = 15;
+
+// Buffers a thread keeps for itself per size class, and the memory its
+// cache may hold in total
+constexpr size_t THREAD_CACHE_SLOTS = 4;
+constexpr size_t THREAD_CACHE_MAX_BYTES = 32 * 1024 * 1024;
+
+// Memory the shared pool may hold per size class, with at least one and at
+// most a handful of buffers per class, and across all classes
+constexpr size_t SHARED_CLASS_MAX_BYTES = 64 * 1024 * 1024;
+constexpr size_t SHARED_CLASS_MAX_BUFFERS = 16;
+constexpr size_t SHARED_POOL_MAX_BYTES = 256 * 1024 * 1024;
+
+size_t getClassSize(uint32_t classIdx) {
+  return size_t(1) << (classIdx + MIN_CLASS_SHIFT);
+}
+
+// The smallest class that fits the size, CLASS_COUNT if none does
+uint32_t getClassForSize(size_t size) {
+  uint32_t classIdx = 0;
+  while (classIdx < CLASS_COUNT && getClassSize(classIdx) < size)
+    ++classIdx;
+  return classIdx;
+}
+
+// The largest class the capacity can serve, CLASS_COUNT if none
+uint32_t getClassForCapacity(size_t capacity) {
+  if (capacity < getClassSize(0))
+    return CLASS_COUNT;
+
+  uint32_t classIdx = 0;
+  while (classIdx + 1 < CLASS_COUNT && getClassSize(classIdx + 1) <= capacity)
+    ++classIdx;
+  return classIdx;
+}
+
+size_t getSharedClassCapacity(uint32_t classIdx) {
+  return std::clamp<size_t>(
+      SHARED_CLASS_MAX_BYTES / getClassSize(classIdx),
+      1,
+      SHARED_CLASS_MAX_BUFFERS);
+}
+
+// Allocated without initializing the memory, unlike std::make_unique
+std::unique_ptr<char[]> allocateBuffer(size_t capacity) {
+  return std::unique_ptr<char[]>(new char[capacity]);
+}
+
+struct PooledBuffer {
+  std::unique_ptr<char[]> pData;
+  size_t capacity = 0;
+};
+
+struct SharedClass {
+  std::mutex mutex;
+  std::vector<PooledBuffer> buffers;
+};
+
+std::array<SharedClass, CLASS_COUNT> s_sharedClasses;
+
+std::atomic<uint64_t> s_threadCacheHits{0};
+std::atomic<uint64_t> s_sharedHits{0};
+std::atomic<uint64_t> s_misses{0};
+std::atomic<uint64_t> s_discards{0};
+std::atomic<uint64_t> s_pooledBytes{0};
+// The part of s_pooledBytes held by the shared pool
+std::atomic<size_t> s_sharedBytes{0};
+
+// Reserve room for the buffer in the shared pool, fails if it would go over
+// its total budget
+bool reserveSharedBytes(size_t capacity) {
+  size_t sharedBytes = s_sharedBytes.load(std::memory_order_relaxed);
+  do {
+    if (sharedBytes + capacity > SHARED_POOL_MAX_BYTES)
+      return false;
+  } while (!s_sharedBytes.compare_exchange_weak(
+      sharedBytes,
+      sharedBytes + capacity,
+      std::memory_order_relaxed));
+
+  return true;
+}
+
+void recycleShared(uint32_t classIdx, PooledBuffer&& buffer) {
+  size_t capacity = buffer.capacity;
+  SharedClass& sharedClass = s_sharedClasses[classIdx];
+  {
+    std::lock_guard<std::mutex> lock(sharedClass.mutex);
+    if (sharedClass.buffers.size() < getSharedClassCapacity(classIdx) &&
+        reserveSharedBytes(capacity)) {
+      sharedClass.buffers.push_back(std::move(buffer));
+      s_pooledBytes.fetch_add(capacity, std::memory_order_relaxed);
+      return;
+    }
+  }
+
+  s_discards.fetch_add(1, std::memory_order_relaxed);
+}
+
+// Only ever touched by its own thread, hands its buffers to the shared pool
+// when the thread exits
+struct ThreadCache {
+  std::array<std::vector<PooledBuffer>, CLASS_COUNT> classes;
+  size_t bytes = 0;
+
+  ~ThreadCache() { flush(); }
+
+  void flush() {
+    for (uint32_t classIdx = 0; classIdx < CLASS_COUNT; ++classIdx) {
+      for (PooledBuffer& buffer : classes[classIdx]) {
+        s_pooledBytes.fetch_sub(buffer.capacity, std::memory_order_relaxed);
+        recycleShared(classIdx, std::move(buffer));
+      }
+      classes[classIdx].clear();
+    }
+    bytes = 0;
+  }
+};
+
+thread_local ThreadCache tl_threadCache;
+} // namespace
+
+FileBuffer::FileBuffer(FileBuffer&& rhs)
+    : m_pData(std::move(rhs.m_pData)),
+      m_size(rhs.m_size),
+      m_capacity(rhs.m_capacity) {
+  rhs.m_size = 0;
+  rhs.m_capacity = 0;
+}
+
+FileBuffer& FileBuffer::operator=(FileBuffer&& rhs) {
+  if (this != &rhs) {
+    _release();
+    m_pData = std::move(rhs.m_pData);
+    m_size = rhs.m_size;
+    m_capacity = rhs.m_capacity;
+    rhs.m_size = 0;
+    rhs.m_capacity = 0;
+  }
+  return *this;
+}
+
+void FileBuffer::resize(size_t size) {
+  if (size > m_capacity) {
+    FileBuffer grown = FileBufferPool::acquire(size);
+    if (m_size != 0)
+      std::memcpy(grown.getData(), getData(), m_size);
+    *this = std::move(grown);
+  }
+
+  m_size = size;
+}
+
+void FileBuffer::_release() {
+  // Moved-from handles have nothing to return
+  if (m_pData)
+    FileBufferPool::_recycle(std::move(m_pData), m_capacity);
+  m_size = 0;
+  m_capacity = 0;
+}
+
+/*static*/
+FileBuffer FileBufferPool::acquire(size_t size) {
+  uint32_t classIdx = getClassForSize(size);
+  if (classIdx == CLASS_COUNT) {
+    s_misses.fetch_add(1, std::memory_order_relaxed);
+    return FileBuffer(allocateBuffer(size), size, size);
+  }
+
+  PooledBuffer buffer;
+  bool found = false;
+
+  ThreadCache& threadCache = tl_threadCache;
+  std::vector<PooledBuffer>& cached = threadCache.classes[classIdx];
+  if (!cached.empty()) {
+    buffer = std::move(cached.back());
+    cached.pop_back();
+    threadCache.bytes -= buffer.capacity;
+    s_threadCacheHits.fetch_add(1, std::memory_order_relaxed);
+    found = true;
+  } else {
+    SharedClass& sharedClass = s_sharedClasses[classIdx];
+    std::lock_guard<std::mutex> lock(sharedClass.mutex);
+    if (!sharedClass.buffers.empty()) {
+      buffer = std::move(sharedClass.buffers.back());
+      sharedClass.buffers.pop_back();
+      s_sharedBytes.fetch_sub(buffer.capacity, std::memory_order_relaxed);
+      s_sharedHits.fetch_add(1, std::memory_order_relaxed);
+      found = true;
+    }
+  }
+
+  if (found) {
+    s_pooledBytes.fetch_sub(buffer.capacity, std::memory_order_relaxed);
+  } else {
+    s_misses.fetch_add(1, std::memory_order_relaxed);
+    // Allocated at the full class size, so the buffer can serve any request
+    // of its class later on
+    buffer.capacity = getClassSize(classIdx);
+    buffer.pData = allocateBuffer(buffer.capacity);
+  }
+
+  return FileBuffer(std::move(buffer.pData), size, buffer.capacity);
+}
+
+/*static*/
+void FileBufferPool::_recycle(
+    std::unique_ptr<char[]>&& pData,
+    size_t capacity) {
+  PooledBuffer buffer{std::move(pData), capacity};
+  uint32_t classIdx = getClassForCapacity(capacity);
+  if (classIdx == CLASS_COUNT ||
+      capacity > getClassSize(CLASS_COUNT - 1)) {
+    s_discards.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+
+  ThreadCache& threadCache = tl_threadCache;
+  std::vector<PooledBuffer>& cached = threadCache.classes[classIdx];
+  if (cached.size() < THREAD_CACHE_SLOTS &&
+      threadCache.bytes + capacity <= THREAD_CACHE_MAX_BYTES) {
+    cached.push_back(std::move(buffer));
+    threadCache.bytes += capacity;
+    s_pooledBytes.fetch_add(capacity, std::memory_order_relaxed);
+    return;
+  }
+
+  recycleShared(classIdx, std::move(buffer));
+}
+
+/*static*/
+void FileBufferPool::trim() {
+  ThreadCache& threadCache = tl_threadCache;
+  for (std::vector<PooledBuffer>& cached : threadCache.classes) {
+    for (const PooledBuffer& buffer : cached)
+      s_pooledBytes.fetch_sub(buffer.capacity, std::memory_order_relaxed);
+    cached.clear();
+  }
+  threadCache.bytes = 0;
+
+  for (SharedClass& sharedClass : s_sharedClasses) {
+    std::vector<PooledBuffer> buffers;
+    {
+      std::lock_guard<std::mutex> lock(sharedClass.mutex);
+      buffers.swap(sharedClass.buffers);
+    }
+
+    for (const PooledBuffer& buffer : buffers) {
+      s_sharedBytes.fetch_sub(buffer.capacity, std::memory_order_relaxed);
+      s_pooledBytes.fetch_sub(buffer.capacity, std::memory_order_relaxed);
+    }
+  }
+}
+
+/*static*/
+FileBufferPoolStats FileBufferPool::getStats() {
+  FileBufferPoolStats stats{};
+  stats.threadCacheHits = s_threadCacheHits.load(std::memory_order_relaxed);
+  stats.sharedHits = s_sharedHits.load(std::memory_order_relaxed);
+  stats.misses = s_misses.load(std::memory_order_relaxed);
+  stats.discards = s_discards.load(std::memory_order_relaxed);
+  stats.pooledBytes = s_pooledBytes.load(std::memory_order_relaxed);
+  return stats;
+}
+
+/*static*/
+void FileBufferPool::resetStats() {
+  s_threadCacheHits = 0;
+  s_sharedHits = 0;
+  s_misses = 0;
+  s_discards = 0;
+}
+} // namespace AltheaEngine
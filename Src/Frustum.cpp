@@ -0,0 +1,56 @@
+#include "Frustum.h"
+
+namespace AltheaEngine {
+/*static*/
+Frustum Frustum::fromViewProjection(const glm::mat4& viewProjection) {
+  // Gribb / Hartmann plane extraction, glm matrices are column-major so
+  // gather the rows first
+  glm::vec4 rows[4];
+  for (int i = 0; i < 4; ++i) {
+    rows[i] = glm::vec4(
+        viewProjection[0][i],
+        viewProjection[1][i],
+        viewProjection[2][i],
+        viewProjection[3][i]);
+  }
+
+  Frustum frustum;
+  frustum.planes[PLANE_LEFT] = rows[3] + rows[0];
+  frustum.planes[PLANE_RIGHT] = rows[3] - rows[0];
+  frustum.planes[PLANE_BOTTOM] = rows[3] + rows[1];
+  frustum.planes[PLANE_TOP] = rows[3] - rows[1];
+  // Clip-space depth is in [0, 1]
+  frustum.planes[PLANE_NEAR] = rows[2];
+  frustum.planes[PLANE_FAR] = rows[3] - rows[2];
+
+  for (glm::vec4& plane : frustum.planes) {
+    plane /= glm::length(glm::vec3(plane));
+  }
+
+  return frustum;
+}
+
+bool Frustum::intersectsSphere(const glm::vec3& center, float radius) const {
+  for (const glm::vec4& plane : this->planes) {
+    if (glm::dot(glm::vec3(plane), center) + plane.w < -radius)
+      return false;
+  }
+
+  return true;
+}
+
+bool Frustum::intersectsAABB(const glm::vec3& min, const glm::vec3& max)
+    const {
+  for (const glm::vec4& plane : this->planes) {
+    // Test the corner furthest along the plane normal
+    glm::vec3 p(
+        plane.x >= 0.0f ? max.x : min.x,
+        plane.y >= 0.0f ? max.y : min.y,
+        plane.z >= 0.0f ? max.z : min.z);
+    if (glm::dot(glm::vec3(plane), p) + plane.w < 0.0f)
+      return false;
+  }
+
+  return true;
+}
+} // namespace AltheaEngine
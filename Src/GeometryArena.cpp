@@ -0,0 +1,268 @@
+#include "GeometryArena.h"
+
+#include "Application.h"
+#include "BufferUtilities.h"
+#include "Common/InstanceDataCommon.h"
+#include "GlobalHeap.h"
+
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+
+// Default block sizes, in elements
+#define VERTICES_PER_BLOCK (1 << 18)
+#define INDICES_PER_BLOCK (1 << 22)
+#define MESHLETS_PER_BLOCK (1 << 16)
+
+#define ACCELERATION_STRUCTURE_INPUT_USAGE                                     \
+  VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR
+
+namespace AltheaEngine {
+FreeListAllocator::FreeListAllocator(uint32_t capacity)
+    : m_capacity(capacity), m_freeCount(0) {
+  _insertFreeRange(0, capacity);
+}
+
+std::optional<uint32_t>
+FreeListAllocator::allocate(uint32_t count, uint32_t alignment) {
+  if (count == 0)
+    return std::nullopt;
+
+  // Best fit, find the smallest free range that can hold the aligned
+  // allocation
+  for (auto sizeIt = m_freeBySize.lower_bound(count);
+       sizeIt != m_freeBySize.end();
+       ++sizeIt) {
+    uint32_t rangeOffset = sizeIt->second;
+    uint32_t rangeCount = sizeIt->first;
+
+    uint32_t alignedOffset =
+        (rangeOffset + alignment - 1) / alignment * alignment;
+    uint32_t padding = alignedOffset - rangeOffset;
+    if (padding + count > rangeCount)
+      continue;
+
+    _eraseFreeRange(m_freeByOffset.find(rangeOffset));
+
+    // Return the leading padding and the remaining tail to the free list
+    if (padding > 0)
+      _insertFreeRange(rangeOffset, padding);
+    if (padding + count < rangeCount)
+      _insertFreeRange(alignedOffset + count, rangeCount - padding - count);
+
+    return alignedOffset;
+  }
+
+  return std::nullopt;
+}
+
+void FreeListAllocator::free(uint32_t offset, uint32_t count) {
+  if (count == 0)
+    return;
+
+  // Coalesce with the free ranges on either side
+  auto nextIt = m_freeByOffset.lower_bound(offset);
+  if (nextIt != m_freeByOffset.end() && nextIt->first == offset + count) {
+    count += nextIt->second;
+    _eraseFreeRange(nextIt);
+  }
+
+  auto prevIt = m_freeByOffset.lower_bound(offset);
+  if (prevIt != m_freeByOffset.begin()) {
+    --prevIt;
+    if (prevIt->first + prevIt->second == offset) {
+      offset = prevIt->first;
+      count += prevIt->second;
+      _eraseFreeRange(prevIt);
+    }
+  }
+
+  _insertFreeRange(offset, count);
+}
+
+void FreeListAllocator::_insertFreeRange(uint32_t offset, uint32_t count) {
+  m_freeByOffset.emplace(offset, count);
+  m_freeBySize.emplace(count, offset);
+  m_freeCount += count;
+}
+
+void FreeListAllocator::_eraseFreeRange(
+    std::map<uint32_t, uint32_t>::iterator it) {
+  auto range = m_freeBySize.equal_range(it->second);
+  for (auto sizeIt = range.first; sizeIt != range.second; ++sizeIt) {
+    if (sizeIt->second == it->first) {
+      m_freeBySize.erase(sizeIt);
+      break;
+    }
+  }
+
+  m_freeCount -= it->second;
+  m_freeByOffset.erase(it);
+}
+
+GeometryPool::GeometryPool(
+    uint32_t elementSize,
+    uint32_t elementsPerBlock,
+    VkBufferUsageFlags usage)
+    : m_elementSize(elementSize),
+      m_elementsPerBlock(elementsPerBlock),
+      m_usage(usage) {}
+
+GeometryRange GeometryPool::allocate(
+    const Application& app,
+    SingleTimeCommandBuffer& commandBuffer,
+    GlobalHeap& heap,
+    gsl::span<const std::byte> elements) {
+  if (elements.size() % m_elementSize != 0) {
+    throw std::runtime_error(
+        "Geometry pool allocation is not a multiple of the element size!");
+  }
+
+  uint32_t count = static_cast<uint32_t>(elements.size() / m_elementSize);
+  if (count == 0)
+    return {};
+
+  if (m_alignment == 0) {
+    uint32_t minAlignment = static_cast<uint32_t>(
+        app.getPhysicalDeviceProperties()
+            .limits.minStorageBufferOffsetAlignment);
+    m_alignment = std::lcm(m_elementSize, std::max(minAlignment, 1u)) /
+                  m_elementSize;
+  }
+
+  GeometryRange range{};
+  range.count = count;
+
+  for (uint32_t i = 0; i < m_blocks.size(); ++i) {
+    std::optional<uint32_t> offset =
+        m_blocks[i].allocator.allocate(count, m_alignment);
+    if (offset) {
+      range.blockIdx = i;
+      range.offset = *offset;
+      break;
+    }
+  }
+
+  if (!range.isValid()) {
+    range.blockIdx =
+        _createBlock(app, heap, std::max(count, m_elementsPerBlock));
+    range.offset = *m_blocks[range.blockIdx].allocator.allocate(count, 1);
+  }
+
+  StagingRange staging = commandBuffer.createStagingBuffer(app, elements);
+  BufferUtilities::copyBuffer(
+      commandBuffer,
+      staging.buffer,
+      staging.offset,
+      m_blocks[range.blockIdx].allocation.getBuffer(),
+      static_cast<size_t>(range.offset) * m_elementSize,
+      elements.size());
+
+  m_allocatedCount += count;
+
+  return range;
+}
+
+void GeometryPool::free(const GeometryRange& range) {
+  if (!range.isValid())
+    return;
+
+  m_blocks[range.blockIdx].allocator.free(range.offset, range.count);
+  m_allocatedCount -= range.count;
+}
+
+uint32_t GeometryPool::_createBlock(
+    const Application& app,
+    GlobalHeap& heap,
+    uint32_t capacity) {
+  Block& block = m_blocks.emplace_back();
+
+  VmaAllocationCreateInfo deviceAllocInfo{};
+  deviceAllocInfo.usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
+
+  // Acceleration structures can only be built from the blocks on devices
+  // with ray tracing
+  VkBufferUsageFlags usage = m_usage;
+  if (!app.isRayTracingSupported())
+    usage &= ~ACCELERATION_STRUCTURE_INPUT_USAGE;
+
+  block.allocation = BufferUtilities::createBuffer(
+      app,
+      static_cast<VkDeviceSize>(capacity) * m_elementSize,
+      VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+          VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | usage,
+      deviceAllocInfo);
+  block.allocator = FreeListAllocator(capacity);
+
+  block.handle = heap.registerBuffer();
+  heap.updateStorageBuffer(
+      block.handle,
+      block.allocation.getBuffer(),
+      0,
+      static_cast<size_t>(capacity) * m_elementSize);
+
+  return static_cast<uint32_t>(m_blocks.size() - 1);
+}
+
+GeometryArena::GeometryArena()
+    : m_pVertexPool(std::make_shared<GeometryPool>(
+          static_cast<uint32_t>(sizeof(Vertex)),
+          VERTICES_PER_BLOCK,
+          VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
+              ACCELERATION_STRUCTURE_INPUT_USAGE)),
+      m_pIndexPool(std::make_shared<GeometryPool>(
+          static_cast<uint32_t>(sizeof(uint32_t)),
+          INDICES_PER_BLOCK,
+          VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
+              ACCELERATION_STRUCTURE_INPUT_USAGE)),
+      m_pMeshletPool(std::make_shared<GeometryPool>(
+          static_cast<uint32_t>(sizeof(Meshlet)),
+          MESHLETS_PER_BLOCK,
+          0)) {}
+
+GeometryAllocation::GeometryAllocation(GeometryAllocation&& rhs)
+    : m_pApp(rhs.m_pApp), m_pPool(rhs.m_pPool), m_range(rhs.m_range) {
+  rhs.m_pApp = nullptr;
+  rhs.m_pPool = nullptr;
+  rhs.m_range = {};
+}
+
+GeometryAllocation& GeometryAllocation::operator=(GeometryAllocation&& rhs) {
+  if (this != &rhs) {
+    _release();
+
+    m_pApp = rhs.m_pApp;
+    m_pPool = rhs.m_pPool;
+    m_range = rhs.m_range;
+
+    rhs.m_pApp = nullptr;
+    rhs.m_pPool = nullptr;
+    rhs.m_range = {};
+  }
+
+  return *this;
+}
+
+GeometryAllocation::~GeometryAllocation() { _release(); }
+
+void GeometryAllocation::_release() {
+  if (!m_pPool || !m_range.isValid())
+    return;
+
+  // Frames in flight may still read from the range, only hand it back to the
+  // pool once this frame ring slot comes around again. The pool may be
+  // destroyed with the heap before then, in which case there is nothing left
+  // to free.
+  std::weak_ptr<GeometryPool> pPool = m_pPool->weak_from_this();
+  GeometryRange range = m_range;
+  m_pApp->addDeletiontask(
+      {[pPool, range]() {
+         if (std::shared_ptr<GeometryPool> pLivePool = pPool.lock())
+           pLivePool->free(range);
+       },
+       m_pApp->getCurrentFrameRingBufferIndex()});
+
+  m_pPool = nullptr;
+  m_range = {};
+}
+} // namespace AltheaEngine
@@ -17,9 +17,13 @@ GlobalHeap::GlobalHeap(const Application& app) : _device(app.getDevice()) {
   layoutBuilder.addUniformHeapBinding(UNIFORM_HEAP_SLOTS, VK_SHADER_STAGE_ALL);
   layoutBuilder.addTextureHeapBinding(TEXTURE_HEAP_SLOTS, VK_SHADER_STAGE_ALL);
   layoutBuilder.addStorageImageHeapBinding(IMAGE_HEAP_SLOTS, VK_SHADER_STAGE_ALL);
-  layoutBuilder.addAccelerationStructureHeapBinding(
-      TLAS_HEAP_SLOTS,
-      VK_SHADER_STAGE_ALL);
+  // Acceleration structure descriptors need the ray tracing extensions
+  if (app.isRayTracingSupported()) {
+    layoutBuilder.addAccelerationStructureHeapBinding(
+        TLAS_HEAP_SLOTS,
+        VK_SHADER_STAGE_ALL);
+  }
+  this->_rayTracingSupported = app.isRayTracingSupported();
 
   this->_setAllocator = DescriptorSetAllocator(app, layoutBuilder, 1);
   this->_set = this->_setAllocator.allocateVkDescriptorSet();
@@ -138,7 +142,11 @@ void GlobalHeap::updateStorageImage(
 void GlobalHeap::updateTlas(
     TlasHandle handle,
     VkAccelerationStructureKHR tlas) {
-      
+  if (!this->_rayTracingSupported) {
+    throw std::runtime_error(
+        "Attempting to update TLAS heap slot without ray tracing support!");
+  }
+
   VkWriteDescriptorSetAccelerationStructureKHR accelerationStructureInfo{
       VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET_ACCELERATION_STRUCTURE_KHR};
   accelerationStructureInfo.accelerationStructureCount = 1;
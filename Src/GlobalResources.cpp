@@ -3,6 +3,8 @@
 #include "Application.h"
 #include "GlobalHeap.h"
 
+#include <iostream>
+
 namespace AltheaEngine {
 
 GlobalResources::GlobalResources(
@@ -26,8 +28,11 @@ GlobalResources::GlobalResources(
   constants.ibl = this->_ibl.getHandles();
   constants.shadowMapArray = builder.shadowMapArrayHandle.index;
 
-  if (builder.rayTracing)
-  {
+  // Ray traced resources are skipped on devices that can't use them
+  if (builder.rayTracing && !app.isRayTracingSupported()) {
+    std::cout << "Skipping ray tracing resources, ray tracing is not "
+                 "supported\n";
+  } else if (builder.rayTracing) {
     _rayTracingResources = RayTracingResources(app, commandBuffer, heap, *builder.rayTracing);
     constants.raytracing = _rayTracingResources.getHandles();
   }
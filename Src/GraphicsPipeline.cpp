@@ -7,12 +7,23 @@
 #include <iostream>
 
 namespace AltheaEngine {
+namespace {
+ShaderReflection reflectShaders(const std::vector<ShaderBuilder>& shaders) {
+  ShaderReflection reflection;
+  for (const ShaderBuilder& shader : shaders)
+    reflection.merge(shader.reflect());
+  return reflection;
+}
+} // namespace
 
 GraphicsPipeline::GraphicsPipeline(
     const Application& app,
     PipelineContext&& context,
     GraphicsPipelineBuilder&& builder)
-    : _pipelineLayout(app, builder.layoutBuilder),
+    : _pipelineLayout(
+          app,
+          builder.layoutBuilder,
+          reflectShaders(builder._shaderBuilders)),
       _context(std::move(context)),
       _builder(std::move(builder)) {
 
@@ -215,7 +226,7 @@ GraphicsPipeline::GraphicsPipeline(
   VkPipeline pipeline;
   if (vkCreateGraphicsPipelines(
           device,
-          VK_NULL_HANDLE,
+          app.getPipelineCache(),
           1,
           &pipelineInfo,
           nullptr,
@@ -259,7 +270,7 @@ bool GraphicsPipeline::recompileStaleShaders() {
   for (ShaderBuilder& shader : this->_builder._shaderBuilders) {
     if (shader.reloadIfStale()) {
       stale = true;
-      shader.recompile();
+      shader.recompileAsync();
     }
   }
 
@@ -526,9 +537,13 @@ GraphicsPipelineBuilder& GraphicsPipelineBuilder::setDynamicStencil(
 
 std::string GraphicsPipelineBuilder::compileShadersGetErrors()
 {
+  // Queue every stage before waiting, so they compile in parallel
+  for (ShaderBuilder& shader : _shaderBuilders)
+    shader.recompileAsync();
+
   std::string errors;
   for (ShaderBuilder& shader : _shaderBuilders) {
-    if (!shader.recompile())
+    if (!shader.waitForCompile())
     {
       errors += shader.getErrors() + "\n";
     }
@@ -107,8 +107,12 @@ void Image::uploadMip(
     SingleTimeCommandBuffer& commandBuffer,
     gsl::span<const std::byte> src,
     uint32_t mipIndex) {
-  VkBuffer stagingBuffer = commandBuffer.createStagingBuffer(app, src);
-  this->copyMipFromBuffer(commandBuffer, stagingBuffer, 0, mipIndex);
+  StagingRange staging = commandBuffer.createStagingBuffer(app, src);
+  this->copyMipFromBuffer(
+      commandBuffer,
+      staging.buffer,
+      staging.offset,
+      mipIndex);
 }
 
 void Image::uploadMip(
@@ -7,6 +7,17 @@
 #include <gsl/span>
 
 namespace AltheaEngine {
+namespace {
+// Acceleration structures can only be built from index buffers on devices
+// with ray tracing
+VkBufferUsageFlags getAccelerationStructureInputUsage(const Application& app) {
+  if (!app.isRayTracingSupported())
+    return 0;
+
+  return VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR;
+}
+} // namespace
+
 // In this constructor, the client is responsible for keeping the srcBuffer
 // alive until the copy is complete.
 IndexBuffer::IndexBuffer(
@@ -28,7 +39,7 @@ IndexBuffer::IndexBuffer(
       VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
           VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
           VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT |
-          VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR,
+          getAccelerationStructureInputUsage(app),
       deviceAllocInfo);
 
   BufferUtilities::copyBuffer(
@@ -49,7 +60,7 @@ IndexBuffer::IndexBuffer(
       reinterpret_cast<const std::byte*>(this->_indices.data()),
       sizeof(uint32_t) * this->_indices.size());
 
-  VkBuffer stagingBuffer = commandBuffer.createStagingBuffer(app, indicesView);
+  StagingRange staging = commandBuffer.createStagingBuffer(app, indicesView);
 
   VmaAllocationCreateInfo deviceAllocInfo{};
   deviceAllocInfo.usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
@@ -60,13 +71,13 @@ IndexBuffer::IndexBuffer(
       VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
           VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
           VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT |
-          VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR,
+          getAccelerationStructureInputUsage(app),
       deviceAllocInfo);
 
   BufferUtilities::copyBuffer(
       commandBuffer,
-      stagingBuffer,
-      0,
+      staging.buffer,
+      staging.offset,
       this->_allocation.getBuffer(),
       0,
       indicesView.size());
@@ -102,7 +113,7 @@ IndexBuffer::IndexBuffer(
       VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
           VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
           VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT |
-          VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR,
+          getAccelerationStructureInputUsage(app),
       deviceAllocInfo);
 
   BufferUtilities::copyBuffer(
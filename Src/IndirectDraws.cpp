@@ -0,0 +1,519 @@
+#include "IndirectDraws.h"
+
+#include "Application.h"
+#include "BufferUtilities.h"
+#include "Frustum.h"
+#include "GlobalHeap.h"
+#include "GraphicsPipeline.h"
+#include "Model.h"
+#include "Primitive.h"
+#include "SingleTimeCommandBuffer.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+
+namespace AltheaEngine {
+namespace {
+struct CullPushConstants {
+  glm::vec4 frustumPlanes[Frustum::PLANE_COUNT];
+  uint32_t itemBufferHandle;
+  uint32_t primitiveBufferHandle;
+  uint32_t commandBufferHandle;
+  uint32_t countBufferHandle;
+  uint32_t itemCount;
+  uint32_t padding;
+};
+
+struct DrawPushConstants {
+  uint32_t itemBufferHandle;
+  uint32_t primitiveBufferHandle;
+  uint32_t globalResourcesHandle;
+  uint32_t globalUniformsHandle;
+};
+
+static_assert(
+    sizeof(IndirectDrawCommand) == sizeof(VkDrawIndexedIndirectCommand),
+    "IndirectDrawCommand must match VkDrawIndexedIndirectCommand");
+
+// Must exactly match isItemVisible() in IndirectDrawCull.comp, including the
+// order of operations, so the CPU reference produces the same commands
+bool isItemVisible(
+    const IndirectDrawItem& item,
+    const glm::mat4& transform,
+    const Frustum& frustum) {
+  if (item.isSkinned)
+    return true;
+
+  // Transform the local bounds into world space (Arvo's method)
+  glm::vec3 boundsMin(transform[3]);
+  glm::vec3 boundsMax(transform[3]);
+  for (int col = 0; col < 3; ++col) {
+    for (int row = 0; row < 3; ++row) {
+      float a = transform[col][row] * item.boundsMin[col];
+      float b = transform[col][row] * item.boundsMax[col];
+      boundsMin[row] += glm::min(a, b);
+      boundsMax[row] += glm::max(a, b);
+    }
+  }
+
+  return frustum.intersectsAABB(boundsMin, boundsMax);
+}
+} // namespace
+
+IndirectDraws::IndirectDraws(const Application& app, GlobalHeap& heap) {
+  ComputePipelineBuilder builder{};
+  builder.setComputeShader(
+      GEngineDirectory + "/Shaders/Gltf/IndirectDrawCull.comp");
+  builder.layoutBuilder.addDescriptorSet(heap.getDescriptorSetLayout());
+  builder.layoutBuilder.addPushConstants<CullPushConstants>(
+      VK_SHADER_STAGE_COMPUTE_BIT);
+
+  m_cullCompute = ComputePipeline(app, std::move(builder));
+}
+
+void IndirectDraws::update(
+    GlobalHeap& heap,
+    const FrameContext& frame,
+    const std::vector<Model>& models) {
+  m_primitiveConstants.clear();
+  m_items.clear();
+  m_batches.clear();
+  m_itemModels.clear();
+
+  for (uint32_t modelIdx = 0; modelIdx < models.size(); ++modelIdx) {
+    const Model& model = models[modelIdx];
+    BufferHandle transformsHandle = model.getTransformsHandle(frame);
+
+    for (const Primitive& primitive : model.getPrimitives()) {
+      uint32_t primitiveIdx =
+          static_cast<uint32_t>(m_primitiveConstants.size());
+      m_primitiveConstants.push_back(primitive.getConstants());
+
+      VkBuffer vertexBuffer = primitive.getVertexAllocation().getBuffer();
+      VkBuffer indexBuffer = primitive.getIndexAllocation().getBuffer();
+      VkFrontFace frontFace = primitive.getFrontFace();
+
+      // There are only a handful of arena blocks, so a linear search is
+      // enough
+      uint32_t batchIdx = 0;
+      for (; batchIdx < m_batches.size(); ++batchIdx) {
+        const Batch& batch = m_batches[batchIdx];
+        if (batch.vertexBuffer == vertexBuffer &&
+            batch.indexBuffer == indexBuffer && batch.frontFace == frontFace)
+          break;
+      }
+
+      if (batchIdx == m_batches.size())
+        m_batches.push_back({vertexBuffer, indexBuffer, frontFace, 0, 0});
+
+      const AABB& bounds = primitive.getAABB();
+      for (uint32_t nodeIdx : primitive.getInstanceNodes()) {
+        IndirectDrawItem& item = m_items.emplace_back();
+        item.boundsMin = bounds.min;
+        item.primitiveIdx = primitiveIdx;
+        item.boundsMax = bounds.max;
+        item.matrixBufferHandle = transformsHandle.index;
+        item.nodeIdx = nodeIdx;
+        item.isSkinned = primitive.isSkinned() ? 1 : 0;
+        item.batchIdx = batchIdx;
+
+        ++m_batches[batchIdx].itemCount;
+        m_itemModels.push_back(modelIdx);
+      }
+    }
+  }
+
+  // Give each batch a range of the command buffer large enough for all of
+  // its items
+  uint32_t commandCount = 0;
+  for (Batch& batch : m_batches) {
+    batch.firstCommand = commandCount;
+    commandCount += batch.itemCount;
+  }
+
+  for (IndirectDrawItem& item : m_items)
+    item.firstCommand = m_batches[item.batchIdx].firstCommand;
+
+  // Always keep at least one element worth of space so the buffers are valid
+  uint32_t ringIdx = frame.frameRingBufferIndex;
+
+  size_t primitivesSize = sizeof(PrimitiveConstants) *
+                          std::max<size_t>(m_primitiveConstants.size(), 1);
+  DrawBuffer& primitiveBuffer = m_primitiveBuffers[ringIdx];
+  if (primitiveBuffer.size < primitivesSize)
+    _allocateBuffer(
+        heap,
+        primitiveBuffer,
+        primitivesSize,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        true);
+
+  size_t itemsSize =
+      sizeof(IndirectDrawItem) * std::max<size_t>(m_items.size(), 1);
+  DrawBuffer& itemBuffer = m_itemBuffers[ringIdx];
+  if (itemBuffer.size < itemsSize)
+    _allocateBuffer(
+        heap,
+        itemBuffer,
+        itemsSize,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        true);
+
+  size_t commandsSize =
+      sizeof(IndirectDrawCommand) * std::max<size_t>(commandCount, 1);
+  DrawBuffer& commandBuffer = m_commandBuffers[ringIdx];
+  if (commandBuffer.size < commandsSize)
+    _allocateBuffer(
+        heap,
+        commandBuffer,
+        commandsSize,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+            VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+            VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        false);
+
+  size_t countsSize = sizeof(uint32_t) * std::max<size_t>(m_batches.size(), 1);
+  DrawBuffer& countBuffer = m_countBuffers[ringIdx];
+  if (countBuffer.size < countsSize)
+    _allocateBuffer(
+        heap,
+        countBuffer,
+        countsSize,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+            VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+            VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
+            VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        false);
+
+  if (!m_primitiveConstants.empty()) {
+    void* p = primitiveBuffer.allocation.mapMemory();
+    std::memcpy(
+        p,
+        m_primitiveConstants.data(),
+        sizeof(PrimitiveConstants) * m_primitiveConstants.size());
+    primitiveBuffer.allocation.unmapMemory();
+  }
+
+  if (!m_items.empty()) {
+    void* p = itemBuffer.allocation.mapMemory();
+    std::memcpy(p, m_items.data(), sizeof(IndirectDrawItem) * m_items.size());
+    itemBuffer.allocation.unmapMemory();
+  }
+}
+
+void IndirectDraws::cull(
+    VkCommandBuffer commandBuffer,
+    GlobalHeap& heap,
+    const FrameContext& frame,
+    const Frustum& frustum) const {
+  if (m_items.empty())
+    return;
+
+  uint32_t ringIdx = frame.frameRingBufferIndex;
+  VkBuffer countBuffer = m_countBuffers[ringIdx].allocation.getBuffer();
+
+  vkCmdFillBuffer(commandBuffer, countBuffer, 0, VK_WHOLE_SIZE, 0);
+
+  {
+    VkBufferMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.buffer = countBuffer;
+    barrier.offset = 0;
+    barrier.size = VK_WHOLE_SIZE;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask =
+        VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+
+    vkCmdPipelineBarrier(
+        commandBuffer,
+        VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        0,
+        0,
+        nullptr,
+        1,
+        &barrier,
+        0,
+        nullptr);
+  }
+
+  CullPushConstants push{};
+  for (uint32_t i = 0; i < Frustum::PLANE_COUNT; ++i)
+    push.frustumPlanes[i] = frustum.planes[i];
+  push.itemBufferHandle = m_itemBuffers[ringIdx].handle.index;
+  push.primitiveBufferHandle = m_primitiveBuffers[ringIdx].handle.index;
+  push.commandBufferHandle = m_commandBuffers[ringIdx].handle.index;
+  push.countBufferHandle = m_countBuffers[ringIdx].handle.index;
+  push.itemCount = getItemCount();
+
+  m_cullCompute.bindPipeline(commandBuffer);
+  m_cullCompute.bindDescriptorSet(commandBuffer, heap.getDescriptorSet());
+  m_cullCompute.setPushConstants(commandBuffer, push);
+
+  vkCmdDispatch(
+      commandBuffer,
+      (push.itemCount + INDIRECT_CULL_GROUP_SIZE - 1) /
+          INDIRECT_CULL_GROUP_SIZE,
+      1,
+      1);
+
+  // The commands and counts are consumed as indirect arguments
+  VkBufferMemoryBarrier barriers[2]{};
+  barriers[0].sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+  barriers[0].buffer = m_commandBuffers[ringIdx].allocation.getBuffer();
+  barriers[0].offset = 0;
+  barriers[0].size = VK_WHOLE_SIZE;
+  barriers[0].srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  barriers[0].dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+  barriers[0].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barriers[0].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+
+  barriers[1] = barriers[0];
+  barriers[1].buffer = countBuffer;
+
+  vkCmdPipelineBarrier(
+      commandBuffer,
+      VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+      VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+      0,
+      0,
+      nullptr,
+      2,
+      barriers,
+      0,
+      nullptr);
+}
+
+void IndirectDraws::cullCpu(
+    const std::vector<Model>& models,
+    const Frustum& frustum,
+    std::vector<IndirectDrawCommand>& commands,
+    std::vector<uint32_t>& counts) const {
+  commands.clear();
+  commands.resize(m_items.size());
+  counts.clear();
+  counts.resize(m_batches.size());
+
+  for (uint32_t itemIdx = 0; itemIdx < m_items.size(); ++itemIdx) {
+    const IndirectDrawItem& item = m_items[itemIdx];
+    const std::vector<glm::mat4>& transforms =
+        models[m_itemModels[itemIdx]].getTransformsBuffer().getVertices();
+    if (!isItemVisible(item, transforms[item.nodeIdx], frustum))
+      continue;
+
+    const PrimitiveConstants& constants =
+        m_primitiveConstants[item.primitiveIdx];
+
+    IndirectDrawCommand& command =
+        commands[item.firstCommand + counts[item.batchIdx]++];
+    command.indexCount = constants.indexCount;
+    command.instanceCount = 1;
+    command.firstIndex = constants.firstIndex;
+    command.vertexOffset = static_cast<int32_t>(constants.vertexOffset);
+    command.firstInstance = itemIdx;
+  }
+}
+
+uint32_t IndirectDraws::validateGpuCull(
+    const Application& app,
+    GlobalHeap& heap,
+    const FrameContext& frame,
+    const std::vector<Model>& models,
+    const Frustum& frustum) const {
+  std::vector<IndirectDrawCommand> expectedCommands;
+  std::vector<uint32_t> expectedCounts;
+  cullCpu(models, frustum, expectedCommands, expectedCounts);
+
+  if (m_items.empty())
+    return 0;
+
+  uint32_t ringIdx = frame.frameRingBufferIndex;
+  size_t commandsSize = sizeof(IndirectDrawCommand) * m_items.size();
+  size_t countsSize = sizeof(uint32_t) * m_batches.size();
+
+  VmaAllocationCreateInfo info{};
+  info.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT;
+  info.usage = VMA_MEMORY_USAGE_AUTO;
+  BufferAllocation readback = BufferUtilities::createBuffer(
+      commandsSize + countsSize,
+      VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+      info);
+
+  {
+    // Waits for the GPU on destruction
+    SingleTimeCommandBuffer commandBuffer(app);
+    cull(commandBuffer, heap, frame, frustum);
+
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    vkCmdPipelineBarrier(
+        commandBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_PIPELINE_STAGE_TRANSFER_BIT,
+        0,
+        1,
+        &barrier,
+        0,
+        nullptr,
+        0,
+        nullptr);
+
+    VkBufferCopy commandsRegion{0, 0, commandsSize};
+    vkCmdCopyBuffer(
+        commandBuffer,
+        m_commandBuffers[ringIdx].allocation.getBuffer(),
+        readback.getBuffer(),
+        1,
+        &commandsRegion);
+    VkBufferCopy countsRegion{0, commandsSize, countsSize};
+    vkCmdCopyBuffer(
+        commandBuffer,
+        m_countBuffers[ringIdx].allocation.getBuffer(),
+        readback.getBuffer(),
+        1,
+        &countsRegion);
+
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    vkCmdPipelineBarrier(
+        commandBuffer,
+        VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_HOST_BIT,
+        0,
+        1,
+        &barrier,
+        0,
+        nullptr,
+        0,
+        nullptr);
+  }
+
+  std::vector<IndirectDrawCommand> commands(m_items.size());
+  std::vector<uint32_t> counts(m_batches.size());
+  {
+    const std::byte* p =
+        reinterpret_cast<const std::byte*>(readback.mapMemory());
+    std::memcpy(commands.data(), p, commandsSize);
+    std::memcpy(counts.data(), p + commandsSize, countsSize);
+    readback.unmapMemory();
+  }
+
+  auto byFirstInstance = [](const IndirectDrawCommand& a,
+                            const IndirectDrawCommand& b) {
+    return a.firstInstance < b.firstInstance;
+  };
+
+  uint32_t mismatchCount = 0;
+  for (uint32_t batchIdx = 0; batchIdx < m_batches.size(); ++batchIdx) {
+    uint32_t firstCommand = m_batches[batchIdx].firstCommand;
+    if (counts[batchIdx] != expectedCounts[batchIdx]) {
+      std::cout << "IndirectDraws: batch " << batchIdx << " has "
+                << counts[batchIdx] << " commands on the GPU, expected "
+                << expectedCounts[batchIdx] << "\n";
+      ++mismatchCount;
+      continue;
+    }
+
+    auto gpuBegin = commands.begin() + firstCommand;
+    auto cpuBegin = expectedCommands.begin() + firstCommand;
+    std::sort(gpuBegin, gpuBegin + counts[batchIdx], byFirstInstance);
+    std::sort(cpuBegin, cpuBegin + counts[batchIdx], byFirstInstance);
+
+    // The commands are plain 32-bit fields without padding
+    if (std::memcmp(
+            &*gpuBegin,
+            &*cpuBegin,
+            sizeof(IndirectDrawCommand) * counts[batchIdx]) != 0) {
+      std::cout << "IndirectDraws: batch " << batchIdx
+                << " has different commands on the GPU\n";
+      ++mismatchCount;
+    }
+  }
+
+  return mismatchCount;
+}
+
+// IGBufferSubpass impl
+void IndirectDraws::registerGBufferSubpass(
+    GraphicsPipelineBuilder& builder) const {
+  Primitive::buildPipeline(builder);
+
+  builder.addVertexShader(GEngineDirectory + "/Shaders/Gltf/GltfIndirect.vert")
+      .addFragmentShader(
+          GEngineDirectory + "/Shaders/Gltf/GltfIndirect.frag")
+      .layoutBuilder.addPushConstants<DrawPushConstants>(VK_SHADER_STAGE_ALL);
+}
+
+void IndirectDraws::beginGBufferSubpass(
+    const DrawContext& context,
+    BufferHandle globalResourcesHandle,
+    UniformHandle globalUniformsHandle) {
+  if (m_items.empty())
+    return;
+
+  uint32_t ringIdx = context.getFrame().frameRingBufferIndex;
+  VkCommandBuffer commandBuffer = context.getCommandBuffer();
+
+  DrawPushConstants push{};
+  push.itemBufferHandle = m_itemBuffers[ringIdx].handle.index;
+  push.primitiveBufferHandle = m_primitiveBuffers[ringIdx].handle.index;
+  push.globalResourcesHandle = globalResourcesHandle.index;
+  push.globalUniformsHandle = globalUniformsHandle.index;
+
+  context.bindDescriptorSets();
+  context.updatePushConstants(push, 0);
+
+  VkBuffer commands = m_commandBuffers[ringIdx].allocation.getBuffer();
+  VkBuffer counts = m_countBuffers[ringIdx].allocation.getBuffer();
+
+  for (uint32_t batchIdx = 0; batchIdx < m_batches.size(); ++batchIdx) {
+    const Batch& batch = m_batches[batchIdx];
+    context.bindVertexBuffer(batch.vertexBuffer);
+    context.bindIndexBuffer(batch.indexBuffer);
+    context.setFrontFaceDynamic(batch.frontFace);
+
+    vkCmdDrawIndexedIndirectCount(
+        commandBuffer,
+        commands,
+        sizeof(IndirectDrawCommand) * batch.firstCommand,
+        counts,
+        sizeof(uint32_t) * batchIdx,
+        batch.itemCount,
+        sizeof(IndirectDrawCommand));
+  }
+}
+
+/*static*/
+void IndirectDraws::_allocateBuffer(
+    GlobalHeap& heap,
+    DrawBuffer& buffer,
+    size_t size,
+    VkBufferUsageFlags usage,
+    bool hostVisible) {
+  if (!buffer.handle.isValid())
+    buffer.handle = heap.registerBuffer();
+
+  VmaAllocationCreateInfo info{};
+  if (hostVisible) {
+    info.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT;
+    info.usage = VMA_MEMORY_USAGE_AUTO;
+  } else {
+    info.usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
+  }
+
+  buffer.allocation = BufferUtilities::createBuffer(size, usage, info);
+  buffer.size = size;
+
+  heap.updateStorageBuffer(
+      buffer.handle,
+      buffer.allocation.getBuffer(),
+      0,
+      size);
+}
+} // namespace AltheaEngine
@@ -0,0 +1,212 @@
+#include "JobGraph.h"
+
+#include <chrono>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+
+namespace AltheaEngine {
+namespace {
+constexpr JobGraph::JobId INVALID_JOB_ID =
+    std::numeric_limits<JobGraph::JobId>::max();
+
+uint64_t getTimeNs() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+std::string escapeJson(const std::string& str) {
+  std::string escaped;
+  escaped.reserve(str.size());
+  for (char c : str) {
+    if (c == '"' || c == '\\')
+      escaped += '\\';
+    if (static_cast<unsigned char>(c) < 0x20) {
+      escaped += ' ';
+      continue;
+    }
+    escaped += c;
+  }
+  return escaped;
+}
+
+// Trace timestamps are in microseconds
+std::string formatMicroseconds(uint64_t ns) {
+  return std::to_string(ns / 1000) + "." + std::to_string(ns / 100 % 10);
+}
+} // namespace
+
+JobGraph::JobId JobGraph::addJob(
+    const std::string& name,
+    std::function<void()>&& fn,
+    const std::vector<JobId>& dependencies) {
+  JobId jobId = static_cast<JobId>(m_jobs.size());
+  Job& job = m_jobs.emplace_back();
+  job.name = name;
+  job.fn = std::move(fn);
+
+  for (JobId dependency : dependencies)
+    addDependency(dependency, jobId);
+
+  return jobId;
+}
+
+JobGraph::JobId JobGraph::addParallelFor(
+    const std::string& name,
+    uint32_t count,
+    std::function<void(uint32_t begin, uint32_t end)>&& fn,
+    const std::vector<JobId>& dependencies,
+    uint32_t minChunkSize) {
+  return addJob(
+      name,
+      [this, count, fn = std::move(fn), minChunkSize]() {
+        m_pPool->parallelFor(count, fn, minChunkSize);
+      },
+      dependencies);
+}
+
+void JobGraph::addDependency(JobId before, JobId after) {
+  if (before >= m_jobs.size() || after >= m_jobs.size() || before == after)
+    throw std::runtime_error("Invalid job dependency!");
+
+  m_jobs[before].continuations.push_back(after);
+  ++m_jobs[after].dependencyCount;
+}
+
+void JobGraph::execute(ThreadPool& pool) {
+  if (m_jobs.empty())
+    return;
+
+  _validateAcyclic();
+
+  m_pPool = &pool;
+  // One trace row per worker, plus one for any thread outside the pool
+  m_traceThreadCount = pool.getThreadCount() + 1;
+  m_remainingDependencies =
+      std::make_unique<std::atomic<uint32_t>[]>(m_jobs.size());
+  for (size_t i = 0; i < m_jobs.size(); ++i)
+    m_remainingDependencies[i] = m_jobs[i].dependencyCount;
+  m_pendingJobCount = static_cast<uint32_t>(m_jobs.size());
+  m_executeStartNs = getTimeNs();
+
+  for (JobId jobId = 0; jobId < m_jobs.size(); ++jobId) {
+    if (m_jobs[jobId].dependencyCount == 0)
+      pool.submit([this, jobId]() { _runJob(jobId); });
+  }
+
+  pool.waitUntil([this]() { return m_pendingJobCount == 0; });
+
+  m_pPool = nullptr;
+  m_remainingDependencies = nullptr;
+}
+
+void JobGraph::writeChromeTrace(const std::string& path) const {
+  std::ofstream file(path, std::ios::out | std::ios::trunc);
+  file << "{\"traceEvents\":[\n";
+
+  bool first = true;
+  auto beginEvent = [&]() {
+    if (!first)
+      file << ",\n";
+    first = false;
+  };
+
+  for (uint32_t threadIdx = 0; threadIdx < m_traceThreadCount; ++threadIdx) {
+    std::string threadName = threadIdx + 1 == m_traceThreadCount
+                                 ? "Calling thread"
+                                 : "Worker " + std::to_string(threadIdx);
+    beginEvent();
+    file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":"
+         << threadIdx << ",\"args\":{\"name\":\"" << threadName << "\"}}";
+  }
+
+  for (JobId jobId = 0; jobId < m_jobs.size(); ++jobId) {
+    const Job& job = m_jobs[jobId];
+    beginEvent();
+    file << "{\"name\":\"" << escapeJson(job.name)
+         << "\",\"cat\":\"job\",\"ph\":\"X\",\"pid\":0,\"tid\":"
+         << job.threadIdx << ",\"ts\":" << formatMicroseconds(job.startNs)
+         << ",\"dur\":" << formatMicroseconds(job.endNs - job.startNs) << "}";
+  }
+
+  // Dependencies are drawn as flow arrows from the end of each job to the
+  // start of its continuations
+  uint32_t flowId = 0;
+  for (const Job& job : m_jobs) {
+    for (JobId continuationId : job.continuations) {
+      const Job& continuation = m_jobs[continuationId];
+      beginEvent();
+      file << "{\"name\":\"dependency\",\"cat\":\"dependency\",\"ph\":\"s\","
+              "\"id\":"
+           << flowId << ",\"pid\":0,\"tid\":" << job.threadIdx
+           << ",\"ts\":" << formatMicroseconds(job.endNs) << "},\n"
+           << "{\"name\":\"dependency\",\"cat\":\"dependency\",\"ph\":\"f\","
+              "\"bp\":\"e\",\"id\":"
+           << flowId << ",\"pid\":0,\"tid\":" << continuation.threadIdx
+           << ",\"ts\":" << formatMicroseconds(continuation.startNs) << "}";
+      ++flowId;
+    }
+  }
+
+  file << "\n]}\n";
+  if (!file.good())
+    throw std::runtime_error("Failed to write job graph trace to " + path);
+}
+
+void JobGraph::_validateAcyclic() const {
+  // Kahn's algorithm, every job is reached iff there is no cycle
+  std::vector<uint32_t> remaining(m_jobs.size());
+  std::vector<JobId> ready;
+  for (JobId jobId = 0; jobId < m_jobs.size(); ++jobId) {
+    remaining[jobId] = m_jobs[jobId].dependencyCount;
+    if (remaining[jobId] == 0)
+      ready.push_back(jobId);
+  }
+
+  size_t reachedCount = 0;
+  while (!ready.empty()) {
+    JobId jobId = ready.back();
+    ready.pop_back();
+    ++reachedCount;
+
+    for (JobId continuationId : m_jobs[jobId].continuations) {
+      if (--remaining[continuationId] == 0)
+        ready.push_back(continuationId);
+    }
+  }
+
+  if (reachedCount != m_jobs.size())
+    throw std::runtime_error("Job graph dependencies contain a cycle!");
+}
+
+void JobGraph::_runJob(JobId jobId) {
+  while (true) {
+    Job& job = m_jobs[jobId];
+    job.threadIdx = m_pPool->getCurrentWorkerIndex();
+    job.startNs = getTimeNs() - m_executeStartNs;
+    job.fn();
+    job.endNs = getTimeNs() - m_executeStartNs;
+
+    // Continue with one ready continuation on this thread, while its inputs
+    // are still in cache, and queue the rest
+    JobId nextJobId = INVALID_JOB_ID;
+    for (JobId continuationId : job.continuations) {
+      if (--m_remainingDependencies[continuationId] != 0)
+        continue;
+
+      if (nextJobId == INVALID_JOB_ID)
+        nextJobId = continuationId;
+      else
+        m_pPool->submit([this, continuationId]() { _runJob(continuationId); });
+    }
+
+    // The graph may be destroyed as soon as the last job is counted
+    --m_pendingJobCount;
+    if (nextJobId == INVALID_JOB_ID)
+      return;
+
+    jobId = nextJobId;
+  }
+}
+} // namespace AltheaEngine
@@ -0,0 +1,126 @@
+#include "LayoutCache.h"
+
+#include <stdexcept>
+
+namespace AltheaEngine {
+namespace {
+template <typename T> void appendKey(std::string& key, const T& value) {
+  key.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+} // namespace
+
+LayoutCache::LayoutCache(VkDevice device) : m_device(device) {}
+
+LayoutCache::~LayoutCache() {
+  for (auto& it : m_pipelineLayouts)
+    vkDestroyPipelineLayout(m_device, it.second, nullptr);
+  for (auto& it : m_setLayouts)
+    vkDestroyDescriptorSetLayout(m_device, it.second, nullptr);
+}
+
+VkDescriptorSetLayout LayoutCache::getDescriptorSetLayout(
+    const VkDescriptorSetLayoutCreateInfo& createInfo) {
+  std::string key;
+  appendKey(key, createInfo.flags);
+  appendKey(key, createInfo.bindingCount);
+  for (uint32_t i = 0; i < createInfo.bindingCount; ++i) {
+    const VkDescriptorSetLayoutBinding& binding = createInfo.pBindings[i];
+    appendKey(key, binding.binding);
+    appendKey(key, binding.descriptorType);
+    appendKey(key, binding.descriptorCount);
+    appendKey(key, binding.stageFlags);
+    appendKey(key, binding.pImmutableSamplers);
+  }
+
+  // The only extension struct used for set layouts
+  const VkBaseInStructure* pNext =
+      reinterpret_cast<const VkBaseInStructure*>(createInfo.pNext);
+  for (; pNext; pNext = pNext->pNext) {
+    if (pNext->sType !=
+        VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO) {
+      throw std::runtime_error(
+          "Unsupported extension struct in descriptor set layout!");
+    }
+
+    const VkDescriptorSetLayoutBindingFlagsCreateInfo* pFlags =
+        reinterpret_cast<const VkDescriptorSetLayoutBindingFlagsCreateInfo*>(
+            pNext);
+    appendKey(key, pFlags->bindingCount);
+    for (uint32_t i = 0; i < pFlags->bindingCount; ++i)
+      appendKey(key, pFlags->pBindingFlags[i]);
+  }
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto it = m_setLayouts.find(key);
+  if (it != m_setLayouts.end()) {
+    ++m_hitCount;
+    return it->second;
+  }
+
+  VkDescriptorSetLayout layout;
+  if (vkCreateDescriptorSetLayout(m_device, &createInfo, nullptr, &layout) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("Failed to create descriptor set layout!");
+  }
+
+  m_setLayouts.emplace(std::move(key), layout);
+  return layout;
+}
+
+VkPipelineLayout LayoutCache::getPipelineLayout(
+    gsl::span<const VkDescriptorSetLayout> descriptorSetLayouts,
+    gsl::span<const VkPushConstantRange> pushConstantRanges) {
+  std::string key;
+  appendKey(key, static_cast<uint32_t>(descriptorSetLayouts.size()));
+  for (VkDescriptorSetLayout setLayout : descriptorSetLayouts)
+    appendKey(key, setLayout);
+  for (const VkPushConstantRange& range : pushConstantRanges) {
+    appendKey(key, range.stageFlags);
+    appendKey(key, range.offset);
+    appendKey(key, range.size);
+  }
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto it = m_pipelineLayouts.find(key);
+  if (it != m_pipelineLayouts.end()) {
+    ++m_hitCount;
+    return it->second;
+  }
+
+  VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+  pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  pipelineLayoutInfo.setLayoutCount =
+      static_cast<uint32_t>(descriptorSetLayouts.size());
+  pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
+  pipelineLayoutInfo.pushConstantRangeCount =
+      static_cast<uint32_t>(pushConstantRanges.size());
+  pipelineLayoutInfo.pPushConstantRanges = pushConstantRanges.data();
+
+  VkPipelineLayout pipelineLayout;
+  if (vkCreatePipelineLayout(
+          m_device,
+          &pipelineLayoutInfo,
+          nullptr,
+          &pipelineLayout) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to create pipeline layout!");
+  }
+
+  m_pipelineLayouts.emplace(std::move(key), pipelineLayout);
+  return pipelineLayout;
+}
+
+uint32_t LayoutCache::getDescriptorSetLayoutCount() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return static_cast<uint32_t>(m_setLayouts.size());
+}
+
+uint32_t LayoutCache::getPipelineLayoutCount() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return static_cast<uint32_t>(m_pipelineLayouts.size());
+}
+
+uint32_t LayoutCache::getHitCount() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_hitCount;
+}
+} // namespace AltheaEngine
@@ -0,0 +1,493 @@
+#include "LightClusters.h"
+
+#include "Application.h"
+#include "BufferUtilities.h"
+#include "Camera.h"
+#include "GlobalHeap.h"
+#include "PointLight.h"
+#include "SingleTimeCommandBuffer.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#define LIGHT_CLUSTERS_USE_SSE
+#include <emmintrin.h>
+#endif
+
+// Offsets into the light grid, in uint32 words
+#define GRID_COUNTS_OFFSET (sizeof(LightGridHeader) / sizeof(uint32_t))
+#define GRID_INDICES_OFFSET (GRID_COUNTS_OFFSET + LIGHT_CLUSTER_COUNT)
+#define GRID_WORD_COUNT                                                        \
+  (GRID_INDICES_OFFSET + LIGHT_CLUSTER_COUNT * MAX_LIGHTS_PER_CLUSTER)
+
+namespace AltheaEngine {
+namespace {
+struct PushConstants {
+  uint32_t boundsHandle;
+  uint32_t lightsHandle;
+  uint32_t gridHandle;
+  uint32_t lightCount;
+  float zNear;
+  float zFar;
+};
+} // namespace
+
+LightClusters::LightClusters(const Application& app, GlobalHeap& heap) {
+  ComputePipelineBuilder builder{};
+  builder.setComputeShader(GEngineDirectory + "/Shaders/LightClusters.comp");
+  builder.layoutBuilder.addDescriptorSet(heap.getDescriptorSetLayout());
+  builder.layoutBuilder.addPushConstants<PushConstants>(
+      VK_SHADER_STAGE_COMPUTE_BIT);
+
+  m_buildCompute = ComputePipeline(app, std::move(builder));
+
+  for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+    _allocateBuffer(heap, m_gridBuffers[i], getGridByteSize());
+    _allocateBuffer(
+        heap,
+        m_boundsBuffers[i],
+        sizeof(LightClusterBounds) * LIGHT_CLUSTER_COUNT);
+  }
+
+  m_clusterBounds.resize(LIGHT_CLUSTER_COUNT);
+  m_cpuGrid.resize(GRID_WORD_COUNT);
+}
+
+void LightClusters::build(
+    const FrameContext& frame,
+    const Camera& camera,
+    const PointLightCollection& lights) {
+  _prepareInputs(camera, lights);
+  m_builtOnDevice = false;
+
+  LightGridHeader header{};
+  header.zNear = m_zNear;
+  header.zFar = m_zFar;
+  header.lightCount = static_cast<uint32_t>(m_lights.size());
+  std::memcpy(m_cpuGrid.data(), &header, sizeof(LightGridHeader));
+
+  // Split the depth slices between threads, every cluster is written by
+  // exactly one thread
+  ThreadPool::getShared().parallelFor(
+      LIGHT_CLUSTERS_Z,
+      [this](uint32_t firstSlice, uint32_t endSlice) {
+        _buildSlices(firstSlice, endSlice - firstSlice);
+      });
+
+  // Upload the header and counts, but only the used part of each cluster's
+  // index list
+  uint32_t* pGrid = reinterpret_cast<uint32_t*>(
+      m_gridBuffers[frame.frameRingBufferIndex].allocation.mapMemory());
+  std::memcpy(pGrid, m_cpuGrid.data(), GRID_INDICES_OFFSET * sizeof(uint32_t));
+  for (uint32_t clusterIdx = 0; clusterIdx < LIGHT_CLUSTER_COUNT;
+       ++clusterIdx) {
+    size_t offset = GRID_INDICES_OFFSET +
+                    static_cast<size_t>(clusterIdx) * MAX_LIGHTS_PER_CLUSTER;
+    std::memcpy(
+        pGrid + offset,
+        m_cpuGrid.data() + offset,
+        m_cpuGrid[GRID_COUNTS_OFFSET + clusterIdx] * sizeof(uint32_t));
+  }
+  m_gridBuffers[frame.frameRingBufferIndex].allocation.unmapMemory();
+}
+
+void LightClusters::dispatch(
+    VkCommandBuffer commandBuffer,
+    GlobalHeap& heap,
+    const FrameContext& frame,
+    const Camera& camera,
+    const PointLightCollection& lights) {
+  _prepareInputs(camera, lights);
+  _uploadInputs(heap, frame);
+
+  uint32_t ringIdx = frame.frameRingBufferIndex;
+
+  // Only ever written and read on the GPU, so it lives in device memory
+  ClusterBuffer& gridBuffer = m_deviceGridBuffers[ringIdx];
+  if (gridBuffer.size == 0)
+    _allocateBuffer(heap, gridBuffer, getGridByteSize(), false);
+  m_builtOnDevice = true;
+
+  PushConstants push{};
+  push.boundsHandle = m_boundsBuffers[ringIdx].handle.index;
+  push.lightsHandle = m_lightBuffers[ringIdx].handle.index;
+  push.gridHandle = gridBuffer.handle.index;
+  push.lightCount = static_cast<uint32_t>(m_lights.size());
+  push.zNear = m_zNear;
+  push.zFar = m_zFar;
+
+  m_buildCompute.bindPipeline(commandBuffer);
+  m_buildCompute.bindDescriptorSet(commandBuffer, heap.getDescriptorSet());
+  m_buildCompute.setPushConstants(commandBuffer, push);
+
+  vkCmdDispatch(
+      commandBuffer,
+      (LIGHT_CLUSTER_COUNT + LIGHT_CLUSTERS_GROUP_SIZE - 1) /
+          LIGHT_CLUSTERS_GROUP_SIZE,
+      1,
+      1);
+
+  VkBufferMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+  barrier.buffer = gridBuffer.allocation.getBuffer();
+  barrier.offset = 0;
+  barrier.size = VK_WHOLE_SIZE;
+  barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+
+  vkCmdPipelineBarrier(
+      commandBuffer,
+      VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+      VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT |
+          VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+      0,
+      0,
+      nullptr,
+      1,
+      &barrier,
+      0,
+      nullptr);
+}
+
+uint32_t LightClusters::validateGpuBuild(
+    const Application& app,
+    GlobalHeap& heap,
+    const FrameContext& frame,
+    const Camera& camera,
+    const PointLightCollection& lights) {
+  build(frame, camera, lights);
+
+  VmaAllocationCreateInfo info{};
+  info.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT;
+  info.usage = VMA_MEMORY_USAGE_AUTO;
+  BufferAllocation readback = BufferUtilities::createBuffer(
+      getGridByteSize(),
+      VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+      info);
+
+  {
+    // Waits for the GPU on destruction
+    SingleTimeCommandBuffer commandBuffer(app);
+    dispatch(commandBuffer, heap, frame, camera, lights);
+
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    vkCmdPipelineBarrier(
+        commandBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_PIPELINE_STAGE_TRANSFER_BIT,
+        0,
+        1,
+        &barrier,
+        0,
+        nullptr,
+        0,
+        nullptr);
+
+    VkBufferCopy region{0, 0, getGridByteSize()};
+    vkCmdCopyBuffer(
+        commandBuffer,
+        m_deviceGridBuffers[frame.frameRingBufferIndex]
+            .allocation.getBuffer(),
+        readback.getBuffer(),
+        1,
+        &region);
+
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    vkCmdPipelineBarrier(
+        commandBuffer,
+        VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_HOST_BIT,
+        0,
+        1,
+        &barrier,
+        0,
+        nullptr,
+        0,
+        nullptr);
+  }
+
+  std::vector<uint32_t> gpuGrid(GRID_WORD_COUNT);
+  std::memcpy(gpuGrid.data(), readback.mapMemory(), getGridByteSize());
+  readback.unmapMemory();
+
+  uint32_t mismatchCount = 0;
+  if (std::memcmp(
+          gpuGrid.data(),
+          m_cpuGrid.data(),
+          sizeof(LightGridHeader)) != 0) {
+    std::cout << "LightClusters: the grid header differs on the GPU\n";
+    ++mismatchCount;
+  }
+
+  // Only the used part of each cluster's index list is written
+  for (uint32_t clusterIdx = 0; clusterIdx < LIGHT_CLUSTER_COUNT;
+       ++clusterIdx) {
+    uint32_t gpuCount = gpuGrid[GRID_COUNTS_OFFSET + clusterIdx];
+    uint32_t cpuCount = m_cpuGrid[GRID_COUNTS_OFFSET + clusterIdx];
+    if (gpuCount != cpuCount) {
+      std::cout << "LightClusters: cluster " << clusterIdx << " has "
+                << gpuCount << " lights on the GPU, expected " << cpuCount
+                << "\n";
+      ++mismatchCount;
+      continue;
+    }
+
+    size_t offset = GRID_INDICES_OFFSET +
+                    static_cast<size_t>(clusterIdx) * MAX_LIGHTS_PER_CLUSTER;
+    if (std::memcmp(
+            gpuGrid.data() + offset,
+            m_cpuGrid.data() + offset,
+            cpuCount * sizeof(uint32_t)) != 0) {
+      std::cout << "LightClusters: cluster " << clusterIdx
+                << " has different lights on the GPU\n";
+      ++mismatchCount;
+    }
+  }
+
+  return mismatchCount;
+}
+
+/*static*/
+size_t LightClusters::getGridByteSize() {
+  return GRID_WORD_COUNT * sizeof(uint32_t);
+}
+
+void LightClusters::_prepareInputs(
+    const Camera& camera,
+    const PointLightCollection& lights) {
+  if (camera.getProjection() != m_projection ||
+      camera.getNearPlane() != m_zNear || camera.getFarPlane() != m_zFar) {
+    _computeClusterBounds(camera);
+  }
+
+  glm::mat4 view = camera.computeView();
+
+  uint32_t lightCount = static_cast<uint32_t>(lights.getCount());
+  size_t paddedCount = (static_cast<size_t>(lightCount) + 3) & ~size_t(3);
+
+  m_lights.resize(lightCount);
+  m_lightX.resize(paddedCount);
+  m_lightY.resize(paddedCount);
+  m_lightZ.resize(paddedCount);
+  m_lightRadiusSq.resize(paddedCount);
+
+  for (uint32_t i = 0; i < lightCount; ++i) {
+    const PointLight& light = lights.getLight(i);
+
+    LightClusterLight& clusterLight = m_lights[i];
+    clusterLight.viewPosition =
+        glm::vec3(view * glm::vec4(light.position, 1.0f));
+    clusterLight.radius = PointLightCollection::computeLightRadius(light);
+
+    m_lightX[i] = clusterLight.viewPosition.x;
+    m_lightY[i] = clusterLight.viewPosition.y;
+    m_lightZ[i] = clusterLight.viewPosition.z;
+    m_lightRadiusSq[i] = clusterLight.radius * clusterLight.radius;
+  }
+
+  // Padding lanes can never intersect a cluster
+  for (size_t i = lightCount; i < paddedCount; ++i) {
+    m_lightX[i] = 0.0f;
+    m_lightY[i] = 0.0f;
+    m_lightZ[i] = 0.0f;
+    m_lightRadiusSq[i] = -1.0f;
+  }
+}
+
+void LightClusters::_computeClusterBounds(const Camera& camera) {
+  m_projection = camera.getProjection();
+  m_zNear = camera.getNearPlane();
+  m_zFar = camera.getFarPlane();
+  ++m_boundsVersion;
+
+  // Assumes a symmetric perspective projection, a point at NDC xy and view
+  // depth d is at (x * d / P[0][0], y * d / P[1][1], -d) in view space.
+  float depthRatio = m_zFar / m_zNear;
+  for (uint32_t z = 0; z < LIGHT_CLUSTERS_Z; ++z) {
+    float sliceDepths[2] = {
+        m_zNear * std::pow(depthRatio, float(z) / LIGHT_CLUSTERS_Z),
+        m_zNear * std::pow(depthRatio, float(z + 1) / LIGHT_CLUSTERS_Z)};
+
+    for (uint32_t y = 0; y < LIGHT_CLUSTERS_Y; ++y) {
+      float ndcY[2] = {
+          2.0f * y / LIGHT_CLUSTERS_Y - 1.0f,
+          2.0f * (y + 1) / LIGHT_CLUSTERS_Y - 1.0f};
+
+      for (uint32_t x = 0; x < LIGHT_CLUSTERS_X; ++x) {
+        float ndcX[2] = {
+            2.0f * x / LIGHT_CLUSTERS_X - 1.0f,
+            2.0f * (x + 1) / LIGHT_CLUSTERS_X - 1.0f};
+
+        glm::vec3 boundsMin(std::numeric_limits<float>::max());
+        glm::vec3 boundsMax(std::numeric_limits<float>::lowest());
+        for (float depth : sliceDepths) {
+          for (float cornerY : ndcY) {
+            for (float cornerX : ndcX) {
+              glm::vec3 corner(
+                  cornerX * depth / m_projection[0][0],
+                  cornerY * depth / m_projection[1][1],
+                  -depth);
+              boundsMin = glm::min(boundsMin, corner);
+              boundsMax = glm::max(boundsMax, corner);
+            }
+          }
+        }
+
+        LightClusterBounds& bounds =
+            m_clusterBounds[(z * LIGHT_CLUSTERS_Y + y) * LIGHT_CLUSTERS_X + x];
+        bounds.boundsMin = glm::vec4(boundsMin, 0.0f);
+        bounds.boundsMax = glm::vec4(boundsMax, 0.0f);
+      }
+    }
+  }
+}
+
+void LightClusters::_buildSlices(uint32_t firstSlice, uint32_t sliceCount) {
+  uint32_t firstCluster = firstSlice * LIGHT_CLUSTERS_X * LIGHT_CLUSTERS_Y;
+  uint32_t clusterCount = sliceCount * LIGHT_CLUSTERS_X * LIGHT_CLUSTERS_Y;
+  size_t paddedLightCount = m_lightX.size();
+
+  // Must exactly match the sphere-box test in LightClusters.comp, including
+  // the order of operations, so both builders produce the same grid
+  for (uint32_t clusterIdx = firstCluster;
+       clusterIdx < firstCluster + clusterCount;
+       ++clusterIdx) {
+    const LightClusterBounds& bounds = m_clusterBounds[clusterIdx];
+    uint32_t* pIndices =
+        m_cpuGrid.data() + GRID_INDICES_OFFSET +
+        static_cast<size_t>(clusterIdx) * MAX_LIGHTS_PER_CLUSTER;
+    uint32_t count = 0;
+
+#ifdef LIGHT_CLUSTERS_USE_SSE
+    __m128 minX = _mm_set1_ps(bounds.boundsMin.x);
+    __m128 minY = _mm_set1_ps(bounds.boundsMin.y);
+    __m128 minZ = _mm_set1_ps(bounds.boundsMin.z);
+    __m128 maxX = _mm_set1_ps(bounds.boundsMax.x);
+    __m128 maxY = _mm_set1_ps(bounds.boundsMax.y);
+    __m128 maxZ = _mm_set1_ps(bounds.boundsMax.z);
+
+    for (size_t i = 0; i < paddedLightCount && count < MAX_LIGHTS_PER_CLUSTER;
+         i += 4) {
+      __m128 lightX = _mm_loadu_ps(&m_lightX[i]);
+      __m128 lightY = _mm_loadu_ps(&m_lightY[i]);
+      __m128 lightZ = _mm_loadu_ps(&m_lightZ[i]);
+
+      __m128 dx =
+          _mm_sub_ps(_mm_min_ps(_mm_max_ps(lightX, minX), maxX), lightX);
+      __m128 dy =
+          _mm_sub_ps(_mm_min_ps(_mm_max_ps(lightY, minY), maxY), lightY);
+      __m128 dz =
+          _mm_sub_ps(_mm_min_ps(_mm_max_ps(lightZ, minZ), maxZ), lightZ);
+      __m128 distSq = _mm_add_ps(
+          _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)),
+          _mm_mul_ps(dz, dz));
+
+      int mask = _mm_movemask_ps(
+          _mm_cmple_ps(distSq, _mm_loadu_ps(&m_lightRadiusSq[i])));
+      for (uint32_t lane = 0; lane < 4 && count < MAX_LIGHTS_PER_CLUSTER;
+           ++lane) {
+        if (mask & (1 << lane))
+          pIndices[count++] = static_cast<uint32_t>(i + lane);
+      }
+    }
+#else
+    for (size_t i = 0; i < paddedLightCount && count < MAX_LIGHTS_PER_CLUSTER;
+         ++i) {
+      float dx = std::min(
+                     std::max(m_lightX[i], bounds.boundsMin.x),
+                     bounds.boundsMax.x) -
+                 m_lightX[i];
+      float dy = std::min(
+                     std::max(m_lightY[i], bounds.boundsMin.y),
+                     bounds.boundsMax.y) -
+                 m_lightY[i];
+      float dz = std::min(
+                     std::max(m_lightZ[i], bounds.boundsMin.z),
+                     bounds.boundsMax.z) -
+                 m_lightZ[i];
+      float distSq = dx * dx + dy * dy + dz * dz;
+      if (distSq <= m_lightRadiusSq[i])
+        pIndices[count++] = static_cast<uint32_t>(i);
+    }
+#endif
+
+    m_cpuGrid[GRID_COUNTS_OFFSET + clusterIdx] = count;
+  }
+}
+
+void LightClusters::_uploadInputs(GlobalHeap& heap, const FrameContext& frame) {
+  uint32_t ringIdx = frame.frameRingBufferIndex;
+
+  if (m_uploadedBoundsVersions[ringIdx] != m_boundsVersion) {
+    ClusterBuffer& boundsBuffer = m_boundsBuffers[ringIdx];
+    void* p = boundsBuffer.allocation.mapMemory();
+    std::memcpy(
+        p,
+        m_clusterBounds.data(),
+        sizeof(LightClusterBounds) * m_clusterBounds.size());
+    boundsBuffer.allocation.unmapMemory();
+
+    m_uploadedBoundsVersions[ringIdx] = m_boundsVersion;
+  }
+
+  // Always keep at least one light worth of space so the buffer is valid
+  ClusterBuffer& lightBuffer = m_lightBuffers[ringIdx];
+  size_t lightsSize =
+      sizeof(LightClusterLight) * std::max<size_t>(m_lights.size(), 1);
+  if (lightBuffer.size < lightsSize)
+    _allocateBuffer(heap, lightBuffer, lightsSize);
+
+  if (!m_lights.empty()) {
+    void* p = lightBuffer.allocation.mapMemory();
+    std::memcpy(
+        p,
+        m_lights.data(),
+        sizeof(LightClusterLight) * m_lights.size());
+    lightBuffer.allocation.unmapMemory();
+  }
+}
+
+/*static*/
+void LightClusters::_allocateBuffer(
+    GlobalHeap& heap,
+    ClusterBuffer& buffer,
+    size_t size,
+    bool hostWritable) {
+  if (!buffer.handle.isValid())
+    buffer.handle = heap.registerBuffer();
+
+  VmaAllocationCreateInfo info{};
+  if (hostWritable) {
+    info.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT;
+    info.usage = VMA_MEMORY_USAGE_AUTO;
+  } else {
+    info.usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
+  }
+
+  // Device buffers can be copied out by validateGpuBuild()
+  buffer.allocation = BufferUtilities::createBuffer(
+      size,
+      hostWritable ? VK_BUFFER_USAGE_STORAGE_BUFFER_BIT
+                   : VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                         VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+      info);
+  buffer.size = size;
+
+  heap.updateStorageBuffer(
+      buffer.handle,
+      buffer.allocation.getBuffer(),
+      0,
+      size);
+}
+} // namespace AltheaEngine
@@ -0,0 +1,76 @@
+#include "MappedFile.h"
+
+#include <fstream>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace AltheaEngine {
+/*static*/
+std::unique_ptr<MappedFile> MappedFile::open(const std::string& path) {
+  std::unique_ptr<MappedFile> pFile(new MappedFile());
+
+#ifdef _WIN32
+  std::ifstream file(path, std::ios::ate | std::ios::binary);
+  if (!file.is_open())
+    return nullptr;
+
+  size_t size = static_cast<size_t>(file.tellg());
+  if (size == 0)
+    return nullptr;
+
+  pFile->m_data.resize(size);
+  file.seekg(0);
+  file.read(pFile->m_data.data(), size);
+  if (!file.good())
+    return nullptr;
+
+  pFile->m_pData = pFile->m_data.data();
+  pFile->m_size = size;
+#else
+  int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return nullptr;
+
+  struct stat fileStat;
+  if (fstat(fd, &fileStat) != 0 || fileStat.st_size == 0) {
+    close(fd);
+    return nullptr;
+  }
+
+  void* pMapping = mmap(
+      nullptr,
+      static_cast<size_t>(fileStat.st_size),
+      PROT_READ,
+      MAP_PRIVATE,
+      fd,
+      0);
+  // The mapping stays valid after the file is closed
+  close(fd);
+  if (pMapping == MAP_FAILED)
+    return nullptr;
+
+  pFile->m_pData = static_cast<const char*>(pMapping);
+  pFile->m_size = static_cast<size_t>(fileStat.st_size);
+#endif
+
+  return pFile;
+}
+
+MappedFile::~MappedFile() {
+#ifndef _WIN32
+  if (m_pData)
+    munmap(const_cast<char*>(m_pData), m_size);
+#endif
+}
+
+void MappedFile::prefetch() const {
+#ifndef _WIN32
+  madvise(const_cast<char*>(m_pData), m_size, MADV_WILLNEED);
+#endif
+}
+} // namespace AltheaEngine
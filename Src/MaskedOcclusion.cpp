@@ -0,0 +1,519 @@
+#include "MaskedOcclusion.h"
+
+#include "JobGraph.h"
+#include "MaskedOcclusionCoverage.h"
+#include "Model.h"
+#include "SceneBVH.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <memory>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#define MASKED_OCCLUSION_USE_SSE
+#include <emmintrin.h>
+#endif
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#define MASKED_OCCLUSION_USE_CPUID
+#include <immintrin.h>
+#include <intrin.h>
+#elif (defined(__GNUC__) || defined(__clang__)) &&                             \
+    (defined(__x86_64__) || defined(__i386__))
+#define MASKED_OCCLUSION_USE_CPUID
+#endif
+
+#define FULL_TILE_COVERAGE 0xffffffffu
+
+namespace AltheaEngine {
+namespace {
+// Computes which of the 8 pixels of a tile row are inside all three edges.
+// Each edge function is A * x + rowC, evaluated at the pixel centers, where
+// rowC already accounts for the row's y coordinate.
+uint32_t computeRowCoverage(
+    const float edgeA[3],
+    const float rowC[3],
+    float tileMinX) {
+#if defined(MASKED_OCCLUSION_USE_SSE)
+  __m128 x0 = _mm_add_ps(
+      _mm_set1_ps(tileMinX),
+      _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f));
+  __m128 x1 = _mm_add_ps(x0, _mm_set1_ps(4.0f));
+  __m128 inside0 = _mm_castsi128_ps(_mm_set1_epi32(-1));
+  __m128 inside1 = inside0;
+  for (int k = 0; k < 3; ++k) {
+    __m128 a = _mm_set1_ps(edgeA[k]);
+    __m128 c = _mm_set1_ps(rowC[k]);
+    inside0 = _mm_and_ps(
+        inside0,
+        _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a, x0), c), _mm_setzero_ps()));
+    inside1 = _mm_and_ps(
+        inside1,
+        _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a, x1), c), _mm_setzero_ps()));
+  }
+
+  return static_cast<uint32_t>(_mm_movemask_ps(inside0)) |
+         (static_cast<uint32_t>(_mm_movemask_ps(inside1)) << 4);
+#else
+  uint32_t coverage = 0;
+  for (uint32_t i = 0; i < MaskedOcclusionBuffer::TILE_WIDTH; ++i) {
+    float x = tileMinX + i + 0.5f;
+    if (edgeA[0] * x + rowC[0] >= 0.0f && edgeA[1] * x + rowC[1] >= 0.0f &&
+        edgeA[2] * x + rowC[2] >= 0.0f)
+      coverage |= 1 << i;
+  }
+
+  return coverage;
+#endif
+}
+
+bool checkAVX2Support() {
+#if !defined(MASKED_OCCLUSION_USE_CPUID)
+  return false;
+#elif defined(_MSC_VER)
+  int info[4];
+  __cpuid(info, 0);
+  if (info[0] < 7)
+    return false;
+
+  // The OS must also save the AVX registers on context switches
+  __cpuid(info, 1);
+  bool osxsave = (info[2] & (1 << 27)) != 0;
+  bool avx = (info[2] & (1 << 28)) != 0;
+  if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6)
+    return false;
+
+  __cpuidex(info, 7, 0);
+  return (info[1] & (1 << 5)) != 0;
+#else
+  // Also checks that the OS saves the AVX registers
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2");
+#endif
+}
+
+uint32_t resolveTaskCount(
+    const ThreadPool& pool,
+    uint32_t taskCount,
+    uint32_t maxTasks) {
+  // One task per worker, plus the calling thread
+  if (taskCount == 0)
+    taskCount = pool.getThreadCount() + 1;
+  return std::clamp(taskCount, 1u, std::max(maxTasks, 1u));
+}
+} // namespace
+
+/*static*/
+uint32_t MaskedOcclusionCoverage::computeTileCoverage(
+    const float edgeA[3],
+    const float rowC[4][3],
+    float tileMinX) {
+  uint32_t coverage = 0;
+  for (uint32_t row = 0; row < MaskedOcclusionBuffer::TILE_HEIGHT; ++row) {
+    coverage |= computeRowCoverage(edgeA, rowC[row], tileMinX)
+                << (row * MaskedOcclusionBuffer::TILE_WIDTH);
+  }
+
+  return coverage;
+}
+
+/*static*/
+bool MaskedOcclusionCoverage::isAVX2Supported() {
+  static const bool supported = checkAVX2Support();
+  return supported;
+}
+
+/*static*/
+MaskedOcclusionCoverage::TileCoverageFunction
+MaskedOcclusionCoverage::getTileCoverageFunction() {
+  static const TileCoverageFunction function =
+      isAVX2Supported() ? &computeTileCoverageAVX2 : &computeTileCoverage;
+  return function;
+}
+
+MaskedOcclusionBuffer::MaskedOcclusionBuffer(uint32_t width, uint32_t height)
+    : m_tilesX((width + TILE_WIDTH - 1) / TILE_WIDTH),
+      m_tilesY((height + TILE_HEIGHT - 1) / TILE_HEIGHT) {
+  m_width = m_tilesX * TILE_WIDTH;
+  m_height = m_tilesY * TILE_HEIGHT;
+
+  size_t tileCount = static_cast<size_t>(m_tilesX) * m_tilesY;
+  m_tileDepths.resize(tileCount, 1.0f);
+  m_workingDepths.resize(tileCount, 0.0f);
+  m_coverageMasks.resize(tileCount, 0);
+}
+
+void MaskedOcclusionBuffer::render(
+    const glm::mat4& viewProjection,
+    const std::vector<OccluderMesh>& occluders,
+    uint32_t threadCount) {
+  m_viewProjection = viewProjection;
+
+  std::fill(m_tileDepths.begin(), m_tileDepths.end(), 1.0f);
+  std::fill(m_workingDepths.begin(), m_workingDepths.end(), 0.0f);
+  std::fill(m_coverageMasks.begin(), m_coverageMasks.end(), 0);
+
+  ThreadPool& pool = ThreadPool::getShared();
+  uint32_t taskCount = resolveTaskCount(pool, threadCount, m_tilesY);
+
+  JobGraph jobs;
+
+  // Transform, clip and project the occluders, each task handles a
+  // contiguous range of occluders and bins its triangles separately
+  m_triangleBins.resize(taskCount);
+  size_t occludersPerTask = (occluders.size() + taskCount - 1) / taskCount;
+  JobGraph::JobId setupJob = jobs.addParallelFor(
+      "Setup occluder triangles",
+      taskCount,
+      [this, &occluders, occludersPerTask](
+          uint32_t firstTask,
+          uint32_t endTask) {
+        for (uint32_t task = firstTask; task < endTask; ++task) {
+          size_t first = std::min(task * occludersPerTask, occluders.size());
+          size_t count = std::min(occludersPerTask, occluders.size() - first);
+          _setupTriangles(occluders, first, count, m_triangleBins[task]);
+        }
+      });
+
+  // Rasterize all triangles, each task owns a band of tile rows so no two
+  // threads ever touch the same tile
+  uint32_t rowsPerBand =
+      std::max((m_tilesY + taskCount - 1) / taskCount, 1u);
+  uint32_t bandCount = (m_tilesY + rowsPerBand - 1) / rowsPerBand;
+  jobs.addParallelFor(
+      "Rasterize occluders",
+      bandCount,
+      [this, rowsPerBand](uint32_t firstBand, uint32_t endBand) {
+        for (uint32_t band = firstBand; band < endBand; ++band) {
+          uint32_t firstRow = band * rowsPerBand;
+          _rasterizeBand(firstRow, std::min(rowsPerBand, m_tilesY - firstRow));
+        }
+      },
+      {setupJob});
+
+  jobs.execute(pool);
+}
+
+std::future<void> MaskedOcclusionBuffer::renderAsync(
+    const glm::mat4& viewProjection,
+    const std::vector<OccluderMesh>& occluders,
+    uint32_t threadCount) {
+  auto pTask = std::make_shared<std::packaged_task<void()>>(
+      [this, viewProjection, &occluders, threadCount]() {
+        render(viewProjection, occluders, threadCount);
+      });
+  std::future<void> future = pTask->get_future();
+  ThreadPool::getShared().submit([pTask]() { (*pTask)(); });
+  return future;
+}
+
+bool MaskedOcclusionBuffer::isOccluded(
+    const glm::vec3& min,
+    const glm::vec3& max) const {
+  if (m_tileDepths.empty())
+    return false;
+
+  glm::vec2 screenMin(std::numeric_limits<float>::max());
+  glm::vec2 screenMax(std::numeric_limits<float>::lowest());
+  float nearestDepth = std::numeric_limits<float>::max();
+  for (uint32_t i = 0; i < 8; ++i) {
+    glm::vec4 corner(
+        (i & 1) ? max.x : min.x,
+        (i & 2) ? max.y : min.y,
+        (i & 4) ? max.z : min.z,
+        1.0f);
+    glm::vec4 clip = m_viewProjection * corner;
+
+    // Boxes crossing the near plane can't be tested reliably
+    if (clip.z < 0.0f || clip.w <= 0.0f)
+      return false;
+
+    glm::vec3 ndc = glm::vec3(clip) / clip.w;
+    glm::vec2 screen(
+        (0.5f * ndc.x + 0.5f) * m_width,
+        (0.5f * ndc.y + 0.5f) * m_height);
+    screenMin = glm::min(screenMin, screen);
+    screenMax = glm::max(screenMax, screen);
+    nearestDepth = std::min(nearestDepth, ndc.z);
+  }
+
+  if (screenMax.x < 0.0f || screenMax.y < 0.0f || screenMin.x >= m_width ||
+      screenMin.y >= m_height)
+    return false;
+
+  uint32_t tileMinX = static_cast<uint32_t>(std::max(screenMin.x, 0.0f)) /
+                      TILE_WIDTH;
+  uint32_t tileMinY = static_cast<uint32_t>(std::max(screenMin.y, 0.0f)) /
+                      TILE_HEIGHT;
+  uint32_t tileMaxX = std::min(
+      static_cast<uint32_t>(screenMax.x) / TILE_WIDTH,
+      m_tilesX - 1);
+  uint32_t tileMaxY = std::min(
+      static_cast<uint32_t>(screenMax.y) / TILE_HEIGHT,
+      m_tilesY - 1);
+
+  for (uint32_t tileY = tileMinY; tileY <= tileMaxY; ++tileY) {
+    for (uint32_t tileX = tileMinX; tileX <= tileMaxX; ++tileX) {
+      if (nearestDepth < m_tileDepths[tileY * m_tilesX + tileX])
+        return false;
+    }
+  }
+
+  return true;
+}
+
+void MaskedOcclusionBuffer::removeOccluded(
+    const SceneBVH& bvh,
+    std::vector<uint32_t>& items) const {
+  items.erase(
+      std::remove_if(
+          items.begin(),
+          items.end(),
+          [this, &bvh](uint32_t itemIdx) {
+            AABB bounds = bvh.getItemBounds(itemIdx);
+            return isOccluded(bounds.min, bounds.max);
+          }),
+      items.end());
+}
+
+/*static*/
+void MaskedOcclusionBuffer::gatherOccluders(
+    const std::vector<Model>& models,
+    std::vector<OccluderMesh>& occluders) {
+  occluders.clear();
+  for (const Model& model : models) {
+    const std::vector<glm::mat4>& transforms =
+        model.getTransformsBuffer().getVertices();
+    for (const Primitive& primitive : model.getPrimitives()) {
+      // Skinned primitives don't match their bind pose positions
+      if (!primitive.isOccluder() || primitive.isSkinned())
+        continue;
+
+      const std::vector<Vertex>& vertices = primitive.getVertices();
+      const std::vector<uint32_t>& indices = primitive.getIndices();
+      for (uint32_t nodeIdx : primitive.getInstanceNodes()) {
+        OccluderMesh& occluder = occluders.emplace_back();
+        occluder.pPositions = &vertices[0].position;
+        occluder.vertexStride = sizeof(Vertex);
+        occluder.vertexCount = static_cast<uint32_t>(vertices.size());
+        occluder.pIndices = indices.data();
+        occluder.indexCount = static_cast<uint32_t>(indices.size());
+        occluder.transform = transforms[nodeIdx];
+      }
+    }
+  }
+}
+
+void MaskedOcclusionBuffer::_setupTriangles(
+    const std::vector<OccluderMesh>& occluders,
+    size_t firstOccluder,
+    size_t occluderCount,
+    std::vector<ScreenTriangle>& triangles) const {
+  triangles.clear();
+
+  std::vector<glm::vec4> clipPositions;
+  for (size_t occluderIdx = firstOccluder;
+       occluderIdx < firstOccluder + occluderCount;
+       ++occluderIdx) {
+    const OccluderMesh& occluder = occluders[occluderIdx];
+    glm::mat4 transform = m_viewProjection * occluder.transform;
+
+    const uint8_t* pPositionBytes =
+        reinterpret_cast<const uint8_t*>(occluder.pPositions);
+    clipPositions.resize(occluder.vertexCount);
+    for (uint32_t i = 0; i < occluder.vertexCount; ++i) {
+      const glm::vec3& position = *reinterpret_cast<const glm::vec3*>(
+          pPositionBytes + static_cast<size_t>(i) * occluder.vertexStride);
+      clipPositions[i] = transform * glm::vec4(position, 1.0f);
+    }
+
+    for (uint32_t i = 0; i + 2 < occluder.indexCount; i += 3) {
+      const glm::vec4& a = clipPositions[occluder.pIndices[i]];
+      const glm::vec4& b = clipPositions[occluder.pIndices[i + 1]];
+      const glm::vec4& c = clipPositions[occluder.pIndices[i + 2]];
+
+      // Trivially reject triangles entirely outside one of the clip planes
+      if ((a.x > a.w && b.x > b.w && c.x > c.w) ||
+          (a.x < -a.w && b.x < -b.w && c.x < -c.w) ||
+          (a.y > a.w && b.y > b.w && c.y > c.w) ||
+          (a.y < -a.w && b.y < -b.w && c.y < -c.w) ||
+          (a.z > a.w && b.z > b.w && c.z > c.w) ||
+          (a.z < 0.0f && b.z < 0.0f && c.z < 0.0f))
+        continue;
+
+      if (a.z >= 0.0f && b.z >= 0.0f && c.z >= 0.0f) {
+        _emitTriangle(a, b, c, triangles);
+        continue;
+      }
+
+      // Clip against the near plane, leaving a triangle or a quad
+      const glm::vec4* input[3] = {&a, &b, &c};
+      glm::vec4 clipped[4];
+      uint32_t clippedCount = 0;
+      for (uint32_t j = 0; j < 3; ++j) {
+        const glm::vec4& current = *input[j];
+        const glm::vec4& next = *input[(j + 1) % 3];
+        if (current.z >= 0.0f)
+          clipped[clippedCount++] = current;
+        if ((current.z >= 0.0f) != (next.z >= 0.0f)) {
+          float t = current.z / (current.z - next.z);
+          clipped[clippedCount++] = current + t * (next - current);
+        }
+      }
+
+      _emitTriangle(clipped[0], clipped[1], clipped[2], triangles);
+      if (clippedCount == 4)
+        _emitTriangle(clipped[0], clipped[2], clipped[3], triangles);
+    }
+  }
+}
+
+void MaskedOcclusionBuffer::_emitTriangle(
+    const glm::vec4& a,
+    const glm::vec4& b,
+    const glm::vec4& c,
+    std::vector<ScreenTriangle>& triangles) const {
+  ScreenTriangle& triangle = triangles.emplace_back();
+  const glm::vec4* clip[3] = {&a, &b, &c};
+  for (uint32_t i = 0; i < 3; ++i) {
+    glm::vec3 ndc = glm::vec3(*clip[i]) / clip[i]->w;
+    triangle.v[i] = glm::vec3(
+        (0.5f * ndc.x + 0.5f) * m_width,
+        (0.5f * ndc.y + 0.5f) * m_height,
+        ndc.z);
+  }
+}
+
+void MaskedOcclusionBuffer::_rasterizeBand(
+    uint32_t firstTileRow,
+    uint32_t tileRowCount) {
+  for (const std::vector<ScreenTriangle>& triangles : m_triangleBins) {
+    for (const ScreenTriangle& triangle : triangles)
+      _rasterizeTriangle(triangle, firstTileRow, tileRowCount);
+  }
+}
+
+void MaskedOcclusionBuffer::_rasterizeTriangle(
+    const ScreenTriangle& triangle,
+    uint32_t firstTileRow,
+    uint32_t tileRowCount) {
+  glm::vec3 v0 = triangle.v[0];
+  glm::vec3 v1 = triangle.v[1];
+  glm::vec3 v2 = triangle.v[2];
+
+  // Wind consistently so the inside of every edge is positive
+  float area = (v1.x - v0.x) * (v2.y - v0.y) - (v1.y - v0.y) * (v2.x - v0.x);
+  if (std::abs(area) < 1e-6f)
+    return;
+  if (area < 0.0f) {
+    std::swap(v1, v2);
+    area = -area;
+  }
+
+  float minX = std::max(std::floor(std::min({v0.x, v1.x, v2.x})), 0.0f);
+  float minY = std::max(std::floor(std::min({v0.y, v1.y, v2.y})), 0.0f);
+  float maxX = std::min(
+      std::ceil(std::max({v0.x, v1.x, v2.x})),
+      static_cast<float>(m_width - 1));
+  float maxY = std::min(
+      std::ceil(std::max({v0.y, v1.y, v2.y})),
+      static_cast<float>(m_height - 1));
+  if (minX > maxX || minY > maxY)
+    return;
+
+  uint32_t tileMinX = static_cast<uint32_t>(minX) / TILE_WIDTH;
+  uint32_t tileMaxX = static_cast<uint32_t>(maxX) / TILE_WIDTH;
+  uint32_t tileMinY =
+      std::max(static_cast<uint32_t>(minY) / TILE_HEIGHT, firstTileRow);
+  uint32_t tileMaxY = std::min(
+      static_cast<uint32_t>(maxY) / TILE_HEIGHT,
+      firstTileRow + tileRowCount - 1);
+  if (tileMinY > tileMaxY)
+    return;
+
+  // Edge functions E(x, y) = A * x + B * y + C. An edge shared by two
+  // triangles is always set up from the same end, so its function in one
+  // triangle is exactly the negation of the other's and pixels centered on
+  // the edge are covered by at least one of them.
+  const glm::vec3* edgeStart[3] = {&v0, &v1, &v2};
+  const glm::vec3* edgeEnd[3] = {&v1, &v2, &v0};
+  float edgeA[3];
+  float edgeB[3];
+  float edgeC[3];
+  for (uint32_t k = 0; k < 3; ++k) {
+    const glm::vec3* pStart = edgeStart[k];
+    const glm::vec3* pEnd = edgeEnd[k];
+    bool flip = pEnd->x < pStart->x ||
+                (pEnd->x == pStart->x && pEnd->y < pStart->y);
+    if (flip)
+      std::swap(pStart, pEnd);
+
+    edgeA[k] = -(pEnd->y - pStart->y);
+    edgeB[k] = pEnd->x - pStart->x;
+    edgeC[k] = -(edgeA[k] * pStart->x + edgeB[k] * pStart->y);
+    if (flip) {
+      edgeA[k] = -edgeA[k];
+      edgeB[k] = -edgeB[k];
+      edgeC[k] = -edgeC[k];
+    }
+  }
+
+  // Depth plane, the farthest depth of the triangle within a tile is at one
+  // of the tile's corners, but never beyond the farthest vertex
+  float dzdx =
+      ((v1.z - v0.z) * (v2.y - v0.y) - (v2.z - v0.z) * (v1.y - v0.y)) / area;
+  float dzdy =
+      ((v2.z - v0.z) * (v1.x - v0.x) - (v1.z - v0.z) * (v2.x - v0.x)) / area;
+  float maxVertexDepth = std::max({v0.z, v1.z, v2.z});
+  float tileDepthSlope =
+      std::max(dzdx, 0.0f) * TILE_WIDTH + std::max(dzdy, 0.0f) * TILE_HEIGHT;
+
+  MaskedOcclusionCoverage::TileCoverageFunction computeTileCoverage =
+      MaskedOcclusionCoverage::getTileCoverageFunction();
+
+  for (uint32_t tileY = tileMinY; tileY <= tileMaxY; ++tileY) {
+    float tileMinYf = static_cast<float>(tileY * TILE_HEIGHT);
+
+    float rowC[TILE_HEIGHT][3];
+    for (uint32_t row = 0; row < TILE_HEIGHT; ++row) {
+      float y = tileMinYf + row + 0.5f;
+      for (uint32_t k = 0; k < 3; ++k)
+        rowC[row][k] = edgeB[k] * y + edgeC[k];
+    }
+
+    for (uint32_t tileX = tileMinX; tileX <= tileMaxX; ++tileX) {
+      float tileMinXf = static_cast<float>(tileX * TILE_WIDTH);
+      size_t tileIdx = static_cast<size_t>(tileY) * m_tilesX + tileX;
+
+      float cornerDepth =
+          v0.z + dzdx * (tileMinXf - v0.x) + dzdy * (tileMinYf - v0.y);
+      float triangleDepth =
+          std::min(cornerDepth + tileDepthSlope, maxVertexDepth);
+
+      // Already hidden behind the tile's conservative depth
+      if (triangleDepth >= m_tileDepths[tileIdx])
+        continue;
+
+      uint32_t coverage = computeTileCoverage(edgeA, rowC, tileMinXf);
+      if (coverage == 0)
+        continue;
+
+      // Merge into the working layer, and promote it once the whole tile is
+      // covered
+      uint32_t& mask = m_coverageMasks[tileIdx];
+      float& workingDepth = m_workingDepths[tileIdx];
+      workingDepth =
+          mask == 0 ? triangleDepth : std::max(workingDepth, triangleDepth);
+      mask |= coverage;
+
+      if (mask == FULL_TILE_COVERAGE) {
+        m_tileDepths[tileIdx] = workingDepth;
+        workingDepth = 0.0f;
+        mask = 0;
+      }
+    }
+  }
+}
+} // namespace AltheaEngine
@@ -0,0 +1,45 @@
+// The only file built with AVX2 enabled, see the CMakeLists. It must not
+// include headers with inline functions shared with the rest of the engine,
+// since the linker could pick this file's AVX2 copy of them for every caller.
+
+#include "MaskedOcclusionCoverage.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace AltheaEngine {
+/*static*/
+uint32_t MaskedOcclusionCoverage::computeTileCoverageAVX2(
+    const float edgeA[3],
+    const float rowC[4][3],
+    float tileMinX) {
+#if defined(__AVX2__)
+  __m256 x = _mm256_add_ps(
+      _mm256_set1_ps(tileMinX),
+      _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f));
+  __m256 a[3];
+  for (int k = 0; k < 3; ++k)
+    a[k] = _mm256_mul_ps(_mm256_set1_ps(edgeA[k]), x);
+
+  uint32_t coverage = 0;
+  for (int row = 0; row < 4; ++row) {
+    __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+    for (int k = 0; k < 3; ++k) {
+      __m256 e = _mm256_add_ps(a[k], _mm256_set1_ps(rowC[row][k]));
+      inside = _mm256_and_ps(
+          inside,
+          _mm256_cmp_ps(e, _mm256_setzero_ps(), _CMP_GE_OQ));
+    }
+
+    coverage |= static_cast<uint32_t>(_mm256_movemask_ps(inside))
+                << (8 * row);
+  }
+
+  return coverage;
+#else
+  // Not built for AVX2, never chosen by getTileCoverageFunction()
+  return computeTileCoverage(edgeA, rowC, tileMinX);
+#endif
+}
+} // namespace AltheaEngine
@@ -0,0 +1,452 @@
+#include "MeshSimplification.h"
+
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+namespace AltheaEngine {
+namespace {
+// Symmetric 4x4 error quadric, accumulated from the planes of triangles
+// adjacent to a vertex. The weight is tracked so that the evaluated error can
+// be normalized back into a squared distance.
+struct Quadric {
+  double a00 = 0.0, a01 = 0.0, a02 = 0.0, a03 = 0.0;
+  double a11 = 0.0, a12 = 0.0, a13 = 0.0;
+  double a22 = 0.0, a23 = 0.0;
+  double a33 = 0.0;
+  double w = 0.0;
+
+  void addPlane(double nx, double ny, double nz, double d, double weight) {
+    a00 += weight * nx * nx;
+    a01 += weight * nx * ny;
+    a02 += weight * nx * nz;
+    a03 += weight * nx * d;
+    a11 += weight * ny * ny;
+    a12 += weight * ny * nz;
+    a13 += weight * ny * d;
+    a22 += weight * nz * nz;
+    a23 += weight * nz * d;
+    a33 += weight * d * d;
+    w += weight;
+  }
+
+  void add(const Quadric& q) {
+    a00 += q.a00;
+    a01 += q.a01;
+    a02 += q.a02;
+    a03 += q.a03;
+    a11 += q.a11;
+    a12 += q.a12;
+    a13 += q.a13;
+    a22 += q.a22;
+    a23 += q.a23;
+    a33 += q.a33;
+    w += q.w;
+  }
+
+  // Returns the weighted-average squared distance of p to the planes.
+  double evaluate(const glm::vec3& p) const {
+    double x = p.x, y = p.y, z = p.z;
+    double e = a00 * x * x + a11 * y * y + a22 * z * z + a33 +
+               2.0 * (a01 * x * y + a02 * x * z + a12 * y * z + a03 * x +
+                      a13 * y + a23 * z);
+    return w > 0.0 ? std::max(e / w, 0.0) : 0.0;
+  }
+};
+
+struct Collapse {
+  uint32_t fromPos;
+  uint32_t toVertex;
+  double cost;
+};
+
+enum VertexKind : uint8_t {
+  // Interior vertex with continuous attributes, free to collapse.
+  VERTEX_KIND_MANIFOLD = 0,
+  // Seam, border or non-manifold vertex - may be collapsed onto, but is never
+  // moved itself.
+  VERTEX_KIND_LOCKED
+};
+
+template <size_t N> struct BitwiseKey {
+  uint32_t words[N];
+
+  bool operator==(const BitwiseKey& other) const {
+    return std::memcmp(words, other.words, sizeof(words)) == 0;
+  }
+};
+
+template <size_t N> struct BitwiseKeyHash {
+  size_t operator()(const BitwiseKey<N>& key) const {
+    // FNV-1a
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < N; ++i) {
+      hash ^= key.words[i];
+      hash *= 1099511628211ull;
+    }
+    return static_cast<size_t>(hash);
+  }
+};
+
+template <size_t N, typename T> BitwiseKey<N> makeKey(const T& value) {
+  static_assert(sizeof(T) == N * sizeof(uint32_t));
+  BitwiseKey<N> key;
+  std::memcpy(key.words, &value, sizeof(T));
+  return key;
+}
+
+uint32_t getDominantJoint(const Vertex& v) {
+  uint32_t dominant = 0;
+  for (uint32_t i = 1; i < 4; ++i) {
+    if (v.weights[i] > v.weights[dominant])
+      dominant = i;
+  }
+  return v.joints[dominant];
+}
+
+glm::vec3 triangleNormal(
+    const glm::vec3& a,
+    const glm::vec3& b,
+    const glm::vec3& c) {
+  return glm::cross(b - a, c - a);
+}
+} // namespace
+
+/*static*/
+std::vector<uint32_t> MeshSimplification::simplify(
+    gsl::span<const Vertex> vertices,
+    gsl::span<const uint32_t> indices,
+    size_t targetIndexCount,
+    float maxError,
+    float* pResultError) {
+  if (pResultError)
+    *pResultError = 0.0f;
+
+  size_t vertexCount = vertices.size();
+  std::vector<uint32_t> result(indices.begin(), indices.end());
+  if (vertexCount == 0 || result.size() <= targetIndexCount)
+    return result;
+
+  // Weld bitwise-identical vertices together, the glTF import may have
+  // duplicated them.
+  std::vector<uint32_t> vertexRemap(vertexCount);
+  // Map each vertex to a canonical vertex with the same position. Vertices
+  // with the same position but different attributes form a seam.
+  std::vector<uint32_t> posRemap(vertexCount);
+  {
+    constexpr size_t VERTEX_WORDS = sizeof(Vertex) / sizeof(uint32_t);
+    std::unordered_map<
+        BitwiseKey<VERTEX_WORDS>,
+        uint32_t,
+        BitwiseKeyHash<VERTEX_WORDS>>
+        vertexMap;
+    std::unordered_map<BitwiseKey<3>, uint32_t, BitwiseKeyHash<3>> posMap;
+    vertexMap.reserve(vertexCount);
+    posMap.reserve(vertexCount);
+    for (uint32_t i = 0; i < vertexCount; ++i) {
+      vertexRemap[i] =
+          vertexMap.emplace(makeKey<VERTEX_WORDS>(vertices[i]), i)
+              .first->second;
+      posRemap[i] =
+          posMap.emplace(makeKey<3>(vertices[i].position), i).first->second;
+    }
+  }
+
+  for (uint32_t& idx : result)
+    idx = vertexRemap[idx];
+
+  bool isSkinned = false;
+  glm::vec3 aabbMin = vertices[0].position;
+  glm::vec3 aabbMax = vertices[0].position;
+  for (const Vertex& v : vertices) {
+    aabbMin = glm::min(aabbMin, v.position);
+    aabbMax = glm::max(aabbMax, v.position);
+    isSkinned |= v.weights.x > 0.0f || v.weights.y > 0.0f ||
+                 v.weights.z > 0.0f || v.weights.w > 0.0f;
+  }
+
+  glm::vec3 extent = aabbMax - aabbMin;
+  float meshScale = std::max(extent.x, std::max(extent.y, extent.z));
+  double maxErrorSq =
+      static_cast<double>(maxError) * maxError * meshScale * meshScale;
+
+  // Classify vertices, everything is tracked on the canonical position
+  // vertex.
+  std::vector<uint8_t> kinds(vertexCount, VERTEX_KIND_MANIFOLD);
+  // The single referenced vertex at each (manifold) position.
+  std::vector<uint32_t> posVertex(vertexCount, ~0u);
+  for (uint32_t idx : result) {
+    uint32_t pos = posRemap[idx];
+    if (posVertex[pos] == ~0u)
+      posVertex[pos] = idx;
+    else if (posVertex[pos] != idx)
+      kinds[pos] = VERTEX_KIND_LOCKED;
+  }
+
+  {
+    // Open borders and non-manifold edges are locked
+    std::unordered_map<uint64_t, uint32_t> edgeCounts;
+    edgeCounts.reserve(result.size());
+    for (size_t i = 0; i < result.size(); i += 3) {
+      for (uint32_t e = 0; e < 3; ++e) {
+        uint32_t a = posRemap[result[i + e]];
+        uint32_t b = posRemap[result[i + (e + 1) % 3]];
+        if (a == b)
+          continue;
+        if (a > b)
+          std::swap(a, b);
+        ++edgeCounts[(static_cast<uint64_t>(a) << 32) | b];
+      }
+    }
+
+    for (const auto& it : edgeCounts) {
+      if (it.second != 2) {
+        kinds[static_cast<uint32_t>(it.first >> 32)] = VERTEX_KIND_LOCKED;
+        kinds[static_cast<uint32_t>(it.first & 0xffffffff)] =
+            VERTEX_KIND_LOCKED;
+      }
+    }
+  }
+
+  std::vector<Quadric> quadrics(vertexCount);
+  for (size_t i = 0; i < result.size(); i += 3) {
+    uint32_t p0 = posRemap[result[i + 0]];
+    uint32_t p1 = posRemap[result[i + 1]];
+    uint32_t p2 = posRemap[result[i + 2]];
+
+    const glm::vec3& a = vertices[p0].position;
+    glm::vec3 n = triangleNormal(a, vertices[p1].position, vertices[p2].position);
+    float len = glm::length(n);
+    if (len <= 0.0f)
+      continue;
+
+    n /= len;
+    float area = 0.5f * len;
+    float d = -glm::dot(n, a);
+
+    quadrics[p0].addPlane(n.x, n.y, n.z, d, area);
+    quadrics[p1].addPlane(n.x, n.y, n.z, d, area);
+    quadrics[p2].addPlane(n.x, n.y, n.z, d, area);
+  }
+
+  double resultErrorSq = 0.0;
+
+  std::vector<uint32_t> triOffsets(vertexCount + 1);
+  std::vector<uint32_t> triList;
+  std::vector<Collapse> collapses;
+  std::vector<uint32_t> collapseRemap(vertexCount);
+  std::vector<uint8_t> touched(vertexCount);
+  std::vector<uint32_t> simplified;
+
+  while (result.size() > targetIndexCount) {
+    // Build position -> adjacent triangle lists
+    std::fill(triOffsets.begin(), triOffsets.end(), 0);
+    for (uint32_t idx : result)
+      ++triOffsets[posRemap[idx] + 1];
+    for (size_t i = 0; i < vertexCount; ++i)
+      triOffsets[i + 1] += triOffsets[i];
+
+    triList.resize(result.size());
+    {
+      std::vector<uint32_t> cursor(triOffsets.begin(), triOffsets.end() - 1);
+      for (size_t i = 0; i < result.size(); ++i)
+        triList[cursor[posRemap[result[i]]]++] = static_cast<uint32_t>(i / 3);
+    }
+
+    // Gather candidate edge collapses
+    collapses.clear();
+    for (size_t i = 0; i < result.size(); i += 3) {
+      for (uint32_t e = 0; e < 3; ++e) {
+        uint32_t a = result[i + e];
+        uint32_t b = result[i + (e + 1) % 3];
+        uint32_t pa = posRemap[a];
+        uint32_t pb = posRemap[b];
+        if (pa == pb)
+          continue;
+
+        if (isSkinned &&
+            getDominantJoint(vertices[a]) != getDominantJoint(vertices[b]))
+          continue;
+
+        Quadric q = quadrics[pa];
+        q.add(quadrics[pb]);
+
+        if (kinds[pa] == VERTEX_KIND_MANIFOLD)
+          collapses.push_back({pa, b, q.evaluate(vertices[pb].position)});
+        if (kinds[pb] == VERTEX_KIND_MANIFOLD)
+          collapses.push_back({pb, a, q.evaluate(vertices[pa].position)});
+      }
+    }
+
+    std::sort(
+        collapses.begin(),
+        collapses.end(),
+        [](const Collapse& a, const Collapse& b) { return a.cost < b.cost; });
+
+    for (uint32_t i = 0; i < vertexCount; ++i)
+      collapseRemap[i] = i;
+    std::fill(touched.begin(), touched.end(), 0);
+
+    size_t triCount = result.size() / 3;
+    size_t targetTriCount = targetIndexCount / 3;
+    uint32_t collapseCount = 0;
+
+    for (const Collapse& collapse : collapses) {
+      if (triCount <= targetTriCount || collapse.cost > maxErrorSq)
+        break;
+
+      uint32_t fromPos = collapse.fromPos;
+      uint32_t toPos = posRemap[collapse.toVertex];
+      if (touched[fromPos] || touched[toPos])
+        continue;
+
+      const glm::vec3& target = vertices[toPos].position;
+
+      // Reject collapses that would flip any of the surviving triangles
+      bool flips = false;
+      uint32_t removedTris = 0;
+      for (uint32_t t = triOffsets[fromPos]; t < triOffsets[fromPos + 1];
+           ++t) {
+        const uint32_t* tri = &result[3 * triList[t]];
+        uint32_t p[3] = {
+            posRemap[tri[0]],
+            posRemap[tri[1]],
+            posRemap[tri[2]]};
+        if (p[0] == toPos || p[1] == toPos || p[2] == toPos) {
+          ++removedTris;
+          continue;
+        }
+
+        glm::vec3 before = triangleNormal(
+            vertices[p[0]].position,
+            vertices[p[1]].position,
+            vertices[p[2]].position);
+        glm::vec3 after = triangleNormal(
+            p[0] == fromPos ? target : vertices[p[0]].position,
+            p[1] == fromPos ? target : vertices[p[1]].position,
+            p[2] == fromPos ? target : vertices[p[2]].position);
+        if (glm::dot(before, after) <= 0.0f) {
+          flips = true;
+          break;
+        }
+      }
+
+      if (flips)
+        continue;
+
+      collapseRemap[posVertex[fromPos]] = collapse.toVertex;
+      quadrics[toPos].add(quadrics[fromPos]);
+      resultErrorSq = std::max(resultErrorSq, collapse.cost);
+
+      // The neighborhood of this collapse is now stale for the rest of the
+      // pass.
+      for (uint32_t t = triOffsets[fromPos]; t < triOffsets[fromPos + 1];
+           ++t) {
+        const uint32_t* tri = &result[3 * triList[t]];
+        touched[posRemap[tri[0]]] = 1;
+        touched[posRemap[tri[1]]] = 1;
+        touched[posRemap[tri[2]]] = 1;
+      }
+
+      triCount -= std::min<size_t>(removedTris, triCount);
+      ++collapseCount;
+    }
+
+    if (collapseCount == 0)
+      break;
+
+    simplified.clear();
+    simplified.reserve(result.size());
+    for (size_t i = 0; i < result.size(); i += 3) {
+      uint32_t a = collapseRemap[result[i + 0]];
+      uint32_t b = collapseRemap[result[i + 1]];
+      uint32_t c = collapseRemap[result[i + 2]];
+      uint32_t pa = posRemap[a];
+      uint32_t pb = posRemap[b];
+      uint32_t pc = posRemap[c];
+      if (pa == pb || pb == pc || pc == pa)
+        continue;
+
+      simplified.push_back(a);
+      simplified.push_back(b);
+      simplified.push_back(c);
+    }
+
+    std::swap(result, simplified);
+  }
+
+  if (pResultError)
+    *pResultError = static_cast<float>(std::sqrt(resultErrorSq));
+
+  return result;
+}
+
+/*static*/
+std::vector<MeshLod> MeshSimplification::generateLods(
+    gsl::span<const Vertex> vertices,
+    gsl::span<const uint32_t> indices,
+    uint32_t lodCount,
+    float reductionPerLod,
+    float maxError,
+    std::vector<uint32_t>& lodIndices) {
+  struct LodResult {
+    std::vector<uint32_t> indices;
+    float error = 0.0f;
+  };
+
+  // Each LOD is simplified straight from the full-detail mesh, so they can
+  // all be generated in parallel.
+  std::vector<size_t> targetIndexCounts(lodCount);
+  float reduction = 1.0f;
+  for (uint32_t lodIdx = 0; lodIdx < lodCount; ++lodIdx) {
+    reduction *= reductionPerLod;
+    targetIndexCounts[lodIdx] =
+        static_cast<size_t>(indices.size() / 3 * reduction) * 3;
+  }
+
+  std::vector<LodResult> results(lodCount);
+  ThreadPool::getShared().parallelFor(
+      lodCount,
+      [&](uint32_t firstLod, uint32_t endLod) {
+        for (uint32_t lodIdx = firstLod; lodIdx < endLod; ++lodIdx) {
+          LodResult& lod = results[lodIdx];
+          lod.indices = simplify(
+              vertices,
+              indices,
+              targetIndexCounts[lodIdx],
+              maxError,
+              &lod.error);
+        }
+      });
+
+  std::vector<MeshLod> lods;
+  lods.reserve(lodCount);
+  size_t prevIndexCount = indices.size();
+  for (LodResult& result : results) {
+    // Stop once the simplifier stalls, e.g. due to locked seams or the error
+    // limit.
+    if (result.indices.empty() ||
+        result.indices.size() > prevIndexCount * 9 / 10)
+      break;
+
+    MeshLod& lod = lods.emplace_back();
+    lod.firstIndex = static_cast<uint32_t>(lodIndices.size());
+    lod.indexCount = static_cast<uint32_t>(result.indices.size());
+    // Keep errors monotonic so that LOD selection can rely on them.
+    lod.error = lods.size() > 1
+                    ? std::max(result.error, lods[lods.size() - 2].error)
+                    : result.error;
+
+    lodIndices.insert(
+        lodIndices.end(),
+        result.indices.begin(),
+        result.indices.end());
+    prevIndexCount = result.indices.size();
+  }
+
+  return lods;
+}
+} // namespace AltheaEngine
@@ -0,0 +1,344 @@
+#include "Meshlets.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace AltheaEngine {
+namespace {
+// Meshlets whose triangle normals spread further than this can never be
+// backface culled as a whole, so the cone is disabled for them.
+constexpr float MIN_CONE_SPREAD = 0.1f;
+
+struct MeshletBuilderState {
+  // CSR vertex -> triangle adjacency
+  std::vector<uint32_t> triangleOffsets;
+  std::vector<uint32_t> adjacentTriangles;
+
+  std::vector<bool> emittedTriangles;
+
+  // Local index of each vertex in the current meshlet, or 0xff if the vertex
+  // is not in the current meshlet
+  std::vector<uint8_t> localIndices;
+
+  std::vector<uint32_t> currentVertices;
+  std::vector<uint32_t> currentTriangles;
+};
+
+uint32_t countNewVertices(
+    const MeshletBuilderState& state,
+    gsl::span<const uint32_t> indices,
+    uint32_t triangleIdx) {
+  uint32_t count = 0;
+  for (uint32_t i = 0; i < 3; ++i) {
+    if (state.localIndices[indices[3 * triangleIdx + i]] == 0xff)
+      ++count;
+  }
+
+  return count;
+}
+} // namespace
+
+/*static*/
+void MeshletUtilities::buildMeshlets(
+    gsl::span<const Vertex> vertices,
+    gsl::span<const uint32_t> indices,
+    std::vector<Meshlet>& meshlets,
+    std::vector<uint32_t>& meshletData) {
+  meshlets.clear();
+  meshletData.clear();
+
+  uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+  if (triangleCount == 0)
+    return;
+
+  MeshletBuilderState state;
+
+  state.triangleOffsets.resize(vertices.size() + 1, 0);
+  for (size_t i = 0; i < 3 * static_cast<size_t>(triangleCount); ++i)
+    ++state.triangleOffsets[indices[i] + 1];
+  for (size_t i = 1; i < state.triangleOffsets.size(); ++i)
+    state.triangleOffsets[i] += state.triangleOffsets[i - 1];
+
+  state.adjacentTriangles.resize(3 * static_cast<size_t>(triangleCount));
+  {
+    std::vector<uint32_t> fill(
+        state.triangleOffsets.begin(),
+        state.triangleOffsets.end() - 1);
+    for (uint32_t t = 0; t < triangleCount; ++t) {
+      for (uint32_t i = 0; i < 3; ++i)
+        state.adjacentTriangles[fill[indices[3 * t + i]]++] = t;
+    }
+  }
+
+  state.emittedTriangles.resize(triangleCount, false);
+  state.localIndices.resize(vertices.size(), 0xff);
+  state.currentVertices.reserve(MESHLET_MAX_VERTICES);
+  state.currentTriangles.reserve(MESHLET_MAX_TRIANGLES);
+
+  auto flushMeshlet = [&]() {
+    if (state.currentTriangles.empty())
+      return;
+
+    Meshlet& meshlet = meshlets.emplace_back();
+    meshlet.vertexOffset = static_cast<uint32_t>(meshletData.size());
+    meshlet.vertexCount = static_cast<uint32_t>(state.currentVertices.size());
+    meshletData.insert(
+        meshletData.end(),
+        state.currentVertices.begin(),
+        state.currentVertices.end());
+
+    meshlet.triangleOffset = static_cast<uint32_t>(meshletData.size());
+    meshlet.triangleCount =
+        static_cast<uint32_t>(state.currentTriangles.size());
+    meshletData.insert(
+        meshletData.end(),
+        state.currentTriangles.begin(),
+        state.currentTriangles.end());
+
+    computeMeshletBounds(vertices, meshletData, meshlet);
+
+    for (uint32_t vertexIdx : state.currentVertices)
+      state.localIndices[vertexIdx] = 0xff;
+    state.currentVertices.clear();
+    state.currentTriangles.clear();
+  };
+
+  auto emitTriangle = [&](uint32_t triangleIdx) {
+    uint32_t packedTriangle = 0;
+    for (uint32_t i = 0; i < 3; ++i) {
+      uint32_t vertexIdx = indices[3 * triangleIdx + i];
+      uint8_t& localIdx = state.localIndices[vertexIdx];
+      if (localIdx == 0xff) {
+        localIdx = static_cast<uint8_t>(state.currentVertices.size());
+        state.currentVertices.push_back(vertexIdx);
+      }
+
+      packedTriangle |= static_cast<uint32_t>(localIdx) << (8 * i);
+    }
+
+    state.currentTriangles.push_back(packedTriangle);
+    state.emittedTriangles[triangleIdx] = true;
+  };
+
+  uint32_t seedTriangle = 0;
+  while (true) {
+    // Find the best triangle adjacent to the current meshlet
+    uint32_t bestTriangle = std::numeric_limits<uint32_t>::max();
+    uint32_t bestNewVertices = 4;
+    for (uint32_t vertexIdx : state.currentVertices) {
+      for (uint32_t i = state.triangleOffsets[vertexIdx];
+           i < state.triangleOffsets[vertexIdx + 1];
+           ++i) {
+        uint32_t triangleIdx = state.adjacentTriangles[i];
+        if (state.emittedTriangles[triangleIdx])
+          continue;
+
+        uint32_t newVertices = countNewVertices(state, indices, triangleIdx);
+        if (newVertices < bestNewVertices) {
+          bestNewVertices = newVertices;
+          bestTriangle = triangleIdx;
+        }
+      }
+
+      if (bestNewVertices == 0)
+        break;
+    }
+
+    if (bestTriangle == std::numeric_limits<uint32_t>::max()) {
+      // The current meshlet cannot grow any further through adjacency,
+      // start a new one from the next unused triangle.
+      flushMeshlet();
+
+      while (seedTriangle < triangleCount &&
+             state.emittedTriangles[seedTriangle])
+        ++seedTriangle;
+
+      if (seedTriangle == triangleCount)
+        break;
+
+      bestTriangle = seedTriangle;
+      bestNewVertices = countNewVertices(state, indices, bestTriangle);
+    }
+
+    if (state.currentVertices.size() + bestNewVertices >
+            MESHLET_MAX_VERTICES ||
+        state.currentTriangles.size() + 1 > MESHLET_MAX_TRIANGLES) {
+      flushMeshlet();
+    }
+
+    emitTriangle(bestTriangle);
+  }
+
+  flushMeshlet();
+}
+
+/*static*/
+void MeshletUtilities::computeMeshletBounds(
+    gsl::span<const Vertex> vertices,
+    gsl::span<const uint32_t> meshletData,
+    Meshlet& meshlet) {
+  auto getPosition = [&](uint32_t localIdx) -> const glm::vec3& {
+    return vertices[meshletData[meshlet.vertexOffset + localIdx]].position;
+  };
+
+  // Ritter's bounding sphere
+  glm::vec3 a = getPosition(0);
+  glm::vec3 b = a;
+  float maxDist2 = 0.0f;
+  for (uint32_t i = 0; i < meshlet.vertexCount; ++i) {
+    glm::vec3 diff = getPosition(i) - a;
+    float dist2 = glm::dot(diff, diff);
+    if (dist2 > maxDist2) {
+      maxDist2 = dist2;
+      b = getPosition(i);
+    }
+  }
+
+  glm::vec3 c = b;
+  maxDist2 = 0.0f;
+  for (uint32_t i = 0; i < meshlet.vertexCount; ++i) {
+    glm::vec3 diff = getPosition(i) - b;
+    float dist2 = glm::dot(diff, diff);
+    if (dist2 > maxDist2) {
+      maxDist2 = dist2;
+      c = getPosition(i);
+    }
+  }
+
+  glm::vec3 center = 0.5f * (b + c);
+  float radius = 0.5f * glm::length(c - b);
+  for (uint32_t i = 0; i < meshlet.vertexCount; ++i) {
+    glm::vec3 diff = getPosition(i) - center;
+    float dist = glm::length(diff);
+    if (dist > radius) {
+      float newRadius = 0.5f * (radius + dist);
+      center += (newRadius - radius) / dist * diff;
+      radius = newRadius;
+    }
+  }
+
+  meshlet.center = center;
+  meshlet.radius = radius;
+
+  // Normal cone
+  std::vector<glm::vec3> normals;
+  normals.reserve(meshlet.triangleCount);
+  glm::vec3 axis(0.0f);
+  for (uint32_t t = 0; t < meshlet.triangleCount; ++t) {
+    uint32_t packedTriangle = meshletData[meshlet.triangleOffset + t];
+    const glm::vec3& p0 = getPosition(packedTriangle & 0xff);
+    const glm::vec3& p1 = getPosition((packedTriangle >> 8) & 0xff);
+    const glm::vec3& p2 = getPosition((packedTriangle >> 16) & 0xff);
+
+    glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+    float area = glm::length(n);
+    if (area == 0.0f)
+      continue;
+
+    n /= area;
+    normals.push_back(n);
+    axis += n;
+  }
+
+  float axisLength = glm::length(axis);
+  float minDot = 1.0f;
+  if (axisLength > 0.0f) {
+    axis /= axisLength;
+    for (const glm::vec3& n : normals)
+      minDot = glm::min(minDot, glm::dot(axis, n));
+  } else {
+    minDot = -1.0f;
+  }
+
+  if (minDot < MIN_CONE_SPREAD) {
+    // Degenerate cone, never cull
+    meshlet.coneAxis = glm::vec3(0.0f);
+    meshlet.coneCutoff = 1.0f;
+    meshlet.coneApex = center;
+    return;
+  }
+
+  // Move the apex back along the axis until it is behind every triangle
+  // plane, so the cone test is conservative for any viewer position.
+  float maxT = 0.0f;
+  for (uint32_t t = 0, n = 0; t < meshlet.triangleCount; ++t) {
+    uint32_t packedTriangle = meshletData[meshlet.triangleOffset + t];
+    const glm::vec3& p0 = getPosition(packedTriangle & 0xff);
+    const glm::vec3& p1 = getPosition((packedTriangle >> 8) & 0xff);
+    const glm::vec3& p2 = getPosition((packedTriangle >> 16) & 0xff);
+    if (glm::length(glm::cross(p1 - p0, p2 - p0)) == 0.0f)
+      continue;
+
+    const glm::vec3& normal = normals[n++];
+    float dc = glm::dot(center - p0, normal);
+    float dn = glm::dot(axis, normal);
+    maxT = glm::max(maxT, dc / dn);
+  }
+
+  meshlet.coneAxis = axis;
+  meshlet.coneCutoff = glm::sqrt(1.0f - minDot * minDot);
+  meshlet.coneApex = center - axis * maxT;
+}
+
+/*static*/
+uint32_t MeshletUtilities::cullMeshlets(
+    gsl::span<const Meshlet> meshlets,
+    const glm::mat4& transform,
+    const Frustum& frustum,
+    const glm::vec3& cameraPosition,
+    std::vector<uint32_t>& visibleMeshlets) {
+  visibleMeshlets.clear();
+
+  glm::mat3 linear(transform);
+  float scale = glm::max(
+      glm::length(linear[0]),
+      glm::max(glm::length(linear[1]), glm::length(linear[2])));
+  // Mirroring transforms flip the winding, and non-uniform scale distorts the
+  // cone, in either case only the frustum test is applied.
+  bool useCone = glm::determinant(linear) > 0.0f &&
+                 glm::abs(glm::length(linear[0]) - scale) < 1e-3f * scale &&
+                 glm::abs(glm::length(linear[1]) - scale) < 1e-3f * scale &&
+                 glm::abs(glm::length(linear[2]) - scale) < 1e-3f * scale;
+
+  for (uint32_t i = 0; i < meshlets.size(); ++i) {
+    const Meshlet& meshlet = meshlets[i];
+
+    Meshlet worldMeshlet = meshlet;
+    worldMeshlet.center = glm::vec3(transform * glm::vec4(meshlet.center, 1.0f));
+    worldMeshlet.radius = meshlet.radius * scale;
+    if (useCone && meshlet.coneCutoff < 1.0f) {
+      worldMeshlet.coneAxis = linear * meshlet.coneAxis / scale;
+      worldMeshlet.coneApex =
+          glm::vec3(transform * glm::vec4(meshlet.coneApex, 1.0f));
+    } else {
+      worldMeshlet.coneCutoff = 1.0f;
+      worldMeshlet.coneAxis = glm::vec3(0.0f);
+    }
+
+    if (isMeshletVisible(worldMeshlet, frustum, cameraPosition))
+      visibleMeshlets.push_back(i);
+  }
+
+  return static_cast<uint32_t>(visibleMeshlets.size());
+}
+
+/*static*/
+bool MeshletUtilities::isMeshletVisible(
+    const Meshlet& meshlet,
+    const Frustum& frustum,
+    const glm::vec3& cameraPosition) {
+  if (!frustum.intersectsSphere(meshlet.center, meshlet.radius))
+    return false;
+
+  if (meshlet.coneCutoff >= 1.0f)
+    return true;
+
+  glm::vec3 apexDir = meshlet.coneApex - cameraPosition;
+  float apexDist = glm::length(apexDir);
+  if (apexDist == 0.0f)
+    return true;
+
+  return glm::dot(apexDir, meshlet.coneAxis) < meshlet.coneCutoff * apexDist;
+}
+} // namespace AltheaEngine
@@ -5,6 +5,11 @@
 #include "DescriptorSet.h"
 #include "FileAssetAccessor.h"
 #include "GraphicsPipeline.h"
+#include "JobGraph.h"
+#include "MappedFile.h"
+#include "ModelLoader.h"
+#include "PackFile.h"
+#include "PackFileSystem.h"
 #include "TaskProcessor.h"
 #include "Utilities.h"
 
@@ -16,17 +21,26 @@
 #include <vulkan/vulkan.h>
 
 #include <array>
+#include <exception>
 #include <filesystem>
 #include <memory>
+#include <optional>
+#include <stdexcept>
 
 namespace AltheaEngine {
+static CesiumAsync::AsyncSystem& getAsyncSystem() {
+  static CesiumAsync::AsyncSystem async(std::make_shared<TaskProcessor>());
+  return async;
+}
+
 static CesiumAsync::Future<CesiumGltfReader::GltfReaderResult>
 resolveExternalData(
     CesiumAsync::AsyncSystem asyncSystem,
     const std::string& baseUrl,
     std::shared_ptr<CesiumAsync::IAssetAccessor> pAssetAccessor,
     const CesiumGltfReader::GltfReaderOptions& options,
-    CesiumGltfReader::GltfReaderResult&& result) {
+    CesiumGltfReader::GltfReaderResult&& result,
+    const std::shared_ptr<ModelLoadHandle>& pHandle) {
 
   if (!result.model) {
     return asyncSystem.createResolvedFuture(std::move(result));
@@ -77,18 +91,20 @@ resolveExternalData(
                   basePath.parent_path().append(*buffer.uri).string(),
                   {})
               .thenInWorkerThread(
-                  [pBuffer = &buffer](
+                  [pBuffer = &buffer, pHandle](
                       std::shared_ptr<CesiumAsync::IAssetRequest>&& pRequest) {
                     const CesiumAsync::IAssetResponse* pResponse =
                         pRequest->response();
 
                     std::string bufferUri = *pBuffer->uri;
 
-                    if (pResponse) {
+                    if (pResponse && pResponse->statusCode() == 200) {
                       pBuffer->uri = std::nullopt;
                       pBuffer->cesium.data = std::vector<std::byte>(
                           pResponse->data().begin(),
                           pResponse->data().end());
+                      if (pHandle)
+                        pHandle->onExternalDataLoaded();
                       return ExternalBufferLoadResult{true, bufferUri};
                     }
 
@@ -107,14 +123,20 @@ resolveExternalData(
                   {})
               .thenInWorkerThread(
                   [pImage = &image,
-                   ktx2TranscodeTargets = options.ktx2TranscodeTargets](
+                   ktx2TranscodeTargets = options.ktx2TranscodeTargets,
+                   pHandle](
                       std::shared_ptr<CesiumAsync::IAssetRequest>&& pRequest) {
                     const CesiumAsync::IAssetResponse* pResponse =
                         pRequest->response();
 
                     std::string imageUri = *pImage->uri;
 
-                    if (pResponse) {
+                    // Decoding is the expensive part, skip it when the
+                    // model isn't wanted anymore
+                    if (pHandle && pHandle->isCancelled())
+                      return ExternalBufferLoadResult{false, imageUri};
+
+                    if (pResponse && pResponse->statusCode() == 200) {
                       pImage->uri = std::nullopt;
 
                       CesiumGltfReader::ImageReaderResult imageResult =
@@ -123,6 +145,8 @@ resolveExternalData(
                               ktx2TranscodeTargets);
                       if (imageResult.image) {
                         pImage->cesium = std::move(*imageResult.image);
+                        if (pHandle)
+                          pHandle->onExternalDataLoaded();
                         return ExternalBufferLoadResult{true, imageUri};
                       }
                     }
@@ -132,6 +156,11 @@ resolveExternalData(
     }
   }
 
+  if (pHandle) {
+    pHandle->addExternalDataCount(
+        static_cast<uint32_t>(resolvedBuffers.size()));
+  }
+
   return asyncSystem.all(std::move(resolvedBuffers))
       .thenInWorkerThread(
           [pResult = std::move(pResult)](
@@ -147,62 +176,36 @@ resolveExternalData(
           });
 }
 
+static CesiumGltf::Model readGltf(const std::string& path) {
+  CesiumGltfReader::GltfReaderResult result =
+      Model::readGltfAsync(path).wait();
+  if (!result.model)
+    return {};
+
+  return std::move(*result.model);
+}
+
 Model::Model(
-    const Application& app,
+    Application& app,
     SingleTimeCommandBuffer& commandBuffer,
     GlobalHeap& heap,
     const std::string& path,
     const glm::mat4& transform)
-    : _modelTransform(transform) {
-  // TODO: just for testing
-  static CesiumAsync::AsyncSystem async(std::make_shared<TaskProcessor>());
-
-  std::vector<char> modelFile = Utilities::readFile(path);
-
-  CesiumGltfReader::GltfReaderOptions options;
-  // TODO:
-  // options.ktx2TranscodeTargets ...
-  CesiumGltfReader::GltfReader reader;
-  CesiumGltfReader::GltfReaderResult result = reader.readGltf(
-      gsl::span<const std::byte>(
-          reinterpret_cast<const std::byte*>(modelFile.data()),
-          modelFile.size()),
-      options);
-
-  CesiumAsync::Future<CesiumGltfReader::GltfReaderResult> futureResult =
-      resolveExternalData(
-          async,
-          // this might not be a valid base url, may need to remove file name
-          path,
-          std::make_shared<FileAssetAccessor>(),
-          options,
-          std::move(result));
-
-  // All on main thread right now, but not safe in general.
-  result = futureResult.wait();
-
-  if (!result.model) {
-    return;
-  }
+    : Model(readGltf(path), transform) {
+  uint32_t stepCount = getUploadStepCount();
+  for (uint32_t stepIdx = 0; stepIdx < stepCount; ++stepIdx)
+    runUploadStep(stepIdx, app, commandBuffer, heap);
+}
 
-  this->_model = std::move(*result.model);
+Model::Model(CesiumGltf::Model&& gltfModel, const glm::mat4& transform)
+    : _model(std::move(gltfModel)), _modelTransform(transform) {
   // this->_model.generateMissingNormalsSmooth();
 
-  _nodes.resize(_model.nodes.size()); 
+  _nodes.resize(_model.nodes.size());
+  _nodeBounds.resize(_model.nodes.size(), AABB::createEmpty());
 
-  _skins.reserve(_model.skins.size());
+  // setup inverse bind matrices if applicable
   for (const CesiumGltf::Skin& gltfSkin : _model.skins) {
-    // joint maps are used to lookup node indices in order to fetch
-    // transforms
-    Skin& skin = _skins.emplace_back();
-    skin.jointMap = StructuredBuffer<uint32_t>(app, gltfSkin.joints.size());
-    for (uint32_t jointIdx = 0; jointIdx < gltfSkin.joints.size(); ++jointIdx) {
-      skin.jointMap.setElement(gltfSkin.joints[jointIdx], jointIdx);
-    }
-    skin.jointMap.upload(app, commandBuffer);
-    skin.jointMap.registerToHeap(heap);
-
-    // setup inverse bind matrices if applicable
     if (gltfSkin.inverseBindMatrices >= 0) {
       CesiumGltf::AccessorView<glm::mat4> inverseBindMatrices(
           _model,
@@ -220,95 +223,168 @@ Model::Model(
   // need to mark which textures are srgb
   // we need to infer this from whether they are referenced as base colors
   // or emissive textures from materials
-  bool* bIsSrgb = (bool*)alloca(sizeof(bool) * textureCount);
-  memset(bIsSrgb, 0, sizeof(bool) * textureCount);
+  _isTextureSrgb.resize(textureCount, false);
 
   for (const CesiumGltf::Material& material : _model.materials) {
     if (material.pbrMetallicRoughness) {
       if (material.pbrMetallicRoughness->baseColorTexture) {
         int texIndex = material.pbrMetallicRoughness->baseColorTexture->index;
         if (texIndex >= 0 && texIndex < textureCount)
-          bIsSrgb[texIndex] = true;
+          _isTextureSrgb[texIndex] = true;
       }
     }
 
     if (material.emissiveTexture) {
       int texIndex = material.emissiveTexture->index;
       if (texIndex >= 0 && texIndex < textureCount)
-        bIsSrgb[texIndex] = true;
+        _isTextureSrgb[texIndex] = true;
     }
   }
 
+  // Materials hold on to the textures and primitives hold on to the
+  // materials, neither may move once created
+  _skins.reserve(_model.skins.size());
   _textures.reserve(textureCount);
-  for (uint32_t texIdx = 0; texIdx < textureCount; ++texIdx) {
-    _textures.emplace_back(
-        app,
-        commandBuffer,
-        _model,
-        _model.textures[texIdx],
-        bIsSrgb[texIdx]);
-    _textures.back().registerToHeap(heap);
-  }
-
   _materials.reserve(_model.materials.size());
-  for (const CesiumGltf::Material& material : _model.materials) {
-    _materials
-        .emplace_back(app, commandBuffer, heap, _model, material, _textures);
-  }
 
-  // Sensible estimate of number of primitives that will be in the model
-  this->_primitives.reserve(this->_model.meshes.size());
+  // Nodes referencing the same mesh share its primitives, which are drawn
+  // instanced
+  std::unordered_map<uint64_t, uint32_t> meshLookup;
   if (this->_model.scene >= 0 &&
       this->_model.scene < this->_model.scenes.size()) {
     const CesiumGltf::Scene& scene = this->_model.scenes[this->_model.scene];
     for (int32_t nodeId : scene.nodes) {
       if (nodeId >= 0 && nodeId < this->_model.nodes.size()) {
-        this->_loadNode(app, commandBuffer, heap, nodeId, _modelTransform);
+        this->_loadNode(nodeId, _modelTransform, meshLookup);
       }
     }
   } else if (this->_model.scenes.size()) {
     const CesiumGltf::Scene& scene = this->_model.scenes[0];
     for (int32_t nodeId : scene.nodes) {
       if (nodeId >= 0 && nodeId < this->_model.nodes.size()) {
-        this->_loadNode(app, commandBuffer, heap, nodeId, _modelTransform);
+        this->_loadNode(nodeId, _modelTransform, meshLookup);
       }
     }
   } else if (this->_model.nodes.size()) {
-    this->_loadNode(app, commandBuffer, heap, 0, _modelTransform);
-  } else {
-    for (const CesiumGltf::Mesh& mesh : this->_model.meshes) {
-      for (const CesiumGltf::MeshPrimitive& primitive : mesh.primitives) {
-        this->_primitives.emplace_back(
-            app,
-            commandBuffer,
-            heap,
-            this->_model,
-            primitive,
-            _materials,
-            BufferHandle(),
-            0);
-      }
+    this->_loadNode(0, _modelTransform, meshLookup);
+  }
+
+  uint32_t instanceCount = 0;
+  for (Mesh& mesh : _meshes) {
+    mesh.firstInstance = instanceCount;
+    instanceCount += static_cast<uint32_t>(mesh.instanceNodes.size());
+  }
+
+  _buildPrimitiveGeometry();
+  this->_primitives.reserve(_primitiveGeometry.size());
+}
+
+/*static*/
+CesiumAsync::Future<CesiumGltfReader::GltfReaderResult> Model::readGltfAsync(
+    const std::string& path,
+    const std::shared_ptr<ModelLoadHandle>& pHandle) {
+  CesiumAsync::AsyncSystem& asyncSystem = getAsyncSystem();
+  return asyncSystem.runInWorkerThread([asyncSystem, path, pHandle]() {
+    if (pHandle && pHandle->isCancelled()) {
+      return asyncSystem.createResolvedFuture(
+          CesiumGltfReader::GltfReaderResult{});
+    }
+
+    // Parsed straight out of the mapping of the file, or of the pack
+    // containing it, so the binary chunk of a GLB is only copied once, into
+    // its buffer
+    std::optional<gsl::span<const std::byte>> modelBytes;
+    std::string packedName;
+    std::shared_ptr<const PackFile> pPackFile =
+        PackFileSystem::find(path, packedName);
+    FileBuffer unpackedModel;
+    if (pPackFile) {
+      modelBytes = pPackFile->view(packedName);
+      if (!modelBytes && pPackFile->read(packedName, unpackedModel))
+        modelBytes = unpackedModel.getBytes();
+    }
+
+    std::unique_ptr<MappedFile> pModelFile;
+    if (!modelBytes) {
+      pModelFile = MappedFile::open(path);
+      if (!pModelFile)
+        throw std::runtime_error("Failed to open file: " + path);
+      modelBytes = pModelFile->getBytes();
     }
+
+    CesiumGltfReader::GltfReaderOptions options;
+    // TODO:
+    // options.ktx2TranscodeTargets ...
+    CesiumGltfReader::GltfReader reader;
+    CesiumGltfReader::GltfReaderResult result =
+        reader.readGltf(*modelBytes, options);
+
+    return resolveExternalData(
+        asyncSystem,
+        // this might not be a valid base url, may need to remove file name
+        path,
+        std::make_shared<FileAssetAccessor>(),
+        options,
+        std::move(result),
+        pHandle);
+  });
+}
+
+uint32_t Model::getUploadStepCount() const {
+  // Skins, then each texture, then materials, then each mesh, then the
+  // node transforms
+  return 1 + static_cast<uint32_t>(_model.textures.size()) + 1 +
+         _getMeshStepCount() + 1;
+}
+
+void Model::runUploadStep(
+    uint32_t stepIdx,
+    Application& app,
+    SingleTimeCommandBuffer& commandBuffer,
+    GlobalHeap& heap) {
+  if (stepIdx == 0) {
+    _createSkins(app, commandBuffer, heap);
+    return;
   }
+  --stepIdx;
 
-  // init transforms buffer
-  _nodeTransforms =
-      DynamicVertexBuffer<glm::mat4>(app, glm::max(_nodes.size(), 1ull), true);
-  _nodeTransforms.registerToHeap(heap);
-  recomputeTransforms();
-  for (uint32_t ringBufferIdx = 0; ringBufferIdx < MAX_FRAMES_IN_FLIGHT;
-       ++ringBufferIdx) {
-    _nodeTransforms.upload(ringBufferIdx);
+  uint32_t textureCount = static_cast<uint32_t>(_model.textures.size());
+  if (stepIdx < textureCount) {
+    _textures.emplace_back(
+        app,
+        commandBuffer,
+        _model,
+        _model.textures[stepIdx],
+        _isTextureSrgb[stepIdx]);
+    _textures.back().registerToHeap(heap);
+    return;
   }
+  stepIdx -= textureCount;
+
+  if (stepIdx == 0) {
+    _createMaterials(app, commandBuffer, heap);
+    return;
+  }
+  --stepIdx;
+
+  if (stepIdx < _getMeshStepCount()) {
+    _createPrimitives(stepIdx, app, commandBuffer, heap);
+    return;
+  }
+
+  _createTransforms(app, heap);
 }
 
 void Model::recomputeTransforms() {
+  _bounds = AABB::createEmpty();
+
   if (this->_model.scene >= 0 &&
       this->_model.scene < this->_model.scenes.size()) {
     const CesiumGltf::Scene& scene = this->_model.scenes[this->_model.scene];
     for (int32_t nodeId : scene.nodes) {
       if (nodeId >= 0 && nodeId < this->_model.nodes.size()) {
         this->_updateTransforms(nodeId, _modelTransform);
+        _bounds.expand(_nodeBounds[nodeId]);
       }
     }
   } else if (this->_model.scenes.size()) {
@@ -316,14 +392,18 @@ void Model::recomputeTransforms() {
     for (int32_t nodeId : scene.nodes) {
       if (nodeId >= 0 && nodeId < this->_model.nodes.size()) {
         this->_updateTransforms(nodeId, _modelTransform);
+        _bounds.expand(_nodeBounds[nodeId]);
       }
     }
   } else if (this->_model.nodes.size()) {
     this->_updateTransforms(0, _modelTransform);
+    _bounds.expand(_nodeBounds[0]);
   }
 
   if (_nodes.size() == 0) {
     _nodeTransforms.setVertex(_modelTransform, 0);
+    for (const Primitive& primitive : _primitives)
+      _bounds.expand(primitive.computeWorldAABB(_modelTransform));
   }
 }
 
@@ -348,19 +428,25 @@ void Model::_updateTransforms(
 
   _nodeTransforms.setVertex(transform * node.inverseBindPose, nodeIdx);
 
+  AABB& bounds = _nodeBounds[nodeIdx];
+  if (node.meshIdx >= 0) {
+    bounds = _meshes[node.meshIdx].localBounds.transform(transform);
+  } else {
+    bounds = AABB::createEmpty();
+  }
+
   for (int32_t childNodeId : _model.nodes[nodeIdx].children) {
     if (childNodeId >= 0 && childNodeId < _nodes.size()) {
       _updateTransforms(childNodeId, transform);
+      bounds.expand(_nodeBounds[childNodeId]);
     }
   }
 }
 
 void Model::_loadNode(
-    const Application& app,
-    SingleTimeCommandBuffer& commandBuffer,
-    GlobalHeap& heap,
     int32_t nodeIdx,
-    const glm::mat4& parentTransform) {
+    const glm::mat4& parentTransform,
+    std::unordered_map<uint64_t, uint32_t>& meshLookup) {
   const CesiumGltf::Node& gltfNode = _model.nodes[nodeIdx];
   Node& node = _nodes[nodeIdx];
 
@@ -442,29 +528,176 @@ void Model::_loadNode(
   glm::mat4 nodeTransform = parentTransform * node.currentTransform;
 
   if (gltfNode.mesh >= 0 && gltfNode.mesh < _model.meshes.size()) {
-    const CesiumGltf::Mesh& gltfMesh = _model.meshes[gltfNode.mesh];
-    node.meshIdx = _meshes.size();
-    Mesh& mesh = _meshes.emplace_back();
-    mesh.primitiveStartIdx = this->_primitives.size();
-    mesh.primitiveCount = gltfMesh.primitives.size();
-    for (const CesiumGltf::MeshPrimitive& primitive : gltfMesh.primitives) {
+    uint64_t key = (static_cast<uint64_t>(gltfNode.mesh) << 32) |
+                   static_cast<uint32_t>(gltfNode.skin);
+    auto it = meshLookup.find(key);
+    if (it == meshLookup.end()) {
+      it = meshLookup.emplace(key, static_cast<uint32_t>(_meshes.size())).first;
+      Mesh& mesh = _meshes.emplace_back();
+      mesh.gltfMeshIdx = gltfNode.mesh;
+      mesh.skinIdx = gltfNode.skin;
+    }
+
+    node.meshIdx = it->second;
+    _meshes[it->second].instanceNodes.push_back(nodeIdx);
+  }
+
+  for (int32_t childNodeId : gltfNode.children) {
+    if (childNodeId >= 0 && childNodeId < _model.nodes.size()) {
+      this->_loadNode(childNodeId, nodeTransform, meshLookup);
+    }
+  }
+}
+
+bool Model::_hasNodes() const {
+  return !this->_model.scenes.empty() || !this->_model.nodes.empty();
+}
+
+uint32_t Model::_getMeshStepCount() const {
+  return static_cast<uint32_t>(
+      _hasNodes() ? _meshes.size() : _model.meshes.size());
+}
+
+const CesiumGltf::Mesh&
+Model::_getMeshStepGltfMesh(uint32_t meshIdx) const {
+  return _model.meshes[_hasNodes() ? _meshes[meshIdx].gltfMeshIdx : meshIdx];
+}
+
+void Model::_buildPrimitiveGeometry() {
+  std::vector<const CesiumGltf::MeshPrimitive*> primitives;
+  for (uint32_t meshIdx = 0; meshIdx < _getMeshStepCount(); ++meshIdx) {
+    for (const CesiumGltf::MeshPrimitive& primitive :
+         _getMeshStepGltfMesh(meshIdx).primitives)
+      primitives.push_back(&primitive);
+  }
+
+  // Jobs must not throw, the first failure is rethrown once all are done
+  _primitiveGeometry.resize(primitives.size());
+  std::vector<std::exception_ptr> errors(primitives.size());
+
+  JobGraph jobs;
+  jobs.addParallelFor(
+      "Build primitive geometry",
+      static_cast<uint32_t>(primitives.size()),
+      [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; ++i) {
+          try {
+            _primitiveGeometry[i] =
+                PrimitiveGeometry::build(_model, *primitives[i]);
+          } catch (...) {
+            errors[i] = std::current_exception();
+          }
+        }
+      });
+  jobs.execute();
+
+  for (const std::exception_ptr& pError : errors) {
+    if (pError)
+      std::rethrow_exception(pError);
+  }
+}
+
+void Model::_createSkins(
+    const Application& app,
+    SingleTimeCommandBuffer& commandBuffer,
+    GlobalHeap& heap) {
+  for (const CesiumGltf::Skin& gltfSkin : _model.skins) {
+    // joint maps are used to lookup node indices in order to fetch
+    // transforms
+    Skin& skin = _skins.emplace_back();
+    skin.jointMap = StructuredBuffer<uint32_t>(app, gltfSkin.joints.size());
+    for (uint32_t jointIdx = 0; jointIdx < gltfSkin.joints.size(); ++jointIdx) {
+      skin.jointMap.setElement(gltfSkin.joints[jointIdx], jointIdx);
+    }
+    skin.jointMap.upload(app, commandBuffer);
+    skin.jointMap.registerToHeap(heap);
+  }
+}
+
+void Model::_createMaterials(
+    const Application& app,
+    SingleTimeCommandBuffer& commandBuffer,
+    GlobalHeap& heap) {
+  for (const CesiumGltf::Material& material : _model.materials) {
+    _materials
+        .emplace_back(app, commandBuffer, heap, _model, material, _textures);
+  }
+
+  uint32_t instanceCount = 0;
+  for (const Mesh& mesh : _meshes)
+    instanceCount += static_cast<uint32_t>(mesh.instanceNodes.size());
+
+  if (instanceCount > _meshes.size()) {
+    // At least one mesh is instanced, upload the instance node lists
+    _instanceNodes = StructuredBuffer<uint32_t>(app, instanceCount);
+    for (const Mesh& mesh : _meshes) {
+      for (uint32_t i = 0; i < mesh.instanceNodes.size(); ++i) {
+        _instanceNodes.setElement(mesh.instanceNodes[i], mesh.firstInstance + i);
+      }
+    }
+    _instanceNodes.upload(app, commandBuffer);
+    _instanceNodes.registerToHeap(heap);
+  }
+}
+
+void Model::_createPrimitives(
+    uint32_t meshIdx,
+    Application& app,
+    SingleTimeCommandBuffer& commandBuffer,
+    GlobalHeap& heap) {
+  uint32_t primitiveCount =
+      static_cast<uint32_t>(_getMeshStepGltfMesh(meshIdx).primitives.size());
+  // The geometry is listed in the order the primitives are created
+  size_t geometryIdx = this->_primitives.size();
+
+  if (!_hasNodes()) {
+    for (uint32_t i = 0; i < primitiveCount; ++i) {
       this->_primitives.emplace_back(
           app,
           commandBuffer,
           heap,
-          this->_model,
-          primitive,
+          std::move(_primitiveGeometry[geometryIdx++]),
           _materials,
-          gltfNode.skin >= 0 ? getSkinJointMapHandle(gltfNode.skin)
-                             : BufferHandle(),
-          nodeIdx);
+          BufferHandle(),
+          0);
     }
+    return;
   }
 
-  for (int32_t childNodeId : gltfNode.children) {
-    if (childNodeId >= 0 && childNodeId < _model.nodes.size()) {
-      this->_loadNode(app, commandBuffer, heap, childNodeId, nodeTransform);
-    }
+  Mesh& mesh = _meshes[meshIdx];
+  mesh.primitiveStartIdx = this->_primitives.size();
+  mesh.primitiveCount = primitiveCount;
+  for (uint32_t i = 0; i < primitiveCount; ++i) {
+    this->_primitives.emplace_back(
+        app,
+        commandBuffer,
+        heap,
+        std::move(_primitiveGeometry[geometryIdx++]),
+        _materials,
+        mesh.skinIdx >= 0 ? getSkinJointMapHandle(mesh.skinIdx)
+                          : BufferHandle(),
+        mesh.instanceNodes[0],
+        mesh.instanceNodes.size() > 1 ? _instanceNodes.getHandle()
+                                      : BufferHandle(),
+        mesh.firstInstance,
+        mesh.instanceNodes);
+    mesh.localBounds.expand(this->_primitives.back().getAABB());
   }
 }
+
+void Model::_createTransforms(const Application& app, GlobalHeap& heap) {
+  // init transforms buffer
+  _nodeTransforms =
+      DynamicVertexBuffer<glm::mat4>(app, glm::max(_nodes.size(), 1ull), true);
+  _nodeTransforms.registerToHeap(heap);
+  recomputeTransforms();
+  for (uint32_t ringBufferIdx = 0; ringBufferIdx < MAX_FRAMES_IN_FLIGHT;
+       ++ringBufferIdx) {
+    _nodeTransforms.upload(ringBufferIdx);
+  }
+
+  // Only needed while creating the textures and primitives
+  _isTextureSrgb = {};
+  _primitiveGeometry = {};
+}
 } // namespace AltheaEngine
@@ -0,0 +1,201 @@
+#include "ModelLoader.h"
+
+#include "Application.h"
+#include "SingleTimeCommandBuffer.h"
+#include "UploadRing.h"
+
+#include <algorithm>
+#include <exception>
+
+namespace AltheaEngine {
+ModelLoadHandle::ModelLoadHandle(
+    const std::string& path,
+    const glm::mat4& transform)
+    : m_path(path), m_transform(transform) {}
+
+bool ModelLoadHandle::isDone() const {
+  ModelLoadState state = m_state;
+  return state == ModelLoadState::READY || state == ModelLoadState::FAILED ||
+         state == ModelLoadState::CANCELLED;
+}
+
+float ModelLoadHandle::getProgress() const {
+  switch (m_state) {
+  case ModelLoadState::LOADING: {
+    uint32_t count = m_externalDataCount;
+    if (count == 0)
+      return 0.0f;
+    // Fetches may finish before they have all been counted
+    uint32_t loaded = std::min<uint32_t>(m_externalDataLoaded, count);
+    return 0.5f * static_cast<float>(loaded) / static_cast<float>(count);
+  }
+  case ModelLoadState::UPLOADING: {
+    uint32_t count = m_uploadStepCount;
+    if (count == 0)
+      return 0.5f;
+    return 0.5f + 0.5f * static_cast<float>(m_uploadStepsDone) /
+                      static_cast<float>(count);
+  }
+  case ModelLoadState::READY:
+    return 1.0f;
+  default:
+    return 0.0f;
+  }
+}
+
+std::string ModelLoadHandle::getError() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_error;
+}
+
+std::unique_ptr<Model> ModelLoadHandle::takeModel() {
+  if (m_state != ModelLoadState::READY)
+    return nullptr;
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return std::move(m_pModel);
+}
+
+void ModelLoadHandle::_onParsed(std::unique_ptr<Model>&& pModel) {
+  uint32_t stepCount = pModel->getUploadStepCount();
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_pModel = std::move(pModel);
+  }
+
+  m_uploadStepCount = stepCount;
+
+  // The load may have been cancelled in the meantime
+  ModelLoadState expected = ModelLoadState::LOADING;
+  m_state.compare_exchange_strong(expected, ModelLoadState::UPLOADING);
+}
+
+void ModelLoadHandle::_fail(const std::string& error) {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_error = error;
+  }
+
+  ModelLoadState expected = ModelLoadState::LOADING;
+  m_state.compare_exchange_strong(expected, ModelLoadState::FAILED);
+}
+
+ModelLoader::~ModelLoader() {
+  // Lets the workers skip whatever they haven't started on yet
+  for (const std::shared_ptr<ModelLoadHandle>& pHandle : m_pending)
+    pHandle->cancel();
+}
+
+std::shared_ptr<ModelLoadHandle>
+ModelLoader::load(const std::string& path, const glm::mat4& transform) {
+  std::shared_ptr<ModelLoadHandle> pHandle =
+      std::make_shared<ModelLoadHandle>(path, transform);
+  m_pending.push_back(pHandle);
+
+  Model::readGltfAsync(path, pHandle)
+      .thenInWorkerThread(
+          [pHandle](CesiumGltfReader::GltfReaderResult&& result) {
+            if (pHandle->isCancelled())
+              return;
+
+            if (!result.model) {
+              std::string error = "Failed to load model " + pHandle->m_path;
+              for (const std::string& readerError : result.errors)
+                error += "\n" + readerError;
+              pHandle->_fail(error);
+              return;
+            }
+
+            pHandle->_onParsed(std::make_unique<Model>(
+                std::move(*result.model),
+                pHandle->m_transform));
+          })
+      .catchImmediately([pHandle](std::exception&& e) {
+        pHandle->_fail(
+            "Failed to load model " + pHandle->m_path + ": " + e.what());
+      });
+
+  return pHandle;
+}
+
+void ModelLoader::update(Application& app, GlobalHeap& heap) {
+  UploadRing& uploadRing = app.getUploadRing();
+
+  // Shared by all loads this frame, submitted once they are done recording
+  std::unique_ptr<SingleTimeCommandBuffer> pCommandBuffer;
+  std::vector<std::shared_ptr<ModelLoadHandle>> finished;
+  std::vector<std::shared_ptr<Model>> released;
+
+  auto hasCapacity = [&]() {
+    return uploadRing.hasCapacity(
+        pCommandBuffer ? pCommandBuffer->getStagingBytes() : 0);
+  };
+
+  for (auto it = m_pending.begin(); it != m_pending.end();) {
+    ModelLoadHandle& handle = **it;
+
+    if (handle.isCancelled()) {
+      handle.m_state = ModelLoadState::CANCELLED;
+      std::lock_guard<std::mutex> lock(handle.m_mutex);
+      if (handle.m_pModel)
+        released.push_back(std::move(handle.m_pModel));
+      it = m_pending.erase(it);
+      continue;
+    }
+
+    ModelLoadState state = handle.m_state;
+    if (state == ModelLoadState::FAILED) {
+      it = m_pending.erase(it);
+      continue;
+    }
+
+    if (state != ModelLoadState::UPLOADING || !hasCapacity()) {
+      ++it;
+      continue;
+    }
+
+    // The workers are done with the model, only this thread touches it now
+    Model& model = *handle.m_pModel;
+    uint32_t stepCount = handle.m_uploadStepCount;
+    uint32_t stepIdx = handle.m_uploadStepsDone;
+    try {
+      while (stepIdx < stepCount && hasCapacity()) {
+        if (!pCommandBuffer) {
+          pCommandBuffer =
+              std::make_unique<SingleTimeCommandBuffer>(app, uploadRing);
+        }
+
+        model.runUploadStep(stepIdx, app, *pCommandBuffer, heap);
+        handle.m_uploadStepsDone = ++stepIdx;
+      }
+    } catch (const std::exception& e) {
+      {
+        std::lock_guard<std::mutex> lock(handle.m_mutex);
+        handle.m_error =
+            "Failed to upload model " + handle.m_path + ": " + e.what();
+        released.push_back(std::move(handle.m_pModel));
+      }
+      handle.m_state = ModelLoadState::FAILED;
+      it = m_pending.erase(it);
+      continue;
+    }
+
+    if (stepIdx == stepCount) {
+      finished.push_back(std::move(*it));
+      it = m_pending.erase(it);
+    } else {
+      ++it;
+    }
+  }
+
+  // Submits everything recorded this frame
+  pCommandBuffer.reset();
+
+  // Resources of abandoned models may still be the target of uploads
+  for (std::shared_ptr<Model>& pModel : released)
+    uploadRing.releaseAfterUploads([pModel = std::move(pModel)]() {});
+
+  for (const std::shared_ptr<ModelLoadHandle>& pHandle : finished)
+    pHandle->m_state = ModelLoadState::READY;
+}
+} // namespace AltheaEngine
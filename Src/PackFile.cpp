@@ -0,0 +1,499 @@
+#include "PackFile.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+namespace AltheaEngine {
+namespace {
+// 'APAK'
+constexpr uint32_t PACK_FILE_MAGIC = 0x4B415041;
+constexpr uint32_t PACK_FILE_VERSION = 1;
+
+// Entries are aligned to cache lines, which also satisfies the alignment of
+// anything parsed in place out of the mapping
+constexpr uint64_t BLOB_ALIGNMENT = 64;
+
+// Compressed entries are only kept if they save at least this fraction of
+// their size, otherwise reading them in place is worth more
+constexpr uint64_t MIN_COMPRESSION_SAVINGS_DIVISOR = 8;
+
+struct PackFileHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t entryCount;
+  uint32_t namesSize;
+};
+
+uint64_t hashName(const char* pName, size_t length) {
+  // FNV-1a
+  uint64_t hash = 14695981039346656037ull;
+  for (size_t i = 0; i < length; ++i) {
+    hash ^= static_cast<uint8_t>(pName[i]);
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+uint64_t alignUp(uint64_t offset, uint64_t alignment) {
+  return (offset + alignment - 1) / alignment * alignment;
+}
+
+bool readWholeFile(const std::string& path, std::vector<char>& result) {
+  std::ifstream file(path, std::ios::ate | std::ios::binary);
+  if (!file.is_open())
+    return false;
+
+  size_t size = static_cast<size_t>(file.tellg());
+  result.resize(size);
+  file.seekg(0);
+  file.read(result.data(), size);
+  return file.good();
+}
+
+// A minimal LZ4 block format codec, see
+// https://github.com/lz4/lz4/blob/dev/doc/lz4_Block_format.md
+constexpr size_t LZ4_MIN_MATCH = 4;
+// The last 5 bytes are always literals and the last match starts at least
+// 12 bytes before the end of the block
+constexpr size_t LZ4_LAST_LITERALS = 5;
+constexpr size_t LZ4_MATCH_LIMIT = 12;
+constexpr size_t LZ4_MAX_OFFSET = 65535;
+// A block can't decompress to more than 255 times its compressed size, each
+// further 0xFF length byte adds at most 255 bytes of output
+constexpr uint64_t LZ4_MAX_EXPANSION = 255;
+constexpr uint32_t LZ4_HASH_BITS = 16;
+
+uint32_t read32(const char* pSrc) {
+  uint32_t value;
+  std::memcpy(&value, pSrc, sizeof(value));
+  return value;
+}
+
+void writeLz4Length(std::vector<char>& dst, size_t length) {
+  for (; length >= 255; length -= 255)
+    dst.push_back(static_cast<char>(255));
+  dst.push_back(static_cast<char>(length));
+}
+
+// Writes the literals, followed by the match unless this is the last
+// sequence of the block
+void writeLz4Sequence(
+    std::vector<char>& dst,
+    const char* pLiterals,
+    size_t literalCount,
+    size_t matchOffset,
+    size_t matchLength) {
+  size_t matchCode = matchLength ? matchLength - LZ4_MIN_MATCH : 0;
+  uint8_t token = static_cast<uint8_t>(
+      (std::min<size_t>(literalCount, 15) << 4) |
+      std::min<size_t>(matchCode, 15));
+  dst.push_back(static_cast<char>(token));
+  if (literalCount >= 15)
+    writeLz4Length(dst, literalCount - 15);
+  dst.insert(dst.end(), pLiterals, pLiterals + literalCount);
+
+  if (matchLength == 0)
+    return;
+
+  dst.push_back(static_cast<char>(matchOffset & 0xFF));
+  dst.push_back(static_cast<char>(matchOffset >> 8));
+  if (matchCode >= 15)
+    writeLz4Length(dst, matchCode - 15);
+}
+
+// Greedy single pass compression, fast enough for offline packing
+std::vector<char> compressLz4(const char* pSrc, size_t size) {
+  std::vector<char> dst;
+  dst.reserve(size);
+
+  std::vector<size_t> lastPositions(size_t(1) << LZ4_HASH_BITS, SIZE_MAX);
+  size_t anchor = 0;
+  size_t position = 0;
+  while (position + LZ4_MATCH_LIMIT <= size) {
+    uint32_t sequence = read32(pSrc + position);
+    uint32_t hash = (sequence * 2654435761u) >> (32 - LZ4_HASH_BITS);
+    size_t candidate = lastPositions[hash];
+    lastPositions[hash] = position;
+
+    if (candidate == SIZE_MAX || position - candidate > LZ4_MAX_OFFSET ||
+        read32(pSrc + candidate) != sequence) {
+      ++position;
+      continue;
+    }
+
+    size_t matchLength = LZ4_MIN_MATCH;
+    size_t matchEnd = size - LZ4_LAST_LITERALS;
+    while (position + matchLength < matchEnd &&
+           pSrc[candidate + matchLength] == pSrc[position + matchLength])
+      ++matchLength;
+
+    writeLz4Sequence(
+        dst,
+        pSrc + anchor,
+        position - anchor,
+        position - candidate,
+        matchLength);
+    position += matchLength;
+    anchor = position;
+  }
+
+  writeLz4Sequence(dst, pSrc + anchor, size - anchor, 0, 0);
+  return dst;
+}
+
+bool readLz4Length(
+    const uint8_t* pSrc,
+    size_t srcSize,
+    size_t& srcOffset,
+    size_t& length) {
+  uint8_t byte;
+  do {
+    if (srcOffset >= srcSize)
+      return false;
+    byte = pSrc[srcOffset++];
+    length += byte;
+  } while (byte == 255);
+  return true;
+}
+
+// Fails on malformed input rather than reading or writing out of bounds
+bool decompressLz4(
+    const char* pSrcChars,
+    size_t srcSize,
+    char* pDst,
+    size_t dstSize) {
+  const uint8_t* pSrc = reinterpret_cast<const uint8_t*>(pSrcChars);
+  size_t srcOffset = 0;
+  size_t dstOffset = 0;
+  while (srcOffset < srcSize) {
+    uint8_t token = pSrc[srcOffset++];
+
+    size_t literalCount = token >> 4;
+    if (literalCount == 15 &&
+        !readLz4Length(pSrc, srcSize, srcOffset, literalCount))
+      return false;
+    if (literalCount > srcSize - srcOffset ||
+        literalCount > dstSize - dstOffset)
+      return false;
+
+    std::memcpy(pDst + dstOffset, pSrc + srcOffset, literalCount);
+    srcOffset += literalCount;
+    dstOffset += literalCount;
+
+    // The last sequence has no match
+    if (srcOffset == srcSize)
+      break;
+
+    if (srcSize - srcOffset < 2)
+      return false;
+    size_t matchOffset = static_cast<size_t>(pSrc[srcOffset]) |
+                         (static_cast<size_t>(pSrc[srcOffset + 1]) << 8);
+    srcOffset += 2;
+    if (matchOffset == 0 || matchOffset > dstOffset)
+      return false;
+
+    size_t matchLength = token & 0xF;
+    if (matchLength == 15 &&
+        !readLz4Length(pSrc, srcSize, srcOffset, matchLength))
+      return false;
+    matchLength += LZ4_MIN_MATCH;
+    if (matchLength > dstSize - dstOffset)
+      return false;
+
+    // Matches may overlap the bytes they produce
+    char* pMatch = pDst + dstOffset - matchOffset;
+    if (matchOffset >= matchLength) {
+      std::memcpy(pDst + dstOffset, pMatch, matchLength);
+    } else {
+      for (size_t i = 0; i < matchLength; ++i)
+        pDst[dstOffset + i] = pMatch[i];
+    }
+    dstOffset += matchLength;
+  }
+
+  return dstOffset == dstSize;
+}
+} // namespace
+
+struct PackFile::IndexEntry {
+  uint64_t nameHash;
+  uint64_t nameOffset;
+  uint64_t dataOffset;
+  uint64_t storedSize;
+  uint64_t size;
+  uint32_t nameLength;
+  PackCompression compression;
+};
+
+/*static*/
+std::unique_ptr<PackFile> PackFile::open(const std::string& path) {
+  std::unique_ptr<PackFile> pPack(new PackFile());
+
+  pPack->m_pFile = MappedFile::open(path);
+  if (!pPack->m_pFile)
+    return nullptr;
+
+  if (!pPack->_validate()) {
+    std::cout << "Ignoring invalid pack file: " << path << "\n";
+    return nullptr;
+  }
+
+  return pPack;
+}
+
+/*static*/
+void PackFile::write(
+    const std::string& path,
+    const std::vector<Source>& sources,
+    PackCompression compression) {
+  std::vector<IndexEntry> entries(sources.size());
+  std::vector<const Source*> sortedSources(sources.size());
+  for (size_t i = 0; i < sources.size(); ++i)
+    sortedSources[i] = &sources[i];
+
+  auto compareSources = [](const Source* pA, const Source* pB) {
+    uint64_t hashA = hashName(pA->name.data(), pA->name.size());
+    uint64_t hashB = hashName(pB->name.data(), pB->name.size());
+    return hashA != hashB ? hashA < hashB : pA->name < pB->name;
+  };
+  std::sort(sortedSources.begin(), sortedSources.end(), compareSources);
+
+  std::string names;
+  for (size_t i = 0; i < sortedSources.size(); ++i) {
+    const std::string& name = sortedSources[i]->name;
+    if (name.empty())
+      throw std::runtime_error("Pack entries must have a name");
+    if (i > 0 && sortedSources[i - 1]->name == name)
+      throw std::runtime_error("Duplicate pack entry: \"" + name + "\"");
+
+    IndexEntry& entry = entries[i];
+    entry.nameHash = hashName(name.data(), name.size());
+    entry.nameOffset = names.size();
+    entry.nameLength = static_cast<uint32_t>(name.size());
+    names += name;
+  }
+
+  if (entries.size() > UINT32_MAX || names.size() > UINT32_MAX)
+    throw std::runtime_error("Too many entries for a single pack file");
+
+  PackFileHeader header{};
+  header.magic = PACK_FILE_MAGIC;
+  header.version = PACK_FILE_VERSION;
+  header.entryCount = static_cast<uint32_t>(entries.size());
+  header.namesSize = static_cast<uint32_t>(names.size());
+
+  uint64_t namesOffset =
+      sizeof(PackFileHeader) + entries.size() * sizeof(IndexEntry);
+  uint64_t blobsOffset = alignUp(namesOffset + names.size(), BLOB_ALIGNMENT);
+
+  std::filesystem::path packPath(path);
+  std::error_code errorCode;
+  if (packPath.has_parent_path())
+    std::filesystem::create_directories(packPath.parent_path(), errorCode);
+
+  // Mappings of the old pack stay valid after it is replaced
+  std::string tempPath = path + ".tmp";
+  std::string error;
+  {
+    std::ofstream file(tempPath, std::ios::out | std::ios::binary);
+    if (!file.is_open())
+      throw std::runtime_error("Failed to write pack file: " + path);
+
+    // The index is filled in once every entry has been written, the blobs
+    // are streamed one file at a time
+    std::vector<char> padding(BLOB_ALIGNMENT);
+    std::vector<char> data;
+    uint64_t offset = blobsOffset;
+    file.seekp(static_cast<std::streamoff>(offset));
+    for (size_t i = 0; i < sortedSources.size(); ++i) {
+      const Source& source = *sortedSources[i];
+      if (!readWholeFile(source.path, data)) {
+        error = "Failed to read file: " + source.path;
+        break;
+      }
+
+      IndexEntry& entry = entries[i];
+      entry.dataOffset = offset;
+      entry.size = data.size();
+      entry.storedSize = data.size();
+      entry.compression = PackCompression::NONE;
+
+      const std::vector<char>* pStored = &data;
+      std::vector<char> compressed;
+      if (compression == PackCompression::LZ4 && !data.empty()) {
+        compressed = compressLz4(data.data(), data.size());
+        if (compressed.size() <=
+            data.size() - data.size() / MIN_COMPRESSION_SAVINGS_DIVISOR) {
+          entry.storedSize = compressed.size();
+          entry.compression = PackCompression::LZ4;
+          pStored = &compressed;
+        }
+      }
+
+      file.write(pStored->data(), pStored->size());
+      offset += pStored->size();
+
+      uint64_t alignedOffset = alignUp(offset, BLOB_ALIGNMENT);
+      file.write(padding.data(), alignedOffset - offset);
+      offset = alignedOffset;
+    }
+
+    file.seekp(0);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(
+        reinterpret_cast<const char*>(entries.data()),
+        entries.size() * sizeof(IndexEntry));
+    file.write(names.data(), names.size());
+    file.write(padding.data(), blobsOffset - namesOffset - names.size());
+    if (error.empty() && !file.good())
+      error = "Failed to write pack file: " + path;
+  }
+
+  if (!error.empty()) {
+    std::filesystem::remove(tempPath, errorCode);
+    throw std::runtime_error(error);
+  }
+
+  std::filesystem::rename(tempPath, path, errorCode);
+  if (errorCode) {
+    std::filesystem::remove(tempPath, errorCode);
+    throw std::runtime_error("Failed to write pack file: " + path);
+  }
+}
+
+bool PackFile::contains(const std::string& name) const {
+  return _find(name) != nullptr;
+}
+
+std::optional<gsl::span<const std::byte>>
+PackFile::view(const std::string& name) const {
+  const IndexEntry* pEntry = _find(name);
+  if (!pEntry || pEntry->compression != PackCompression::NONE)
+    return std::nullopt;
+
+  return gsl::span<const std::byte>(
+      reinterpret_cast<const std::byte*>(
+          m_pFile->getData() + pEntry->dataOffset),
+      static_cast<size_t>(pEntry->size));
+}
+
+bool PackFile::read(const std::string& name, std::vector<char>& result) const {
+  const IndexEntry* pEntry = _find(name);
+  if (!pEntry)
+    return false;
+
+  result.resize(static_cast<size_t>(pEntry->size));
+  return _extract(*pEntry, result.data());
+}
+
+bool PackFile::read(const std::string& name, FileBuffer& result) const {
+  const IndexEntry* pEntry = _find(name);
+  if (!pEntry)
+    return false;
+
+  result = FileBufferPool::acquire(static_cast<size_t>(pEntry->size));
+  return _extract(*pEntry, result.getData());
+}
+
+bool PackFile::_validate() {
+  const char* pData = m_pFile->getData();
+  uint64_t size = m_pFile->getSize();
+
+  PackFileHeader header;
+  if (size < sizeof(header))
+    return false;
+
+  std::memcpy(&header, pData, sizeof(header));
+  if (header.magic != PACK_FILE_MAGIC || header.version != PACK_FILE_VERSION)
+    return false;
+
+  uint64_t namesOffset = sizeof(header) +
+                         static_cast<uint64_t>(header.entryCount) *
+                             sizeof(IndexEntry);
+  if (namesOffset > size || header.namesSize > size - namesOffset)
+    return false;
+
+  // The header is a multiple of the entry alignment
+  m_pEntries = reinterpret_cast<const IndexEntry*>(pData + sizeof(header));
+  m_entryCount = header.entryCount;
+  m_pNames = pData + namesOffset;
+  m_namesSize = header.namesSize;
+
+  // Checked once up front, so lookups can trust the index
+  for (uint32_t i = 0; i < m_entryCount; ++i) {
+    const IndexEntry& entry = m_pEntries[i];
+    if (entry.nameOffset > m_namesSize ||
+        entry.nameLength > m_namesSize - entry.nameOffset ||
+        entry.dataOffset > size || entry.storedSize > size - entry.dataOffset)
+      return false;
+
+    if (entry.nameHash !=
+        hashName(m_pNames + entry.nameOffset, entry.nameLength))
+      return false;
+    if (i > 0 && m_pEntries[i - 1].nameHash > entry.nameHash)
+      return false;
+
+    if (entry.compression == PackCompression::NONE) {
+      if (entry.storedSize != entry.size)
+        return false;
+    } else if (entry.compression == PackCompression::LZ4) {
+      // Otherwise a corrupt index could make reads allocate arbitrarily much
+      if (entry.size / LZ4_MAX_EXPANSION > entry.storedSize)
+        return false;
+    } else {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+const PackFile::IndexEntry*
+PackFile::_find(const std::string& name) const {
+  uint64_t hash = hashName(name.data(), name.size());
+  const IndexEntry* pEnd = m_pEntries + m_entryCount;
+  const IndexEntry* pEntry = std::lower_bound(
+      m_pEntries,
+      pEnd,
+      hash,
+      [](const IndexEntry& entry, uint64_t value) {
+        return entry.nameHash < value;
+      });
+
+  // Names whose hashes collide are adjacent
+  for (; pEntry != pEnd && pEntry->nameHash == hash; ++pEntry) {
+    if (pEntry->nameLength == name.size() &&
+        std::memcmp(
+            m_pNames + pEntry->nameOffset,
+            name.data(),
+            name.size()) == 0)
+      return pEntry;
+  }
+
+  return nullptr;
+}
+
+bool PackFile::_extract(const IndexEntry& entry, char* pDst) const {
+  const char* pStored = m_pFile->getData() + entry.dataOffset;
+  size_t storedSize = static_cast<size_t>(entry.storedSize);
+  size_t size = static_cast<size_t>(entry.size);
+
+  // Empty entries have nothing to copy, and pDst may be null
+  if (size == 0)
+    return true;
+
+  switch (entry.compression) {
+  case PackCompression::NONE:
+    std::memcpy(pDst, pStored, size);
+    return true;
+  case PackCompression::LZ4:
+    return decompressLz4(pStored, storedSize, pDst, size);
+  default:
+    return false;
+  }
+}
+} // namespace AltheaEngine
@@ -0,0 +1,114 @@
+#include "PackFileSystem.h"
+
+#include "PackFile.h"
+
+#include <filesystem>
+#include <mutex>
+#include <system_error>
+
+namespace AltheaEngine {
+namespace {
+struct PackMount {
+  std::string packPath;
+  // Normalized, always ends with a '/'
+  std::string directory;
+  std::shared_ptr<const PackFile> pPack;
+};
+
+std::mutex s_mountMutex;
+std::vector<PackMount> s_mounts;
+
+// Absolute and with '/' separators, so the same file is always spelled the
+// same way
+std::string normalizePath(const std::string& path) {
+  std::error_code errorCode;
+  std::filesystem::path absolutePath =
+      std::filesystem::absolute(std::filesystem::path(path), errorCode);
+  if (errorCode)
+    return path;
+  return absolutePath.lexically_normal().generic_string();
+}
+} // namespace
+
+/*static*/
+bool PackFileSystem::mount(
+    const std::string& packPath,
+    const std::string& directory) {
+  std::unique_ptr<PackFile> pPack = PackFile::open(packPath);
+  if (!pPack)
+    return false;
+
+  PackMount mount;
+  mount.packPath = packPath;
+  mount.directory = normalizePath(directory);
+  if (mount.directory.empty() || mount.directory.back() != '/')
+    mount.directory += '/';
+  mount.pPack = std::move(pPack);
+
+  std::lock_guard<std::mutex> lock(s_mountMutex);
+  s_mounts.push_back(std::move(mount));
+  return true;
+}
+
+/*static*/
+void PackFileSystem::unmount(const std::string& packPath) {
+  std::lock_guard<std::mutex> lock(s_mountMutex);
+  for (auto it = s_mounts.begin(); it != s_mounts.end();) {
+    if (it->packPath == packPath)
+      it = s_mounts.erase(it);
+    else
+      ++it;
+  }
+}
+
+/*static*/
+void PackFileSystem::unmountAll() {
+  std::lock_guard<std::mutex> lock(s_mountMutex);
+  s_mounts.clear();
+}
+
+/*static*/
+std::shared_ptr<const PackFile>
+PackFileSystem::find(const std::string& path, std::string& name) {
+  std::lock_guard<std::mutex> lock(s_mountMutex);
+  if (s_mounts.empty())
+    return nullptr;
+
+  std::string normalizedPath = normalizePath(path);
+  for (auto it = s_mounts.rbegin(); it != s_mounts.rend(); ++it) {
+    const std::string& directory = it->directory;
+    if (normalizedPath.compare(0, directory.size(), directory) != 0)
+      continue;
+
+    std::string packedName = normalizedPath.substr(directory.size());
+    if (it->pPack->contains(packedName)) {
+      name = std::move(packedName);
+      return it->pPack;
+    }
+  }
+
+  return nullptr;
+}
+
+/*static*/
+bool PackFileSystem::contains(const std::string& path) {
+  std::string name;
+  return find(path, name) != nullptr;
+}
+
+/*static*/
+bool PackFileSystem::readFile(
+    const std::string& path,
+    std::vector<char>& result) {
+  std::string name;
+  std::shared_ptr<const PackFile> pPack = find(path, name);
+  return pPack && pPack->read(name, result);
+}
+
+/*static*/
+bool PackFileSystem::readFile(const std::string& path, FileBuffer& result) {
+  std::string name;
+  std::shared_ptr<const PackFile> pPack = find(path, name);
+  return pPack && pPack->read(name, result);
+}
+} // namespace AltheaEngine
@@ -0,0 +1,120 @@
+#include "ParallelCommandRecorder.h"
+
+#include "Application.h"
+#include "ThreadPool.h"
+
+#include <stdexcept>
+
+namespace AltheaEngine {
+ParallelCommandRecorder::ParallelCommandRecorder(const Application& app)
+    : m_device(app.getDevice()),
+      m_queueFamilyIndex(
+          app.findQueueFamilies(app.getPhysicalDevice())
+              .graphicsFamily.value()) {}
+
+ParallelCommandRecorder::~ParallelCommandRecorder() {
+  // Destroying the pools frees their command buffers as well
+  for (Worker& worker : m_workers) {
+    for (WorkerPool& workerPool : worker) {
+      if (workerPool.pool != VK_NULL_HANDLE)
+        vkDestroyCommandPool(m_device, workerPool.pool, nullptr);
+    }
+  }
+}
+
+void ParallelCommandRecorder::beginFrame(const FrameContext& frame) {
+  for (Worker& worker : m_workers) {
+    WorkerPool& workerPool = worker[frame.frameRingBufferIndex];
+    if (workerPool.usedCount == 0)
+      continue;
+
+    vkResetCommandPool(m_device, workerPool.pool, 0);
+    workerPool.usedCount = 0;
+  }
+}
+
+void ParallelCommandRecorder::reserveWorkers(uint32_t workerCount) {
+  while (m_workers.size() < workerCount) {
+    Worker& worker = m_workers.emplace_back();
+    for (WorkerPool& workerPool : worker) {
+      VkCommandPoolCreateInfo poolInfo{};
+      poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+      // The whole pool is reset each frame, so command buffers are never
+      // reset individually
+      poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+      poolInfo.queueFamilyIndex = m_queueFamilyIndex;
+
+      if (vkCreateCommandPool(
+              m_device,
+              &poolInfo,
+              nullptr,
+              &workerPool.pool) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create worker command pool!");
+      }
+    }
+  }
+}
+
+VkCommandBuffer ParallelCommandRecorder::beginSecondary(
+    uint32_t workerIdx,
+    const FrameContext& frame,
+    VkRenderPass renderPass,
+    uint32_t subpass,
+    VkFramebuffer frameBuffer) {
+  if (workerIdx >= m_workers.size()) {
+    throw std::runtime_error(
+        "Attempting to record with a worker slot that was not reserved.");
+  }
+
+  WorkerPool& workerPool = m_workers[workerIdx][frame.frameRingBufferIndex];
+  if (workerPool.usedCount == workerPool.commandBuffers.size()) {
+    VkCommandBufferAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.commandPool = workerPool.pool;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+    allocInfo.commandBufferCount = 1;
+
+    VkCommandBuffer commandBuffer;
+    if (vkAllocateCommandBuffers(m_device, &allocInfo, &commandBuffer) !=
+        VK_SUCCESS) {
+      throw std::runtime_error("Failed to allocate secondary command buffer!");
+    }
+
+    workerPool.commandBuffers.push_back(commandBuffer);
+  }
+
+  VkCommandBuffer commandBuffer =
+      workerPool.commandBuffers[workerPool.usedCount++];
+
+  VkCommandBufferInheritanceInfo inheritanceInfo{};
+  inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+  inheritanceInfo.renderPass = renderPass;
+  inheritanceInfo.subpass = subpass;
+  inheritanceInfo.framebuffer = frameBuffer;
+
+  VkCommandBufferBeginInfo beginInfo{};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT |
+                    VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+  beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+  if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+    throw std::runtime_error(
+        "Failed to begin recording secondary command buffer!");
+  }
+
+  return commandBuffer;
+}
+
+void ParallelCommandRecorder::endSecondary(VkCommandBuffer commandBuffer) {
+  if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to record secondary command buffer!");
+  }
+}
+
+/*static*/
+uint32_t ParallelCommandRecorder::getDefaultWorkerCount() {
+  // Every worker of the shared pool, along with the recording thread
+  return ThreadPool::getShared().getThreadCount() + 1;
+}
+} // namespace AltheaEngine
@@ -0,0 +1,157 @@
+#include "PipelineCache.h"
+
+#include "Utilities.h"
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+namespace AltheaEngine {
+namespace {
+// 'APLC'
+constexpr uint32_t PIPELINE_CACHE_MAGIC = 0x434c5041;
+constexpr uint32_t PIPELINE_CACHE_VERSION = 1;
+
+struct PipelineCacheFileHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t dataSize;
+  uint64_t dataHash;
+};
+
+uint64_t hashData(const char* pData, size_t size) {
+  // FNV-1a
+  uint64_t hash = 14695981039346656037ull;
+  for (size_t i = 0; i < size; ++i) {
+    hash ^= static_cast<uint8_t>(pData[i]);
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+bool isCacheDataCompatible(
+    const char* pData,
+    size_t size,
+    const VkPhysicalDeviceProperties& properties) {
+  VkPipelineCacheHeaderVersionOne header;
+  if (size < sizeof(header))
+    return false;
+
+  std::memcpy(&header, pData, sizeof(header));
+  return header.headerSize >= sizeof(header) &&
+         header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+         header.vendorID == properties.vendorID &&
+         header.deviceID == properties.deviceID &&
+         std::memcmp(
+             header.pipelineCacheUUID,
+             properties.pipelineCacheUUID,
+             VK_UUID_SIZE) == 0;
+}
+} // namespace
+
+PipelineCache::PipelineCache(
+    VkDevice device,
+    const VkPhysicalDeviceProperties& properties,
+    const std::string& path)
+    : m_device(device), m_properties(properties), m_path(path) {
+  std::vector<char> fileData;
+  if (Utilities::checkFileExists(m_path))
+    fileData = Utilities::readFile(m_path);
+
+  const char* pInitialData = nullptr;
+  size_t initialDataSize = 0;
+
+  PipelineCacheFileHeader fileHeader{};
+  if (fileData.size() >= sizeof(fileHeader)) {
+    std::memcpy(&fileHeader, fileData.data(), sizeof(fileHeader));
+
+    const char* pData = fileData.data() + sizeof(fileHeader);
+    size_t dataSize = fileData.size() - sizeof(fileHeader);
+    if (fileHeader.magic == PIPELINE_CACHE_MAGIC &&
+        fileHeader.version == PIPELINE_CACHE_VERSION &&
+        fileHeader.dataSize == dataSize &&
+        fileHeader.dataHash == hashData(pData, dataSize) &&
+        isCacheDataCompatible(pData, dataSize, m_properties)) {
+      pInitialData = pData;
+      initialDataSize = dataSize;
+    } else {
+      std::cout << "Discarding stale or invalid pipeline cache: " << m_path
+                << "\n";
+    }
+  }
+
+  VkPipelineCacheCreateInfo createInfo{};
+  createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+  createInfo.initialDataSize = initialDataSize;
+  createInfo.pInitialData = pInitialData;
+
+  if (vkCreatePipelineCache(m_device, &createInfo, nullptr, &m_pipelineCache) !=
+      VK_SUCCESS) {
+    // The driver may still reject data that passed validation, retry empty
+    createInfo.initialDataSize = 0;
+    createInfo.pInitialData = nullptr;
+    initialDataSize = 0;
+    if (vkCreatePipelineCache(
+            m_device,
+            &createInfo,
+            nullptr,
+            &m_pipelineCache) != VK_SUCCESS) {
+      throw std::runtime_error("Failed to create pipeline cache!");
+    }
+  }
+
+  m_loadedFromDisk = initialDataSize > 0;
+}
+
+PipelineCache::~PipelineCache() {
+  if (m_pipelineCache != VK_NULL_HANDLE)
+    vkDestroyPipelineCache(m_device, m_pipelineCache, nullptr);
+}
+
+bool PipelineCache::save() const {
+  size_t dataSize = 0;
+  if (vkGetPipelineCacheData(m_device, m_pipelineCache, &dataSize, nullptr) !=
+      VK_SUCCESS)
+    return false;
+
+  std::vector<char> fileData(sizeof(PipelineCacheFileHeader) + dataSize);
+  char* pData = fileData.data() + sizeof(PipelineCacheFileHeader);
+  if (vkGetPipelineCacheData(m_device, m_pipelineCache, &dataSize, pData) !=
+      VK_SUCCESS)
+    return false;
+
+  // The cache may have shrunk between the two calls
+  fileData.resize(sizeof(PipelineCacheFileHeader) + dataSize);
+
+  PipelineCacheFileHeader fileHeader{};
+  fileHeader.magic = PIPELINE_CACHE_MAGIC;
+  fileHeader.version = PIPELINE_CACHE_VERSION;
+  fileHeader.dataSize = dataSize;
+  fileHeader.dataHash = hashData(pData, dataSize);
+  std::memcpy(fileData.data(), &fileHeader, sizeof(fileHeader));
+
+  std::error_code errorCode;
+  std::filesystem::path path(m_path);
+  if (path.has_parent_path())
+    std::filesystem::create_directories(path.parent_path(), errorCode);
+
+  // Write next to the destination, then swap the new file in
+  std::string tempPath = m_path + ".tmp";
+  {
+    std::ofstream file(tempPath, std::ios::out | std::ios::binary);
+    if (!file.is_open())
+      return false;
+
+    file.write(fileData.data(), fileData.size());
+    if (!file.good())
+      return false;
+  }
+
+  std::filesystem::rename(tempPath, m_path, errorCode);
+  return !errorCode;
+}
+} // namespace AltheaEngine
@@ -2,9 +2,70 @@
 
 #include "Application.h"
 
+#include <algorithm>
 #include <stdexcept>
 
 namespace AltheaEngine {
+namespace {
+std::string getStageNames(VkShaderStageFlags stageFlags) {
+  static const std::pair<VkShaderStageFlagBits, const char*> stageNames[] = {
+      {VK_SHADER_STAGE_VERTEX_BIT, "vertex"},
+      {VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT, "tessellation control"},
+      {VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT, "tessellation evaluation"},
+      {VK_SHADER_STAGE_GEOMETRY_BIT, "geometry"},
+      {VK_SHADER_STAGE_FRAGMENT_BIT, "fragment"},
+      {VK_SHADER_STAGE_COMPUTE_BIT, "compute"},
+      {VK_SHADER_STAGE_RAYGEN_BIT_KHR, "ray gen"},
+      {VK_SHADER_STAGE_ANY_HIT_BIT_KHR, "any hit"},
+      {VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR, "closest hit"},
+      {VK_SHADER_STAGE_MISS_BIT_KHR, "miss"},
+      {VK_SHADER_STAGE_INTERSECTION_BIT_KHR, "intersection"},
+      {VK_SHADER_STAGE_CALLABLE_BIT_KHR, "callable"}};
+
+  std::string names;
+  for (const auto& stageName : stageNames) {
+    if (stageFlags & stageName.first) {
+      if (!names.empty())
+        names += ", ";
+      names += stageName.second;
+    }
+  }
+
+  return names;
+}
+
+// SPIR-V block sizes end at the last member, while sizeof() of the C++ struct
+// includes its tail padding
+bool blockSizesMatch(uint32_t shaderSize, uint32_t cppSize) {
+  return cppSize >= shaderSize && cppSize - shaderSize < 16;
+}
+
+std::vector<VkPushConstantRange>
+createReflectedPushConstantRanges(const ShaderReflection& reflection) {
+  // A single range visible to every stage that uses push constants
+  std::vector<VkPushConstantRange> ranges;
+  for (const ReflectedPushConstants& pushConstants :
+       reflection.getPushConstants()) {
+    if (ranges.empty()) {
+      VkPushConstantRange& range = ranges.emplace_back();
+      range.offset = pushConstants.offset;
+      range.size = pushConstants.size;
+      range.stageFlags = pushConstants.stageFlags;
+      continue;
+    }
+
+    VkPushConstantRange& range = ranges.back();
+    uint32_t end = std::max(
+        range.offset + range.size,
+        pushConstants.offset + pushConstants.size);
+    range.offset = std::min(range.offset, pushConstants.offset);
+    range.size = end - range.offset;
+    range.stageFlags |= pushConstants.stageFlags;
+  }
+
+  return ranges;
+}
+} // namespace
 
 PipelineLayoutBuilder& PipelineLayoutBuilder::addDescriptorSet(
     VkDescriptorSetLayout descriptorSetLayout) {
@@ -12,35 +73,96 @@ PipelineLayoutBuilder& PipelineLayoutBuilder::addDescriptorSet(
   return *this;
 }
 
+PipelineLayoutBuilder& PipelineLayoutBuilder::reflectPushConstants() {
+  this->_reflectPushConstants = true;
+  return *this;
+}
+
 PipelineLayout::PipelineLayout(
     const Application& app,
     const PipelineLayoutBuilder& builder)
+    : PipelineLayout(app, builder, ShaderReflection()) {}
+
+PipelineLayout::PipelineLayout(
+    const Application& app,
+    const PipelineLayoutBuilder& builder,
+    const ShaderReflection& reflection)
     : _pushConstantRanges(builder._pushConstantRanges) {
-  VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-  pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-  pipelineLayoutInfo.setLayoutCount =
-      static_cast<uint32_t>(builder._descriptorSetLayouts.size());
-  pipelineLayoutInfo.pSetLayouts = builder._descriptorSetLayouts.data();
-  pipelineLayoutInfo.pushConstantRangeCount =
-      static_cast<uint32_t>(builder._pushConstantRanges.size());
-  pipelineLayoutInfo.pPushConstantRanges = builder._pushConstantRanges.data();
-
-  VkDevice device = app.getDevice();
-  VkPipelineLayout pipelineLayout;
-  if (vkCreatePipelineLayout(
-          device,
-          &pipelineLayoutInfo,
-          nullptr,
-          &pipelineLayout) != VK_SUCCESS) {
-    throw std::runtime_error("Failed to create pipeline layout!");
+  if (builder._reflectPushConstants) {
+    if (!this->_pushConstantRanges.empty()) {
+      throw std::runtime_error(
+          "Cannot both declare and reflect push constants in a pipeline "
+          "layout!");
+    }
+
+    this->_pushConstantRanges = createReflectedPushConstantRanges(reflection);
   }
 
-  this->_layout.set(device, pipelineLayout);
-}
+  std::string errors;
+
+  for (const ReflectedPushConstants& pushConstants :
+       reflection.getPushConstants()) {
+    uint32_t declaredEnd = 0;
+    for (const VkPushConstantRange& range : this->_pushConstantRanges) {
+      if (range.stageFlags & pushConstants.stageFlags)
+        declaredEnd = std::max(declaredEnd, range.offset + range.size);
+    }
+
+    uint32_t blockEnd = pushConstants.offset + pushConstants.size;
+    // With a single C++ push constant struct, its size must match the block
+    // exactly, otherwise the two have drifted apart
+    bool mismatch = this->_pushConstantRanges.size() == 1
+                        ? !blockSizesMatch(blockEnd, declaredEnd)
+                        : blockEnd > declaredEnd;
+    if (mismatch) {
+      errors += "Push constant block \"" + pushConstants.name + "\" in the " +
+                getStageNames(pushConstants.stageFlags) + " stage is " +
+                std::to_string(blockEnd) + " bytes, but the layout declares " +
+                std::to_string(declaredEnd) + " bytes for that stage.\n";
+    }
+  }
+
+  uint32_t setCount = reflection.getDescriptorSetCount();
+  if (setCount > builder._descriptorSetLayouts.size()) {
+    errors += "Shaders use " + std::to_string(setCount) +
+              " descriptor sets, but the layout only declares " +
+              std::to_string(builder._descriptorSetLayouts.size()) + ".\n";
+  }
+
+  for (const PipelineLayoutBuilder::ExpectedBlock& expected :
+       builder._expectedBlocks) {
+    const ReflectedBinding* pBinding =
+        reflection.findBinding(expected.set, expected.binding);
+    // The block may be unused by these shaders
+    if (!pBinding)
+      continue;
+
+    // Array strides already include padding, so those must match exactly
+    uint32_t reflectedSize = expected.runtimeArrayElement
+                                 ? pBinding->runtimeArrayStride
+                                 : pBinding->blockSize;
+    bool match = expected.runtimeArrayElement
+                     ? reflectedSize == expected.size
+                     : blockSizesMatch(reflectedSize, expected.size);
+    if (!match) {
+      std::string description = expected.runtimeArrayElement
+                                    ? "Array elements of buffer block \""
+                                    : "Buffer block \"";
+      errors += description + pBinding->name + "\" (set " +
+                std::to_string(expected.set) + ", binding " +
+                std::to_string(expected.binding) + ") are " +
+                std::to_string(reflectedSize) + " bytes in the shader, but " +
+                std::to_string(expected.size) + " bytes in C++.\n";
+    }
+  }
+
+  if (!errors.empty()) {
+    throw std::runtime_error(
+        "Pipeline layout does not match its shaders:\n" + errors);
+  }
 
-void PipelineLayout::PipelineLayoutDeleter::operator()(
-    VkDevice device,
-    VkPipelineLayout pipelineLayout) {
-  vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+  this->_layout = app.getLayoutCache().getPipelineLayout(
+      builder._descriptorSetLayouts,
+      this->_pushConstantRanges);
 }
-} // namespace AltheaEngine
\ No newline at end of file
+} // namespace AltheaEngine
@@ -2,10 +2,13 @@
 
 #include "Application.h"
 #include "Camera.h"
+#include "Frustum.h"
 #include "Primitive.h"
 
 #include <glm/gtc/constants.hpp>
+#include <glm/gtc/matrix_transform.hpp>
 
+#include <algorithm>
 #include <memory>
 
 namespace AltheaEngine {
@@ -18,8 +21,42 @@ struct ShadowMapPushConstants {
   uint32_t globalResourcesHandle;
   uint32_t pointLightsHandle;
   uint32_t constantsHandle;
+  uint32_t faceMask;
 };
 
+// Must match the far plane of the scene capture camera and the shadow map
+// shaders
+#define SHADOW_MAP_FAR_PLANE 1000.0f
+
+// Lights are considered to not affect surfaces where their inverse-square
+// attenuated emission falls below this.
+#define LIGHT_EMISSION_CUTOFF 0.001f
+
+#define ALL_CUBE_FACES 0x3f
+
+// Shadow passes with at least this many draw packets are recorded in
+// parallel with secondary command buffers
+#define PARALLEL_SHADOW_PACKET_COUNT 2048
+
+bool intersectsSphere(const AABB& aabb, const glm::vec3& center, float radius) {
+  glm::vec3 closest = glm::clamp(center, aabb.min, aabb.max);
+  glm::vec3 diff = closest - center;
+  return glm::dot(diff, diff) <= radius * radius;
+}
+
+// FNV-1a
+void hashBytes(uint64_t& hash, const void* pData, size_t size) {
+  const uint8_t* pBytes = reinterpret_cast<const uint8_t*>(pData);
+  for (size_t i = 0; i < size; ++i) {
+    hash ^= pBytes[i];
+    hash *= 1099511628211ull;
+  }
+}
+
+template <typename T> void hashValue(uint64_t& hash, const T& value) {
+  hashBytes(hash, &value, sizeof(T));
+}
+
 struct LightMeshPushConstants {
   uint32_t globalUniformsHandle;
   uint32_t lightBufferHandle;
@@ -49,6 +86,8 @@ PointLightCollection::PointLightCollection(
   this->_buffer.registerToHeap(heap);
   this->_lights.resize(lightCount);
 
+  this->_lightClusters = LightClusters(app, heap);
+
   if (createShadowMap) {
     // Create shadow map resources
     // TODO: Configure shadowmap resolution
@@ -70,7 +109,7 @@ PointLightCollection::PointLightCollection(
 
     {
       // TODO: Configure near / far plane, does it matter??
-      Camera sceneCaptureCamera(90.0f, 1.0f, 0.01f, 1000.0f);
+      Camera sceneCaptureCamera(90.0f, 1.0f, 0.01f, SHADOW_MAP_FAR_PLANE);
 
       PointLightConstants pointLightConstants{};
       pointLightConstants.projection = sceneCaptureCamera.getProjection();
@@ -173,6 +212,8 @@ PointLightCollection::PointLightCollection(
         std::move(attachments),
         std::move(subpassBuilders));
 
+    this->_shadowMapHashes.resize(lightCount);
+
     this->_shadowFrameBuffers.resize(lightCount);
     for (size_t i = 0; i < lightCount; ++i) {
       this->_shadowFrameBuffers[i] = FrameBuffer(
@@ -202,6 +243,33 @@ void PointLightCollection::updateResource(const FrameContext& frame) {
   this->_dirty = false;
 }
 
+void PointLightCollection::buildLightClusters(
+    const FrameContext& frame,
+    const Camera& camera) {
+  this->_lightClusters.build(frame, camera, *this);
+  this->_lightClustersBuilt = true;
+}
+
+void PointLightCollection::dispatchLightClusters(
+    VkCommandBuffer commandBuffer,
+    GlobalHeap& heap,
+    const FrameContext& frame,
+    const Camera& camera) {
+  this->_lightClusters.dispatch(commandBuffer, heap, frame, camera, *this);
+  this->_lightClustersBuilt = true;
+}
+
+void PointLightCollection::setGlobalUniforms(
+    const FrameContext& frame,
+    GlobalUniforms& uniforms) const {
+  uniforms.lightCount = static_cast<int>(this->_lights.size());
+  uniforms.lightBufferHandle = getCurrentLightBufferHandle(frame).index;
+  uniforms.lightClusterGridHandle =
+      this->_lightClustersBuilt
+          ? this->_lightClusters.getGridHandle(frame).index
+          : INVALID_BINDLESS_HANDLE;
+}
+
 void PointLightCollection::setupPointLightMeshSubpass(
     SubpassBuilder& subpassBuilder,
     uint32_t colorAttachment,
@@ -232,6 +300,13 @@ void PointLightCollection::setupPointLightMeshSubpass(
       .addPushConstants<LightMeshPushConstants>(VK_SHADER_STAGE_ALL);
 }
 
+/*static*/
+float PointLightCollection::computeLightRadius(const PointLight& light) {
+  float maxEmission =
+      glm::max(light.emission.x, glm::max(light.emission.y, light.emission.z));
+  return glm::sqrt(glm::max(maxEmission, 0.0f) / LIGHT_EMISSION_CUTOFF);
+}
+
 void PointLightCollection::drawShadowMaps(
     Application& app,
     VkCommandBuffer commandBuffer,
@@ -239,46 +314,256 @@ void PointLightCollection::drawShadowMaps(
     const std::vector<Model>& models,
     VkDescriptorSet globalSet,
     BufferHandle globalResources) {
-
-  // Shadow passes
-  this->_shadowMap.transitionToAttachment(commandBuffer);
-
   ShadowMapPushConstants constants{};
   constants.globalResourcesHandle = globalResources.index;
   constants.pointLightsHandle =
       this->_buffer.getCurrentBufferHandle(frame.frameRingBufferIndex).index;
   constants.constantsHandle = this->_pointLightConstants.getHandle().index;
 
+  const PointLightConstants& lightConstants =
+      this->_pointLightConstants.getConstants();
+  float lodScale = Primitive::computeLodScale(
+      lightConstants.projection,
+      this->_shadowMap.getExtent().height);
+
+  // Skinned primitives are deformed by joints, which may not be reflected in
+  // their node transform or bounds. Those are never culled, and a light they
+  // reach is re-rendered whenever any transform of their model changes.
+  std::vector<uint64_t> modelTransformHashes(models.size(), 0);
+  std::vector<PrimitiveInstanceRef> skinnedPrimitives;
+
+  // The hierarchy over every primitive instance is refit to the current
+  // transforms, and only rebuilt when the models' primitives change
+  std::vector<uint32_t> layout;
+  for (uint32_t modelIdx = 0; modelIdx < models.size(); ++modelIdx) {
+    const std::vector<Primitive>& primitives = models[modelIdx].getPrimitives();
+    layout.push_back(static_cast<uint32_t>(primitives.size()));
+    for (uint32_t primIdx = 0; primIdx < primitives.size(); ++primIdx) {
+      const Primitive& primitive = primitives[primIdx];
+      layout.push_back(primitive.getInstanceCount());
+      if (!primitive.isSkinned())
+        continue;
+
+      skinnedPrimitives.push_back({modelIdx, primIdx, 0});
+      if (modelTransformHashes[modelIdx] == 0) {
+        const std::vector<glm::mat4>& transforms =
+            models[modelIdx].getTransformsBuffer().getVertices();
+        uint64_t hash = 14695981039346656037ull;
+        hashBytes(
+            hash,
+            transforms.data(),
+            transforms.size() * sizeof(glm::mat4));
+        modelTransformHashes[modelIdx] = hash;
+      }
+    }
+  }
+
+  if (layout != this->_shadowCasterLayout) {
+    this->_shadowCasterBVH.build(models);
+    this->_shadowCasterLayout = std::move(layout);
+  } else {
+    this->_shadowCasterBVH.refit(models);
+  }
+  this->_itemFaceMasks.assign(this->_shadowCasterBVH.getItemCount(), 0);
+
+  this->_renderedShadowMapCount = 0;
+  this->_shadowDrawList.resetStats();
+  bool transitioned = false;
+
   for (uint32_t i = 0; i < this->_lights.size(); ++i) {
     const PointLight& light = this->_lights[i];
+    // Primitives beyond the light's radius are not drawn into its shadow map
+    float radius =
+        glm::min(computeLightRadius(light), SHADOW_MAP_FAR_PLANE);
+
+    uint64_t hash = 14695981039346656037ull;
+    hashValue(hash, light.position);
+    hashValue(hash, radius);
+
+    this->_shadowCasters.clear();
+    for (const PrimitiveInstanceRef& ref : skinnedPrimitives) {
+      const Model& model = models[ref.modelIdx];
+      const Primitive& primitive = model.getPrimitives()[ref.primitiveIdx];
+      const std::vector<glm::mat4>& transforms =
+          model.getTransformsBuffer().getVertices();
+      uint32_t lodIdx = primitive.getLodCount() - 1;
+      for (uint32_t instanceNodeIdx : primitive.getInstanceNodes()) {
+        lodIdx = std::min(
+            lodIdx,
+            primitive.selectLod(
+                transforms[instanceNodeIdx],
+                light.position,
+                lodScale));
+      }
+
+      hashValue(hash, modelTransformHashes[ref.modelIdx]);
+      hashValue(hash, primitive.getConstantBufferHandle().index);
+      hashValue(hash, lodIdx);
+
+      this->_shadowCasters.push_back(
+          {&primitive,
+           model.getTransformsHandle(frame),
+           lodIdx,
+           ALL_CUBE_FACES,
+           0.0f});
+    }
+
+    // Cull each cube face through the hierarchy, with the far plane pulled in
+    // to the light's radius, so only the instances near the light are visited
+    glm::mat4 cullProjection =
+        Camera(90.0f, 1.0f, 0.01f, radius).getProjection();
+    glm::mat4 lightTranslation =
+        glm::translate(glm::mat4(1.0f), -light.position);
+    this->_casterItems.clear();
+    for (uint32_t face = 0; face < 6; ++face) {
+      Frustum faceFrustum = Frustum::fromViewProjection(
+          cullProjection * lightConstants.views[face] * lightTranslation);
+      this->_shadowCasterBVH.cullFrustum(faceFrustum, this->_visibleItems);
+      for (uint32_t itemIdx : this->_visibleItems) {
+        if (this->_itemFaceMasks[itemIdx] == 0)
+          this->_casterItems.push_back(itemIdx);
+        this->_itemFaceMasks[itemIdx] |= 1 << face;
+      }
+    }
+
+    // Items are numbered in model, primitive and instance order, so sorting
+    // groups the instances of each primitive and keeps the hash stable
+    std::sort(this->_casterItems.begin(), this->_casterItems.end());
+
+    for (size_t itemBegin = 0; itemBegin < this->_casterItems.size();) {
+      const PrimitiveInstanceRef& first =
+          this->_shadowCasterBVH.getInstance(this->_casterItems[itemBegin]);
+      const Model& model = models[first.modelIdx];
+      const Primitive& primitive = model.getPrimitives()[first.primitiveIdx];
+      const std::vector<glm::mat4>& transforms =
+          model.getTransformsBuffer().getVertices();
+
+      // All instances are drawn with the same LOD and face mask, use the
+      // finest LOD and union of faces any instance needs
+      uint32_t faceMask = 0;
+      uint32_t lodIdx = primitive.getLodCount() - 1;
+      float depth = 1.0f;
+
+      size_t itemEnd = itemBegin;
+      for (; itemEnd < this->_casterItems.size(); ++itemEnd) {
+        uint32_t itemIdx = this->_casterItems[itemEnd];
+        const PrimitiveInstanceRef& instance =
+            this->_shadowCasterBVH.getInstance(itemIdx);
+        if (instance.modelIdx != first.modelIdx ||
+            instance.primitiveIdx != first.primitiveIdx)
+          break;
+
+        uint32_t instanceFaceMask = this->_itemFaceMasks[itemIdx];
+        this->_itemFaceMasks[itemIdx] = 0;
+
+        // Already drawn into every face above
+        if (primitive.isSkinned())
+          continue;
+
+        AABB bounds = this->_shadowCasterBVH.getItemBounds(itemIdx);
+        if (!intersectsSphere(bounds, light.position, radius))
+          continue;
+
+        const glm::mat4& transform =
+            transforms[primitive.getInstanceNodes()[instance.instanceIdx]];
+        hashValue(hash, transform);
+
+        glm::vec3 closest = glm::clamp(light.position, bounds.min, bounds.max);
+        depth =
+            glm::min(depth, glm::length(closest - light.position) / radius);
+
+        faceMask |= instanceFaceMask;
+        lodIdx = std::min(
+            lodIdx,
+            primitive.selectLod(transform, light.position, lodScale));
+      }
+
+      itemBegin = itemEnd;
+
+      if (faceMask == 0)
+        continue;
+
+      hashValue(hash, primitive.getConstantBufferHandle().index);
+      hashValue(hash, lodIdx);
+      hashValue(hash, faceMask);
+
+      this->_shadowCasters.push_back(
+          {&primitive,
+           model.getTransformsHandle(frame),
+           lodIdx,
+           faceMask,
+           depth});
+    }
+
+    // Reuse the shadow map if nothing that affects it has changed
+    if (this->_shadowCacheValid && this->_shadowMapHashes[i] == hash)
+      continue;
+
+    this->_shadowMapHashes[i] = hash;
+    ++this->_renderedShadowMapCount;
+
+    // Shadow passes
+    if (!transitioned) {
+      this->_shadowMap.transitionToAttachment(commandBuffer);
+      transitioned = true;
+    }
+
     constants.lightIdx = i;
 
+    // Draw shadow casters sorted by material and front face, then front to
+    // back, so redundant state changes can be skipped
+    this->_shadowDrawList.clear();
+    for (const ShadowCaster& caster : this->_shadowCasters) {
+      const Primitive& primitive = *caster.pPrimitive;
+      constants.matrixBufferHandle = caster.transformsHandle.index;
+      constants.primitiveConstantsHandle =
+          primitive.getConstantBufferHandle().index;
+      constants.faceMask = caster.faceMask;
+
+      uint64_t sortKey = DrawList::makeSortKey(
+          0,
+          primitive.getConstants().materialHandle,
+          primitive.getFrontFace(),
+          caster.depth);
+      this->_shadowDrawList.addPrimitive(
+          sortKey,
+          primitive,
+          caster.lodIdx,
+          constants);
+    }
+
+    this->_shadowDrawList.sort();
+
+    // Large caster lists are split across workers, each recording a
+    // secondary command buffer
+    bool recordParallel =
+        this->_shadowDrawList.getPacketCount() >= PARALLEL_SHADOW_PACKET_COUNT;
+
     ActiveRenderPass pass = this->_shadowPass.begin(
         app,
         commandBuffer,
         frame,
-        this->_shadowFrameBuffers[i]);
+        this->_shadowFrameBuffers[i],
+        recordParallel ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS
+                       : VK_SUBPASS_CONTENTS_INLINE);
 
     pass.setGlobalDescriptorSets(gsl::span(&globalSet, 1));
-    pass.getDrawContext().bindDescriptorSets();
-
-    // Draw models
-    for (const Model& model : models) {
-      constants.matrixBufferHandle = model.getTransformsHandle(frame).index;
-      for (const Primitive& primitive : model.getPrimitives()) {
-        constants.primitiveConstantsHandle =
-            primitive.getConstantBufferHandle().index;
-
-        pass.getDrawContext().setFrontFaceDynamic(primitive.getFrontFace());
-        pass.getDrawContext().updatePushConstants(constants, 0);
-        pass.getDrawContext().drawIndexed(
-            primitive.getVertexBuffer(),
-            primitive.getIndexBuffer());
-      }
+
+    if (recordParallel) {
+      this->_shadowDrawList.recordParallel(
+          pass,
+          app.getParallelCommandRecorder(),
+          ParallelCommandRecorder::getDefaultWorkerCount());
+    } else {
+      pass.getDrawContext().bindDescriptorSets();
+      this->_shadowDrawList.record(pass.getDrawContext());
     }
   }
 
-  this->_shadowMap.transitionToTexture(commandBuffer);
+  this->_shadowCacheValid = true;
+
+  if (transitioned)
+    this->_shadowMap.transitionToTexture(commandBuffer);
 }
 
 void PointLightCollection::draw(
@@ -5,6 +5,7 @@
 #include "DescriptorSet.h"
 #include "GeometryUtilities.h"
 #include "GraphicsPipeline.h"
+#include "JobGraph.h"
 #include "ModelViewProjection.h"
 #include "Utilities.h"
 
@@ -16,9 +17,59 @@
 #include <CesiumGltf/TextureInfo.h>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include <algorithm>
+#include <limits>
 #include <string>
 
 namespace AltheaEngine {
+/*static*/
+AABB AABB::createEmpty() {
+  AABB aabb;
+  aabb.min = glm::vec3(std::numeric_limits<float>::max());
+  aabb.max = glm::vec3(std::numeric_limits<float>::lowest());
+  return aabb;
+}
+
+AABB AABB::transform(const glm::mat4& transform) const {
+  if (isEmpty())
+    return *this;
+
+  // Start from the translation and add the extremes of each rotated and
+  // scaled axis separately
+  AABB result;
+  result.min = result.max = glm::vec3(transform[3]);
+
+  for (int col = 0; col < 3; ++col) {
+    for (int row = 0; row < 3; ++row) {
+      float a = transform[col][row] * this->min[col];
+      float b = transform[col][row] * this->max[col];
+      result.min[row] += glm::min(a, b);
+      result.max[row] += glm::max(a, b);
+    }
+  }
+
+  return result;
+}
+
+static PrimitiveLodSettings s_lodSettings{};
+
+/*static*/
+void Primitive::setLodSettings(const PrimitiveLodSettings& settings) {
+  s_lodSettings = settings;
+}
+
+/*static*/
+const PrimitiveLodSettings& Primitive::getLodSettings() {
+  return s_lodSettings;
+}
+
+/*static*/
+float Primitive::computeLodScale(
+    const glm::mat4& projection,
+    uint32_t viewportHeight) {
+  return 0.5f * static_cast<float>(viewportHeight) * glm::abs(projection[1][1]);
+}
+
 /*static*/
 void Primitive::buildPipeline(GraphicsPipelineBuilder& builder) {
   builder.setPrimitiveType(PrimitiveType::TRIANGLES)
@@ -365,96 +416,305 @@ private:
 };
 } // namespace
 
-Primitive::Primitive(
-    const Application& app,
-    SingleTimeCommandBuffer& commandBuffer,
-    GlobalHeap& heap,
+/*static*/
+PrimitiveGeometry PrimitiveGeometry::build(
     const CesiumGltf::Model& model,
-    const CesiumGltf::MeshPrimitive& primitive,
-    const std::vector<Material>& materialMap,
-    BufferHandle jointMapHandle,
-    uint32_t nodeIdx)
-    : 
-      // TODO:
-      // glm::determinant(glm::mat3(nodeTransform)) < 0.0f
-      m_flipFrontFace(false) {
+    const CesiumGltf::MeshPrimitive& primitive) {
+  PrimitiveGeometry geometry;
 
   // If the normal map exists, we might need its UV coordinates for
   // tangent-space generation later.
-  uint32_t normalMapUvIndex = 0; 
-
-  PrimitiveConstants constants{};
-
-  constants.jointMapHandle = jointMapHandle.index;
-  constants.nodeIdx = nodeIdx;
-
-   if (primitive.material >= 0 && primitive.material < model.materials.size()) {
-    constants.materialHandle = materialMap[primitive.material].getHandle().index;
-    normalMapUvIndex = materialMap[primitive.material].getNormalTextureCoordinateIndex();
-   }
-   else
-   {
-    // TODO - setup default material...
-    constants.materialHandle = INVALID_BINDLESS_HANDLE;
-   }
+  uint32_t normalMapUvIndex = 0;
+  if (primitive.material >= 0 && primitive.material < model.materials.size()) {
+    geometry.materialIdx = primitive.material;
 
+    const CesiumGltf::Material& material = model.materials[primitive.material];
+    if (material.normalTexture)
+      normalMapUvIndex = material.normalTexture->texCoord;
+  }
 
   VertexBufferBuilder vbBuilder(model, primitive, normalMapUvIndex);
   if (vbBuilder.failed) {
     throw std::runtime_error(
         "Failed to create glTF vertex buffer for primitive!");
-    return;
   }
 
-  std::vector<Vertex> vertices = std::move(vbBuilder.vertices);
-  std::vector<uint32_t> indices = std::move(vbBuilder.indices);
+  std::vector<Vertex>& vertices = geometry.vertices;
+  std::vector<uint32_t>& indices = geometry.indices;
+  vertices = std::move(vbBuilder.vertices);
+  indices = std::move(vbBuilder.indices);
+
+  geometry.isSkinned = vbBuilder.isSkinned;
 
-  constants.isSkinned = vbBuilder.isSkinned;
-  
   // Compute AABB
   if (vertices.size() > 0) {
-    m_aabb.min = m_aabb.max = vertices[0].position;
+    geometry.aabb.min = geometry.aabb.max = vertices[0].position;
     for (size_t i = 1; i < vertices.size(); ++i) {
-      m_aabb.min = glm::min(m_aabb.min, vertices[i].position);
-      m_aabb.max = glm::max(m_aabb.max, vertices[i].position);
+      geometry.aabb.min = glm::min(geometry.aabb.min, vertices[i].position);
+      geometry.aabb.max = glm::max(geometry.aabb.max, vertices[i].position);
     }
   } else {
     throw std::runtime_error(
         "Attempting to create a primitive with no vertices!");
   }
 
-  m_vertexBuffer = VertexBuffer(app, commandBuffer, std::move(vertices));
-  m_vertexBuffer.registerToHeap(heap);
-  constants.vertexBufferHandle = m_vertexBuffer.getHandle().index;
+  // Meshlets and LODs are both built from the full-detail mesh, so they are
+  // built side by side
+  JobGraph jobs;
+  jobs.addJob("Build meshlets", [&]() {
+    MeshletUtilities::buildMeshlets(
+        vertices,
+        indices,
+        geometry.meshlets,
+        geometry.meshletData);
+  });
+
+  std::vector<uint32_t> lodIndices;
+  if (s_lodSettings.lodCount > 0 &&
+      indices.size() / 3 >= s_lodSettings.minTriangleCount) {
+    jobs.addJob("Generate LODs", [&]() {
+      geometry.lods = MeshSimplification::generateLods(
+          vertices,
+          indices,
+          s_lodSettings.lodCount,
+          s_lodSettings.reductionPerLod,
+          s_lodSettings.maxError,
+          lodIndices);
+    });
+  }
 
-  m_indexBuffer = IndexBuffer(app, commandBuffer, std::move(indices));
-  m_indexBuffer.registerToHeap(heap);
-  constants.indexBufferHandle = m_indexBuffer.getHandle().index;
+  jobs.execute();
+
+  // Pack the full-detail indices, LOD indices and meshlet data into a single
+  // range of the shared index buffer.
+  uint32_t lodStart = static_cast<uint32_t>(indices.size());
+  geometry.meshletDataStart =
+      lodStart + static_cast<uint32_t>(lodIndices.size());
+
+  std::vector<uint32_t>& packedIndices = geometry.packedIndices;
+  packedIndices.reserve(
+      geometry.meshletDataStart + geometry.meshletData.size());
+  packedIndices.insert(packedIndices.end(), indices.begin(), indices.end());
+  packedIndices.insert(
+      packedIndices.end(),
+      lodIndices.begin(),
+      lodIndices.end());
+  packedIndices.insert(
+      packedIndices.end(),
+      geometry.meshletData.begin(),
+      geometry.meshletData.end());
+
+  for (MeshLod& lod : geometry.lods)
+    lod.firstIndex += lodStart;
+
+  return geometry;
+}
+
+Primitive::Primitive(
+    Application& app,
+    SingleTimeCommandBuffer& commandBuffer,
+    GlobalHeap& heap,
+    PrimitiveGeometry&& geometry,
+    const std::vector<Material>& materialMap,
+    BufferHandle jointMapHandle,
+    uint32_t nodeIdx,
+    BufferHandle instanceNodesHandle,
+    uint32_t firstInstance,
+    gsl::span<const uint32_t> instanceNodes)
+    : 
+      // TODO:
+      // glm::determinant(glm::mat3(nodeTransform)) < 0.0f
+      m_flipFrontFace(false),
+      m_vertices(std::move(geometry.vertices)),
+      m_indices(std::move(geometry.indices)),
+      m_lods(std::move(geometry.lods)),
+      m_meshlets(std::move(geometry.meshlets)),
+      m_meshletData(std::move(geometry.meshletData)),
+      m_aabb(geometry.aabb) {
+  PrimitiveConstants constants{};
+
+  constants.jointMapHandle = jointMapHandle.index;
+  constants.nodeIdx = nodeIdx;
+
+  if (instanceNodes.empty()) {
+    m_instanceNodes.push_back(nodeIdx);
+  } else {
+    m_instanceNodes.assign(instanceNodes.begin(), instanceNodes.end());
+  }
+
+  constants.instanceNodesHandle = instanceNodesHandle.index;
+  constants.firstInstance = firstInstance;
+  constants.instanceCount = static_cast<uint32_t>(m_instanceNodes.size());
+
+  if (geometry.materialIdx >= 0 &&
+      geometry.materialIdx < materialMap.size()) {
+    constants.materialHandle =
+        materialMap[geometry.materialIdx].getHandle().index;
+  } else {
+    // TODO - setup default material...
+    constants.materialHandle = INVALID_BINDLESS_HANDLE;
+  }
+
+  constants.isSkinned = geometry.isSkinned;
+
+  GeometryArena& arena = heap.getGeometryArena();
+
+  m_vertexAllocation = GeometryAllocation(
+      app,
+      arena.getVertexPool(),
+      arena.getVertexPool().allocate(
+          app,
+          commandBuffer,
+          heap,
+          gsl::as_bytes(gsl::span<const Vertex>(m_vertices))));
+  constants.vertexBufferHandle = m_vertexAllocation.getHandle().index;
+  constants.vertexOffset = m_vertexAllocation.getOffset();
+
+  m_indexAllocation = GeometryAllocation(
+      app,
+      arena.getIndexPool(),
+      arena.getIndexPool().allocate(
+          app,
+          commandBuffer,
+          heap,
+          gsl::as_bytes(gsl::span<const uint32_t>(geometry.packedIndices))));
+  constants.indexBufferHandle = m_indexAllocation.getHandle().index;
+  constants.firstIndex = m_indexAllocation.getOffset();
+  constants.indexCount = static_cast<uint32_t>(m_indices.size());
+
+  if (!m_meshlets.empty()) {
+    // The GPU copy of the meshlets addresses the meshlet data within the
+    // shared index buffer
+    uint32_t meshletDataOffset =
+        m_indexAllocation.getOffset() + geometry.meshletDataStart;
+    std::vector<Meshlet> gpuMeshlets = m_meshlets;
+    for (Meshlet& meshlet : gpuMeshlets) {
+      meshlet.vertexOffset += meshletDataOffset;
+      meshlet.triangleOffset += meshletDataOffset;
+    }
+
+    m_meshletAllocation = GeometryAllocation(
+        app,
+        arena.getMeshletPool(),
+        arena.getMeshletPool().allocate(
+            app,
+            commandBuffer,
+            heap,
+            gsl::as_bytes(gsl::span<const Meshlet>(gpuMeshlets))));
+    constants.meshletBufferHandle = m_meshletAllocation.getHandle().index;
+    constants.meshletOffset = m_meshletAllocation.getOffset();
+    constants.meshletCount = static_cast<uint32_t>(m_meshlets.size());
+  } else {
+    constants.meshletBufferHandle = INVALID_BINDLESS_HANDLE;
+    constants.meshletOffset = 0;
+    constants.meshletCount = 0;
+  }
 
   m_constantBuffer = ConstantBuffer<PrimitiveConstants>(app, commandBuffer, constants);
   m_constantBuffer.registerToHeap(heap);
 }
 
-AABB Primitive::computeWorldAABB() const {
-  const std::vector<Vertex>& vertices = m_vertexBuffer.getVertices();
-
-  if (vertices.empty())
-    throw std::runtime_error(
-        "Attempting to compute world AABB with empty vertices");
+Primitive::Primitive(
+    Application& app,
+    SingleTimeCommandBuffer& commandBuffer,
+    GlobalHeap& heap,
+    const CesiumGltf::Model& model,
+    const CesiumGltf::MeshPrimitive& primitive,
+    const std::vector<Material>& materialMap,
+    BufferHandle jointMapHandle,
+    uint32_t nodeIdx,
+    BufferHandle instanceNodesHandle,
+    uint32_t firstInstance,
+    gsl::span<const uint32_t> instanceNodes)
+    : Primitive(
+          app,
+          commandBuffer,
+          heap,
+          PrimitiveGeometry::build(model, primitive),
+          materialMap,
+          jointMapHandle,
+          nodeIdx,
+          instanceNodesHandle,
+          firstInstance,
+          instanceNodes) {}
+
+MeshLod Primitive::getLod(uint32_t lodIdx) const {
+  MeshLod lod{};
+  if (lodIdx == 0 || m_lods.empty()) {
+    lod.indexCount = static_cast<uint32_t>(m_indices.size());
+  } else {
+    lod = m_lods[std::min<size_t>(lodIdx - 1, m_lods.size() - 1)];
+  }
 
-  // TODO: BROKEN
-  glm::mat4 transform(1.0f);
+  lod.firstIndex += m_indexAllocation.getOffset();
+  return lod;
+}
 
-  AABB aabb;
-  aabb.min = aabb.max =
-      glm::vec3(transform * glm::vec4(vertices[0].position, 1.0f));
+uint32_t Primitive::selectLod(
+    const glm::mat4& transform,
+    const glm::vec3& viewPos,
+    float lodScale,
+    float maxPixelError) const {
+  if (m_lods.empty())
+    return 0;
+
+  glm::vec3 center =
+      glm::vec3(transform * glm::vec4(0.5f * (m_aabb.min + m_aabb.max), 1.0f));
+  float scale = glm::max(
+      glm::length(glm::vec3(transform[0])),
+      glm::max(
+          glm::length(glm::vec3(transform[1])),
+          glm::length(glm::vec3(transform[2]))));
+  float radius = 0.5f * glm::length(m_aabb.max - m_aabb.min) * scale;
+
+  float distance = glm::length(center - viewPos) - radius;
+  if (distance <= 0.0f)
+    return 0;
+
+  // LOD errors are monotonically increasing, pick the coarsest one that
+  // stays under the pixel threshold
+  uint32_t lodIdx = 0;
+  for (uint32_t i = 0; i < m_lods.size(); ++i) {
+    float pixelError = m_lods[i].error * scale * lodScale / distance;
+    if (pixelError > maxPixelError)
+      break;
 
-  for (size_t i = 0; i < vertices.size(); ++i) {
-    glm::vec3 worldPos(transform * glm::vec4(vertices[i].position, 1.0f));
-    aabb.min = glm::min(aabb.min, worldPos);
-    aabb.max = glm::max(aabb.max, worldPos);
+    lodIdx = i + 1;
   }
 
-  return aabb;
+  return lodIdx;
 }
+
+void Primitive::draw(const DrawContext& context, uint32_t lodIdx) const {
+  // The arena blocks are shared, so consecutive primitives usually rebind
+  // the same buffers
+  context.bindVertexBuffer(m_vertexAllocation.getBuffer());
+  context.bindIndexBuffer(m_indexAllocation.getBuffer());
+
+  MeshLod lod = getLod(lodIdx);
+  const PrimitiveConstants& constants = getConstants();
+  context.drawIndexed(
+      lod.indexCount,
+      constants.instanceCount,
+      lod.firstIndex,
+      static_cast<int32_t>(m_vertexAllocation.getOffset()),
+      constants.firstInstance);
+}
+
+void Primitive::drawInstance(
+    const DrawContext& context,
+    uint32_t lodIdx,
+    uint32_t instanceIdx) const {
+  context.bindVertexBuffer(m_vertexAllocation.getBuffer());
+  context.bindIndexBuffer(m_indexAllocation.getBuffer());
+
+  MeshLod lod = getLod(lodIdx);
+  context.drawIndexed(
+      lod.indexCount,
+      1,
+      lod.firstIndex,
+      static_cast<int32_t>(m_vertexAllocation.getOffset()),
+      getConstants().firstInstance + instanceIdx);
+}
+
 } // namespace AltheaEngine
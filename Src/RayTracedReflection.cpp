@@ -4,6 +4,7 @@
 
 #include <cstdint>
 #include <iostream>
+#include <stdexcept>
 
 namespace AltheaEngine {
 
@@ -15,6 +16,11 @@ RayTracedReflection::RayTracedReflection(
     const GBufferResources& gBuffer,
     const ShaderDefines& shaderDefs)
     : _reflectionBuffer(app, commandBuffer, heap) {
+  if (!app.isRayTracingSupported()) {
+    throw std::runtime_error(
+        "Attempting to create ray traced reflections on a device without ray "
+        "tracing support!");
+  }
 
   // TODO: Switch this to bindless, this looks broken after removal of old
   // descriptor set code.
@@ -8,12 +8,43 @@
 #include <iostream>
 
 namespace AltheaEngine {
+namespace {
+// Checked before any of the pipeline's members are created
+const Application& checkRayTracingSupport(const Application& app) {
+  if (!app.isRayTracingSupported()) {
+    throw std::runtime_error(
+        "Attempting to create a ray tracing pipeline on a device without ray "
+        "tracing support!");
+  }
+
+  return app;
+}
+
+ShaderReflection reflectShaders(
+    const ShaderBuilder& rayGenShader,
+    const std::vector<ShaderBuilder>& missShaders,
+    const std::vector<ShaderBuilder>& closestHitShaders) {
+  ShaderReflection reflection = rayGenShader.reflect();
+  for (const ShaderBuilder& shader : missShaders)
+    reflection.merge(shader.reflect());
+  for (const ShaderBuilder& shader : closestHitShaders)
+    reflection.merge(shader.reflect());
+  return reflection;
+}
+} // namespace
+
 // TODO: AnyHit and Intersection shaders...
 RayTracingPipeline::RayTracingPipeline(
     const Application& app,
     RayTracingPipelineBuilder&& builder)
     : _builder(std::move(builder)),
-      _pipelineLayout(app, _builder.layoutBuilder),
+      _pipelineLayout(
+          checkRayTracingSupport(app),
+          _builder.layoutBuilder,
+          reflectShaders(
+              _builder._rayGenShaderBuilder,
+              _builder._missShaderBuilders,
+              _builder._closestHitShaderBuilders)),
       _rayGenShader(app, _builder._rayGenShaderBuilder) {
   uint32_t missCount =
       static_cast<uint32_t>(_builder._missShaderBuilders.size());
@@ -114,7 +145,7 @@ RayTracingPipeline::RayTracingPipeline(
   if (app.vkCreateRayTracingPipelinesKHR(
           device,
           VK_NULL_HANDLE,
-          VK_NULL_HANDLE,
+          app.getPipelineCache(),
           1,
           &createInfo,
           nullptr,
@@ -151,20 +182,20 @@ bool RayTracingPipeline::recompileStaleShaders() {
   bool stale = false;
   if (this->_builder._rayGenShaderBuilder.reloadIfStale()) {
     stale = true;
-    this->_builder._rayGenShaderBuilder.recompile();
+    this->_builder._rayGenShaderBuilder.recompileAsync();
   }
 
   for (ShaderBuilder& shader : this->_builder._closestHitShaderBuilders) {
     if (shader.reloadIfStale()) {
       stale = true;
-      shader.recompile();
+      shader.recompileAsync();
     }
   }
 
   for (ShaderBuilder& shader : this->_builder._missShaderBuilders) {
     if (shader.reloadIfStale()) {
       stale = true;
-      shader.recompile();
+      shader.recompileAsync();
     }
   }
 
@@ -0,0 +1,789 @@
+#include "RenderGraph.h"
+
+#include "Application.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace AltheaEngine {
+namespace {
+constexpr VkAccessFlags WRITE_ACCESS_BITS =
+    VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+    VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+    VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_HOST_WRITE_BIT |
+    VK_ACCESS_MEMORY_WRITE_BIT |
+    VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+
+VkDeviceSize alignUp(VkDeviceSize offset, VkDeviceSize alignment) {
+  return (offset + alignment - 1) / alignment * alignment;
+}
+
+VkImageCreateInfo makeImageCreateInfo(const ImageOptions& options) {
+  VkImageCreateInfo imageInfo{};
+  imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+  imageInfo.imageType = options.imageType;
+  imageInfo.extent.width = options.width;
+  imageInfo.extent.height = options.height;
+  imageInfo.extent.depth = options.depth;
+  imageInfo.mipLevels = options.mipCount;
+  imageInfo.arrayLayers = options.layerCount;
+  imageInfo.format = options.format;
+  imageInfo.tiling = options.tiling;
+  imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  imageInfo.usage = options.usage;
+  imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+  imageInfo.flags = options.createFlags;
+  return imageInfo;
+}
+
+// The synchronization state of a resource between passes
+struct ResourceState {
+  VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+  // The stages and accesses of the last write, or layout transition
+  VkPipelineStageFlags writeStages = 0;
+  VkAccessFlags writeAccess = 0;
+  // The stages and accesses that have read the resource since the last
+  // write, these are already synchronized with the write
+  VkPipelineStageFlags readStages = 0;
+  VkAccessFlags readAccess = 0;
+  // Whether any pass has used the resource so far
+  bool isUsed = false;
+
+  void apply(const RenderGraphAccess& access, bool write, bool layoutChange) {
+    if (write) {
+      writeStages = access.stageMask;
+      writeAccess = access.accessMask & WRITE_ACCESS_BITS;
+      readStages = 0;
+      readAccess = 0;
+    } else if (layoutChange) {
+      // Later reads must wait for the layout transition
+      writeStages = access.stageMask;
+      writeAccess = 0;
+      readStages = access.stageMask;
+      readAccess = access.accessMask;
+    } else {
+      readStages |= access.stageMask;
+      readAccess |= access.accessMask;
+    }
+
+    layout = access.layout;
+    isUsed = true;
+  }
+};
+} // namespace
+
+bool RenderGraphAccess::isWrite() const {
+  return (accessMask & WRITE_ACCESS_BITS) != 0;
+}
+
+/*static*/
+RenderGraphAccess RenderGraphAccess::colorAttachment() {
+  return {
+      VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+      VK_ACCESS_COLOR_ATTACHMENT_READ_BIT |
+          VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+      VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
+}
+
+/*static*/
+RenderGraphAccess RenderGraphAccess::depthAttachment() {
+  return {
+      VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+      VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+          VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+      VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+          VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT};
+}
+
+/*static*/
+RenderGraphAccess RenderGraphAccess::depthReadOnly() {
+  return {
+      VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+      VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT,
+      VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+          VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT};
+}
+
+/*static*/
+RenderGraphAccess RenderGraphAccess::sampled(VkPipelineStageFlags stageMask) {
+  return {
+      VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+      VK_ACCESS_SHADER_READ_BIT,
+      stageMask};
+}
+
+/*static*/
+RenderGraphAccess
+RenderGraphAccess::storageRead(VkPipelineStageFlags stageMask) {
+  return {VK_IMAGE_LAYOUT_GENERAL, VK_ACCESS_SHADER_READ_BIT, stageMask};
+}
+
+/*static*/
+RenderGraphAccess
+RenderGraphAccess::storageWrite(VkPipelineStageFlags stageMask) {
+  return {VK_IMAGE_LAYOUT_GENERAL, VK_ACCESS_SHADER_WRITE_BIT, stageMask};
+}
+
+/*static*/
+RenderGraphAccess
+RenderGraphAccess::storageReadWrite(VkPipelineStageFlags stageMask) {
+  return {
+      VK_IMAGE_LAYOUT_GENERAL,
+      VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+      stageMask};
+}
+
+/*static*/
+RenderGraphAccess RenderGraphAccess::transferSrc() {
+  return {
+      VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+      VK_ACCESS_TRANSFER_READ_BIT,
+      VK_PIPELINE_STAGE_TRANSFER_BIT};
+}
+
+/*static*/
+RenderGraphAccess RenderGraphAccess::transferDst() {
+  return {
+      VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+      VK_ACCESS_TRANSFER_WRITE_BIT,
+      VK_PIPELINE_STAGE_TRANSFER_BIT};
+}
+
+/*static*/
+RenderGraphAccess RenderGraphAccess::indirectArgs() {
+  return {
+      VK_IMAGE_LAYOUT_UNDEFINED,
+      VK_ACCESS_INDIRECT_COMMAND_READ_BIT,
+      VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT};
+}
+
+/*static*/
+RenderGraphAccess RenderGraphAccess::present() {
+  return {
+      VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+      0,
+      VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT};
+}
+
+RenderGraphPassBuilder& RenderGraphPassBuilder::read(
+    RenderGraphHandle resource,
+    const RenderGraphAccess& access) {
+  return this->_addAccess(resource, access, true, false);
+}
+
+RenderGraphPassBuilder& RenderGraphPassBuilder::write(
+    RenderGraphHandle resource,
+    const RenderGraphAccess& access) {
+  return this->_addAccess(resource, access, false, true);
+}
+
+RenderGraphPassBuilder& RenderGraphPassBuilder::readWrite(
+    RenderGraphHandle resource,
+    const RenderGraphAccess& access) {
+  return this->_addAccess(resource, access, true, true);
+}
+
+RenderGraphPassBuilder& RenderGraphPassBuilder::setSideEffects() {
+  m_graph.m_passes[m_passIdx].hasSideEffects = true;
+  return *this;
+}
+
+RenderGraphPassBuilder& RenderGraphPassBuilder::_addAccess(
+    RenderGraphHandle resource,
+    const RenderGraphAccess& access,
+    bool read,
+    bool write) {
+  if (!resource.isValid() || resource.index >= m_graph.m_resources.size()) {
+    throw std::runtime_error("Invalid render graph resource used by pass.");
+  }
+
+  RenderGraph::Pass& pass = m_graph.m_passes[m_passIdx];
+
+  // Multiple uses of a resource within a pass are merged into one access
+  for (RenderGraph::ResourceAccess& existing : pass.accesses) {
+    if (existing.resourceIdx != resource.index)
+      continue;
+
+    bool isBuffer = m_graph.m_resources[resource.index].type ==
+                    RenderGraph::ResourceType::IMPORTED_BUFFER;
+    if (!isBuffer && existing.access.layout != access.layout) {
+      throw std::runtime_error(
+          "Render graph pass uses an image in two different layouts.");
+    }
+
+    existing.access.accessMask |= access.accessMask;
+    existing.access.stageMask |= access.stageMask;
+    existing.read |= read;
+    existing.write |= write;
+    return *this;
+  }
+
+  pass.accesses.push_back({resource.index, access, read, write});
+  return *this;
+}
+
+RenderGraphHandle RenderGraph::createImage(
+    const std::string& name,
+    const ImageOptions& options) {
+  Resource resource{};
+  resource.name = name;
+  resource.type = ResourceType::TRANSIENT_IMAGE;
+  resource.options = options;
+  return this->_addResource(std::move(resource));
+}
+
+RenderGraphHandle RenderGraph::importImage(
+    const std::string& name,
+    VkImage image,
+    VkImageView view,
+    const ImageOptions& options,
+    const RenderGraphAccess& initialAccess,
+    const std::optional<RenderGraphAccess>& finalAccess) {
+  Resource resource{};
+  resource.name = name;
+  resource.type = ResourceType::IMPORTED_IMAGE;
+  resource.options = options;
+  resource.image = image;
+  resource.view = view;
+  resource.initialAccess = initialAccess;
+  resource.finalAccess = finalAccess ? *finalAccess : initialAccess;
+  return this->_addResource(std::move(resource));
+}
+
+RenderGraphHandle RenderGraph::importImage(
+    const std::string& name,
+    const Image& image,
+    VkImageView view) {
+  return this->importImage(
+      name,
+      image,
+      view,
+      image.getOptions(),
+      {image.getLayout(), image.getAccessMask(), image.getStage()});
+}
+
+RenderGraphHandle
+RenderGraph::importBuffer(const std::string& name, VkBuffer buffer) {
+  Resource resource{};
+  resource.name = name;
+  resource.type = ResourceType::IMPORTED_BUFFER;
+  resource.buffer = buffer;
+  return this->_addResource(std::move(resource));
+}
+
+RenderGraphPassBuilder RenderGraph::addPass(
+    const std::string& name,
+    RenderGraphExecuteFunction&& execute) {
+  Pass& pass = this->m_passes.emplace_back();
+  pass.name = name;
+  pass.execute = std::move(execute);
+
+  this->m_isCompiled = false;
+
+  return RenderGraphPassBuilder(
+      *this,
+      static_cast<uint32_t>(this->m_passes.size() - 1));
+}
+
+void RenderGraph::compile(const RenderGraphMemoryQuery& memoryQuery) {
+  // Images must be destroyed before the memory they are bound to
+  this->m_transientImages.clear();
+  this->m_transientAllocations.clear();
+  this->m_transientMemory.clear();
+  this->m_stats = {};
+
+  this->_cullPasses();
+  this->_computeLifetimes();
+  this->_placeTransientImages(memoryQuery);
+  this->_computeBarriers();
+
+  this->m_stats.passCount = static_cast<uint32_t>(this->m_passes.size());
+  this->m_stats.culledPassCount = static_cast<uint32_t>(
+      this->m_passes.size() - this->m_executionOrder.size());
+
+  this->m_isCompiled = true;
+}
+
+void RenderGraph::compile(const Application& app) {
+  VkDevice device = app.getDevice();
+  this->compile([device](const ImageOptions& options) {
+    VkImageCreateInfo imageInfo = makeImageCreateInfo(options);
+
+    VkDeviceImageMemoryRequirements requirementsInfo{};
+    requirementsInfo.sType =
+        VK_STRUCTURE_TYPE_DEVICE_IMAGE_MEMORY_REQUIREMENTS;
+    requirementsInfo.pCreateInfo = &imageInfo;
+
+    VkMemoryRequirements2 requirements{};
+    requirements.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+    vkGetDeviceImageMemoryRequirements(
+        device,
+        &requirementsInfo,
+        &requirements);
+
+    return requirements.memoryRequirements;
+  });
+
+  this->_createTransientImages(app);
+}
+
+void RenderGraph::execute(
+    VkCommandBuffer commandBuffer,
+    const FrameContext& frame) const {
+  if (!this->m_isCompiled) {
+    throw std::runtime_error("Attempting to execute an uncompiled graph.");
+  }
+
+  RenderGraphContext context{commandBuffer, frame, *this};
+  for (uint32_t orderIdx = 0; orderIdx < this->m_executionOrder.size();
+       ++orderIdx) {
+    _recordBarriers(
+        commandBuffer,
+        this->m_barriers[orderIdx],
+        this->m_resources);
+
+    const Pass& pass = this->m_passes[this->m_executionOrder[orderIdx]];
+    if (pass.execute)
+      pass.execute(context);
+  }
+
+  _recordBarriers(commandBuffer, this->m_finalBarriers, this->m_resources);
+}
+
+VkImage RenderGraph::getImage(RenderGraphHandle resource) const {
+  return this->m_resources[resource.index].image;
+}
+
+VkImageView RenderGraph::getImageView(RenderGraphHandle resource) const {
+  return this->m_resources[resource.index].view;
+}
+
+VkBuffer RenderGraph::getBuffer(RenderGraphHandle resource) const {
+  return this->m_resources[resource.index].buffer;
+}
+
+RenderGraphHandle RenderGraph::_addResource(Resource&& resource) {
+  this->m_resources.push_back(std::move(resource));
+  this->m_isCompiled = false;
+  return {static_cast<uint32_t>(this->m_resources.size() - 1)};
+}
+
+void RenderGraph::_cullPasses() {
+  // Walk the passes backwards, keeping track of which resources have their
+  // current contents read by a later live pass. Imported resources outlive
+  // the graph, so their final contents are always needed.
+  std::vector<bool> isNeeded(this->m_resources.size(), false);
+  for (uint32_t i = 0; i < this->m_resources.size(); ++i) {
+    isNeeded[i] = this->m_resources[i].type != ResourceType::TRANSIENT_IMAGE;
+  }
+
+  for (auto passIt = this->m_passes.rbegin(); passIt != this->m_passes.rend();
+       ++passIt) {
+    Pass& pass = *passIt;
+    pass.isAlive = pass.hasSideEffects;
+    for (const ResourceAccess& access : pass.accesses) {
+      if (access.write && isNeeded[access.resourceIdx])
+        pass.isAlive = true;
+    }
+
+    if (!pass.isAlive)
+      continue;
+
+    // Contents overwritten by this pass are not needed from earlier passes,
+    // unless this pass also reads them
+    for (const ResourceAccess& access : pass.accesses) {
+      if (access.write && !access.read)
+        isNeeded[access.resourceIdx] = false;
+    }
+    for (const ResourceAccess& access : pass.accesses) {
+      if (access.read)
+        isNeeded[access.resourceIdx] = true;
+    }
+  }
+
+  // Transient images are undefined until written
+  std::vector<bool> isWritten(this->m_resources.size(), false);
+  for (const Pass& pass : this->m_passes) {
+    if (!pass.isAlive)
+      continue;
+
+    for (const ResourceAccess& access : pass.accesses) {
+      const Resource& resource = this->m_resources[access.resourceIdx];
+      if (access.read && resource.type == ResourceType::TRANSIENT_IMAGE &&
+          !isWritten[access.resourceIdx]) {
+        throw std::runtime_error(
+            "Render graph pass " + pass.name + " reads transient image " +
+            resource.name + " before it is written.");
+      }
+
+      if (access.write)
+        isWritten[access.resourceIdx] = true;
+    }
+  }
+}
+
+void RenderGraph::_computeLifetimes() {
+  this->m_executionOrder.clear();
+  for (Resource& resource : this->m_resources) {
+    resource.firstUse = UINT32_MAX;
+    resource.lastUse = 0;
+    resource.memoryIdx = UINT32_MAX;
+    resource.memoryOffset = 0;
+  }
+
+  for (uint32_t passIdx = 0; passIdx < this->m_passes.size(); ++passIdx) {
+    const Pass& pass = this->m_passes[passIdx];
+    if (!pass.isAlive)
+      continue;
+
+    uint32_t orderIdx = static_cast<uint32_t>(this->m_executionOrder.size());
+    this->m_executionOrder.push_back(passIdx);
+
+    for (const ResourceAccess& access : pass.accesses) {
+      Resource& resource = this->m_resources[access.resourceIdx];
+      resource.firstUse = std::min(resource.firstUse, orderIdx);
+      resource.lastUse = std::max(resource.lastUse, orderIdx);
+    }
+  }
+}
+
+void RenderGraph::_placeTransientImages(
+    const RenderGraphMemoryQuery& memoryQuery) {
+  std::vector<uint32_t> transients;
+  for (uint32_t i = 0; i < this->m_resources.size(); ++i) {
+    Resource& resource = this->m_resources[i];
+    if (resource.type != ResourceType::TRANSIENT_IMAGE ||
+        resource.firstUse == UINT32_MAX)
+      continue;
+
+    resource.memoryRequirements = memoryQuery(resource.options);
+    this->m_stats.unaliasedMemorySize += resource.memoryRequirements.size;
+    transients.push_back(i);
+  }
+
+  this->m_stats.transientImageCount = static_cast<uint32_t>(transients.size());
+
+  // Place the largest images first, each one at the lowest offset that does
+  // not overlap the memory of an already placed image alive at the same time
+  std::stable_sort(
+      transients.begin(),
+      transients.end(),
+      [&](uint32_t a, uint32_t b) {
+        return this->m_resources[a].memoryRequirements.size >
+               this->m_resources[b].memoryRequirements.size;
+      });
+
+  struct Range {
+    VkDeviceSize begin;
+    VkDeviceSize end;
+  };
+  std::vector<Range> occupied;
+
+  for (uint32_t i = 0; i < transients.size(); ++i) {
+    Resource& resource = this->m_resources[transients[i]];
+    const VkMemoryRequirements& requirements = resource.memoryRequirements;
+
+    uint32_t memoryIdx = 0;
+    for (; memoryIdx < this->m_transientMemory.size(); ++memoryIdx) {
+      if (this->m_transientMemory[memoryIdx].memoryTypeBits &
+          requirements.memoryTypeBits)
+        break;
+    }
+
+    if (memoryIdx == this->m_transientMemory.size()) {
+      this->m_transientMemory.push_back(
+          {requirements.memoryTypeBits, requirements.alignment, 0});
+    }
+
+    occupied.clear();
+    for (uint32_t j = 0; j < i; ++j) {
+      const Resource& other = this->m_resources[transients[j]];
+      if (other.memoryIdx != memoryIdx || other.lastUse < resource.firstUse ||
+          resource.lastUse < other.firstUse)
+        continue;
+
+      occupied.push_back(
+          {other.memoryOffset,
+           other.memoryOffset + other.memoryRequirements.size});
+    }
+
+    std::sort(occupied.begin(), occupied.end(), [](Range a, Range b) {
+      return a.begin < b.begin;
+    });
+
+    VkDeviceSize offset = 0;
+    for (const Range& range : occupied) {
+      VkDeviceSize alignedOffset = alignUp(offset, requirements.alignment);
+      if (alignedOffset + requirements.size <= range.begin)
+        break;
+      offset = std::max(offset, range.end);
+    }
+    offset = alignUp(offset, requirements.alignment);
+
+    TransientMemory& memory = this->m_transientMemory[memoryIdx];
+    memory.memoryTypeBits &= requirements.memoryTypeBits;
+    memory.alignment = std::max(memory.alignment, requirements.alignment);
+    memory.size = std::max(memory.size, offset + requirements.size);
+
+    resource.memoryIdx = memoryIdx;
+    resource.memoryOffset = offset;
+  }
+
+  for (const TransientMemory& memory : this->m_transientMemory)
+    this->m_stats.transientMemorySize += memory.size;
+}
+
+void RenderGraph::_computeBarriers() {
+  std::vector<ResourceState> states(this->m_resources.size());
+  for (uint32_t i = 0; i < this->m_resources.size(); ++i) {
+    const Resource& resource = this->m_resources[i];
+    if (resource.type == ResourceType::IMPORTED_IMAGE) {
+      states[i].layout = resource.initialAccess.layout;
+      states[i].writeStages = resource.initialAccess.stageMask;
+      states[i].writeAccess =
+          resource.initialAccess.accessMask & WRITE_ACCESS_BITS;
+    }
+  }
+
+  // The state transient images are left in by the previous execution of the
+  // graph, which the first use of their memory in this execution must wait
+  // for. Command buffers of consecutive frames may overlap on the queue.
+  std::vector<ResourceState> previousStates(this->m_resources.size());
+  for (uint32_t passIdx : this->m_executionOrder) {
+    for (const ResourceAccess& access : this->m_passes[passIdx].accesses) {
+      if (this->m_resources[access.resourceIdx].type !=
+          ResourceType::TRANSIENT_IMAGE)
+        continue;
+
+      ResourceState& state = previousStates[access.resourceIdx];
+      state.apply(
+          access.access,
+          access.write || access.access.isWrite(),
+          state.layout != access.access.layout);
+    }
+  }
+
+  auto addBarrier = [&](RenderGraphBarrierBatch& batch,
+                        uint32_t resourceIdx,
+                        const RenderGraphAccess& access,
+                        bool write) {
+    const Resource& resource = this->m_resources[resourceIdx];
+    ResourceState& state = states[resourceIdx];
+
+    bool isImage = resource.type != ResourceType::IMPORTED_BUFFER;
+    bool layoutChange = isImage && state.layout != access.layout;
+
+    VkPipelineStageFlags srcStages = 0;
+    VkAccessFlags srcAccess = 0;
+    if (layoutChange || write) {
+      // Wait for the last write and every read since then
+      srcStages = state.writeStages | state.readStages;
+      srcAccess = state.writeAccess;
+    } else if (
+        (access.stageMask & ~state.readStages) ||
+        (access.accessMask & ~state.readAccess)) {
+      // A new kind of read only needs to see the last write
+      srcStages = state.writeStages;
+      srcAccess = state.writeAccess;
+    }
+
+    // A transient image's first use must wait for every image using the
+    // same memory, itself included, to be done with it. Images used earlier
+    // in this execution are waited on directly. The others last used the
+    // memory in the previous execution, and are waited on in the state that
+    // execution left them in.
+    if (resource.type == ResourceType::TRANSIENT_IMAGE && !state.isUsed) {
+      for (uint32_t otherIdx = 0; otherIdx < this->m_resources.size();
+           ++otherIdx) {
+        const Resource& other = this->m_resources[otherIdx];
+        if (other.type != ResourceType::TRANSIENT_IMAGE ||
+            other.memoryIdx != resource.memoryIdx ||
+            other.memoryOffset + other.memoryRequirements.size <=
+                resource.memoryOffset ||
+            resource.memoryOffset + resource.memoryRequirements.size <=
+                other.memoryOffset)
+          continue;
+
+        const ResourceState& otherState = other.lastUse < resource.firstUse
+                                              ? states[otherIdx]
+                                              : previousStates[otherIdx];
+        srcStages |= otherState.writeStages | otherState.readStages;
+        srcAccess |= otherState.writeAccess;
+      }
+    }
+
+    if (layoutChange || srcStages != 0 || srcAccess != 0) {
+      if (isImage) {
+        batch.imageBarriers.push_back(
+            {resourceIdx,
+             state.layout,
+             access.layout,
+             srcAccess,
+             access.accessMask});
+      } else {
+        batch.hasMemoryBarrier = true;
+        batch.memorySrcAccessMask |= srcAccess;
+        batch.memoryDstAccessMask |= access.accessMask;
+      }
+
+      // Only imported images with no initial access have nothing to wait on
+      batch.srcStageMask |=
+          srcStages != 0 ? srcStages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+      batch.dstStageMask |= access.stageMask;
+      ++this->m_stats.barrierCount;
+    }
+
+    state.apply(access, write, layoutChange);
+  };
+
+  this->m_barriers.clear();
+  this->m_barriers.resize(this->m_executionOrder.size());
+  for (uint32_t orderIdx = 0; orderIdx < this->m_executionOrder.size();
+       ++orderIdx) {
+    const Pass& pass = this->m_passes[this->m_executionOrder[orderIdx]];
+    RenderGraphBarrierBatch& batch = this->m_barriers[orderIdx];
+    for (const ResourceAccess& access : pass.accesses) {
+      addBarrier(
+          batch,
+          access.resourceIdx,
+          access.access,
+          access.write || access.access.isWrite());
+    }
+
+    if (!batch.isEmpty())
+      ++this->m_stats.barrierBatchCount;
+  }
+
+  // Move imported images to their final states. Whatever uses the images
+  // next only knows about the final state, so it must wait on every access
+  // made by the graph.
+  this->m_finalBarriers = {};
+  for (uint32_t i = 0; i < this->m_resources.size(); ++i) {
+    const Resource& resource = this->m_resources[i];
+    if (resource.type != ResourceType::IMPORTED_IMAGE)
+      continue;
+
+    const RenderGraphAccess& finalAccess = *resource.finalAccess;
+    if (!states[i].isUsed && states[i].layout == finalAccess.layout)
+      continue;
+
+    addBarrier(this->m_finalBarriers, i, finalAccess, true);
+  }
+
+  if (!this->m_finalBarriers.isEmpty())
+    ++this->m_stats.barrierBatchCount;
+}
+
+void RenderGraph::_createTransientImages(const Application& app) {
+  VkDevice device = app.getDevice();
+
+  for (const TransientMemory& memory : this->m_transientMemory) {
+    VkMemoryRequirements requirements{};
+    requirements.size = memory.size;
+    requirements.alignment = memory.alignment;
+    requirements.memoryTypeBits = memory.memoryTypeBits;
+
+    VmaAllocationCreateInfo allocInfo{};
+    allocInfo.usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
+    allocInfo.requiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+
+    this->m_transientAllocations.push_back(
+        app.getAllocator().allocateMemory(requirements, allocInfo));
+  }
+
+  for (Resource& resource : this->m_resources) {
+    if (resource.type != ResourceType::TRANSIENT_IMAGE ||
+        resource.memoryIdx == UINT32_MAX)
+      continue;
+
+    VkImageCreateInfo imageInfo = makeImageCreateInfo(resource.options);
+    VkImage image;
+    if (vkCreateImage(device, &imageInfo, nullptr, &image) != VK_SUCCESS) {
+      throw std::runtime_error("Failed to create transient image!");
+    }
+
+    TransientImage& transient = this->m_transientImages.emplace_back();
+    transient.image.set(device, image);
+
+    app.getAllocator().bindImageMemory(
+        this->m_transientAllocations[resource.memoryIdx],
+        resource.memoryOffset,
+        image);
+
+    ImageViewOptions viewOptions{};
+    viewOptions.format = resource.options.format;
+    viewOptions.mipCount = resource.options.mipCount;
+    viewOptions.layerCount = resource.options.layerCount;
+    viewOptions.aspectFlags = resource.options.aspectMask;
+    if (resource.options.imageType == VK_IMAGE_TYPE_3D) {
+      viewOptions.type = VK_IMAGE_VIEW_TYPE_3D;
+    } else if (
+        (resource.options.createFlags &
+         VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT) &&
+        resource.options.layerCount == 6) {
+      viewOptions.type = VK_IMAGE_VIEW_TYPE_CUBE;
+    } else if (resource.options.layerCount > 1) {
+      viewOptions.type = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+    }
+
+    transient.view = ImageView(app, image, viewOptions);
+
+    resource.image = image;
+    resource.view = transient.view;
+  }
+}
+
+/*static*/
+void RenderGraph::_recordBarriers(
+    VkCommandBuffer commandBuffer,
+    const RenderGraphBarrierBatch& batch,
+    const std::vector<Resource>& resources) {
+  if (batch.isEmpty())
+    return;
+
+  std::vector<VkImageMemoryBarrier> imageBarriers;
+  imageBarriers.reserve(batch.imageBarriers.size());
+  for (const RenderGraphBarrier& barrier : batch.imageBarriers) {
+    const Resource& resource = resources[barrier.resourceIdx];
+
+    VkImageMemoryBarrier& imageBarrier = imageBarriers.emplace_back();
+    imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    imageBarrier.image = resource.image;
+    imageBarrier.oldLayout = barrier.oldLayout;
+    imageBarrier.newLayout = barrier.newLayout;
+    imageBarrier.srcAccessMask = barrier.srcAccessMask;
+    imageBarrier.dstAccessMask = barrier.dstAccessMask;
+    imageBarrier.subresourceRange.aspectMask = resource.options.aspectMask;
+    imageBarrier.subresourceRange.baseMipLevel = 0;
+    imageBarrier.subresourceRange.levelCount = resource.options.mipCount;
+    imageBarrier.subresourceRange.baseArrayLayer = 0;
+    imageBarrier.subresourceRange.layerCount = resource.options.layerCount;
+    imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  }
+
+  VkMemoryBarrier memoryBarrier{};
+  memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  memoryBarrier.srcAccessMask = batch.memorySrcAccessMask;
+  memoryBarrier.dstAccessMask = batch.memoryDstAccessMask;
+
+  vkCmdPipelineBarrier(
+      commandBuffer,
+      batch.srcStageMask,
+      batch.dstStageMask,
+      0,
+      batch.hasMemoryBarrier ? 1 : 0,
+      &memoryBarrier,
+      0,
+      nullptr,
+      static_cast<uint32_t>(imageBarriers.size()),
+      imageBarriers.data());
+}
+
+void RenderGraph::TransientImage::ImageDeleter::operator()(
+    VkDevice device,
+    VkImage image) {
+  vkDestroyImage(device, image, nullptr);
+}
+} // namespace AltheaEngine
@@ -2,8 +2,13 @@
 
 #include "Application.h"
 #include "ImageView.h"
+#include "ParallelCommandRecorder.h"
+#include "ThreadPool.h"
 
+#include <iostream>
+#include <optional>
 #include <stdexcept>
+#include <vector>
 
 namespace AltheaEngine {
 Subpass::Subpass(
@@ -217,22 +222,49 @@ RenderPass::RenderPass(
 
   this->_renderPass.set(this->_device, renderPass);
 
-  // Create pipelines for all subpasses
-  this->_subpasses.reserve(subpassBuilders.size());
-  for (uint32_t subpassIndex = 0; subpassIndex < subpassBuilders.size();
-       ++subpassIndex) {
-    this->_subpasses.emplace_back(
+  // Create pipelines for all subpasses. The pipelines are independent, so
+  // they are created in parallel and share the application's pipeline cache.
+  VkRenderPass vkRenderPass = this->_renderPass;
+  auto createSubpass = [&](uint32_t subpassIndex) {
+    return Subpass(
         app,
         extent,
-        this->_renderPass,
+        vkRenderPass,
         subpassIndex,
         std::move(subpassBuilders[subpassIndex]));
-  }
+  };
+
+  std::vector<std::optional<Subpass>> subpasses(subpassBuilders.size());
+  ThreadPool::getShared().parallelFor(
+      static_cast<uint32_t>(subpassBuilders.size()),
+      [&](uint32_t firstSubpass, uint32_t endSubpass) {
+        for (uint32_t subpassIndex = firstSubpass; subpassIndex < endSubpass;
+             ++subpassIndex)
+          subpasses[subpassIndex].emplace(createSubpass(subpassIndex));
+      });
+
+  this->_subpasses.reserve(subpassBuilders.size());
+  for (std::optional<Subpass>& subpass : subpasses)
+    this->_subpasses.push_back(std::move(*subpass));
 }
 
 void RenderPass::tryRecompile(Application& app) {
-  for (Subpass& subpass : this->_subpasses) {
-    subpass.getPipeline().tryRecompile(app);
+  // Queue the stale shaders of every subpass first, so they all compile in
+  // parallel instead of one pipeline at a time
+  std::vector<bool> stale(this->_subpasses.size());
+  for (size_t i = 0; i < this->_subpasses.size(); ++i)
+    stale[i] = this->_subpasses[i].getPipeline().recompileStaleShaders();
+
+  for (size_t i = 0; i < this->_subpasses.size(); ++i) {
+    if (!stale[i])
+      continue;
+
+    GraphicsPipeline& pipeline = this->_subpasses[i].getPipeline();
+    if (pipeline.hasShaderRecompileErrors()) {
+      std::cout << pipeline.getShaderRecompileErrors() << "\n" << std::flush;
+    } else {
+      pipeline.recreatePipeline(app);
+    }
   }
 }
 
@@ -240,19 +272,23 @@ ActiveRenderPass RenderPass::begin(
     const Application& app,
     const VkCommandBuffer& commandBuffer,
     const FrameContext& frame,
-    VkFramebuffer frameBuffer) const {
-  return ActiveRenderPass(*this, commandBuffer, frame, frameBuffer);
+    VkFramebuffer frameBuffer,
+    VkSubpassContents contents) const {
+  return ActiveRenderPass(*this, commandBuffer, frame, frameBuffer, contents);
 }
 
 ActiveRenderPass::ActiveRenderPass(
     const RenderPass& renderPass,
     const VkCommandBuffer& commandBuffer,
     const FrameContext& frame,
-    VkFramebuffer frameBuffer)
+    VkFramebuffer frameBuffer,
+    VkSubpassContents contents)
     : _currentSubpass(0),
       _renderPass(renderPass),
       _commandBuffer(commandBuffer),
-      _frame(frame) {
+      _frame(frame),
+      _frameBuffer(frameBuffer),
+      _contents(contents) {
 
   this->_drawContext._commandBuffer = commandBuffer;
   this->_drawContext._pFrame = &frame;
@@ -280,31 +316,91 @@ ActiveRenderPass::ActiveRenderPass(
   this->_drawContext._pCurrentSubpass = &currentSubpass;
 
   // TODO: Support compute as well?
-  vkCmdBeginRenderPass(
-      this->_commandBuffer,
-      &renderPassInfo,
-      VK_SUBPASS_CONTENTS_INLINE);
-  currentSubpass.getPipeline().bindPipeline(this->_commandBuffer);
+  vkCmdBeginRenderPass(this->_commandBuffer, &renderPassInfo, contents);
+
+  // Subpasses recorded in secondary command buffers bind the pipeline there
+  if (contents == VK_SUBPASS_CONTENTS_INLINE)
+    currentSubpass.getPipeline().bindPipeline(this->_commandBuffer);
 }
 
 ActiveRenderPass::~ActiveRenderPass() {
   vkCmdEndRenderPass(this->_commandBuffer);
 }
 
-ActiveRenderPass& ActiveRenderPass::nextSubpass() {
+ActiveRenderPass& ActiveRenderPass::nextSubpass(VkSubpassContents contents) {
   ++this->_currentSubpass;
   if (this->_currentSubpass >= this->_renderPass._subpasses.size()) {
     throw std::runtime_error("Called nextSubpass with no remaining subpasses");
   }
 
-  vkCmdNextSubpass(this->_commandBuffer, VK_SUBPASS_CONTENTS_INLINE);
+  vkCmdNextSubpass(this->_commandBuffer, contents);
+  this->_contents = contents;
 
   const Subpass& currentSubpass =
       this->_renderPass._subpasses[this->_currentSubpass];
 
   this->_drawContext._pCurrentSubpass = &currentSubpass;
 
-  currentSubpass.getPipeline().bindPipeline(this->_commandBuffer);
+  if (contents == VK_SUBPASS_CONTENTS_INLINE)
+    currentSubpass.getPipeline().bindPipeline(this->_commandBuffer);
+
+  return *this;
+}
+
+ActiveRenderPass& ActiveRenderPass::recordParallel(
+    ParallelCommandRecorder& recorder,
+    uint32_t taskCount,
+    const std::function<void(const DrawContext& context, uint32_t taskIdx)>&
+        recordTask) {
+  if (this->_contents != VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS) {
+    throw std::runtime_error(
+        "Attempting to record a subpass in parallel that expects inline "
+        "commands.");
+  }
+
+  if (taskCount == 0)
+    return *this;
+
+  // Each task owns a worker slot, and with it a command pool, for the
+  // duration of the task
+  recorder.reserveWorkers(taskCount);
+
+  std::vector<VkCommandBuffer> secondaryCommandBuffers(taskCount);
+  auto runTask = [&](uint32_t taskIdx) {
+    VkCommandBuffer commandBuffer = recorder.beginSecondary(
+        taskIdx,
+        this->_frame,
+        this->_renderPass._renderPass,
+        this->_currentSubpass,
+        this->_frameBuffer);
+
+    // Nothing is inherited from the primary command buffer besides the
+    // render pass, so bind the subpass state again
+    DrawContext context = this->_drawContext;
+    context._commandBuffer = commandBuffer;
+    context._pCurrentSubpass->getPipeline().bindPipeline(commandBuffer);
+    if (context._globalDescriptorSetCount > 0)
+      context.bindDescriptorSets();
+
+    recordTask(context, taskIdx);
+
+    recorder.endSecondary(commandBuffer);
+    secondaryCommandBuffers[taskIdx] = commandBuffer;
+  };
+
+  // Each index runs exactly once, so no worker slot is used by two threads
+  // at a time
+  ThreadPool::getShared().parallelFor(
+      taskCount,
+      [&](uint32_t firstTask, uint32_t endTask) {
+        for (uint32_t taskIdx = firstTask; taskIdx < endTask; ++taskIdx)
+          runTask(taskIdx);
+      });
+
+  vkCmdExecuteCommands(
+      this->_commandBuffer,
+      taskCount,
+      secondaryCommandBuffers.data());
 
   return *this;
 }
@@ -0,0 +1,362 @@
+#include "SceneBVH.h"
+
+#include "Model.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#define SCENE_BVH_USE_SSE
+#include <emmintrin.h>
+#endif
+
+#define BVH_LEAF_SIZE 4
+#define BVH_MAX_DEPTH 64
+
+namespace AltheaEngine {
+namespace {
+// Returns a bitmask of the lanes of the packet that are on the inner side of
+// every plane in planeMask.
+uint32_t testPacket(
+    const Frustum& frustum,
+    uint32_t planeMask,
+    const float* minX,
+    const float* minY,
+    const float* minZ,
+    const float* maxX,
+    const float* maxY,
+    const float* maxZ) {
+#ifdef SCENE_BVH_USE_SSE
+  __m128 vMinX = _mm_loadu_ps(minX);
+  __m128 vMinY = _mm_loadu_ps(minY);
+  __m128 vMinZ = _mm_loadu_ps(minZ);
+  __m128 vMaxX = _mm_loadu_ps(maxX);
+  __m128 vMaxY = _mm_loadu_ps(maxY);
+  __m128 vMaxZ = _mm_loadu_ps(maxZ);
+
+  __m128 visible = _mm_castsi128_ps(_mm_set1_epi32(-1));
+  for (uint32_t i = 0; i < Frustum::PLANE_COUNT; ++i) {
+    if ((planeMask & (1 << i)) == 0)
+      continue;
+
+    // Test the corner of each box furthest along the plane normal
+    const glm::vec4& plane = frustum.planes[i];
+    __m128 px = plane.x >= 0.0f ? vMaxX : vMinX;
+    __m128 py = plane.y >= 0.0f ? vMaxY : vMinY;
+    __m128 pz = plane.z >= 0.0f ? vMaxZ : vMinZ;
+
+    __m128 d = _mm_add_ps(
+        _mm_add_ps(
+            _mm_mul_ps(_mm_set1_ps(plane.x), px),
+            _mm_mul_ps(_mm_set1_ps(plane.y), py)),
+        _mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.z), pz), _mm_set1_ps(plane.w)));
+    visible = _mm_and_ps(visible, _mm_cmpge_ps(d, _mm_setzero_ps()));
+  }
+
+  return static_cast<uint32_t>(_mm_movemask_ps(visible));
+#else
+  uint32_t visible = 0xf;
+  for (uint32_t i = 0; i < Frustum::PLANE_COUNT; ++i) {
+    if ((planeMask & (1 << i)) == 0)
+      continue;
+
+    const glm::vec4& plane = frustum.planes[i];
+    for (uint32_t lane = 0; lane < 4; ++lane) {
+      float px = plane.x >= 0.0f ? maxX[lane] : minX[lane];
+      float py = plane.y >= 0.0f ? maxY[lane] : minY[lane];
+      float pz = plane.z >= 0.0f ? maxZ[lane] : minZ[lane];
+      if (plane.x * px + plane.y * py + plane.z * pz + plane.w < 0.0f)
+        visible &= ~(1 << lane);
+    }
+  }
+
+  return visible;
+#endif
+}
+} // namespace
+
+void SceneBVH::build(const std::vector<Model>& models) {
+  std::vector<PrimitiveInstanceRef> instances;
+  for (uint32_t modelIdx = 0; modelIdx < models.size(); ++modelIdx) {
+    const std::vector<Primitive>& primitives =
+        models[modelIdx].getPrimitives();
+    for (uint32_t primIdx = 0; primIdx < primitives.size(); ++primIdx) {
+      uint32_t instanceCount = primitives[primIdx].getInstanceCount();
+      for (uint32_t instanceIdx = 0; instanceIdx < instanceCount;
+           ++instanceIdx) {
+        instances.push_back({modelIdx, primIdx, instanceIdx});
+      }
+    }
+  }
+
+  m_instances = std::move(instances);
+
+  std::vector<AABB> bounds;
+  _gatherInstanceBounds(models, bounds);
+  _build(bounds);
+}
+
+void SceneBVH::build(gsl::span<const AABB> bounds) {
+  m_instances.clear();
+  _build(bounds);
+}
+
+void SceneBVH::_build(gsl::span<const AABB> bounds) {
+  m_nodes.clear();
+  m_minX.clear();
+  m_minY.clear();
+  m_minZ.clear();
+  m_maxX.clear();
+  m_maxY.clear();
+  m_maxZ.clear();
+  m_packetItems.clear();
+
+  m_itemCount = static_cast<uint32_t>(bounds.size());
+  m_itemLanes.resize(m_itemCount);
+
+  if (m_itemCount == 0)
+    return;
+
+  std::vector<uint32_t> items(m_itemCount);
+  for (uint32_t i = 0; i < m_itemCount; ++i)
+    items[i] = i;
+
+  m_nodes.reserve(2 * (m_itemCount / BVH_LEAF_SIZE + 1));
+  _buildRecursive(bounds, items, 0, m_itemCount);
+}
+
+void SceneBVH::refit(const std::vector<Model>& models) {
+  std::vector<AABB> bounds;
+  _gatherInstanceBounds(models, bounds);
+  refit(bounds);
+}
+
+void SceneBVH::refit(gsl::span<const AABB> bounds) {
+  if (bounds.size() != m_itemCount) {
+    throw std::runtime_error(
+        "Attempting to refit scene BVH with a different number of items!");
+  }
+
+  for (uint32_t i = 0; i < m_itemCount; ++i) {
+    uint32_t lane = m_itemLanes[i];
+    _writePacket(lane / 4, lane % 4, bounds[i]);
+  }
+
+  _refitNodes();
+}
+
+void SceneBVH::cullFrustum(
+    const Frustum& frustum,
+    std::vector<uint32_t>& visibleItems) const {
+  visibleItems.clear();
+
+  if (m_nodes.empty())
+    return;
+
+  struct StackEntry {
+    uint32_t nodeIdx;
+    uint32_t planeMask;
+  };
+
+  StackEntry stack[BVH_MAX_DEPTH];
+  uint32_t stackSize = 0;
+  stack[stackSize++] = {0, (1 << Frustum::PLANE_COUNT) - 1};
+
+  while (stackSize > 0) {
+    StackEntry entry = stack[--stackSize];
+    const Node& node = m_nodes[entry.nodeIdx];
+
+    // Drop the planes the node is fully inside of, its children will be too
+    uint32_t planeMask = entry.planeMask;
+    bool outside = false;
+    for (uint32_t i = 0; i < Frustum::PLANE_COUNT; ++i) {
+      if ((planeMask & (1 << i)) == 0)
+        continue;
+
+      const glm::vec4& plane = frustum.planes[i];
+      glm::vec3 n(plane);
+      glm::vec3 pVertex(
+          n.x >= 0.0f ? node.bounds.max.x : node.bounds.min.x,
+          n.y >= 0.0f ? node.bounds.max.y : node.bounds.min.y,
+          n.z >= 0.0f ? node.bounds.max.z : node.bounds.min.z);
+      if (glm::dot(n, pVertex) + plane.w < 0.0f) {
+        outside = true;
+        break;
+      }
+
+      glm::vec3 nVertex(
+          n.x >= 0.0f ? node.bounds.min.x : node.bounds.max.x,
+          n.y >= 0.0f ? node.bounds.min.y : node.bounds.max.y,
+          n.z >= 0.0f ? node.bounds.min.z : node.bounds.max.z);
+      if (glm::dot(n, nVertex) + plane.w >= 0.0f)
+        planeMask &= ~(1 << i);
+    }
+
+    if (outside)
+      continue;
+
+    if (node.itemCount > 0) {
+      uint32_t laneMask = (1 << node.itemCount) - 1;
+      if (planeMask != 0) {
+        size_t offset = 4 * static_cast<size_t>(node.index);
+        laneMask &= testPacket(
+            frustum,
+            planeMask,
+            &m_minX[offset],
+            &m_minY[offset],
+            &m_minZ[offset],
+            &m_maxX[offset],
+            &m_maxY[offset],
+            &m_maxZ[offset]);
+      }
+
+      for (uint32_t lane = 0; lane < node.itemCount; ++lane) {
+        if (laneMask & (1 << lane))
+          visibleItems.push_back(m_packetItems[4 * node.index + lane]);
+      }
+
+      continue;
+    }
+
+    stack[stackSize++] = {node.index, planeMask};
+    stack[stackSize++] = {entry.nodeIdx + 1, planeMask};
+  }
+}
+
+void SceneBVH::cullFrustum(
+    const Frustum& frustum,
+    std::vector<PrimitiveInstanceRef>& visibleInstances) const {
+  std::vector<uint32_t> visibleItems;
+  cullFrustum(frustum, visibleItems);
+
+  visibleInstances.clear();
+  visibleInstances.reserve(visibleItems.size());
+  for (uint32_t itemIdx : visibleItems)
+    visibleInstances.push_back(m_instances[itemIdx]);
+}
+
+AABB SceneBVH::getItemBounds(uint32_t itemIdx) const {
+  uint32_t lane = m_itemLanes[itemIdx];
+  AABB bounds;
+  bounds.min = glm::vec3(m_minX[lane], m_minY[lane], m_minZ[lane]);
+  bounds.max = glm::vec3(m_maxX[lane], m_maxY[lane], m_maxZ[lane]);
+  return bounds;
+}
+
+uint32_t SceneBVH::_buildRecursive(
+    gsl::span<const AABB> bounds,
+    std::vector<uint32_t>& items,
+    uint32_t first,
+    uint32_t count) {
+  uint32_t nodeIdx = static_cast<uint32_t>(m_nodes.size());
+  m_nodes.emplace_back();
+
+  AABB nodeBounds = AABB::createEmpty();
+  AABB centroidBounds = AABB::createEmpty();
+  for (uint32_t i = first; i < first + count; ++i) {
+    const AABB& itemBounds = bounds[items[i]];
+    nodeBounds.expand(itemBounds);
+    centroidBounds.expand(0.5f * (itemBounds.min + itemBounds.max));
+  }
+
+  m_nodes[nodeIdx].bounds = nodeBounds;
+
+  if (count <= BVH_LEAF_SIZE) {
+    uint32_t packetIdx = static_cast<uint32_t>(m_packetItems.size() / 4);
+    m_minX.resize(m_minX.size() + 4);
+    m_minY.resize(m_minY.size() + 4);
+    m_minZ.resize(m_minZ.size() + 4);
+    m_maxX.resize(m_maxX.size() + 4);
+    m_maxY.resize(m_maxY.size() + 4);
+    m_maxZ.resize(m_maxZ.size() + 4);
+    m_packetItems.resize(m_packetItems.size() + 4, 0);
+
+    for (uint32_t lane = 0; lane < 4; ++lane) {
+      if (lane < count) {
+        uint32_t itemIdx = items[first + lane];
+        m_packetItems[4 * packetIdx + lane] = itemIdx;
+        m_itemLanes[itemIdx] = 4 * packetIdx + lane;
+        _writePacket(packetIdx, lane, bounds[itemIdx]);
+      } else {
+        _writePacket(packetIdx, lane, AABB::createEmpty());
+      }
+    }
+
+    m_nodes[nodeIdx].index = packetIdx;
+    m_nodes[nodeIdx].itemCount = count;
+    return nodeIdx;
+  }
+
+  // Median split along the largest axis of the centroid bounds
+  glm::vec3 extent = centroidBounds.max - centroidBounds.min;
+  int axis = 0;
+  if (extent.y > extent.x)
+    axis = 1;
+  if (extent.z > extent[axis])
+    axis = 2;
+
+  uint32_t leftCount = count / 2;
+  std::nth_element(
+      items.begin() + first,
+      items.begin() + first + leftCount,
+      items.begin() + first + count,
+      [&bounds, axis](uint32_t a, uint32_t b) {
+        return (bounds[a].min[axis] + bounds[a].max[axis]) <
+               (bounds[b].min[axis] + bounds[b].max[axis]);
+      });
+
+  _buildRecursive(bounds, items, first, leftCount);
+  uint32_t rightIdx =
+      _buildRecursive(bounds, items, first + leftCount, count - leftCount);
+
+  m_nodes[nodeIdx].index = rightIdx;
+  m_nodes[nodeIdx].itemCount = 0;
+  return nodeIdx;
+}
+
+void SceneBVH::_writePacket(
+    uint32_t packetIdx,
+    uint32_t lane,
+    const AABB& bounds) {
+  size_t i = 4 * static_cast<size_t>(packetIdx) + lane;
+  m_minX[i] = bounds.min.x;
+  m_minY[i] = bounds.min.y;
+  m_minZ[i] = bounds.min.z;
+  m_maxX[i] = bounds.max.x;
+  m_maxY[i] = bounds.max.y;
+  m_maxZ[i] = bounds.max.z;
+}
+
+void SceneBVH::_refitNodes() {
+  // Children always come after their parent, so a reverse sweep updates
+  // every node after its children
+  for (size_t i = m_nodes.size(); i-- > 0;) {
+    Node& node = m_nodes[i];
+    node.bounds = AABB::createEmpty();
+    if (node.itemCount > 0) {
+      for (uint32_t lane = 0; lane < node.itemCount; ++lane) {
+        size_t j = 4 * static_cast<size_t>(node.index) + lane;
+        node.bounds.expand(glm::vec3(m_minX[j], m_minY[j], m_minZ[j]));
+        node.bounds.expand(glm::vec3(m_maxX[j], m_maxY[j], m_maxZ[j]));
+      }
+    } else {
+      node.bounds.expand(m_nodes[i + 1].bounds);
+      node.bounds.expand(m_nodes[node.index].bounds);
+    }
+  }
+}
+
+void SceneBVH::_gatherInstanceBounds(
+    const std::vector<Model>& models,
+    std::vector<AABB>& bounds) const {
+  bounds.clear();
+  bounds.reserve(m_instances.size());
+  for (const PrimitiveInstanceRef& instance : m_instances) {
+    const Model& model = models[instance.modelIdx];
+    const Primitive& primitive = model.getPrimitives()[instance.primitiveIdx];
+    uint32_t nodeIdx = primitive.getInstanceNodes()[instance.instanceIdx];
+    bounds.push_back(primitive.computeWorldAABB(
+        model.getTransformsBuffer().getVertices()[nodeIdx]));
+  }
+}
+} // namespace AltheaEngine
@@ -97,6 +97,44 @@ void ScreenSpaceReflection::convolveReflectionBuffer(
       VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
 }
 
+void ScreenSpaceReflection::addToRenderGraph(
+    const Application& app,
+    RenderGraph& graph,
+    const GBufferGraphHandles& gBuffer,
+    VkDescriptorSet heapSet,
+    UniformHandle globalUniforms,
+    BufferHandle globalResources) {
+  RenderGraphPassBuilder capturePass = graph.addPass(
+      "SSR Capture",
+      [this, &app, heapSet, globalUniforms, globalResources](
+          const RenderGraphContext& context) {
+        this->captureReflection(
+            app,
+            context.commandBuffer,
+            heapSet,
+            context.frame,
+            globalUniforms,
+            globalResources);
+      });
+  GBufferResources::readTextures(
+      capturePass,
+      gBuffer,
+      VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+  capturePass.setSideEffects();
+
+  graph
+      .addPass(
+          "SSR Convolve",
+          [this, &app, heapSet](const RenderGraphContext& context) {
+            this->convolveReflectionBuffer(
+                app,
+                context.commandBuffer,
+                heapSet,
+                context.frame);
+          })
+      .setSideEffects();
+}
+
 void ScreenSpaceReflection::bindTexture(ResourcesAssignment& assignment) const {
   this->_reflectionBuffer.bindTexture(assignment);
 }
@@ -1,88 +1,13 @@
 #include "Shader.h"
 
 #include "Application.h"
+#include "ShaderCompiler.h"
 #include "Utilities.h"
 #include "sha256.h"
 
 #include <stdexcept>
 
 namespace AltheaEngine {
-namespace {
-struct IncludedShader {
-  std::string sourceName;
-  std::vector<char> sourceContent;
-};
-
-class AltheaShaderIncluder : public shaderc::CompileOptions::IncluderInterface {
-private:
-  std::filesystem::path _shaderPath;
-
-public:
-  AltheaShaderIncluder(const std::filesystem::path& shaderPath)
-      : _shaderPath(shaderPath) {}
-
-  virtual shaderc_include_result* GetInclude(
-      const char* requested_source,
-      shaderc_include_type type,
-      const char* requesting_source,
-      size_t include_depth) override {
-
-    IncludedShader* pIncludedShader = new IncludedShader();
-    pIncludedShader->sourceName = std::string(requested_source);
-
-    std::filesystem::path includedShaderPath;
-    if (type == shaderc_include_type_relative) {
-      includedShaderPath = std::filesystem::path(this->_shaderPath)
-                               .replace_filename(pIncludedShader->sourceName);
-    } else { // type == shaderc_include_type_standard
-      // TODO: formalize this as configurable shader "include paths"
-
-      // First search the project shader directory
-      includedShaderPath =
-          std::filesystem::path(GProjectDirectory + "/Shaders/")
-              .replace_filename(pIncludedShader->sourceName);
-      if (!Utilities::checkFileExists(includedShaderPath.string())) {
-        // Then search the engine shader directory
-        includedShaderPath =
-            std::filesystem::path(GEngineDirectory + "/Shaders/")
-                .replace_filename(pIncludedShader->sourceName);
-        if (!Utilities::checkFileExists(includedShaderPath.string())) {
-          // TODO: this local path needs to be relative to the requesting shader...
-          // not the original top-level shader.
-          // Else, assume the shader is in the same directory
-          includedShaderPath =
-              std::filesystem::path(this->_shaderPath)
-                  .replace_filename(pIncludedShader->sourceName);
-        }
-      }
-    }
-
-    if (!Utilities::checkFileExists(includedShaderPath.string())) {
-      return new shaderc_include_result();
-    }
-
-    pIncludedShader->sourceContent =
-        Utilities::readFile(includedShaderPath.string());
-
-    shaderc_include_result* pResult = new shaderc_include_result();
-
-    pResult->source_name = pIncludedShader->sourceName.c_str();
-    pResult->source_name_length = pIncludedShader->sourceName.length();
-    pResult->content = pIncludedShader->sourceContent.data();
-    pResult->content_length = pIncludedShader->sourceContent.size();
-    pResult->user_data = (void*)pIncludedShader;
-
-    return pResult;
-  }
-
-  virtual void ReleaseInclude(shaderc_include_result* data) override {
-    IncludedShader* pIncludedShader = (IncludedShader*)data->user_data;
-    delete pIncludedShader;
-    delete data;
-  }
-};
-} // namespace
-
 static bool s_shouldGenerateDebugInfo = false;
 
 /*static*/
@@ -136,72 +61,118 @@ ShaderBuilder::ShaderBuilder(
   SHA256 sha256;
   this->_fileHash = sha256(this->_code.data(), this->_code.size());
 
-  this->recompile();
+  this->_pWatchState = std::make_shared<ShaderWatchState>();
+  ShaderFileWatcher::watch(this->_pWatchState, {this->_path.string()});
+
+  // Compile in the background, so shaders for all the pipelines being set up
+  // compile in parallel
+  this->recompileAsync();
 }
 
 bool ShaderBuilder::recompile() {
-  this->_errors.clear();
-
-  // Compile the glsl shader into spirv bytecode
-  shaderc::Compiler compiler;
-  shaderc::CompileOptions options;
-
-  // TODO: Hot-reloading does not currently work for "included" shader files
-  // dummy changes need to be made in the main shader file
-  options.SetIncluder(std::make_unique<AltheaShaderIncluder>(_path));
-  if (_language == SHADER_LANGUAGE_HLSL)
-    options.SetSourceLanguage(shaderc_source_language_hlsl);
-  else
-    options.SetSourceLanguage(shaderc_source_language_glsl);
-  options.SetTargetEnvironment(shaderc_target_env_vulkan, shaderc_env_version_vulkan_1_3);
-
-  if (s_shouldGenerateDebugInfo)
-    options.SetGenerateDebugInfo();
-
-  // options.SetWarningsAsErrors
-
-  // Add shader defines
-  for (auto& it : this->_defines) {
-    if (it.second == "") {
-      options.AddMacroDefinition(it.first);
-    } else {
-      options.AddMacroDefinition(it.first, it.second);
-    }
+  this->recompileAsync();
+  return this->waitForCompile();
+}
+
+void ShaderBuilder::recompileAsync() {
+  this->_pendingCompile = ShaderCompiler::submit(this->_createCompileJob());
+}
+
+bool ShaderBuilder::waitForCompile() const {
+  if (this->_pendingCompile.valid()) {
+    const ShaderCompileResult& result =
+        ShaderCompiler::wait(this->_pendingCompile);
+    this->_errors = result.errors;
+    // Keep the last working bytecode around if compilation failed
+    if (result.succeeded())
+      this->_spirvBytecode = result.spirv;
+
+    // Includes may have changed along with the source
+    this->_includedFiles = result.includedFiles;
+    if (this->_pWatchState)
+      ShaderFileWatcher::watch(this->_pWatchState, this->_includedFiles);
+
+    this->_pendingCompile = {};
   }
 
-  options.SetTargetSpirv(shaderc_spirv_version_1_4);
+  return this->_errors.empty();
+}
+
+ShaderCompileJob ShaderBuilder::_createCompileJob() const {
+  ShaderCompileJob job{};
+  job.path = this->_path;
+  job.kind = this->_kind;
+  job.language = this->_language;
+  job.defines = this->_defines;
+  job.code = this->_code;
 
+  job.generateDebugInfo = s_shouldGenerateDebugInfo;
 #if !NDEBUG
-  options.SetGenerateDebugInfo();
+  job.generateDebugInfo = true;
 #endif
 
-  shaderc::SpvCompilationResult result = compiler.CompileGlslToSpv(
-      this->_code.data(),
-      this->_code.size(),
-      this->_kind,
-      // TODO: Should we use the short-path instead as the name
-      this->_path.string().c_str(),
-      options);
+  return job;
+}
 
-  if (result.GetCompilationStatus() != shaderc_compilation_status_success) {
-    this->_errors = result.GetErrorMessage();
-    return false;
+VkShaderStageFlagBits ShaderBuilder::getStage() const {
+  switch (this->_kind) {
+  case shaderc_vertex_shader:
+    return VK_SHADER_STAGE_VERTEX_BIT;
+  case shaderc_fragment_shader:
+    return VK_SHADER_STAGE_FRAGMENT_BIT;
+  case shaderc_compute_shader:
+    return VK_SHADER_STAGE_COMPUTE_BIT;
+  case shaderc_geometry_shader:
+    return VK_SHADER_STAGE_GEOMETRY_BIT;
+  case shaderc_tess_control_shader:
+    return VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT;
+  case shaderc_tess_evaluation_shader:
+    return VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT;
+  case shaderc_raygen_shader:
+    return VK_SHADER_STAGE_RAYGEN_BIT_KHR;
+  case shaderc_anyhit_shader:
+    return VK_SHADER_STAGE_ANY_HIT_BIT_KHR;
+  case shaderc_closesthit_shader:
+    return VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR;
+  case shaderc_miss_shader:
+    return VK_SHADER_STAGE_MISS_BIT_KHR;
+  case shaderc_intersection_shader:
+    return VK_SHADER_STAGE_INTERSECTION_BIT_KHR;
+  case shaderc_callable_shader:
+    return VK_SHADER_STAGE_CALLABLE_BIT_KHR;
+  case shaderc_task_shader:
+    return VK_SHADER_STAGE_TASK_BIT_EXT;
+  case shaderc_mesh_shader:
+    return VK_SHADER_STAGE_MESH_BIT_EXT;
+  default:
+    throw std::runtime_error("Unsupported shader kind!");
   }
+}
 
-  this->_spirvBytecode = std::vector<uint32_t>(result.begin(), result.end());
-  return true;
+ShaderReflection ShaderBuilder::reflect() const {
+  // Compilation errors are reported when the shader module is created
+  if (!this->waitForCompile() || this->_spirvBytecode.empty())
+    return ShaderReflection();
+
+  return ShaderReflection(this->_spirvBytecode, this->getStage());
 }
 
 bool ShaderBuilder::reloadIfStale() {
+  // The watcher tracks the shader and all of its includes, so the file only
+  // needs to be touched once something it depends on actually changed
+  bool watched = this->_pWatchState && ShaderFileWatcher::isActive();
+  if (watched && !this->_pWatchState->dirty.exchange(false))
+    return false;
+
   std::vector<char> currentGlslCode = Utilities::readFile(this->_path.string());
 
   SHA256 sha256;
   std::string currentHash =
       sha256(currentGlslCode.data(), currentGlslCode.size());
 
-  // TODO: Implement recursive stale-checking of included shader files
+  // Without the watcher, changes to included files can't be detected
 #ifdef HOTRELOAD_CHECK_STALE
-  if (currentHash == this->_fileHash) {
+  if (!watched && currentHash == this->_fileHash) {
     return false;
   }
 #endif
@@ -0,0 +1,310 @@
+#include "ShaderCache.h"
+
+#include "Application.h"
+#include "sha256.h"
+
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <thread>
+
+namespace AltheaEngine {
+namespace {
+// 'ASPV'
+constexpr uint32_t SHADER_CACHE_MAGIC = 0x56505341;
+constexpr uint32_t SHADER_CACHE_VERSION = 2;
+
+struct ShaderCacheEntryHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t includeCount;
+  uint32_t spirvWordCount;
+};
+
+std::mutex s_directoryMutex;
+std::string s_directory;
+std::atomic<bool> s_enabled{true};
+
+std::atomic<uint32_t> s_hits{0};
+std::atomic<uint32_t> s_misses{0};
+std::atomic<uint32_t> s_staleEntries{0};
+std::atomic<uint32_t> s_writes{0};
+std::atomic<uint32_t> s_writeFailures{0};
+
+bool readWholeFile(const std::string& path, std::vector<char>& result) {
+  std::ifstream file(path, std::ios::ate | std::ios::binary);
+  if (!file.is_open())
+    return false;
+
+  size_t size = static_cast<size_t>(file.tellg());
+  result.resize(size);
+  file.seekg(0);
+  file.read(result.data(), size);
+  return file.good();
+}
+
+std::string getEntryPath(const std::string& key) {
+  return ShaderCache::getDirectory() + "/" + key + ".spvc";
+}
+
+// Reads sequentially from an entry, failing once the data runs out
+class EntryReader {
+public:
+  EntryReader(const std::vector<char>& data) : m_data(data) {}
+
+  bool read(void* pDst, size_t size) {
+    if (m_offset + size > m_data.size())
+      return false;
+
+    std::memcpy(pDst, m_data.data() + m_offset, size);
+    m_offset += size;
+    return true;
+  }
+
+  bool readString(std::string& str) {
+    uint32_t length;
+    if (!read(&length, sizeof(length)) || m_offset + length > m_data.size())
+      return false;
+
+    str.assign(m_data.data() + m_offset, length);
+    m_offset += length;
+    return true;
+  }
+
+private:
+  const std::vector<char>& m_data;
+  size_t m_offset = 0;
+};
+
+// Prefixes of portable paths, standing in for the engine and project
+// directories
+constexpr char ENGINE_PATH_PREFIX[] = "$engine/";
+constexpr char PROJECT_PATH_PREFIX[] = "$project/";
+
+std::string normalizePath(const std::string& path) {
+  std::error_code errorCode;
+  std::filesystem::path absolutePath =
+      std::filesystem::absolute(std::filesystem::path(path), errorCode);
+  if (errorCode)
+    return path;
+  return absolutePath.lexically_normal().generic_string();
+}
+
+// The path relative to the directory, if it is within it
+bool getRelativePath(
+    const std::string& path,
+    const std::string& directory,
+    std::string& relativePath) {
+  if (directory.empty())
+    return false;
+
+  std::string normalizedDirectory = normalizePath(directory);
+  if (normalizedDirectory.back() != '/')
+    normalizedDirectory += '/';
+  if (path.compare(0, normalizedDirectory.size(), normalizedDirectory) != 0)
+    return false;
+
+  relativePath = path.substr(normalizedDirectory.size());
+  return true;
+}
+
+void writeString(std::vector<char>& data, const std::string& str) {
+  uint32_t length = static_cast<uint32_t>(str.size());
+  const char* pLength = reinterpret_cast<const char*>(&length);
+  data.insert(data.end(), pLength, pLength + sizeof(length));
+  data.insert(data.end(), str.begin(), str.end());
+}
+} // namespace
+
+/*static*/
+void ShaderCache::setDirectory(const std::string& directory) {
+  std::lock_guard<std::mutex> lock(s_directoryMutex);
+  s_directory = directory;
+}
+
+/*static*/
+std::string ShaderCache::getDirectory() {
+  std::lock_guard<std::mutex> lock(s_directoryMutex);
+  if (s_directory.empty())
+    return GProjectDirectory + "/Cache/Shaders";
+  return s_directory;
+}
+
+/*static*/
+void ShaderCache::setEnabled(bool enabled) { s_enabled = enabled; }
+
+/*static*/
+bool ShaderCache::isEnabled() { return s_enabled; }
+
+/*static*/
+std::string ShaderCache::hashFile(gsl::span<const char> content) {
+  SHA256 sha256;
+  return sha256(content.data(), content.size());
+}
+
+/*static*/
+std::string ShaderCache::getPortablePath(const std::string& path) {
+  std::string normalizedPath = normalizePath(path);
+
+  // The project may live within the engine directory, prefer the closer of
+  // the two
+  std::string enginePath;
+  std::string projectPath;
+  bool inEngine = getRelativePath(normalizedPath, GEngineDirectory, enginePath);
+  bool inProject =
+      getRelativePath(normalizedPath, GProjectDirectory, projectPath);
+  if (inProject && (!inEngine || projectPath.size() <= enginePath.size()))
+    return PROJECT_PATH_PREFIX + projectPath;
+  if (inEngine)
+    return ENGINE_PATH_PREFIX + enginePath;
+
+  return normalizedPath;
+}
+
+/*static*/
+std::string ShaderCache::resolvePortablePath(const std::string& path) {
+  auto hasPrefix = [&](const char* prefix, size_t prefixLength) {
+    return path.compare(0, prefixLength, prefix) == 0;
+  };
+
+  constexpr size_t engineLength = sizeof(ENGINE_PATH_PREFIX) - 1;
+  constexpr size_t projectLength = sizeof(PROJECT_PATH_PREFIX) - 1;
+  if (hasPrefix(ENGINE_PATH_PREFIX, engineLength))
+    return GEngineDirectory + "/" + path.substr(engineLength);
+  if (hasPrefix(PROJECT_PATH_PREFIX, projectLength))
+    return GProjectDirectory + "/" + path.substr(projectLength);
+
+  return path;
+}
+
+/*static*/
+bool ShaderCache::load(
+    const std::string& key,
+    std::vector<uint32_t>& spirv,
+    std::vector<IncludedFile>& includes) {
+  if (!s_enabled)
+    return false;
+
+  std::vector<char> data;
+  if (!readWholeFile(getEntryPath(key), data)) {
+    ++s_misses;
+    return false;
+  }
+
+  EntryReader reader(data);
+  ShaderCacheEntryHeader header;
+  if (!reader.read(&header, sizeof(header)) ||
+      header.magic != SHADER_CACHE_MAGIC ||
+      header.version != SHADER_CACHE_VERSION) {
+    ++s_misses;
+    return false;
+  }
+
+  // Every included file must still resolve to the same contents
+  includes.clear();
+  std::vector<char> includeContent;
+  for (uint32_t i = 0; i < header.includeCount; ++i) {
+    IncludedFile& include = includes.emplace_back();
+    if (!reader.readString(include.path) ||
+        !reader.readString(include.hash)) {
+      includes.clear();
+      ++s_misses;
+      return false;
+    }
+
+    include.path = resolvePortablePath(include.path);
+    if (!readWholeFile(include.path, includeContent) ||
+        hashFile(includeContent) != include.hash) {
+      includes.clear();
+      ++s_staleEntries;
+      return false;
+    }
+  }
+
+  spirv.resize(header.spirvWordCount);
+  if (header.spirvWordCount == 0 ||
+      !reader.read(spirv.data(), spirv.size() * sizeof(uint32_t))) {
+    spirv.clear();
+    includes.clear();
+    ++s_misses;
+    return false;
+  }
+
+  ++s_hits;
+  return true;
+}
+
+/*static*/
+void ShaderCache::store(
+    const std::string& key,
+    const std::vector<IncludedFile>& includes,
+    gsl::span<const uint32_t> spirv) {
+  if (!s_enabled)
+    return;
+
+  ShaderCacheEntryHeader header{};
+  header.magic = SHADER_CACHE_MAGIC;
+  header.version = SHADER_CACHE_VERSION;
+  header.includeCount = static_cast<uint32_t>(includes.size());
+  header.spirvWordCount = static_cast<uint32_t>(spirv.size());
+
+  std::vector<char> data;
+  const char* pHeader = reinterpret_cast<const char*>(&header);
+  data.insert(data.end(), pHeader, pHeader + sizeof(header));
+  for (const IncludedFile& include : includes) {
+    writeString(data, getPortablePath(include.path));
+    writeString(data, include.hash);
+  }
+  const char* pSpirv = reinterpret_cast<const char*>(spirv.data());
+  data.insert(data.end(), pSpirv, pSpirv + spirv.size_bytes());
+
+  std::error_code errorCode;
+  std::filesystem::create_directories(getDirectory(), errorCode);
+
+  // Unique per thread so concurrent writers of the same key don't collide
+  std::string entryPath = getEntryPath(key);
+  std::string tempPath =
+      entryPath + "." +
+      std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id())) +
+      ".tmp";
+  {
+    std::ofstream file(tempPath, std::ios::out | std::ios::binary);
+    file.write(data.data(), data.size());
+    if (!file.good()) {
+      ++s_writeFailures;
+      return;
+    }
+  }
+
+  std::filesystem::rename(tempPath, entryPath, errorCode);
+  if (errorCode) {
+    std::filesystem::remove(tempPath, errorCode);
+    ++s_writeFailures;
+    return;
+  }
+
+  ++s_writes;
+}
+
+/*static*/
+ShaderCacheStats ShaderCache::getStats() {
+  ShaderCacheStats stats{};
+  stats.hits = s_hits;
+  stats.misses = s_misses;
+  stats.staleEntries = s_staleEntries;
+  stats.writes = s_writes;
+  stats.writeFailures = s_writeFailures;
+  return stats;
+}
+
+/*static*/
+void ShaderCache::resetStats() {
+  s_hits = 0;
+  s_misses = 0;
+  s_staleEntries = 0;
+  s_writes = 0;
+  s_writeFailures = 0;
+}
+} // namespace AltheaEngine
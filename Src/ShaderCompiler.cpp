@@ -0,0 +1,294 @@
+#include "ShaderCompiler.h"
+
+#include "Application.h"
+#include "ShaderCache.h"
+#include "ShaderVariantArchive.h"
+#include "ThreadPool.h"
+#include "Utilities.h"
+#include "sha256.h"
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+
+namespace AltheaEngine {
+namespace {
+struct IncludedShader {
+  std::string sourceName;
+  std::vector<char> sourceContent;
+};
+
+class AltheaShaderIncluder : public shaderc::CompileOptions::IncluderInterface {
+private:
+  std::filesystem::path _shaderPath;
+  // Every file resolved while compiling, for validating shader cache entries
+  std::vector<ShaderCache::IncludedFile>* _pIncludedFiles;
+
+public:
+  AltheaShaderIncluder(
+      const std::filesystem::path& shaderPath,
+      std::vector<ShaderCache::IncludedFile>* pIncludedFiles)
+      : _shaderPath(shaderPath), _pIncludedFiles(pIncludedFiles) {}
+
+  virtual shaderc_include_result* GetInclude(
+      const char* requested_source,
+      shaderc_include_type type,
+      const char* requesting_source,
+      size_t include_depth) override {
+
+    IncludedShader* pIncludedShader = new IncludedShader();
+    pIncludedShader->sourceName = std::string(requested_source);
+
+    std::filesystem::path includedShaderPath;
+    if (type == shaderc_include_type_relative) {
+      includedShaderPath = std::filesystem::path(this->_shaderPath)
+                               .replace_filename(pIncludedShader->sourceName);
+    } else { // type == shaderc_include_type_standard
+      // TODO: formalize this as configurable shader "include paths"
+
+      // First search the project shader directory
+      includedShaderPath =
+          std::filesystem::path(GProjectDirectory + "/Shaders/")
+              .replace_filename(pIncludedShader->sourceName);
+      if (!Utilities::checkFileExists(includedShaderPath.string())) {
+        // Then search the engine shader directory
+        includedShaderPath =
+            std::filesystem::path(GEngineDirectory + "/Shaders/")
+                .replace_filename(pIncludedShader->sourceName);
+        if (!Utilities::checkFileExists(includedShaderPath.string())) {
+          // TODO: this local path needs to be relative to the requesting shader...
+          // not the original top-level shader.
+          // Else, assume the shader is in the same directory
+          includedShaderPath =
+              std::filesystem::path(this->_shaderPath)
+                  .replace_filename(pIncludedShader->sourceName);
+        }
+      }
+    }
+
+    if (!Utilities::checkFileExists(includedShaderPath.string())) {
+      return new shaderc_include_result();
+    }
+
+    pIncludedShader->sourceContent =
+        Utilities::readFile(includedShaderPath.string());
+
+    // Headers are commonly included more than once, behind include guards
+    std::string includedPath = includedShaderPath.string();
+    auto includedIt = std::find_if(
+        _pIncludedFiles->begin(),
+        _pIncludedFiles->end(),
+        [&](const ShaderCache::IncludedFile& included) {
+          return included.path == includedPath;
+        });
+    if (includedIt == _pIncludedFiles->end()) {
+      _pIncludedFiles->push_back(
+          {includedPath,
+           ShaderCache::hashFile(pIncludedShader->sourceContent)});
+    }
+
+    shaderc_include_result* pResult = new shaderc_include_result();
+
+    pResult->source_name = pIncludedShader->sourceName.c_str();
+    pResult->source_name_length = pIncludedShader->sourceName.length();
+    pResult->content = pIncludedShader->sourceContent.data();
+    pResult->content_length = pIncludedShader->sourceContent.size();
+    pResult->user_data = (void*)pIncludedShader;
+
+    return pResult;
+  }
+
+  virtual void ReleaseInclude(shaderc_include_result* data) override {
+    IncludedShader* pIncludedShader = (IncludedShader*)data->user_data;
+    delete pIncludedShader;
+    delete data;
+  }
+};
+
+ShaderCompileResult
+compileWithCompiler(shaderc::Compiler& compiler, const ShaderCompileJob& job) {
+  ShaderCompileResult compileResult{};
+
+  std::string cacheKey = ShaderCompiler::computeCacheKey(job);
+  std::vector<ShaderCache::IncludedFile> includedFiles;
+  // Precompiled variants are a probe into a single mapped file, so check
+  // them before the per-entry files of the cache
+  if (ShaderVariantArchive::load(
+          cacheKey,
+          compileResult.spirv,
+          includedFiles) ||
+      ShaderCache::load(cacheKey, compileResult.spirv, includedFiles)) {
+    for (const ShaderCache::IncludedFile& included : includedFiles)
+      compileResult.includedFiles.push_back(included.path);
+    return compileResult;
+  }
+
+  shaderc::CompileOptions options;
+
+  options.SetIncluder(
+      std::make_unique<AltheaShaderIncluder>(job.path, &includedFiles));
+  if (job.language == SHADER_LANGUAGE_HLSL)
+    options.SetSourceLanguage(shaderc_source_language_hlsl);
+  else
+    options.SetSourceLanguage(shaderc_source_language_glsl);
+  options.SetTargetEnvironment(
+      shaderc_target_env_vulkan,
+      shaderc_env_version_vulkan_1_3);
+
+  if (job.generateDebugInfo)
+    options.SetGenerateDebugInfo();
+
+  // options.SetWarningsAsErrors
+
+  // Add shader defines
+  for (auto& it : job.defines) {
+    if (it.second == "") {
+      options.AddMacroDefinition(it.first);
+    } else {
+      options.AddMacroDefinition(it.first, it.second);
+    }
+  }
+
+  options.SetTargetSpirv(shaderc_spirv_version_1_4);
+
+  shaderc::SpvCompilationResult result = compiler.CompileGlslToSpv(
+      job.code.data(),
+      job.code.size(),
+      job.kind,
+      // TODO: Should we use the short-path instead as the name
+      job.path.string().c_str(),
+      options);
+
+  // Record the includes even on failure, so fixing a broken header still
+  // triggers a hot reload
+  for (const ShaderCache::IncludedFile& included : includedFiles)
+    compileResult.includedFiles.push_back(included.path);
+
+  if (result.GetCompilationStatus() != shaderc_compilation_status_success) {
+    compileResult.errors = result.GetErrorMessage();
+    if (compileResult.errors.empty())
+      compileResult.errors = "Failed to compile " + job.path.string();
+    return compileResult;
+  }
+
+  compileResult.spirv = std::vector<uint32_t>(result.begin(), result.end());
+  ShaderCache::store(cacheKey, includedFiles, compileResult.spirv);
+  return compileResult;
+}
+
+// One compiler per worker of the shared pool, each only ever used by its own
+// worker. Threads outside of the pool, e.g. ones running queued compiles
+// while they wait, use a compiler of their own.
+shaderc::Compiler& getCurrentCompiler() {
+  ThreadPool& pool = ThreadPool::getShared();
+  uint32_t workerIdx = pool.getCurrentWorkerIndex();
+  if (workerIdx == pool.getThreadCount()) {
+    thread_local shaderc::Compiler compiler;
+    return compiler;
+  }
+
+  // Never destroyed, the pool may still run queued compiles while statics
+  // are torn down at exit
+  static std::vector<std::unique_ptr<shaderc::Compiler>>* s_pCompilers =
+      new std::vector<std::unique_ptr<shaderc::Compiler>>(
+          pool.getThreadCount());
+  std::unique_ptr<shaderc::Compiler>& pCompiler = (*s_pCompilers)[workerIdx];
+  if (!pCompiler)
+    pCompiler = std::make_unique<shaderc::Compiler>();
+  return *pCompiler;
+}
+
+std::shared_future<ShaderCompileResult> submitToPool(ShaderCompileJob&& job) {
+  // Tasks must be copyable, so the packaged task is shared with the pool
+  auto pTask = std::make_shared<std::packaged_task<ShaderCompileResult()>>(
+      [job = std::move(job)]() {
+        return compileWithCompiler(getCurrentCompiler(), job);
+      });
+  std::shared_future<ShaderCompileResult> future =
+      pTask->get_future().share();
+  ThreadPool::getShared().submit([pTask]() { (*pTask)(); });
+  return future;
+}
+} // namespace
+
+/*static*/
+std::shared_future<ShaderCompileResult>
+ShaderCompiler::submit(ShaderCompileJob&& job) {
+  return submitToPool(std::move(job));
+}
+
+/*static*/
+std::vector<std::shared_future<ShaderCompileResult>>
+ShaderCompiler::submitBatch(std::vector<ShaderCompileJob>&& jobs) {
+  std::vector<std::shared_future<ShaderCompileResult>> futures;
+  futures.reserve(jobs.size());
+  for (ShaderCompileJob& job : jobs)
+    futures.push_back(submitToPool(std::move(job)));
+
+  return futures;
+}
+
+/*static*/
+const ShaderCompileResult&
+ShaderCompiler::wait(const std::shared_future<ShaderCompileResult>& future) {
+  ThreadPool::getShared().waitUntil([&future]() {
+    return future.wait_for(std::chrono::seconds(0)) ==
+           std::future_status::ready;
+  });
+  return future.get();
+}
+
+/*static*/
+ShaderCompileResult ShaderCompiler::compile(const ShaderCompileJob& job) {
+  return compileWithCompiler(getCurrentCompiler(), job);
+}
+
+/*static*/
+std::string ShaderCompiler::computeCacheKey(const ShaderCompileJob& job) {
+  SHA256 sha256;
+  auto addString = [&](const std::string& str) {
+    // Length prefixed, so neighboring strings can't be confused
+    uint64_t length = str.size();
+    sha256.add(&length, sizeof(length));
+    sha256.add(str.data(), str.size());
+  };
+
+  sha256.add(job.code.data(), job.code.size());
+
+  // Includes resolve relative to the shader and the shader directories. The
+  // path is relative to those directories, so the same shader has the same
+  // key wherever the engine and project are checked out.
+  addString(ShaderCache::getPortablePath(job.path.string()));
+
+  uint32_t kind = static_cast<uint32_t>(job.kind);
+  uint32_t language = static_cast<uint32_t>(job.language);
+  sha256.add(&kind, sizeof(kind));
+  sha256.add(&language, sizeof(language));
+
+  // Defines are unordered, sort them so the key is stable
+  std::vector<std::pair<std::string, std::string>> defines(
+      job.defines.begin(),
+      job.defines.end());
+  std::sort(defines.begin(), defines.end());
+  for (const auto& define : defines) {
+    addString(define.first);
+    addString(define.second);
+  }
+
+  // Compiler options, along with the compiler's own version
+  uint32_t options[] = {
+      shaderc_target_env_vulkan,
+      shaderc_env_version_vulkan_1_3,
+      shaderc_spirv_version_1_4,
+      job.generateDebugInfo ? 1u : 0u};
+  sha256.add(options, sizeof(options));
+
+  unsigned int spvVersion = 0;
+  unsigned int spvRevision = 0;
+  shaderc_get_spv_version(&spvVersion, &spvRevision);
+  sha256.add(&spvVersion, sizeof(spvVersion));
+  sha256.add(&spvRevision, sizeof(spvRevision));
+
+  return sha256.getHash();
+}
+} // namespace AltheaEngine
@@ -0,0 +1,181 @@
+#include "ShaderFileWatcher.h"
+
+#include <filesystem>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace AltheaEngine {
+namespace {
+std::atomic<bool> s_enabled{true};
+
+#ifdef __linux__
+std::string normalizePath(const std::string& path) {
+  std::error_code errorCode;
+  std::filesystem::path normalized =
+      std::filesystem::weakly_canonical(path, errorCode);
+  if (errorCode)
+    return std::filesystem::path(path).lexically_normal().string();
+  return normalized.string();
+}
+
+class InotifyWatcher {
+public:
+  InotifyWatcher(int fd) : _fd(fd) {
+    this->_thread = std::thread([this]() { this->_run(); });
+  }
+
+  ~InotifyWatcher() {
+    this->_stopping = true;
+    this->_thread.join();
+    close(this->_fd);
+  }
+
+  void watch(
+      const std::shared_ptr<ShaderWatchState>& pState,
+      const std::vector<std::string>& files) {
+    std::lock_guard<std::mutex> lock(this->_mutex);
+    for (const std::string& file : files) {
+      std::filesystem::path path = normalizePath(file);
+
+      // Editors often save by replacing the file, so watch the directory
+      // rather than the file itself
+      std::string directory = path.parent_path().string();
+      if (this->_directoryWatches.find(directory) ==
+          this->_directoryWatches.end()) {
+        int wd = inotify_add_watch(
+            this->_fd,
+            directory.c_str(),
+            IN_CLOSE_WRITE | IN_MOVED_TO);
+        if (wd < 0)
+          continue;
+
+        this->_directoryWatches.emplace(directory, wd);
+        this->_watchDirectories.emplace(wd, directory);
+      }
+
+      std::vector<std::weak_ptr<ShaderWatchState>>& dependents =
+          this->_dependents[path.string()];
+
+      bool alreadyWatched = false;
+      for (size_t i = 0; i < dependents.size();) {
+        std::shared_ptr<ShaderWatchState> pDependent = dependents[i].lock();
+        if (!pDependent) {
+          // Drop shaders that no longer exist
+          dependents[i] = std::move(dependents.back());
+          dependents.pop_back();
+          continue;
+        }
+
+        alreadyWatched |= pDependent == pState;
+        ++i;
+      }
+
+      if (!alreadyWatched)
+        dependents.push_back(pState);
+    }
+  }
+
+private:
+  void _run() {
+    alignas(inotify_event) char buffer[4096];
+    while (!this->_stopping) {
+      // Wake up periodically to check whether we should stop
+      pollfd pollFd{};
+      pollFd.fd = this->_fd;
+      pollFd.events = POLLIN;
+      if (poll(&pollFd, 1, 100) <= 0)
+        continue;
+
+      ssize_t length = read(this->_fd, buffer, sizeof(buffer));
+      if (length <= 0)
+        continue;
+
+      std::lock_guard<std::mutex> lock(this->_mutex);
+      for (ssize_t offset = 0; offset < length;) {
+        const inotify_event* pEvent =
+            reinterpret_cast<const inotify_event*>(buffer + offset);
+        offset += sizeof(inotify_event) + pEvent->len;
+
+        if (pEvent->len == 0)
+          continue;
+
+        auto directoryIt = this->_watchDirectories.find(pEvent->wd);
+        if (directoryIt == this->_watchDirectories.end())
+          continue;
+
+        std::string path =
+            (std::filesystem::path(directoryIt->second) / pEvent->name)
+                .string();
+        auto dependentsIt = this->_dependents.find(path);
+        if (dependentsIt == this->_dependents.end())
+          continue;
+
+        for (const std::weak_ptr<ShaderWatchState>& dependent :
+             dependentsIt->second) {
+          if (std::shared_ptr<ShaderWatchState> pDependent = dependent.lock())
+            pDependent->dirty = true;
+        }
+      }
+    }
+  }
+
+  int _fd;
+  std::atomic<bool> _stopping{false};
+
+  std::mutex _mutex;
+  std::unordered_map<std::string, int> _directoryWatches;
+  std::unordered_map<int, std::string> _watchDirectories;
+  // Reverse include graph, from a file to every shader that depends on it
+  std::unordered_map<std::string, std::vector<std::weak_ptr<ShaderWatchState>>>
+      _dependents;
+
+  std::thread _thread;
+};
+
+std::unique_ptr<InotifyWatcher> createWatcher() {
+  if (!s_enabled)
+    return nullptr;
+
+  int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (fd < 0)
+    return nullptr;
+
+  return std::make_unique<InotifyWatcher>(fd);
+}
+
+InotifyWatcher* getWatcher() {
+  static std::unique_ptr<InotifyWatcher> s_pWatcher = createWatcher();
+  return s_pWatcher.get();
+}
+#endif
+} // namespace
+
+/*static*/
+void ShaderFileWatcher::setEnabled(bool enabled) { s_enabled = enabled; }
+
+/*static*/
+bool ShaderFileWatcher::isActive() {
+#ifdef __linux__
+  return getWatcher() != nullptr;
+#else
+  return false;
+#endif
+}
+
+/*static*/
+void ShaderFileWatcher::watch(
+    const std::shared_ptr<ShaderWatchState>& pState,
+    const std::vector<std::string>& files) {
+#ifdef __linux__
+  if (InotifyWatcher* pWatcher = getWatcher())
+    pWatcher->watch(pState, files);
+#endif
+}
+} // namespace AltheaEngine
@@ -0,0 +1,553 @@
+#include "ShaderReflection.h"
+
+#include "DescriptorSet.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <unordered_set>
+
+namespace AltheaEngine {
+namespace {
+constexpr uint32_t SPIRV_MAGIC = 0x07230203;
+constexpr uint32_t SPIRV_HEADER_WORDS = 5;
+
+// The handful of SPIR-V opcodes, decorations and storage classes needed to
+// find resource bindings, from the SPIR-V specification.
+enum SpvOp : uint32_t {
+  SpvOpName = 5,
+  SpvOpEntryPoint = 15,
+  SpvOpTypeBool = 20,
+  SpvOpTypeInt = 21,
+  SpvOpTypeFloat = 22,
+  SpvOpTypeVector = 23,
+  SpvOpTypeMatrix = 24,
+  SpvOpTypeImage = 25,
+  SpvOpTypeSampler = 26,
+  SpvOpTypeSampledImage = 27,
+  SpvOpTypeArray = 28,
+  SpvOpTypeRuntimeArray = 29,
+  SpvOpTypeStruct = 30,
+  SpvOpTypePointer = 32,
+  SpvOpConstant = 43,
+  SpvOpVariable = 59,
+  SpvOpDecorate = 71,
+  SpvOpMemberDecorate = 72,
+  SpvOpTypeAccelerationStructureKHR = 5341
+};
+
+enum SpvDecoration : uint32_t {
+  SpvDecorationBufferBlock = 3,
+  SpvDecorationRowMajor = 4,
+  SpvDecorationArrayStride = 6,
+  SpvDecorationMatrixStride = 7,
+  SpvDecorationBinding = 33,
+  SpvDecorationDescriptorSet = 34,
+  SpvDecorationOffset = 35
+};
+
+enum SpvStorageClass : uint32_t {
+  SpvStorageClassUniformConstant = 0,
+  SpvStorageClassUniform = 2,
+  SpvStorageClassPushConstant = 9,
+  SpvStorageClassStorageBuffer = 12
+};
+
+enum SpvDim : uint32_t { SpvDimBuffer = 5, SpvDimSubpassData = 6 };
+
+// Literal strings are null terminated and padded to a whole word
+std::string
+readLiteralString(gsl::span<const uint32_t> words, size_t& wordCount) {
+  const char* pChars = reinterpret_cast<const char*>(words.data());
+  size_t maxLength = words.size() * sizeof(uint32_t);
+  size_t length = std::find(pChars, pChars + maxLength, '\0') - pChars;
+  wordCount = length / sizeof(uint32_t) + 1;
+  return std::string(pChars, length);
+}
+
+struct SpvMember {
+  uint32_t offset = 0;
+  uint32_t matrixStride = 0;
+  bool rowMajor = false;
+};
+
+struct SpvId {
+  uint32_t opcode = 0;
+  // The operands following the result id
+  std::vector<uint32_t> operands;
+  std::string name;
+
+  // Decorations
+  uint32_t set = 0;
+  uint32_t binding = 0;
+  uint32_t arrayStride = 0;
+  bool bufferBlock = false;
+  std::vector<SpvMember> members;
+};
+
+class SpvModule {
+public:
+  SpvModule(gsl::span<const uint32_t> spirv) {
+    if (spirv.size() < SPIRV_HEADER_WORDS || spirv.data()[0] != SPIRV_MAGIC)
+      throw std::runtime_error("Attempting to reflect invalid SPIR-V!");
+
+    this->version = spirv.data()[1];
+    this->_ids.resize(spirv.data()[3]);
+
+    size_t offset = SPIRV_HEADER_WORDS;
+    while (offset < spirv.size()) {
+      uint32_t instruction = spirv.data()[offset];
+      uint32_t wordCount = instruction >> 16;
+      uint32_t opcode = instruction & 0xffff;
+      if (wordCount == 0 || offset + wordCount > spirv.size())
+        throw std::runtime_error("Attempting to reflect truncated SPIR-V!");
+
+      this->_parseInstruction(
+          opcode,
+          gsl::span<const uint32_t>(
+              spirv.data() + offset + 1,
+              wordCount - 1));
+      offset += wordCount;
+    }
+  }
+
+  const SpvId& get(uint32_t id) const {
+    if (id >= this->_ids.size())
+      throw std::runtime_error("Out of bounds SPIR-V id!");
+    return this->_ids[id];
+  }
+
+  uint32_t getConstant(uint32_t id) const {
+    const SpvId& constant = this->get(id);
+    if (constant.opcode != SpvOpConstant || constant.operands.size() < 2)
+      throw std::runtime_error("Expected a SPIR-V constant!");
+    // Operands: result type, value
+    return constant.operands[1];
+  }
+
+  /**
+   * @brief The size in bytes of the given type when laid out in a block.
+   * Runtime sized arrays take no space.
+   */
+  uint32_t getSize(uint32_t typeId, const SpvMember* pMember = nullptr) const {
+    const SpvId& type = this->get(typeId);
+    switch (type.opcode) {
+    case SpvOpTypeBool:
+      return 4;
+    case SpvOpTypeInt:
+    case SpvOpTypeFloat:
+      // Operands: width, ...
+      return type.operands[0] / 8;
+    case SpvOpTypeVector:
+      // Operands: component type, component count
+      return this->getSize(type.operands[0]) * type.operands[1];
+    case SpvOpTypeMatrix: {
+      // Operands: column type, column count
+      uint32_t stride = pMember ? pMember->matrixStride : 0;
+      const SpvId& column = this->get(type.operands[0]);
+      uint32_t rows = column.operands[1];
+      uint32_t columns = type.operands[1];
+      if (stride == 0)
+        return this->getSize(type.operands[0]) * columns;
+      return stride * (pMember->rowMajor ? rows : columns);
+    }
+    case SpvOpTypeArray:
+      // Operands: element type, length
+      return type.arrayStride * this->getConstant(type.operands[1]);
+    case SpvOpTypeRuntimeArray:
+      return 0;
+    case SpvOpTypeStruct: {
+      uint32_t size = 0;
+      for (size_t i = 0; i < type.operands.size(); ++i) {
+        const SpvMember* pStructMember =
+            i < type.members.size() ? &type.members[i] : nullptr;
+        uint32_t memberOffset = pStructMember ? pStructMember->offset : 0;
+        size = std::max(
+            size,
+            memberOffset + this->getSize(type.operands[i], pStructMember));
+      }
+      return size;
+    }
+    default:
+      return 0;
+    }
+  }
+
+  uint32_t version = 0;
+  std::vector<uint32_t> interfaceIds;
+  std::vector<uint32_t> variableIds;
+
+private:
+  void _parseInstruction(uint32_t opcode, gsl::span<const uint32_t> words) {
+    switch (opcode) {
+    case SpvOpName: {
+      // Operands: target, literal string
+      size_t nameWords;
+      this->_getMutable(words.data()[0]).name =
+          readLiteralString(words.subspan(1), nameWords);
+      break;
+    }
+    case SpvOpEntryPoint: {
+      // Operands: execution model, entry point id, name, interface ids...
+      size_t nameWords;
+      readLiteralString(words.subspan(2), nameWords);
+      for (size_t i = 2 + nameWords; i < words.size(); ++i)
+        this->interfaceIds.push_back(words.data()[i]);
+      break;
+    }
+    case SpvOpDecorate: {
+      // Operands: target, decoration, literals...
+      SpvId& target = this->_getMutable(words.data()[0]);
+      uint32_t decoration = words.data()[1];
+      uint32_t literal = words.size() > 2 ? words.data()[2] : 0;
+      if (decoration == SpvDecorationDescriptorSet)
+        target.set = literal;
+      else if (decoration == SpvDecorationBinding)
+        target.binding = literal;
+      else if (decoration == SpvDecorationArrayStride)
+        target.arrayStride = literal;
+      else if (decoration == SpvDecorationBufferBlock)
+        target.bufferBlock = true;
+      break;
+    }
+    case SpvOpMemberDecorate: {
+      // Operands: struct type, member index, decoration, literals...
+      SpvId& target = this->_getMutable(words.data()[0]);
+      uint32_t memberIndex = words.data()[1];
+      if (target.members.size() <= memberIndex)
+        target.members.resize(memberIndex + 1);
+
+      SpvMember& member = target.members[memberIndex];
+      uint32_t decoration = words.data()[2];
+      uint32_t literal = words.size() > 3 ? words.data()[3] : 0;
+      if (decoration == SpvDecorationOffset)
+        member.offset = literal;
+      else if (decoration == SpvDecorationMatrixStride)
+        member.matrixStride = literal;
+      else if (decoration == SpvDecorationRowMajor)
+        member.rowMajor = true;
+      break;
+    }
+    case SpvOpTypeBool:
+    case SpvOpTypeInt:
+    case SpvOpTypeFloat:
+    case SpvOpTypeVector:
+    case SpvOpTypeMatrix:
+    case SpvOpTypeImage:
+    case SpvOpTypeSampler:
+    case SpvOpTypeSampledImage:
+    case SpvOpTypeArray:
+    case SpvOpTypeRuntimeArray:
+    case SpvOpTypeStruct:
+    case SpvOpTypePointer:
+    case SpvOpTypeAccelerationStructureKHR: {
+      // Operands: result id, ...
+      SpvId& id = this->_getMutable(words.data()[0]);
+      id.opcode = opcode;
+      id.operands.assign(words.begin() + 1, words.end());
+      break;
+    }
+    case SpvOpConstant:
+    case SpvOpVariable: {
+      // Operands: result type, result id, ...
+      SpvId& id = this->_getMutable(words.data()[1]);
+      id.opcode = opcode;
+      id.operands.assign(words.begin(), words.end());
+      id.operands.erase(id.operands.begin() + 1);
+      if (opcode == SpvOpVariable)
+        this->variableIds.push_back(words.data()[1]);
+      break;
+    }
+    default:
+      break;
+    }
+  }
+
+  SpvId& _getMutable(uint32_t id) {
+    if (id >= this->_ids.size())
+      throw std::runtime_error("Out of bounds SPIR-V id!");
+    return this->_ids[id];
+  }
+
+  std::vector<SpvId> _ids;
+};
+
+VkDescriptorType getImageDescriptorType(const SpvId& image) {
+  // Operands: sampled type, dim, depth, arrayed, ms, sampled, format
+  uint32_t dim = image.operands[1];
+  uint32_t sampled = image.operands[5];
+  if (dim == SpvDimBuffer)
+    return sampled == 2 ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER
+                        : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+  if (dim == SpvDimSubpassData)
+    return VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+  return sampled == 2 ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE
+                      : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+}
+
+const char* getDescriptorTypeName(VkDescriptorType type) {
+  switch (type) {
+  case VK_DESCRIPTOR_TYPE_SAMPLER:
+    return "sampler";
+  case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
+    return "combined image sampler";
+  case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
+    return "sampled image";
+  case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
+    return "storage image";
+  case VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER:
+    return "uniform texel buffer";
+  case VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER:
+    return "storage texel buffer";
+  case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
+    return "uniform buffer";
+  case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
+    return "storage buffer";
+  case VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT:
+    return "input attachment";
+  case VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR:
+    return "acceleration structure";
+  default:
+    return "unknown";
+  }
+}
+
+std::string getBindingName(const ReflectedBinding& binding) {
+  return "\"" + binding.name + "\" (set " + std::to_string(binding.set) +
+         ", binding " + std::to_string(binding.binding) + ")";
+}
+} // namespace
+
+ShaderReflection::ShaderReflection(
+    gsl::span<const uint32_t> spirv,
+    VkShaderStageFlags stage) {
+  SpvModule module(spirv);
+
+  // Since SPIR-V 1.4, entry points list every global variable they use
+  std::unordered_set<uint32_t> usedIds(
+      module.interfaceIds.begin(),
+      module.interfaceIds.end());
+  bool filterUnused = module.version >= 0x00010400;
+
+  for (uint32_t variableId : module.variableIds) {
+    if (filterUnused && usedIds.find(variableId) == usedIds.end())
+      continue;
+
+    const SpvId& variable = module.get(variableId);
+    // Operands: result type, storage class
+    uint32_t storageClass = variable.operands[1];
+    if (storageClass != SpvStorageClassUniformConstant &&
+        storageClass != SpvStorageClassUniform &&
+        storageClass != SpvStorageClassPushConstant &&
+        storageClass != SpvStorageClassStorageBuffer)
+      continue;
+
+    // Operands: storage class, pointee type
+    const SpvId& pointer = module.get(variable.operands[0]);
+    uint32_t typeId = pointer.operands[1];
+    const SpvId* pType = &module.get(typeId);
+
+    if (storageClass == SpvStorageClassPushConstant) {
+      ReflectedPushConstants& pushConstants =
+          this->_pushConstants.emplace_back();
+      pushConstants.name = pType->name;
+      pushConstants.stageFlags = stage;
+
+      // The block may start at an explicit offset
+      uint32_t offset = UINT32_MAX;
+      for (const SpvMember& member : pType->members)
+        offset = std::min(offset, member.offset);
+      pushConstants.offset = offset == UINT32_MAX ? 0 : offset;
+      pushConstants.size = module.getSize(typeId) - pushConstants.offset;
+      continue;
+    }
+
+    ReflectedBinding& binding = this->_bindings.emplace_back();
+    binding.name = variable.name.empty() ? pType->name : variable.name;
+    binding.set = variable.set;
+    binding.binding = variable.binding;
+    binding.stageFlags = stage;
+
+    // Arrays of descriptors
+    if (pType->opcode == SpvOpTypeArray) {
+      binding.descriptorCount = module.getConstant(pType->operands[1]);
+      typeId = pType->operands[0];
+      pType = &module.get(typeId);
+    } else if (pType->opcode == SpvOpTypeRuntimeArray) {
+      binding.descriptorCount = 0;
+      typeId = pType->operands[0];
+      pType = &module.get(typeId);
+    }
+
+    switch (pType->opcode) {
+    case SpvOpTypeSampler:
+      binding.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+      break;
+    case SpvOpTypeSampledImage:
+      binding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+      break;
+    case SpvOpTypeImage:
+      binding.descriptorType = getImageDescriptorType(*pType);
+      break;
+    case SpvOpTypeAccelerationStructureKHR:
+      binding.descriptorType = VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR;
+      break;
+    case SpvOpTypeStruct: {
+      bool storage = storageClass == SpvStorageClassStorageBuffer ||
+                     pType->bufferBlock;
+      binding.descriptorType = storage ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER
+                                       : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+      binding.blockSize = module.getSize(typeId);
+
+      if (!pType->operands.empty()) {
+        const SpvId& lastMember = module.get(pType->operands.back());
+        if (lastMember.opcode == SpvOpTypeRuntimeArray)
+          binding.runtimeArrayStride = lastMember.arrayStride;
+      }
+      break;
+    }
+    default:
+      this->_bindings.pop_back();
+      break;
+    }
+  }
+}
+
+void ShaderReflection::merge(const ShaderReflection& other) {
+  for (const ReflectedBinding& otherBinding : other._bindings) {
+    auto it = std::find_if(
+        this->_bindings.begin(),
+        this->_bindings.end(),
+        [&](const ReflectedBinding& binding) {
+          return binding.set == otherBinding.set &&
+                 binding.binding == otherBinding.binding;
+        });
+    if (it == this->_bindings.end()) {
+      this->_bindings.push_back(otherBinding);
+      continue;
+    }
+
+    if (it->descriptorType != otherBinding.descriptorType) {
+      throw std::runtime_error(
+          "Shader stages disagree on the type of " + getBindingName(*it) +
+          ": " + getDescriptorTypeName(it->descriptorType) + " vs " +
+          getDescriptorTypeName(otherBinding.descriptorType));
+    }
+
+    it->stageFlags |= otherBinding.stageFlags;
+    if (it->descriptorCount != 0)
+      it->descriptorCount =
+          otherBinding.descriptorCount == 0
+              ? 0
+              : std::max(it->descriptorCount, otherBinding.descriptorCount);
+    it->blockSize = std::max(it->blockSize, otherBinding.blockSize);
+    it->runtimeArrayStride =
+        std::max(it->runtimeArrayStride, otherBinding.runtimeArrayStride);
+  }
+
+  this->_pushConstants.insert(
+      this->_pushConstants.end(),
+      other._pushConstants.begin(),
+      other._pushConstants.end());
+}
+
+uint32_t ShaderReflection::getDescriptorSetCount() const {
+  uint32_t setCount = 0;
+  for (const ReflectedBinding& binding : this->_bindings)
+    setCount = std::max(setCount, binding.set + 1);
+  return setCount;
+}
+
+const ReflectedBinding*
+ShaderReflection::findBinding(uint32_t set, uint32_t binding) const {
+  for (const ReflectedBinding& reflectedBinding : this->_bindings) {
+    if (reflectedBinding.set == set && reflectedBinding.binding == binding)
+      return &reflectedBinding;
+  }
+
+  return nullptr;
+}
+
+void ShaderReflection::populateDescriptorSetLayout(
+    uint32_t set,
+    DescriptorSetLayoutBuilder& builder) const {
+  std::vector<const ReflectedBinding*> bindings;
+  for (const ReflectedBinding& binding : this->_bindings) {
+    if (binding.set == set)
+      bindings.push_back(&binding);
+  }
+
+  std::sort(
+      bindings.begin(),
+      bindings.end(),
+      [](const ReflectedBinding* pA, const ReflectedBinding* pB) {
+        return pA->binding < pB->binding;
+      });
+
+  for (uint32_t i = 0; i < bindings.size(); ++i) {
+    const ReflectedBinding& binding = *bindings[i];
+
+    // The builder assigns binding indices sequentially
+    if (binding.binding != i) {
+      throw std::runtime_error(
+          "Cannot build a descriptor set layout from non-contiguous bindings, "
+          "missing binding " +
+          std::to_string(i) + " in set " + std::to_string(set));
+    }
+
+    if (binding.descriptorCount == 0) {
+      throw std::runtime_error(
+          "Cannot build a descriptor set layout with the unbounded array " +
+          getBindingName(binding) + ", declare it explicitly");
+    }
+
+    bool isArray = binding.descriptorCount > 1;
+    switch (binding.descriptorType) {
+    case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
+      if (isArray)
+        builder.addTextureHeapBinding(
+            binding.descriptorCount,
+            binding.stageFlags);
+      else
+        builder.addTextureBinding(binding.stageFlags);
+      break;
+    case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
+      if (isArray)
+        builder.addStorageImageHeapBinding(
+            binding.descriptorCount,
+            binding.stageFlags);
+      else
+        builder.addStorageImageBinding(binding.stageFlags);
+      break;
+    case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
+      if (isArray)
+        builder.addUniformHeapBinding(
+            binding.descriptorCount,
+            binding.stageFlags);
+      else
+        builder.addUniformBufferBinding(binding.stageFlags);
+      break;
+    case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
+      if (isArray)
+        builder.addBufferHeapBinding(
+            binding.descriptorCount,
+            binding.stageFlags);
+      else
+        builder.addStorageBufferBinding(binding.stageFlags);
+      break;
+    case VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR:
+      if (isArray)
+        builder.addAccelerationStructureHeapBinding(
+            binding.descriptorCount,
+            binding.stageFlags);
+      else
+        builder.addAccelerationStructureBinding(binding.stageFlags);
+      break;
+    default:
+      throw std::runtime_error(
+          std::string("Cannot build a descriptor set layout with the ") +
+          getDescriptorTypeName(binding.descriptorType) + " " +
+          getBindingName(binding));
+    }
+  }
+}
+} // namespace AltheaEngine
@@ -0,0 +1,525 @@
+#include "ShaderVariantArchive.h"
+
+#include "Application.h"
+#include "MappedFile.h"
+
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace AltheaEngine {
+namespace {
+// 'ASVA'
+constexpr uint32_t SHADER_VARIANT_ARCHIVE_MAGIC = 0x41565341;
+constexpr uint32_t SHADER_VARIANT_ARCHIVE_VERSION = 2;
+
+// ShaderCache keys are hex encoded SHA-256 hashes
+constexpr size_t KEY_LENGTH = 64;
+// SPIR-V blobs are aligned well beyond the 4 bytes needed to read words
+constexpr uint64_t BLOB_ALIGNMENT = 16;
+
+struct ShaderVariantArchiveHeader {
+  uint32_t magic;
+  uint32_t version;
+  // Always a power of two
+  uint32_t bucketCount;
+  uint32_t variantCount;
+};
+
+// One slot of the open-addressed index, empty if spirvWordCount is zero
+struct ShaderVariantArchiveBucket {
+  char key[KEY_LENGTH];
+  uint64_t includesOffset;
+  uint64_t spirvOffset;
+  uint32_t includesSize;
+  uint32_t spirvWordCount;
+};
+
+std::mutex s_archiveMutex;
+std::string s_path;
+std::atomic<bool> s_enabled{true};
+
+std::atomic<uint32_t> s_hits{0};
+std::atomic<uint32_t> s_misses{0};
+std::atomic<uint32_t> s_staleEntries{0};
+
+uint64_t hashKey(const char* key) {
+  // FNV-1a
+  uint64_t hash = 14695981039346656037ull;
+  for (size_t i = 0; i < KEY_LENGTH; ++i) {
+    hash ^= static_cast<uint8_t>(key[i]);
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+uint64_t alignUp(uint64_t offset, uint64_t alignment) {
+  return (offset + alignment - 1) / alignment * alignment;
+}
+
+bool readWholeFile(const std::string& path, std::vector<char>& result) {
+  std::ifstream file(path, std::ios::ate | std::ios::binary);
+  if (!file.is_open())
+    return false;
+
+  size_t size = static_cast<size_t>(file.tellg());
+  result.resize(size);
+  file.seekg(0);
+  file.read(result.data(), size);
+  return file.good();
+}
+
+// Reads sequentially from a range of the archive, failing once the range
+// runs out
+class RangeReader {
+public:
+  RangeReader(const char* pData, size_t size) : m_pData(pData), m_size(size) {}
+
+  bool read(void* pDst, size_t size) {
+    if (m_offset + size > m_size)
+      return false;
+
+    std::memcpy(pDst, m_pData + m_offset, size);
+    m_offset += size;
+    return true;
+  }
+
+  bool readString(std::string& str) {
+    uint32_t length;
+    if (!read(&length, sizeof(length)) || m_offset + length > m_size)
+      return false;
+
+    str.assign(m_pData + m_offset, length);
+    m_offset += length;
+    return true;
+  }
+
+private:
+  const char* m_pData;
+  size_t m_size;
+  size_t m_offset = 0;
+};
+
+void writeString(std::vector<char>& data, const std::string& str) {
+  uint32_t length = static_cast<uint32_t>(str.size());
+  const char* pLength = reinterpret_cast<const char*>(&length);
+  data.insert(data.end(), pLength, pLength + sizeof(length));
+  data.insert(data.end(), str.begin(), str.end());
+}
+
+// An included file as it was on disk when the archive was opened
+struct IncludeState {
+  std::string path;
+  std::string hash;
+  std::filesystem::file_time_type writeTime;
+};
+
+// The included files of one variant, resolved and checked against the disk
+// when the archive is opened
+struct VariantIncludes {
+  std::vector<uint32_t> includeIndices;
+  bool valid = false;
+};
+
+// A read-only view of an archive file, memory mapped where supported
+class MappedArchive {
+public:
+  static std::unique_ptr<MappedArchive> open(const std::string& path) {
+    std::unique_ptr<MappedArchive> pArchive(new MappedArchive());
+
+    pArchive->m_pFile = MappedFile::open(path);
+    if (!pArchive->m_pFile)
+      return nullptr;
+    pArchive->m_pData = pArchive->m_pFile->getData();
+    pArchive->m_size = pArchive->m_pFile->getSize();
+
+    if (!pArchive->_validate()) {
+      std::cout << "Ignoring invalid shader variant archive: " << path
+                << "\n";
+      return nullptr;
+    }
+
+    return pArchive;
+  }
+
+  uint32_t getVariantCount() const { return m_header.variantCount; }
+  uint32_t getBucketCount() const { return m_header.bucketCount; }
+
+  // The index of the key's bucket, or bucketCount if there is none
+  uint32_t find(const std::string& key) const {
+    if (key.size() != KEY_LENGTH)
+      return m_header.bucketCount;
+
+    // The load factor is at most one half, so an empty bucket normally ends
+    // the probe well before it wraps around
+    uint32_t mask = m_header.bucketCount - 1;
+    uint32_t i = static_cast<uint32_t>(hashKey(key.data())) & mask;
+    for (uint32_t step = 0; step < m_header.bucketCount;
+         ++step, i = (i + 1) & mask) {
+      const ShaderVariantArchiveBucket& bucket = m_pBuckets[i];
+      if (bucket.spirvWordCount == 0)
+        break;
+      if (std::memcmp(bucket.key, key.data(), KEY_LENGTH) == 0)
+        return i;
+    }
+
+    return m_header.bucketCount;
+  }
+
+  const ShaderVariantArchiveBucket& getBucket(uint32_t bucketIdx) const {
+    return m_pBuckets[bucketIdx];
+  }
+
+  /**
+   * @brief Whether the included files of the variant in the bucket are
+   * unchanged. They were hashed when the archive was opened, so this only
+   * checks that none of them has been written since.
+   */
+  bool getIncludes(
+      uint32_t bucketIdx,
+      std::vector<ShaderCache::IncludedFile>& includes) const {
+    const VariantIncludes& variantIncludes = m_variantIncludes[bucketIdx];
+    if (!variantIncludes.valid)
+      return false;
+
+    includes.clear();
+    for (uint32_t includeIdx : variantIncludes.includeIndices) {
+      const IncludeState& include = m_includes[includeIdx];
+      std::error_code errorCode;
+      if (std::filesystem::last_write_time(include.path, errorCode) !=
+              include.writeTime ||
+          errorCode) {
+        includes.clear();
+        return false;
+      }
+
+      includes.push_back({include.path, include.hash});
+    }
+
+    return true;
+  }
+
+  const char* getRange(uint64_t offset, uint64_t size) const {
+    if (offset > m_size || size > m_size - offset)
+      return nullptr;
+    return m_pData + offset;
+  }
+
+private:
+  MappedArchive() = default;
+
+  bool _validate() {
+    if (m_size < sizeof(m_header))
+      return false;
+
+    std::memcpy(&m_header, m_pData, sizeof(m_header));
+    if (m_header.magic != SHADER_VARIANT_ARCHIVE_MAGIC ||
+        m_header.version != SHADER_VARIANT_ARCHIVE_VERSION ||
+        m_header.bucketCount == 0 ||
+        (m_header.bucketCount & (m_header.bucketCount - 1)) != 0 ||
+        m_header.variantCount > m_header.bucketCount / 2)
+      return false;
+
+    uint64_t bucketsSize = static_cast<uint64_t>(m_header.bucketCount) *
+                           sizeof(ShaderVariantArchiveBucket);
+    if (!getRange(sizeof(m_header), bucketsSize))
+      return false;
+
+    // The header is a multiple of the bucket alignment
+    m_pBuckets = reinterpret_cast<const ShaderVariantArchiveBucket*>(
+        m_pData + sizeof(m_header));
+
+    // The header's variant count must match the buckets in use, so the load
+    // factor can be trusted
+    uint32_t usedBucketCount = 0;
+    for (uint32_t i = 0; i < m_header.bucketCount; ++i) {
+      const ShaderVariantArchiveBucket& bucket = m_pBuckets[i];
+      if (bucket.spirvWordCount == 0)
+        continue;
+
+      ++usedBucketCount;
+      if (!getRange(bucket.includesOffset, bucket.includesSize) ||
+          !getRange(
+              bucket.spirvOffset,
+              static_cast<uint64_t>(bucket.spirvWordCount) * sizeof(uint32_t)))
+        return false;
+    }
+
+    if (usedBucketCount != m_header.variantCount)
+      return false;
+
+    return _validateIncludes();
+  }
+
+  // Hash every included file once, rather than on every lookup. Variants
+  // whose included files have changed since the archive was built are
+  // never used.
+  bool _validateIncludes() {
+    m_variantIncludes.resize(m_header.bucketCount);
+
+    std::unordered_map<std::string, uint32_t> includeIndices;
+    std::vector<char> includeContent;
+    for (uint32_t i = 0; i < m_header.bucketCount; ++i) {
+      const ShaderVariantArchiveBucket& bucket = m_pBuckets[i];
+      if (bucket.spirvWordCount == 0)
+        continue;
+
+      RangeReader reader(
+          getRange(bucket.includesOffset, bucket.includesSize),
+          bucket.includesSize);
+      uint32_t includeCount;
+      if (!reader.read(&includeCount, sizeof(includeCount)))
+        return false;
+
+      VariantIncludes& variantIncludes = m_variantIncludes[i];
+      variantIncludes.valid = true;
+      for (uint32_t j = 0; j < includeCount; ++j) {
+        std::string path;
+        std::string hash;
+        if (!reader.readString(path) || !reader.readString(hash))
+          return false;
+
+        path = ShaderCache::resolvePortablePath(path);
+        auto it = includeIndices.find(path);
+        if (it == includeIndices.end()) {
+          IncludeState& include = m_includes.emplace_back();
+          include.path = path;
+
+          // Read the write time first, so a write racing with the hash is
+          // caught by the next lookup
+          std::error_code errorCode;
+          include.writeTime =
+              std::filesystem::last_write_time(path, errorCode);
+          if (!errorCode && readWholeFile(path, includeContent))
+            include.hash = ShaderCache::hashFile(includeContent);
+
+          it = includeIndices
+                   .emplace(path, static_cast<uint32_t>(m_includes.size() - 1))
+                   .first;
+        }
+
+        const IncludeState& include = m_includes[it->second];
+        if (include.hash.empty() || include.hash != hash)
+          variantIncludes.valid = false;
+        variantIncludes.includeIndices.push_back(it->second);
+      }
+    }
+
+    return true;
+  }
+
+  ShaderVariantArchiveHeader m_header{};
+  const ShaderVariantArchiveBucket* m_pBuckets = nullptr;
+
+  std::vector<IncludeState> m_includes;
+  // One per bucket
+  std::vector<VariantIncludes> m_variantIncludes;
+
+  std::unique_ptr<MappedFile> m_pFile;
+  const char* m_pData = nullptr;
+  size_t m_size = 0;
+};
+
+std::shared_ptr<const MappedArchive> s_pArchive;
+bool s_archiveOpened = false;
+
+std::string getArchivePath() {
+  if (s_path.empty())
+    return GProjectDirectory + "/Cache/ShaderVariants.asva";
+  return s_path;
+}
+
+std::shared_ptr<const MappedArchive> getArchive() {
+  std::lock_guard<std::mutex> lock(s_archiveMutex);
+  if (!s_archiveOpened) {
+    s_pArchive = MappedArchive::open(getArchivePath());
+    s_archiveOpened = true;
+  }
+
+  return s_pArchive;
+}
+} // namespace
+
+/*static*/
+void ShaderVariantArchive::setPath(const std::string& path) {
+  std::lock_guard<std::mutex> lock(s_archiveMutex);
+  s_path = path;
+
+  // Lookups in flight keep the old mapping alive until they finish
+  s_pArchive = nullptr;
+  s_archiveOpened = false;
+}
+
+/*static*/
+std::string ShaderVariantArchive::getPath() {
+  std::lock_guard<std::mutex> lock(s_archiveMutex);
+  return getArchivePath();
+}
+
+/*static*/
+void ShaderVariantArchive::setEnabled(bool enabled) { s_enabled = enabled; }
+
+/*static*/
+bool ShaderVariantArchive::isEnabled() { return s_enabled; }
+
+/*static*/
+bool ShaderVariantArchive::load(
+    const std::string& key,
+    std::vector<uint32_t>& spirv,
+    std::vector<ShaderCache::IncludedFile>& includes) {
+  if (!s_enabled)
+    return false;
+
+  std::shared_ptr<const MappedArchive> pArchive = getArchive();
+  uint32_t bucketIdx = pArchive ? pArchive->find(key) : 0;
+  if (!pArchive || bucketIdx == pArchive->getBucketCount()) {
+    ++s_misses;
+    return false;
+  }
+
+  // Every included file must still resolve to the same contents
+  if (!pArchive->getIncludes(bucketIdx, includes)) {
+    ++s_staleEntries;
+    return false;
+  }
+
+  // The ranges were checked when the archive was opened
+  const ShaderVariantArchiveBucket& bucket = pArchive->getBucket(bucketIdx);
+  const char* pSpirv = pArchive->getRange(
+      bucket.spirvOffset,
+      static_cast<uint64_t>(bucket.spirvWordCount) * sizeof(uint32_t));
+
+  spirv.resize(bucket.spirvWordCount);
+  std::memcpy(spirv.data(), pSpirv, spirv.size() * sizeof(uint32_t));
+
+  ++s_hits;
+  return true;
+}
+
+/*static*/
+void ShaderVariantArchive::write(
+    const std::string& path,
+    const std::vector<Variant>& variants) {
+  uint32_t bucketCount = 1;
+  while (bucketCount <= 2 * variants.size())
+    bucketCount *= 2;
+
+  std::vector<ShaderVariantArchiveBucket> buckets(bucketCount);
+  std::memset(buckets.data(), 0, buckets.size() * sizeof(buckets[0]));
+
+  uint64_t bucketsEnd =
+      sizeof(ShaderVariantArchiveHeader) + buckets.size() * sizeof(buckets[0]);
+  std::vector<char> blobs;
+  auto blobOffset = [&]() { return bucketsEnd + blobs.size(); };
+  auto alignBlobs = [&]() {
+    blobs.resize(alignUp(blobOffset(), BLOB_ALIGNMENT) - bucketsEnd);
+  };
+
+  uint32_t variantCount = 0;
+  for (const Variant& variant : variants) {
+    if (variant.key.size() != KEY_LENGTH)
+      throw std::runtime_error(
+          "Invalid shader variant key: \"" + variant.key + "\"");
+    if (variant.spirv.empty())
+      throw std::runtime_error(
+          "Shader variant \"" + variant.key + "\" has no SPIR-V");
+
+    uint32_t mask = bucketCount - 1;
+    uint32_t i = static_cast<uint32_t>(hashKey(variant.key.data())) & mask;
+    bool duplicate = false;
+    for (; buckets[i].spirvWordCount != 0; i = (i + 1) & mask) {
+      if (std::memcmp(buckets[i].key, variant.key.data(), KEY_LENGTH) == 0) {
+        duplicate = true;
+        break;
+      }
+    }
+
+    // Identical keys always compile to identical SPIR-V
+    if (duplicate)
+      continue;
+
+    ShaderVariantArchiveBucket& bucket = buckets[i];
+    std::memcpy(bucket.key, variant.key.data(), KEY_LENGTH);
+
+    bucket.includesOffset = blobOffset();
+    uint32_t includeCount = static_cast<uint32_t>(variant.includes.size());
+    const char* pIncludeCount = reinterpret_cast<const char*>(&includeCount);
+    blobs.insert(blobs.end(), pIncludeCount, pIncludeCount + 4);
+    for (const ShaderCache::IncludedFile& include : variant.includes) {
+      writeString(blobs, ShaderCache::getPortablePath(include.path));
+      writeString(blobs, include.hash);
+    }
+    bucket.includesSize =
+        static_cast<uint32_t>(blobOffset() - bucket.includesOffset);
+
+    alignBlobs();
+    bucket.spirvOffset = blobOffset();
+    bucket.spirvWordCount = static_cast<uint32_t>(variant.spirv.size());
+    const char* pSpirv = reinterpret_cast<const char*>(variant.spirv.data());
+    blobs.insert(
+        blobs.end(),
+        pSpirv,
+        pSpirv + variant.spirv.size() * sizeof(uint32_t));
+    alignBlobs();
+
+    ++variantCount;
+  }
+
+  ShaderVariantArchiveHeader header{};
+  header.magic = SHADER_VARIANT_ARCHIVE_MAGIC;
+  header.version = SHADER_VARIANT_ARCHIVE_VERSION;
+  header.bucketCount = bucketCount;
+  header.variantCount = variantCount;
+
+  std::filesystem::path archivePath(path);
+  std::error_code errorCode;
+  if (archivePath.has_parent_path())
+    std::filesystem::create_directories(archivePath.parent_path(), errorCode);
+
+  // Mappings of the old archive stay valid after it is replaced
+  std::string tempPath = path + ".tmp";
+  {
+    std::ofstream file(tempPath, std::ios::out | std::ios::binary);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(
+        reinterpret_cast<const char*>(buckets.data()),
+        buckets.size() * sizeof(buckets[0]));
+    file.write(blobs.data(), blobs.size());
+    if (!file.good())
+      throw std::runtime_error("Failed to write shader variant archive");
+  }
+
+  std::filesystem::rename(tempPath, path, errorCode);
+  if (errorCode) {
+    std::filesystem::remove(tempPath, errorCode);
+    throw std::runtime_error("Failed to write shader variant archive");
+  }
+}
+
+/*static*/
+ShaderVariantArchiveStats ShaderVariantArchive::getStats() {
+  ShaderVariantArchiveStats stats{};
+  {
+    std::lock_guard<std::mutex> lock(s_archiveMutex);
+    if (s_pArchive)
+      stats.variantCount = s_pArchive->getVariantCount();
+  }
+  stats.hits = s_hits;
+  stats.misses = s_misses;
+  stats.staleEntries = s_staleEntries;
+  return stats;
+}
+
+/*static*/
+void ShaderVariantArchive::resetStats() {
+  s_hits = 0;
+  s_misses = 0;
+  s_staleEntries = 0;
+}
+} // namespace AltheaEngine
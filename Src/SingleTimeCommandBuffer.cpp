@@ -2,6 +2,7 @@
 
 #include "Application.h"
 #include "BufferUtilities.h"
+#include "UploadRing.h"
 
 #include <iostream>
 
@@ -25,7 +26,25 @@ SingleTimeCommandBuffer::SingleTimeCommandBuffer(const Application& app)
   vkBeginCommandBuffer(this->_commandBuffer, &beginInfo);
 }
 
+SingleTimeCommandBuffer::SingleTimeCommandBuffer(
+    const Application& app,
+    UploadRing& uploadRing)
+    : SingleTimeCommandBuffer(app) {
+  uploadRing._beginRecording();
+  this->_pUploadRing = &uploadRing;
+}
+
 SingleTimeCommandBuffer::~SingleTimeCommandBuffer() {
+  if (this->_pUploadRing) {
+    UploadRing::Batch batch;
+    batch.commandBuffer = this->_commandBuffer;
+    batch.stagingBuffers = std::move(this->_stagingBuffers);
+    batch.postCompletionTasks = std::move(this->_postCompletionTasks);
+    batch.stagingBytes = this->_stagingBytes;
+    this->_pUploadRing->_submit(std::move(batch));
+    return;
+  }
+
   vkEndCommandBuffer(this->_commandBuffer);
 
   VkSubmitInfo submitInfo{};
@@ -53,13 +72,21 @@ SingleTimeCommandBuffer::~SingleTimeCommandBuffer() {
   // The staging buffers now get released safely.
 }
 
-VkBuffer SingleTimeCommandBuffer::createStagingBuffer(
+StagingRange SingleTimeCommandBuffer::createStagingBuffer(
     const Application& app,
     gsl::span<const std::byte> buffer) {
+  this->_stagingBytes += buffer.size();
+
+  if (this->_pUploadRing) {
+    std::optional<StagingRange> range = this->_pUploadRing->_stage(buffer);
+    if (range)
+      return *range;
+  }
+
   this->_stagingBuffers.push_back(BufferUtilities::createStagingBuffer(
       app,
       buffer));
-  return this->_stagingBuffers.back().getBuffer();
+  return {this->_stagingBuffers.back().getBuffer(), 0};
 }
 
 void SingleTimeCommandBuffer::addPostCompletionTask(std::function<void()>&& task) {
@@ -1,10 +1,14 @@
 
 #include "TaskProcessor.h"
 
-#include <thread>
+#include "ThreadPool.h"
 
 namespace AltheaEngine {
+TaskProcessor::TaskProcessor() : TaskProcessor(ThreadPool::getShared()) {}
+
+TaskProcessor::TaskProcessor(ThreadPool& pool) : m_pool(pool) {}
+
 void TaskProcessor::startTask(std::function<void()> f) {
-  std::thread(f).detach();
+  m_pool.submit(std::move(f));
 }
 } // namespace AltheaEngine
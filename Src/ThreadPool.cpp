@@ -0,0 +1,285 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <exception>
+
+namespace AltheaEngine {
+namespace {
+// Lets submit() find the calling worker's own queue
+thread_local const ThreadPool* tl_pCurrentPool = nullptr;
+thread_local uint32_t tl_currentWorkerIdx = 0;
+
+// Times an idle worker looks for work again before going to sleep, tasks
+// often arrive in quick succession
+constexpr uint32_t IDLE_SPIN_COUNT = 64;
+
+std::mutex s_sharedPoolMutex;
+uint32_t s_sharedThreadCount = 0;
+bool s_sharedPoolStarted = false;
+
+uint32_t getDefaultThreadCount() {
+  uint32_t hardwareThreads = std::thread::hardware_concurrency();
+  return hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+}
+} // namespace
+
+ThreadPool::ThreadPool(uint32_t threadCount) {
+  threadCount = std::max(threadCount, 1u);
+
+  // All queues must exist before any worker starts stealing from them
+  m_workers.reserve(threadCount);
+  for (uint32_t i = 0; i < threadCount; ++i)
+    m_workers.push_back(std::make_unique<Worker>());
+
+  for (uint32_t i = 0; i < threadCount; ++i)
+    m_workers[i]->thread = std::thread([this, i]() { _workerLoop(i); });
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(m_parkMutex);
+    m_stopping = true;
+  }
+  m_parkCondition.notify_all();
+
+  for (std::unique_ptr<Worker>& pWorker : m_workers)
+    pWorker->thread.join();
+}
+
+void ThreadPool::submit(Task&& task) {
+  // Counted before the task is visible, so the count never drops below the
+  // number of tasks actually queued
+  ++m_queuedCount;
+
+  if (tl_pCurrentPool == this) {
+    Worker& worker = *m_workers[tl_currentWorkerIdx];
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    worker.tasks.push_back(std::move(task));
+  } else {
+    std::lock_guard<std::mutex> lock(m_injectionMutex);
+    m_injectionQueue.push_back(std::move(task));
+  }
+
+  _wake();
+}
+
+bool ThreadPool::runPendingTask() {
+  Task task;
+  if (!_tryPop(getCurrentWorkerIndex(), task))
+    return false;
+
+  task();
+  ++m_tasksExecuted;
+  return true;
+}
+
+void ThreadPool::waitUntil(const std::function<bool()>& isDone) {
+  while (!isDone()) {
+    if (!runPendingTask())
+      std::this_thread::yield();
+  }
+}
+
+void ThreadPool::parallelFor(
+    uint32_t count,
+    const std::function<void(uint32_t begin, uint32_t end)>& fn,
+    uint32_t minChunkSize) {
+  if (count == 0)
+    return;
+
+  minChunkSize = std::max(minChunkSize, 1u);
+  if (count <= minChunkSize) {
+    fn(0, count);
+    return;
+  }
+
+  // The calling thread works on the loop as well
+  uint32_t participantCount = getThreadCount() + 1;
+
+  // Shared with helper tasks that may only start after the loop is done, by
+  // then there is nothing left to claim and they never touch fn
+  struct LoopState {
+    std::atomic<uint32_t> next{0};
+    std::atomic<uint32_t> completed{0};
+
+    std::mutex exceptionMutex;
+    std::exception_ptr pException;
+  };
+  std::shared_ptr<LoopState> pState = std::make_shared<LoopState>();
+
+  const std::function<void(uint32_t, uint32_t)>* pFn = &fn;
+  auto runChunks = [pState, pFn, count, minChunkSize, participantCount]() {
+    while (true) {
+      // Guided scheduling, large chunks first and smaller ones towards the
+      // end to even out the finishing times of the threads
+      uint32_t begin = pState->next.load(std::memory_order_relaxed);
+      uint32_t end;
+      do {
+        if (begin >= count)
+          return;
+        uint32_t chunkSize = std::max(
+            minChunkSize,
+            (count - begin) / (2 * participantCount));
+        end = std::min(count, begin + chunkSize);
+      } while (!pState->next.compare_exchange_weak(begin, end));
+
+      try {
+        (*pFn)(begin, end);
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(pState->exceptionMutex);
+        if (!pState->pException)
+          pState->pException = std::current_exception();
+      }
+
+      pState->completed += end - begin;
+    }
+  };
+
+  uint32_t helperCount =
+      std::min(participantCount - 1, (count - 1) / minChunkSize);
+  for (uint32_t i = 0; i < helperCount; ++i)
+    submit(runChunks);
+
+  runChunks();
+  waitUntil([&]() { return pState->completed == count; });
+
+  if (pState->pException)
+    std::rethrow_exception(pState->pException);
+}
+
+bool ThreadPool::isWorkerThread() const { return tl_pCurrentPool == this; }
+
+uint32_t ThreadPool::getCurrentWorkerIndex() const {
+  return tl_pCurrentPool == this ? tl_currentWorkerIdx : getThreadCount();
+}
+
+ThreadPoolStats ThreadPool::getStats() const {
+  ThreadPoolStats stats{};
+  stats.threadCount = getThreadCount();
+  stats.tasksExecuted = m_tasksExecuted;
+  stats.tasksStolen = m_tasksStolen;
+  stats.parks = m_parks;
+  return stats;
+}
+
+void ThreadPool::_workerLoop(uint32_t workerIdx) {
+  tl_pCurrentPool = this;
+  tl_currentWorkerIdx = workerIdx;
+
+  uint32_t idleCount = 0;
+  while (true) {
+    Task task;
+    if (_tryPop(workerIdx, task)) {
+      task();
+      ++m_tasksExecuted;
+      idleCount = 0;
+      continue;
+    }
+
+    if (++idleCount < IDLE_SPIN_COUNT) {
+      std::this_thread::yield();
+      continue;
+    }
+
+    // Sleeping is announced before checking for work one last time, so a
+    // submit either sees this worker sleeping and wakes it, or is seen here
+    ++m_sleepingCount;
+    {
+      std::unique_lock<std::mutex> lock(m_parkMutex);
+      if (m_queuedCount == 0 && !m_stopping)
+        ++m_parks;
+      m_parkCondition.wait(lock, [this]() {
+        return m_stopping || m_queuedCount != 0;
+      });
+    }
+    --m_sleepingCount;
+    idleCount = 0;
+
+    // Drain any remaining tasks before stopping
+    if (m_queuedCount == 0) {
+      std::lock_guard<std::mutex> lock(m_parkMutex);
+      if (m_stopping)
+        break;
+    }
+  }
+
+  tl_pCurrentPool = nullptr;
+}
+
+bool ThreadPool::_tryPop(uint32_t workerIdx, Task& task) {
+  if (m_queuedCount == 0)
+    return false;
+
+  uint32_t workerCount = getThreadCount();
+
+  // Own tasks first, newest first
+  if (workerIdx < workerCount) {
+    Worker& worker = *m_workers[workerIdx];
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    if (!worker.tasks.empty()) {
+      task = std::move(worker.tasks.back());
+      worker.tasks.pop_back();
+      --m_queuedCount;
+      return true;
+    }
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(m_injectionMutex);
+    if (!m_injectionQueue.empty()) {
+      task = std::move(m_injectionQueue.front());
+      m_injectionQueue.pop_front();
+      --m_queuedCount;
+      return true;
+    }
+  }
+
+  // Steal the oldest task of another worker, starting with the next one so
+  // thieves spread out over their victims
+  for (uint32_t i = 1; i <= workerCount; ++i) {
+    uint32_t victimIdx = (workerIdx + i) % (workerCount + 1);
+    if (victimIdx == workerIdx || victimIdx == workerCount)
+      continue;
+
+    Worker& victim = *m_workers[victimIdx];
+    std::lock_guard<std::mutex> lock(victim.mutex);
+    if (!victim.tasks.empty()) {
+      task = std::move(victim.tasks.front());
+      victim.tasks.pop_front();
+      --m_queuedCount;
+      ++m_tasksStolen;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void ThreadPool::_wake() {
+  if (m_sleepingCount == 0)
+    return;
+
+  // Taking the lock orders the notification after a parking worker's final
+  // check for work
+  { std::lock_guard<std::mutex> lock(m_parkMutex); }
+  m_parkCondition.notify_one();
+}
+
+/*static*/
+ThreadPool& ThreadPool::getShared() {
+  static ThreadPool pool([]() {
+    std::lock_guard<std::mutex> lock(s_sharedPoolMutex);
+    s_sharedPoolStarted = true;
+    return s_sharedThreadCount == 0 ? getDefaultThreadCount()
+                                    : s_sharedThreadCount;
+  }());
+  return pool;
+}
+
+/*static*/
+void ThreadPool::setSharedThreadCount(uint32_t threadCount) {
+  std::lock_guard<std::mutex> lock(s_sharedPoolMutex);
+  if (!s_sharedPoolStarted)
+    s_sharedThreadCount = threadCount;
+}
+} // namespace AltheaEngine
@@ -0,0 +1,234 @@
+#include "UploadRing.h"
+
+#include "Application.h"
+#include "BufferUtilities.h"
+
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+namespace AltheaEngine {
+namespace {
+// Enough for buffer copies and for the texel size of every image format the
+// engine uploads
+constexpr size_t STAGING_ALIGNMENT = 16;
+
+size_t alignUp(size_t offset) {
+  return (offset + STAGING_ALIGNMENT - 1) & ~(STAGING_ALIGNMENT - 1);
+}
+} // namespace
+
+UploadRing::UploadRing(
+    const Application& app,
+    size_t frameBudgetBytes,
+    size_t maxInFlightBytes)
+    : m_device(app.getDevice()),
+      m_queue(app.getGraphicsQueue()),
+      m_commandPool(app.getCommandPool()),
+      m_frameBudgetBytes(frameBudgetBytes),
+      m_maxInFlightBytes(maxInFlightBytes) {}
+
+UploadRing::~UploadRing() {
+  if (m_device == VK_NULL_HANDLE)
+    return;
+
+  waitIdle();
+
+  if (m_pRingData)
+    m_ringBuffer.unmapMemory();
+
+  for (VkFence fence : m_freeFences)
+    vkDestroyFence(m_device, fence, nullptr);
+}
+
+void UploadRing::beginFrame() {
+  poll();
+  m_frameBytes = 0;
+}
+
+void UploadRing::poll() {
+  // Retired in order, so a batch's tasks never run before those of an
+  // earlier batch
+  while (!m_batches.empty() &&
+         vkGetFenceStatus(m_device, m_batches.front().fence) == VK_SUCCESS) {
+    _retire(m_batches.front());
+    m_batches.pop_front();
+  }
+}
+
+void UploadRing::waitIdle() {
+  while (!m_batches.empty()) {
+    Batch& batch = m_batches.front();
+    vkWaitForFences(m_device, 1, &batch.fence, VK_TRUE, UINT64_MAX);
+    _retire(batch);
+    m_batches.pop_front();
+  }
+}
+
+bool UploadRing::hasCapacity(size_t pendingBytes) const {
+  size_t frameBytes = m_frameBytes + pendingBytes;
+  if (frameBytes == 0 && m_inFlightBytes == 0)
+    return true;
+
+  return frameBytes < m_frameBudgetBytes &&
+         m_inFlightBytes + pendingBytes < m_maxInFlightBytes;
+}
+
+void UploadRing::releaseAfterUploads(std::function<void()>&& task) {
+  if (m_batches.empty()) {
+    task();
+    return;
+  }
+
+  m_batches.back().postCompletionTasks.push_back(std::move(task));
+}
+
+UploadRingStats UploadRing::getStats() const {
+  UploadRingStats stats{};
+  stats.inFlightBytes = m_inFlightBytes;
+  stats.inFlightBatches = static_cast<uint32_t>(m_batches.size());
+  stats.frameBytes = m_frameBytes;
+  stats.batchesSubmitted = m_batchesSubmitted;
+  stats.bytesSubmitted = m_bytesSubmitted;
+  stats.stagingRingUsedBytes = m_ringUsed;
+  stats.dedicatedStagingBuffers = m_dedicatedStagingBuffers;
+  return stats;
+}
+
+void UploadRing::_beginRecording() {
+  // The ring hands out its bytes in submission order
+  if (m_isRecording)
+    throw std::runtime_error(
+        "Only one SingleTimeCommandBuffer may record into an UploadRing at a "
+        "time!");
+
+  m_isRecording = true;
+}
+
+std::optional<StagingRange>
+UploadRing::_stage(gsl::span<const std::byte> data) {
+  size_t capacity = m_maxInFlightBytes;
+  if (data.size() > capacity) {
+    ++m_dedicatedStagingBuffers;
+    return std::nullopt;
+  }
+
+  if (!m_pRingData) {
+    m_ringBuffer = BufferUtilities::createStagingBuffer(capacity);
+    m_pRingData = reinterpret_cast<std::byte*>(m_ringBuffer.mapMemory());
+  }
+
+  if (m_ringUsed == 0)
+    m_ringHead = 0;
+
+  size_t offset = alignUp(m_ringHead);
+  if (offset + data.size() > capacity) {
+    // Skip the rest of the buffer, the copy has to be contiguous
+    offset = 0;
+  }
+
+  size_t newHead = offset + data.size();
+  size_t consumed = offset >= m_ringHead ? newHead - m_ringHead
+                                         : capacity - m_ringHead + newHead;
+  if (m_ringUsed + consumed > capacity) {
+    ++m_dedicatedStagingBuffers;
+    return std::nullopt;
+  }
+
+  m_ringHead = newHead;
+  m_ringUsed += consumed;
+  m_pendingRingBytes += consumed;
+
+  std::memcpy(m_pRingData + offset, data.data(), data.size());
+
+  return StagingRange{m_ringBuffer.getBuffer(), offset};
+}
+
+void UploadRing::_submit(Batch&& batch) {
+  batch.ringBytes = m_pendingRingBytes;
+  m_pendingRingBytes = 0;
+  m_isRecording = false;
+
+  // Makes the uploads visible to everything submitted to the queue later on
+  VkMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  barrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+  barrier.dstAccessMask =
+      VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+  vkCmdPipelineBarrier(
+      batch.commandBuffer,
+      VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+      VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+      0,
+      1,
+      &barrier,
+      0,
+      nullptr,
+      0,
+      nullptr);
+
+  vkEndCommandBuffer(batch.commandBuffer);
+
+  batch.fence = _acquireFence();
+
+  VkSubmitInfo submitInfo{};
+  submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submitInfo.commandBufferCount = 1;
+  submitInfo.pCommandBuffers = &batch.commandBuffer;
+
+  if (vkQueueSubmit(m_queue, 1, &submitInfo, batch.fence) != VK_SUCCESS) {
+    // Nothing was submitted, so the resources can be released right away
+    std::cout << "Failed to submit upload batch\n";
+    batch.stagingBytes = 0;
+    _retire(batch);
+    return;
+  }
+
+  m_inFlightBytes += batch.stagingBytes;
+  m_frameBytes += batch.stagingBytes;
+  m_bytesSubmitted += batch.stagingBytes;
+  ++m_batchesSubmitted;
+
+  m_batches.push_back(std::move(batch));
+}
+
+void UploadRing::_retire(Batch& batch) {
+  vkFreeCommandBuffers(m_device, m_commandPool, 1, &batch.commandBuffer);
+
+  for (std::function<void()>& task : batch.postCompletionTasks)
+    task();
+  batch.postCompletionTasks.clear();
+
+  // The staging buffers get released here
+  batch.stagingBuffers.clear();
+
+  m_inFlightBytes -= batch.stagingBytes;
+  batch.stagingBytes = 0;
+
+  m_ringUsed -= batch.ringBytes;
+  batch.ringBytes = 0;
+
+  if (batch.fence != VK_NULL_HANDLE) {
+    vkResetFences(m_device, 1, &batch.fence);
+    m_freeFences.push_back(batch.fence);
+    batch.fence = VK_NULL_HANDLE;
+  }
+}
+
+VkFence UploadRing::_acquireFence() {
+  if (!m_freeFences.empty()) {
+    VkFence fence = m_freeFences.back();
+    m_freeFences.pop_back();
+    return fence;
+  }
+
+  VkFenceCreateInfo fenceInfo{};
+  fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+  VkFence fence;
+  if (vkCreateFence(m_device, &fenceInfo, nullptr, &fence) != VK_SUCCESS)
+    throw std::runtime_error("Failed to create upload fence!");
+
+  return fence;
+}
+} // namespace AltheaEngine
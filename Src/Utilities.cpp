@@ -1,5 +1,7 @@
 #include "Utilities.h"
 
+#include "PackFileSystem.h"
+
 #include <CesiumGltf/ImageCesium.h>
 #include <glm/common.hpp>
 #include <glm/glm.hpp>
@@ -17,27 +19,12 @@
 #include <cstdint>
 
 namespace AltheaEngine {
-static std::vector<std::vector<char>> s_fileReadAllocCache;
-
-// TODO: obviously not thread-safe
-static std::vector<char> getFileReadAlloc(size_t count) {
-  for (int i = 0; i < s_fileReadAllocCache.size(); i++) {
-    if (s_fileReadAllocCache[i].size() >= count) {
-      auto alloc = std::move(s_fileReadAllocCache[i]);
-      s_fileReadAllocCache.erase(s_fileReadAllocCache.begin() + i);
-      alloc.resize(count);
-      return std::move(alloc);
-    }
-  }
-  return std::vector<char>(count);
-}
-
-static void freeFileReadAlloc(std::vector<char>&& alloc) {
-  s_fileReadAllocCache.emplace_back(std::move(alloc));
-}
-
 /*static*/
 std::vector<char> Utilities::readFile(const char* filename) {
+  std::vector<char> packed;
+  if (PackFileSystem::readFile(filename, packed))
+    return packed;
+
   std::ifstream file(filename, std::ios::ate | std::ios::binary);
 
   if (!file.is_open()) {
@@ -47,8 +34,9 @@ std::vector<char> Utilities::readFile(const char* filename) {
     return std::vector<char>();
   }
 
+  // Allocated at the exact size, since the caller may hold on to it
   size_t fileSize = (size_t)file.tellg();
-  std::vector<char> buffer = getFileReadAlloc(fileSize);
+  std::vector<char> buffer(fileSize);
 
   file.seekg(0);
   file.read(buffer.data(), fileSize);
@@ -63,6 +51,31 @@ std::vector<char> Utilities::readFile(const std::string& filename) {
   return readFile(filename.c_str());
 }
 
+/*static*/
+FileBuffer Utilities::readFilePooled(const char* filename) {
+  FileBuffer packed;
+  if (PackFileSystem::readFile(filename, packed))
+    return packed;
+
+  std::ifstream file(filename, std::ios::ate | std::ios::binary);
+
+  if (!file.is_open())
+    throw std::runtime_error(std::string("Failed to open file: ") + filename);
+
+  size_t fileSize = (size_t)file.tellg();
+  FileBuffer buffer = FileBufferPool::acquire(fileSize);
+
+  file.seekg(0);
+  file.read(buffer.getData(), fileSize);
+
+  return buffer;
+}
+
+/*static*/
+FileBuffer Utilities::readFilePooled(const std::string& filename) {
+  return readFilePooled(filename.c_str());
+}
+
 /*static*/
 bool Utilities::writeFile(
     const std::string& filename,
@@ -84,6 +97,9 @@ bool Utilities::writeFile(
 
 /*static*/
 bool Utilities::checkFileExists(const char* filename) {
+  if (PackFileSystem::contains(filename))
+    return true;
+
   std::ifstream file(filename, std::ios::ate | std::ios::binary);
   return file.good();
 }
@@ -101,15 +117,15 @@ uint32_t Utilities::computeMipCount(uint32_t width, uint32_t height) {
 
 /*static*/
 void Utilities::loadPng(const std::string& path, Utilities::ImageFile& result) {
-  std::vector<char> data = Utilities::readFile(path);
+  FileBuffer data = Utilities::readFilePooled(path);
 
   result.channels = 4;
   result.bytesPerChannel = 1;
 
   int originalChannels;
   stbi_uc* pPngImage = stbi_load_from_memory(
-      reinterpret_cast<const stbi_uc*>(data.data()),
-      static_cast<int>(data.size()),
+      reinterpret_cast<const stbi_uc*>(data.getData()),
+      static_cast<int>(data.getSize()),
       &result.width,
       &result.height,
       &originalChannels,
@@ -119,13 +135,11 @@ void Utilities::loadPng(const std::string& path, Utilities::ImageFile& result) {
       result.width * result.height * result.channels * result.bytesPerChannel);
   std::memcpy(result.data.data(), pPngImage, result.data.size());
   stbi_image_free(pPngImage);
-
-  freeFileReadAlloc(std::move(data));
 }
 
 /*static*/
 CesiumGltf::ImageCesium Utilities::loadPng(const std::string& path) {
-  std::vector<char> data = Utilities::readFile(path);
+  FileBuffer data = Utilities::readFilePooled(path);
 
   CesiumGltf::ImageCesium image;
   image.channels = 4;
@@ -133,8 +147,8 @@ CesiumGltf::ImageCesium Utilities::loadPng(const std::string& path) {
 
   int32_t originalChannels;
   stbi_uc* pPngImage = stbi_load_from_memory(
-      reinterpret_cast<const stbi_uc*>(data.data()),
-      static_cast<int>(data.size()),
+      reinterpret_cast<const stbi_uc*>(data.getData()),
+      static_cast<int>(data.getSize()),
       &image.width,
       &image.height,
       &originalChannels,
@@ -145,8 +159,6 @@ CesiumGltf::ImageCesium Utilities::loadPng(const std::string& path) {
   std::memcpy(image.pixelData.data(), pPngImage, image.pixelData.size());
   stbi_image_free(pPngImage);
 
-  freeFileReadAlloc(std::move(data));
-
   return image;
 }
 
@@ -189,15 +201,15 @@ void Utilities::savePng(
 void Utilities::loadHdri(
     const std::string& path,
     Utilities::ImageFile& result) {
-  std::vector<char> data = Utilities::readFile(path);
+  FileBuffer data = Utilities::readFilePooled(path);
 
   result.channels = 4;
   result.bytesPerChannel = 4;
 
   int32_t originalChannels;
   float* pHdriImage = stbi_loadf_from_memory(
-      reinterpret_cast<stbi_uc*>(data.data()),
-      static_cast<int>(data.size()),
+      reinterpret_cast<stbi_uc*>(data.getData()),
+      static_cast<int>(data.getSize()),
       &result.width,
       &result.height,
       &originalChannels,
@@ -208,13 +220,11 @@ void Utilities::loadHdri(
   std::memcpy(result.data.data(), pHdriImage, result.data.size());
 
   stbi_image_free(pHdriImage);
-
-  freeFileReadAlloc(std::move(data));
 }
 
 /*static*/
 CesiumGltf::ImageCesium Utilities::loadHdri(const std::string& path) {
-  std::vector<char> data = Utilities::readFile(path);
+  FileBuffer data = Utilities::readFilePooled(path);
 
   CesiumGltf::ImageCesium image;
   image.channels = 4;
@@ -222,8 +232,8 @@ CesiumGltf::ImageCesium Utilities::loadHdri(const std::string& path) {
 
   int32_t originalChannels;
   float* pHdriImage = stbi_loadf_from_memory(
-      reinterpret_cast<stbi_uc*>(data.data()),
-      static_cast<int>(data.size()),
+      reinterpret_cast<stbi_uc*>(data.getData()),
+      static_cast<int>(data.getSize()),
       &image.width,
       &image.height,
       &originalChannels,
@@ -235,8 +245,6 @@ CesiumGltf::ImageCesium Utilities::loadHdri(const std::string& path) {
 
   stbi_image_free(pHdriImage);
 
-  freeFileReadAlloc(std::move(data));
-
   return image;
 }
 
@@ -273,20 +281,16 @@ void Utilities::saveExr(
 namespace TiffLoaderImpl {
 struct TiffParser {
   TiffParser(const char* filepath)
-      : m_buffer(Utilities::readFile(filepath)), m_offset(0) {}
-
-  ~TiffParser() {
-    freeFileReadAlloc(std::move(m_buffer));
-  }
+      : m_buffer(Utilities::readFilePooled(filepath)), m_offset(0) {}
 
   template <typename T> const T& parse() {
-    const T& t = *reinterpret_cast<const T*>(&m_buffer[m_offset]);
+    const T& t = *reinterpret_cast<const T*>(m_buffer.getData() + m_offset);
     m_offset += sizeof(T);
     return t;
   }
 
   template <typename T> const T& peak() {
-    return *reinterpret_cast<const T*>(&m_buffer[m_offset]);
+    return *reinterpret_cast<const T*>(m_buffer.getData() + m_offset);
   }
 
   void seek(uint32_t offset) { m_offset = offset; }
@@ -305,7 +309,7 @@ struct TiffParser {
 
   ScopedSeek pushSeek(uint32_t offset) { return ScopedSeek(this, offset); }
 
-  std::vector<char> m_buffer;
+  FileBuffer m_buffer;
   uint32_t m_offset;
 };
 } // namespace TiffLoaderImpl
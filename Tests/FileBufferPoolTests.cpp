@@ -0,0 +1,195 @@
+// Checks that the file buffer pool hands recycled buffers back out without
+// clearing them, keeps its statistics consistent while many threads acquire
+// and recycle buffers, and doesn't hold on to more memory than it is allowed.
+
+#include "FileBufferPool.h"
+#include "TestUtilities.h"
+
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace AltheaEngine;
+
+namespace {
+constexpr uint64_t SHARED_POOL_MAX_BYTES = 256 * 1024 * 1024;
+constexpr size_t LARGEST_CLASS_SIZE = 64 * 1024 * 1024;
+
+void resetPool() {
+  FileBufferPool::trim();
+  FileBufferPool::resetStats();
+}
+
+void testReuse() {
+  resetPool();
+
+  const char* pData = nullptr;
+  {
+    FileBuffer buffer = FileBufferPool::acquire(10000);
+    CHECK(buffer.getSize() == 10000);
+    std::memset(buffer.getData(), 0xAB, buffer.getSize());
+    pData = buffer.getData();
+  }
+  CHECK(FileBufferPool::getStats().pooledBytes == 16 * 1024);
+
+  // Same size class, so the same memory comes back, untouched
+  FileBuffer buffer = FileBufferPool::acquire(12000);
+  CHECK(buffer.getData() == pData);
+  CHECK(buffer.getSize() == 12000);
+  bool untouched = true;
+  for (size_t i = 0; i < 10000; ++i)
+    untouched = untouched && static_cast<uint8_t>(buffer.getData()[i]) == 0xAB;
+  CHECK(untouched);
+
+  FileBufferPoolStats stats = FileBufferPool::getStats();
+  CHECK(stats.misses == 1);
+  CHECK(stats.threadCacheHits == 1);
+  CHECK(stats.pooledBytes == 0);
+}
+
+void testResize() {
+  resetPool();
+
+  FileBuffer buffer = FileBufferPool::acquire(100);
+  std::memset(buffer.getData(), 0x5C, 100);
+  const char* pData = buffer.getData();
+
+  // Still fits in the 4KB class
+  buffer.resize(3000);
+  CHECK(buffer.getData() == pData);
+  CHECK(buffer.getSize() == 3000);
+
+  buffer.resize(10000);
+  CHECK(buffer.getSize() == 10000);
+  bool kept = true;
+  for (size_t i = 0; i < 100; ++i)
+    kept = kept && static_cast<uint8_t>(buffer.getData()[i]) == 0x5C;
+  CHECK(kept);
+
+  buffer.resize(50);
+  CHECK(buffer.getSize() == 50);
+  CHECK(!buffer.isEmpty());
+}
+
+void testMove() {
+  resetPool();
+
+  FileBuffer buffer = FileBufferPool::acquire(5000);
+  const char* pData = buffer.getData();
+
+  FileBuffer moved(std::move(buffer));
+  CHECK(moved.getData() == pData);
+  CHECK(moved.getSize() == 5000);
+  CHECK(buffer.isEmpty());
+  CHECK(buffer.getData() == nullptr);
+
+  FileBuffer assigned;
+  assigned = std::move(moved);
+  CHECK(assigned.getData() == pData);
+  CHECK(moved.isEmpty());
+
+  // Only the one buffer goes back to the pool
+  buffer = FileBuffer();
+  moved = FileBuffer();
+  assigned = FileBuffer();
+  CHECK(FileBufferPool::getStats().pooledBytes == 8 * 1024);
+  CHECK(FileBufferPool::getStats().discards == 0);
+}
+
+void testOversized() {
+  resetPool();
+
+  {
+    FileBuffer buffer = FileBufferPool::acquire(LARGEST_CLASS_SIZE + 1);
+    CHECK(buffer.getSize() == LARGEST_CLASS_SIZE + 1);
+  }
+
+  FileBufferPoolStats stats = FileBufferPool::getStats();
+  CHECK(stats.misses == 1);
+  CHECK(stats.discards == 1);
+  CHECK(stats.pooledBytes == 0);
+}
+
+void testThreads() {
+  resetPool();
+
+  constexpr uint32_t THREAD_COUNT = 8;
+  constexpr uint32_t ITERATION_COUNT = 2000;
+
+  // Buffers are handed between threads, so they are recycled on a different
+  // thread than the one that acquired them
+  std::mutex handoffMutex;
+  std::vector<FileBuffer> handoff;
+
+  std::vector<uint32_t> corruptCounts(THREAD_COUNT, 0);
+  std::vector<std::thread> threads;
+  for (uint32_t threadIdx = 0; threadIdx < THREAD_COUNT; ++threadIdx) {
+    threads.emplace_back([&, threadIdx]() {
+      std::mt19937 rng(threadIdx);
+      std::uniform_int_distribution<size_t> sizes(1, 1024 * 1024);
+      std::vector<FileBuffer> kept;
+
+      for (uint32_t i = 0; i < ITERATION_COUNT; ++i) {
+        FileBuffer buffer = FileBufferPool::acquire(sizes(rng));
+        char tag = static_cast<char>(threadIdx + 1);
+        buffer.getData()[0] = tag;
+        buffer.getData()[buffer.getSize() - 1] = tag;
+
+        std::this_thread::yield();
+        if (buffer.getData()[0] != tag ||
+            buffer.getData()[buffer.getSize() - 1] != tag)
+          ++corruptCounts[threadIdx];
+
+        if (i % 3 == 0) {
+          std::lock_guard<std::mutex> lock(handoffMutex);
+          handoff.push_back(std::move(buffer));
+          if (handoff.size() > 16) {
+            kept.push_back(std::move(handoff.front()));
+            handoff.erase(handoff.begin());
+          }
+        } else if (i % 3 == 1) {
+          kept.push_back(std::move(buffer));
+          if (kept.size() > 4)
+            kept.erase(kept.begin());
+        }
+      }
+    });
+  }
+
+  for (std::thread& thread : threads)
+    thread.join();
+
+  for (uint32_t corruptCount : corruptCounts)
+    CHECK(corruptCount == 0);
+
+  handoff.clear();
+
+  FileBufferPoolStats stats = FileBufferPool::getStats();
+  CHECK(
+      stats.threadCacheHits + stats.sharedHits + stats.misses ==
+      THREAD_COUNT * ITERATION_COUNT);
+  // Recycling kept most acquires from allocating
+  CHECK(stats.misses < THREAD_COUNT * ITERATION_COUNT / 2);
+  CHECK(stats.sharedHits > 0);
+  // The exited threads flushed their caches into the shared pool, which
+  // stays within its budget. This thread's cache holds the handed off ones.
+  CHECK(stats.pooledBytes <= SHARED_POOL_MAX_BYTES + 32 * 1024 * 1024);
+
+  FileBufferPool::trim();
+  CHECK(FileBufferPool::getStats().pooledBytes == 0);
+}
+} // namespace
+
+int main() {
+  return AltheaTests::runTests({
+      {"Reuse", testReuse},
+      {"Resize", testResize},
+      {"Move", testMove},
+      {"Oversized", testOversized},
+      {"Threads", testThreads},
+  });
+}
@@ -0,0 +1,343 @@
+// Checks that jobs run after their dependencies, that cycles are rejected,
+// that graphs can be executed from within jobs running on the same pool and
+// that the Chrome trace is valid JSON.
+
+#include "JobGraph.h"
+#include "ThreadPool.h"
+#include "TestUtilities.h"
+
+#include <atomic>
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace AltheaEngine;
+
+namespace {
+// Records the order jobs start and finish in
+struct Timeline {
+  std::atomic<uint32_t> clock{0};
+  std::vector<uint32_t> starts;
+  std::vector<uint32_t> ends;
+
+  explicit Timeline(uint32_t jobCount) : starts(jobCount), ends(jobCount) {}
+
+  std::function<void()> record(uint32_t idx) {
+    return [this, idx]() {
+      starts[idx] = ++clock;
+      // Gives a concurrently running job the chance to start too early
+      std::this_thread::yield();
+      ends[idx] = ++clock;
+    };
+  }
+
+  bool isBefore(uint32_t before, uint32_t after) const {
+    return ends[before] < starts[after];
+  }
+};
+
+void testDependencies() {
+  ThreadPool pool(4);
+
+  // A diamond followed by a fan-out, with one job depending on all of them
+  //   0 -> 1, 2 -> 3 -> 4, 5, 6, 7 -> 8
+  constexpr uint32_t JOB_COUNT = 9;
+  Timeline timeline(JOB_COUNT);
+  JobGraph graph;
+  JobGraph::JobId a = graph.addJob("A", timeline.record(0));
+  JobGraph::JobId b = graph.addJob("B", timeline.record(1), {a});
+  JobGraph::JobId c = graph.addJob("C", timeline.record(2), {a});
+  JobGraph::JobId d = graph.addJob("D", timeline.record(3), {b, c});
+  std::vector<JobGraph::JobId> fanOut;
+  for (uint32_t i = 4; i < 8; ++i)
+    fanOut.push_back(graph.addJob("Fan-out", timeline.record(i), {d}));
+  JobGraph::JobId last = graph.addJob("Last", timeline.record(8), fanOut);
+
+  // Graphs are meant to be run again, e.g. every frame
+  for (uint32_t run = 0; run < 20; ++run) {
+    timeline.clock = 0;
+    graph.execute(pool);
+
+    CHECK(timeline.isBefore(a, b));
+    CHECK(timeline.isBefore(a, c));
+    CHECK(timeline.isBefore(b, d));
+    CHECK(timeline.isBefore(c, d));
+    for (JobGraph::JobId fanOutId : fanOut) {
+      CHECK(timeline.isBefore(d, fanOutId));
+      CHECK(timeline.isBefore(fanOutId, last));
+    }
+    CHECK(timeline.clock == 2 * JOB_COUNT);
+  }
+}
+
+void testParallelFor() {
+  ThreadPool pool(4);
+
+  constexpr uint32_t COUNT = 10000;
+  std::vector<uint32_t> values(COUNT, 0);
+  uint64_t sum = 0;
+
+  JobGraph graph;
+  JobGraph::JobId fill =
+      graph.addParallelFor("Fill", COUNT, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; ++i)
+          values[i] = i;
+      });
+  graph.addJob(
+      "Sum",
+      [&]() {
+        for (uint32_t value : values)
+          sum += value;
+      },
+      {fill});
+
+  graph.execute(pool);
+  CHECK(sum == uint64_t(COUNT) * (COUNT - 1) / 2);
+}
+
+void testCycles() {
+  JobGraph graph;
+  JobGraph::JobId a = graph.addJob("A", []() {});
+  JobGraph::JobId b = graph.addJob("B", []() {}, {a});
+  JobGraph::JobId c = graph.addJob("C", []() {}, {b});
+
+  bool threw = false;
+  try {
+    graph.addDependency(a, a);
+  } catch (const std::runtime_error&) {
+    threw = true;
+  }
+  CHECK(threw);
+
+  threw = false;
+  try {
+    graph.addDependency(a, 42);
+  } catch (const std::runtime_error&) {
+    threw = true;
+  }
+  CHECK(threw);
+
+  bool ran = false;
+  graph.addJob("D", [&]() { ran = true; });
+  graph.addDependency(c, a);
+
+  ThreadPool pool(2);
+  threw = false;
+  try {
+    graph.execute(pool);
+  } catch (const std::runtime_error&) {
+    threw = true;
+  }
+  CHECK(threw);
+  // Nothing runs, not even the jobs outside of the cycle
+  CHECK(!ran);
+}
+
+// Builds and runs a small graph, the way a system would from within a job
+uint32_t runInnerGraph(ThreadPool& pool) {
+  std::atomic<uint32_t> count{0};
+  JobGraph graph;
+  JobGraph::JobId first = graph.addJob("Inner first", [&]() { ++count; });
+  graph.addParallelFor(
+      "Inner loop",
+      64,
+      [&](uint32_t begin, uint32_t end) { count += end - begin; },
+      {first});
+  graph.execute(pool);
+  return count;
+}
+
+void testNestedExecute() {
+  // Fewer workers than outer jobs, so every worker blocks in an inner
+  // execute and has to run the inner jobs while it waits
+  ThreadPool pool(2);
+
+  constexpr uint32_t OUTER_COUNT = 8;
+  std::vector<uint32_t> innerCounts(OUTER_COUNT, 0);
+
+  JobGraph graph;
+  for (uint32_t i = 0; i < OUTER_COUNT; ++i) {
+    graph.addJob("Outer", [&pool, &innerCounts, i]() {
+      innerCounts[i] = runInnerGraph(pool);
+    });
+  }
+  graph.execute(pool);
+
+  for (uint32_t innerCount : innerCounts)
+    CHECK(innerCount == 65);
+
+  // And from a plain task, where the caller waits on the result
+  std::atomic<uint32_t> taskCount{0};
+  pool.submit([&]() { taskCount = runInnerGraph(pool); });
+  pool.waitUntil([&]() { return taskCount != 0; });
+  CHECK(taskCount == 65);
+}
+
+// A strict JSON validator, just enough to check the trace
+class JsonValidator {
+public:
+  explicit JsonValidator(const std::string& text) : m_text(text) {}
+
+  bool validate() {
+    return _value() && (_skipWhitespace(), m_pos == m_text.size());
+  }
+
+private:
+  void _skipWhitespace() {
+    while (m_pos < m_text.size() &&
+           std::isspace(static_cast<unsigned char>(m_text[m_pos])))
+      ++m_pos;
+  }
+
+  bool _consume(char c) {
+    _skipWhitespace();
+    if (m_pos < m_text.size() && m_text[m_pos] == c) {
+      ++m_pos;
+      return true;
+    }
+    return false;
+  }
+
+  bool _value() {
+    _skipWhitespace();
+    if (m_pos >= m_text.size())
+      return false;
+
+    char c = m_text[m_pos];
+    if (c == '{')
+      return _object();
+    if (c == '[')
+      return _array();
+    if (c == '"')
+      return _string();
+    if (c == '-' || std::isdigit(static_cast<unsigned char>(c)))
+      return _number();
+    for (const char* literal : {"true", "false", "null"}) {
+      std::string str(literal);
+      if (m_text.compare(m_pos, str.size(), str) == 0) {
+        m_pos += str.size();
+        return true;
+      }
+    }
+    return false;
+  }
+
+  bool _object() {
+    ++m_pos;
+    if (_consume('}'))
+      return true;
+    do {
+      _skipWhitespace();
+      if (!_string() || !_consume(':') || !_value())
+        return false;
+    } while (_consume(','));
+    return _consume('}');
+  }
+
+  bool _array() {
+    ++m_pos;
+    if (_consume(']'))
+      return true;
+    do {
+      if (!_value())
+        return false;
+    } while (_consume(','));
+    return _consume(']');
+  }
+
+  bool _string() {
+    if (m_pos >= m_text.size() || m_text[m_pos] != '"')
+      return false;
+    ++m_pos;
+    while (m_pos < m_text.size()) {
+      char c = m_text[m_pos++];
+      if (c == '"')
+        return true;
+      if (static_cast<unsigned char>(c) < 0x20)
+        return false;
+      if (c == '\\') {
+        if (m_pos >= m_text.size())
+          return false;
+        char escaped = m_text[m_pos++];
+        if (std::string("\"\\/bfnrt").find(escaped) == std::string::npos)
+          return false;
+      }
+    }
+    return false;
+  }
+
+  bool _number() {
+    size_t start = m_pos;
+    if (m_text[m_pos] == '-')
+      ++m_pos;
+    size_t digitsStart = m_pos;
+    while (m_pos < m_text.size() &&
+           std::isdigit(static_cast<unsigned char>(m_text[m_pos])))
+      ++m_pos;
+    if (m_pos == digitsStart)
+      return false;
+    if (m_pos < m_text.size() && m_text[m_pos] == '.') {
+      size_t fractionStart = ++m_pos;
+      while (m_pos < m_text.size() &&
+             std::isdigit(static_cast<unsigned char>(m_text[m_pos])))
+        ++m_pos;
+      if (m_pos == fractionStart)
+        return false;
+    }
+    return m_pos > start;
+  }
+
+  const std::string& m_text;
+  size_t m_pos = 0;
+};
+
+void testChromeTrace() {
+  ThreadPool pool(2);
+
+  JobGraph graph;
+  JobGraph::JobId a = graph.addJob("Quoted \"name\" \\ with\ttab", []() {});
+  JobGraph::JobId b = graph.addJob("B", []() {}, {a});
+  graph.addJob("C", []() {}, {a, b});
+  graph.execute(pool);
+
+  const std::string path = "JobGraphTestsTrace.json";
+  graph.writeChromeTrace(path);
+
+  std::ifstream file(path);
+  std::string trace(
+      (std::istreambuf_iterator<char>(file)),
+      std::istreambuf_iterator<char>());
+  file.close();
+  std::remove(path.c_str());
+
+  CHECK(!trace.empty());
+  CHECK(JsonValidator(trace).validate());
+  // One flow start and end per dependency
+  size_t flowCount = 0;
+  for (size_t pos = trace.find("\"ph\":\"s\""); pos != std::string::npos;
+       pos = trace.find("\"ph\":\"s\"", pos + 1))
+    ++flowCount;
+  CHECK(flowCount == 3);
+
+  // Invalid JSON is caught
+  CHECK(!JsonValidator("{\"traceEvents\":[{},]}").validate());
+  CHECK(!JsonValidator("{\"name\":\"a\"b\"}").validate());
+}
+} // namespace
+
+int main() {
+  return AltheaTests::runTests({
+      {"Dependencies", testDependencies},
+      {"ParallelFor", testParallelFor},
+      {"Cycles", testCycles},
+      {"NestedExecute", testNestedExecute},
+      {"ChromeTrace", testChromeTrace},
+  });
+}
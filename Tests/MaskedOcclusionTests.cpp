@@ -0,0 +1,182 @@
+// Checks the masked occlusion coverage kernels against a scalar reference,
+// and the occlusion buffer against simple scenes with a known answer.
+
+#include "MaskedOcclusion.h"
+#include "MaskedOcclusionCoverage.h"
+#include "TestUtilities.h"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace AltheaEngine;
+
+namespace {
+uint32_t computeReferenceCoverage(
+    const float edgeA[3],
+    const float rowC[4][3],
+    float tileMinX) {
+  uint32_t coverage = 0;
+  for (uint32_t row = 0; row < 4; ++row) {
+    for (uint32_t i = 0; i < 8; ++i) {
+      float x = tileMinX + i + 0.5f;
+      bool inside = true;
+      for (uint32_t k = 0; k < 3; ++k)
+        inside = inside && edgeA[k] * x + rowC[row][k] >= 0.0f;
+      if (inside)
+        coverage |= 1u << (row * 8 + i);
+    }
+  }
+
+  return coverage;
+}
+
+void checkCoverageVariant(
+    MaskedOcclusionCoverage::TileCoverageFunction computeTileCoverage) {
+  std::mt19937 rng(1);
+  std::uniform_real_distribution<float> coefficient(-4.0f, 4.0f);
+  std::uniform_real_distribution<float> constant(-40.0f, 40.0f);
+  std::uniform_int_distribution<int> tile(0, 200);
+
+  uint32_t mismatchCount = 0;
+  for (uint32_t i = 0; i < 100000; ++i) {
+    float tileMinX = 8.0f * tile(rng);
+    float edgeA[3];
+    float rowC[4][3];
+    for (uint32_t k = 0; k < 3; ++k) {
+      edgeA[k] = coefficient(rng);
+      // Edges that pass through the tile, so masks are partially covered
+      float c = constant(rng) - edgeA[k] * (tileMinX + 4.0f);
+      float b = coefficient(rng);
+      for (uint32_t row = 0; row < 4; ++row)
+        rowC[row][k] = c + b * row;
+    }
+
+    if (computeTileCoverage(edgeA, rowC, tileMinX) !=
+        computeReferenceCoverage(edgeA, rowC, tileMinX))
+      ++mismatchCount;
+  }
+
+  CHECK(mismatchCount == 0);
+}
+
+void testCoverage() {
+  checkCoverageVariant(&MaskedOcclusionCoverage::computeTileCoverage);
+}
+
+void testCoverageAVX2() {
+  if (!MaskedOcclusionCoverage::isAVX2Supported()) {
+    std::printf("AVX2 is not supported, skipping\n");
+    return;
+  }
+
+  checkCoverageVariant(&MaskedOcclusionCoverage::computeTileCoverageAVX2);
+  CHECK(
+      MaskedOcclusionCoverage::getTileCoverageFunction() ==
+      &MaskedOcclusionCoverage::computeTileCoverageAVX2);
+}
+
+// A wall facing the camera, covering the whole view at the given distance
+struct Wall {
+  std::vector<glm::vec3> positions = {
+      glm::vec3(-100.0f, -100.0f, 0.0f),
+      glm::vec3(100.0f, -100.0f, 0.0f),
+      glm::vec3(100.0f, 100.0f, 0.0f),
+      glm::vec3(-100.0f, 100.0f, 0.0f)};
+  std::vector<uint32_t> indices = {0, 1, 2, 0, 2, 3};
+
+  OccluderMesh createOccluder(float distance) const {
+    OccluderMesh occluder;
+    occluder.pPositions = positions.data();
+    occluder.vertexCount = static_cast<uint32_t>(positions.size());
+    occluder.pIndices = indices.data();
+    occluder.indexCount = static_cast<uint32_t>(indices.size());
+    occluder.transform =
+        glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -distance));
+    return occluder;
+  }
+};
+
+glm::mat4 createViewProjection() {
+  // Looking down -z from the origin
+  glm::mat4 view = glm::lookAt(
+      glm::vec3(0.0f),
+      glm::vec3(0.0f, 0.0f, -1.0f),
+      glm::vec3(0.0f, 1.0f, 0.0f));
+  glm::mat4 projection =
+      glm::perspective(glm::radians(60.0f), 4.0f / 3.0f, 0.1f, 1000.0f);
+  return projection * view;
+}
+
+bool isBoxOccluded(
+    const MaskedOcclusionBuffer& buffer,
+    const glm::vec3& center,
+    float halfExtent) {
+  return buffer.isOccluded(
+      center - glm::vec3(halfExtent),
+      center + glm::vec3(halfExtent));
+}
+
+void testOcclusion() {
+  Wall wall;
+  std::vector<OccluderMesh> occluders = {wall.createOccluder(20.0f)};
+
+  for (uint32_t threadCount : {1u, 4u}) {
+    MaskedOcclusionBuffer buffer(320, 240);
+    buffer.render(createViewProjection(), occluders, threadCount);
+
+    // Every tile is covered by the wall
+    for (uint32_t y = 0; y < buffer.getTilesY(); ++y) {
+      for (uint32_t x = 0; x < buffer.getTilesX(); ++x)
+        CHECK(buffer.getTileDepth(x, y) < 1.0f);
+    }
+
+    CHECK(isBoxOccluded(buffer, glm::vec3(0.0f, 0.0f, -50.0f), 2.0f));
+    CHECK(isBoxOccluded(buffer, glm::vec3(5.0f, -3.0f, -25.0f), 1.0f));
+
+    // In front of the wall, straddling it and crossing the near plane
+    CHECK(!isBoxOccluded(buffer, glm::vec3(0.0f, 0.0f, -10.0f), 2.0f));
+    CHECK(!isBoxOccluded(buffer, glm::vec3(0.0f, 0.0f, -20.0f), 2.0f));
+    CHECK(!isBoxOccluded(buffer, glm::vec3(0.0f, 0.0f, 0.0f), 1.0f));
+  }
+}
+
+void testPartialOccluder() {
+  // A wall covering only the left half of the view
+  Wall wall;
+  wall.positions = {
+      glm::vec3(-100.0f, -100.0f, 0.0f),
+      glm::vec3(0.0f, -100.0f, 0.0f),
+      glm::vec3(0.0f, 100.0f, 0.0f),
+      glm::vec3(-100.0f, 100.0f, 0.0f)};
+  std::vector<OccluderMesh> occluders = {wall.createOccluder(20.0f)};
+
+  MaskedOcclusionBuffer buffer(320, 240);
+  buffer.render(createViewProjection(), occluders);
+
+  CHECK(isBoxOccluded(buffer, glm::vec3(-20.0f, 0.0f, -50.0f), 2.0f));
+  CHECK(!isBoxOccluded(buffer, glm::vec3(20.0f, 0.0f, -50.0f), 2.0f));
+  // Behind the wall's edge, partly visible
+  CHECK(!isBoxOccluded(buffer, glm::vec3(0.0f, 0.0f, -50.0f), 4.0f));
+}
+
+void testEmpty() {
+  MaskedOcclusionBuffer buffer(64, 64);
+  buffer.render(createViewProjection(), {});
+  CHECK(!isBoxOccluded(buffer, glm::vec3(0.0f, 0.0f, -50.0f), 1.0f));
+}
+} // namespace
+
+int main() {
+  return AltheaTests::runTests({
+      {"Coverage", testCoverage},
+      {"CoverageAVX2", testCoverageAVX2},
+      {"Occlusion", testOcclusion},
+      {"PartialOccluder", testPartialOccluder},
+      {"Empty", testEmpty},
+  });
+}
@@ -0,0 +1,321 @@
+// Checks the meshlet builder and the CPU reference meshlet culler against
+// brute-force results on generated meshes.
+
+#include "Frustum.h"
+#include "Meshlets.h"
+#include "TestUtilities.h"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <vector>
+
+using namespace AltheaEngine;
+
+namespace {
+struct TestMesh {
+  std::vector<Vertex> vertices;
+  std::vector<uint32_t> indices;
+};
+
+// A grid in the z = 0 plane facing +z, optionally displaced by a wave so
+// meshlets are not convex
+TestMesh createGrid(uint32_t size, float waveHeight = 0.0f) {
+  TestMesh mesh;
+  for (uint32_t y = 0; y <= size; ++y) {
+    for (uint32_t x = 0; x <= size; ++x) {
+      Vertex& vertex = mesh.vertices.emplace_back();
+      vertex.position = glm::vec3(
+          float(x),
+          float(y),
+          waveHeight * std::sin(0.7f * float(x)) * std::cos(0.9f * float(y)));
+      vertex.normal = glm::vec3(0.0f, 0.0f, 1.0f);
+    }
+  }
+
+  for (uint32_t y = 0; y < size; ++y) {
+    for (uint32_t x = 0; x < size; ++x) {
+      uint32_t v00 = y * (size + 1) + x;
+      uint32_t v10 = v00 + 1;
+      uint32_t v01 = v00 + size + 1;
+      uint32_t v11 = v01 + 1;
+      mesh.indices.insert(mesh.indices.end(), {v00, v10, v11});
+      mesh.indices.insert(mesh.indices.end(), {v00, v11, v01});
+    }
+  }
+
+  return mesh;
+}
+
+// A UV sphere with outward facing triangles
+TestMesh createSphere(uint32_t rings, uint32_t segments, float radius) {
+  TestMesh mesh;
+  for (uint32_t ring = 0; ring <= rings; ++ring) {
+    float theta = 3.14159265f * float(ring) / float(rings);
+    for (uint32_t segment = 0; segment <= segments; ++segment) {
+      float phi = 2.0f * 3.14159265f * float(segment) / float(segments);
+      Vertex& vertex = mesh.vertices.emplace_back();
+      vertex.normal = glm::vec3(
+          std::sin(theta) * std::cos(phi),
+          std::sin(theta) * std::sin(phi),
+          std::cos(theta));
+      vertex.position = radius * vertex.normal;
+    }
+  }
+
+  for (uint32_t ring = 0; ring < rings; ++ring) {
+    for (uint32_t segment = 0; segment < segments; ++segment) {
+      uint32_t v00 = ring * (segments + 1) + segment;
+      uint32_t v01 = v00 + 1;
+      uint32_t v10 = v00 + segments + 1;
+      uint32_t v11 = v10 + 1;
+      if (ring != 0)
+        mesh.indices.insert(mesh.indices.end(), {v00, v10, v01});
+      if (ring != rings - 1)
+        mesh.indices.insert(mesh.indices.end(), {v01, v10, v11});
+    }
+  }
+
+  return mesh;
+}
+
+uint32_t getMeshletVertex(
+    const std::vector<uint32_t>& meshletData,
+    const Meshlet& meshlet,
+    uint32_t packedTriangle,
+    uint32_t corner) {
+  uint32_t localIdx = (packedTriangle >> (8 * corner)) & 0xff;
+  return meshletData[meshlet.vertexOffset + localIdx];
+}
+
+// Frustum planes that every sphere passes, so only the cone test applies
+Frustum createUnboundedFrustum() {
+  Frustum frustum;
+  for (glm::vec4& plane : frustum.planes)
+    plane = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+  return frustum;
+}
+
+void testMeshletLimits() {
+  for (const TestMesh& mesh :
+       {createGrid(40), createSphere(24, 48, 2.0f)}) {
+    std::vector<Meshlet> meshlets;
+    std::vector<uint32_t> meshletData;
+    MeshletUtilities::buildMeshlets(
+        mesh.vertices,
+        mesh.indices,
+        meshlets,
+        meshletData);
+    CHECK(!meshlets.empty());
+
+    // Every triangle of the mesh ends up in exactly one meshlet
+    std::vector<uint32_t> emittedTriangles;
+    for (const Meshlet& meshlet : meshlets) {
+      CHECK(meshlet.vertexCount > 0);
+      CHECK(meshlet.vertexCount <= MESHLET_MAX_VERTICES);
+      CHECK(meshlet.triangleCount > 0);
+      CHECK(meshlet.triangleCount <= MESHLET_MAX_TRIANGLES);
+      CHECK(
+          meshlet.triangleOffset + meshlet.triangleCount <=
+          meshletData.size());
+
+      for (uint32_t t = 0; t < meshlet.triangleCount; ++t) {
+        uint32_t packedTriangle = meshletData[meshlet.triangleOffset + t];
+        CHECK((packedTriangle >> 24) == 0);
+        for (uint32_t corner = 0; corner < 3; ++corner) {
+          uint32_t localIdx = (packedTriangle >> (8 * corner)) & 0xff;
+          CHECK(localIdx < meshlet.vertexCount);
+        }
+
+        emittedTriangles.push_back(
+            getMeshletVertex(meshletData, meshlet, packedTriangle, 0));
+        emittedTriangles.push_back(
+            getMeshletVertex(meshletData, meshlet, packedTriangle, 1));
+        emittedTriangles.push_back(
+            getMeshletVertex(meshletData, meshlet, packedTriangle, 2));
+      }
+    }
+
+    // Compare as sorted lists of triangles, keeping each triangle's winding
+    auto toSortedTriangles = [](const std::vector<uint32_t>& indices) {
+      std::vector<std::array<uint32_t, 3>> triangles;
+      for (size_t i = 0; i + 2 < indices.size(); i += 3)
+        triangles.push_back({indices[i], indices[i + 1], indices[i + 2]});
+      std::sort(triangles.begin(), triangles.end());
+      return triangles;
+    };
+    CHECK(
+        toSortedTriangles(emittedTriangles) ==
+        toSortedTriangles(mesh.indices));
+  }
+}
+
+void testBoundingSpheres() {
+  TestMesh mesh = createSphere(32, 64, 3.0f);
+  std::vector<Meshlet> meshlets;
+  std::vector<uint32_t> meshletData;
+  MeshletUtilities::buildMeshlets(
+      mesh.vertices,
+      mesh.indices,
+      meshlets,
+      meshletData);
+
+  for (const Meshlet& meshlet : meshlets) {
+    // The sphere should be reasonably tight, not just the whole mesh
+    CHECK(meshlet.radius < 3.0f);
+    for (uint32_t i = 0; i < meshlet.vertexCount; ++i) {
+      const glm::vec3& position =
+          mesh.vertices[meshletData[meshlet.vertexOffset + i]].position;
+      float distance = glm::length(position - meshlet.center);
+      CHECK(distance <= meshlet.radius * (1.0f + 1e-5f) + 1e-5f);
+    }
+  }
+}
+
+void testConeCulling() {
+  Frustum unbounded = createUnboundedFrustum();
+
+  // A flat meshlet facing +z is culled from behind and kept from the front
+  {
+    TestMesh grid = createGrid(4);
+    std::vector<Meshlet> meshlets;
+    std::vector<uint32_t> meshletData;
+    MeshletUtilities::buildMeshlets(
+        grid.vertices,
+        grid.indices,
+        meshlets,
+        meshletData);
+    CHECK(meshlets.size() == 1);
+    CHECK(meshlets[0].coneCutoff < 1.0f);
+
+    glm::vec3 front(2.0f, 2.0f, 5.0f);
+    glm::vec3 behind(2.0f, 2.0f, -5.0f);
+    CHECK(MeshletUtilities::isMeshletVisible(meshlets[0], unbounded, front));
+    CHECK(!MeshletUtilities::isMeshletVisible(meshlets[0], unbounded, behind));
+
+    // The same holds after a rigid transform, here flipping the grid to face
+    // -z and moving it
+    glm::mat4 transform = glm::rotate(
+        glm::translate(glm::mat4(1.0f), glm::vec3(10.0f, 0.0f, 0.0f)),
+        3.14159265f,
+        glm::vec3(0.0f, 1.0f, 0.0f));
+    std::vector<uint32_t> visibleMeshlets;
+    MeshletUtilities::cullMeshlets(
+        meshlets,
+        transform,
+        unbounded,
+        glm::vec3(8.0f, 2.0f, -5.0f),
+        visibleMeshlets);
+    CHECK(visibleMeshlets.size() == 1);
+    MeshletUtilities::cullMeshlets(
+        meshlets,
+        transform,
+        unbounded,
+        glm::vec3(8.0f, 2.0f, 5.0f),
+        visibleMeshlets);
+    CHECK(visibleMeshlets.empty());
+  }
+
+  // A cone cull is only ever conservative, every triangle of a culled
+  // meshlet must face away from the viewer
+  for (const TestMesh& mesh :
+       {createSphere(32, 64, 1.0f), createGrid(24, 0.3f)}) {
+    std::vector<Meshlet> meshlets;
+    std::vector<uint32_t> meshletData;
+    MeshletUtilities::buildMeshlets(
+        mesh.vertices,
+        mesh.indices,
+        meshlets,
+        meshletData);
+
+    auto getPosition = [&](const Meshlet& meshlet,
+                           uint32_t packedTriangle,
+                           uint32_t corner) {
+      return mesh.vertices[getMeshletVertex(
+                               meshletData,
+                               meshlet,
+                               packedTriangle,
+                               corner)]
+          .position;
+    };
+
+    glm::vec3 boundsMin(std::numeric_limits<float>::max());
+    glm::vec3 boundsMax(-std::numeric_limits<float>::max());
+    for (const Vertex& vertex : mesh.vertices) {
+      boundsMin = glm::min(boundsMin, vertex.position);
+      boundsMax = glm::max(boundsMax, vertex.position);
+    }
+
+    // Viewers close to and around the surface, where a cone apex placed in
+    // front of any triangle would cull it wrongly
+    std::mt19937 random(7);
+    std::uniform_real_distribution<float> unit(-0.5f, 1.5f);
+    uint32_t culledCount = 0;
+    for (uint32_t viewerIdx = 0; viewerIdx < 2000; ++viewerIdx) {
+      glm::vec3 viewer =
+          boundsMin +
+          (boundsMax - boundsMin + glm::vec3(1.0f)) *
+              glm::vec3(unit(random), unit(random), unit(random));
+      for (const Meshlet& meshlet : meshlets) {
+        if (MeshletUtilities::isMeshletVisible(meshlet, unbounded, viewer))
+          continue;
+
+        ++culledCount;
+        for (uint32_t t = 0; t < meshlet.triangleCount; ++t) {
+          uint32_t packedTriangle = meshletData[meshlet.triangleOffset + t];
+          glm::vec3 p0 = getPosition(meshlet, packedTriangle, 0);
+          glm::vec3 p1 = getPosition(meshlet, packedTriangle, 1);
+          glm::vec3 p2 = getPosition(meshlet, packedTriangle, 2);
+          glm::vec3 normal = glm::normalize(glm::cross(p1 - p0, p2 - p0));
+          CHECK(glm::dot(normal, viewer - p0) <= 1e-4f);
+        }
+      }
+    }
+
+    // Some of the surface is seen from behind
+    CHECK(culledCount > 0);
+  }
+}
+
+void testFrustum() {
+  glm::mat4 projection =
+      glm::perspective(glm::radians(90.0f), 1.0f, 0.1f, 100.0f);
+  glm::mat4 view = glm::lookAt(
+      glm::vec3(0.0f),
+      glm::vec3(0.0f, 0.0f, -1.0f),
+      glm::vec3(0.0f, 1.0f, 0.0f));
+  Frustum frustum = Frustum::fromViewProjection(projection * view);
+
+  CHECK(frustum.intersectsSphere(glm::vec3(0.0f, 0.0f, -10.0f), 1.0f));
+  CHECK(!frustum.intersectsSphere(glm::vec3(0.0f, 0.0f, 10.0f), 1.0f));
+  CHECK(!frustum.intersectsSphere(glm::vec3(0.0f, 0.0f, -200.0f), 1.0f));
+  // Just outside the 45 degree side plane, and just touching it
+  CHECK(!frustum.intersectsSphere(glm::vec3(12.0f, 0.0f, -10.0f), 1.0f));
+  CHECK(frustum.intersectsSphere(glm::vec3(11.0f, 0.0f, -10.0f), 1.0f));
+
+  CHECK(frustum.intersectsAABB(
+      glm::vec3(-1.0f, -1.0f, -11.0f),
+      glm::vec3(1.0f, 1.0f, -9.0f)));
+  CHECK(!frustum.intersectsAABB(
+      glm::vec3(-1.0f, -1.0f, 9.0f),
+      glm::vec3(1.0f, 1.0f, 11.0f)));
+  // A box straddling the near plane is kept
+  CHECK(frustum.intersectsAABB(
+      glm::vec3(-1.0f, -1.0f, -1.0f),
+      glm::vec3(1.0f, 1.0f, 1.0f)));
+}
+} // namespace
+
+int main() {
+  return AltheaTests::runTests(
+      {{"MeshletLimits", testMeshletLimits},
+       {"BoundingSpheres", testBoundingSpheres},
+       {"ConeCulling", testConeCulling},
+       {"Frustum", testFrustum}});
+}
@@ -0,0 +1,425 @@
+// Round trips files through pack files and checks that damaged packs are
+// rejected, or at least fail to read, without reading out of bounds.
+
+#include "FileBufferPool.h"
+#include "PackFile.h"
+#include "TestUtilities.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <optional>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace AltheaEngine;
+
+namespace {
+// The on-disk layout, see PackFile.cpp
+constexpr size_t HEADER_SIZE = 16;
+struct IndexEntryLayout {
+  uint64_t nameHash;
+  uint64_t nameOffset;
+  uint64_t dataOffset;
+  uint64_t storedSize;
+  uint64_t size;
+  uint32_t nameLength;
+  uint32_t compression;
+};
+
+// Two names with the same 64-bit FNV-1a hash
+const std::string COLLIDING_NAME_A = "Collision/goetuvE9tNO";
+const std::string COLLIDING_NAME_B = "Collision/OhSSOZXqqNG";
+
+uint64_t hashName(const std::string& name) {
+  uint64_t hash = 14695981039346656037ull;
+  for (char c : name) {
+    hash ^= static_cast<uint8_t>(c);
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+std::filesystem::path getTestDirectory() {
+  return std::filesystem::temp_directory_path() / "AltheaPackFileTests";
+}
+
+class TestFiles {
+public:
+  TestFiles() {
+    std::filesystem::remove_all(getTestDirectory());
+    std::filesystem::create_directories(getTestDirectory());
+  }
+
+  ~TestFiles() {
+    std::error_code errorCode;
+    std::filesystem::remove_all(getTestDirectory(), errorCode);
+  }
+
+  void add(const std::string& name, const std::vector<char>& contents) {
+    std::string path =
+        (getTestDirectory() / ("source" + std::to_string(m_sources.size())))
+            .string();
+    std::ofstream file(path, std::ios::out | std::ios::binary);
+    file.write(contents.data(), contents.size());
+
+    m_sources.push_back({name, path});
+    m_contents.push_back(contents);
+  }
+
+  std::string writePack(PackCompression compression) const {
+    std::string path = (getTestDirectory() / "Test.pak").string();
+    PackFile::write(path, m_sources, compression);
+    return path;
+  }
+
+  const std::vector<PackFile::Source>& getSources() const {
+    return m_sources;
+  }
+  const std::vector<char>& getContents(size_t i) const {
+    return m_contents[i];
+  }
+
+private:
+  std::vector<PackFile::Source> m_sources;
+  std::vector<std::vector<char>> m_contents;
+};
+
+std::vector<char> createCompressible(size_t size) {
+  const std::string text = "The quick brown fox jumps over the lazy dog. ";
+  std::vector<char> contents(size);
+  for (size_t i = 0; i < size; ++i)
+    contents[i] = text[i % text.size()];
+  return contents;
+}
+
+std::vector<char> createIncompressible(size_t size, uint32_t seed) {
+  std::mt19937 rng(seed);
+  std::vector<char> contents(size);
+  for (char& c : contents)
+    c = static_cast<char>(rng());
+  return contents;
+}
+
+std::vector<char> readWholeFile(const std::string& path) {
+  std::ifstream file(path, std::ios::ate | std::ios::binary);
+  std::vector<char> contents(static_cast<size_t>(file.tellg()));
+  file.seekg(0);
+  file.read(contents.data(), contents.size());
+  return contents;
+}
+
+void writeWholeFile(const std::string& path, const std::vector<char>& data) {
+  std::ofstream file(path, std::ios::out | std::ios::binary | std::ios::trunc);
+  file.write(data.data(), data.size());
+}
+
+IndexEntryLayout
+readEntry(const std::vector<char>& pack, uint32_t entryIdx) {
+  IndexEntryLayout entry;
+  std::memcpy(
+      &entry,
+      pack.data() + HEADER_SIZE + entryIdx * sizeof(IndexEntryLayout),
+      sizeof(entry));
+  return entry;
+}
+
+void writeEntry(
+    std::vector<char>& pack,
+    uint32_t entryIdx,
+    const IndexEntryLayout& entry) {
+  std::memcpy(
+      pack.data() + HEADER_SIZE + entryIdx * sizeof(IndexEntryLayout),
+      &entry,
+      sizeof(entry));
+}
+
+// Every entry reads back as written, through all of the read functions
+void checkContents(const PackFile& pack, const TestFiles& files) {
+  for (size_t i = 0; i < files.getSources().size(); ++i) {
+    const std::string& name = files.getSources()[i].name;
+    const std::vector<char>& expected = files.getContents(i);
+    CHECK(pack.contains(name));
+
+    std::vector<char> contents;
+    CHECK(pack.read(name, contents));
+    CHECK(contents == expected);
+
+    FileBuffer buffer;
+    CHECK(pack.read(name, buffer));
+    CHECK(buffer.getSize() == expected.size());
+    CHECK(
+        expected.empty() ||
+        std::memcmp(buffer.getData(), expected.data(), expected.size()) == 0);
+
+    std::optional<gsl::span<const std::byte>> view = pack.view(name);
+    if (view) {
+      CHECK(view->size() == expected.size());
+      CHECK(
+          expected.empty() ||
+          std::memcmp(view->data(), expected.data(), expected.size()) == 0);
+    }
+  }
+}
+
+void testRoundTrip() {
+  TestFiles files;
+  files.add("Textures/Compressible.txt", createCompressible(100000));
+  files.add("Textures/Incompressible.bin", createIncompressible(50000, 1));
+  files.add("Empty.txt", {});
+  files.add("Small.txt", {'a', 'b', 'c'});
+  // Long runs of literals and matches use the extended lengths
+  std::vector<char> mixed = createIncompressible(1000, 2);
+  std::vector<char> run(70000, 'x');
+  mixed.insert(mixed.end(), run.begin(), run.end());
+  files.add("Models/Mixed.bin", mixed);
+
+  for (PackCompression compression :
+       {PackCompression::NONE, PackCompression::LZ4}) {
+    std::unique_ptr<PackFile> pPack =
+        PackFile::open(files.writePack(compression));
+    CHECK(pPack != nullptr);
+    if (!pPack)
+      continue;
+
+    CHECK(pPack->getEntryCount() == 5);
+    checkContents(*pPack, files);
+
+    // Only entries worth compressing are compressed, the rest can be viewed
+    // in place
+    bool isLz4 = compression == PackCompression::LZ4;
+    CHECK(pPack->view("Textures/Compressible.txt").has_value() == !isLz4);
+    CHECK(pPack->view("Models/Mixed.bin").has_value() == !isLz4);
+    CHECK(pPack->view("Textures/Incompressible.bin").has_value());
+    CHECK(pPack->view("Empty.txt").has_value());
+
+    CHECK(!pPack->contains("Missing.txt"));
+    CHECK(!pPack->contains("Textures"));
+    std::vector<char> missing;
+    CHECK(!pPack->read("Missing.txt", missing));
+    CHECK(!pPack->view("Missing.txt").has_value());
+  }
+}
+
+void testHashCollisions() {
+  CHECK(COLLIDING_NAME_A != COLLIDING_NAME_B);
+  CHECK(hashName(COLLIDING_NAME_A) == hashName(COLLIDING_NAME_B));
+
+  TestFiles files;
+  files.add(COLLIDING_NAME_A, createCompressible(5000));
+  files.add("Other.txt", createIncompressible(100, 3));
+  files.add(COLLIDING_NAME_B, createIncompressible(5000, 4));
+
+  std::unique_ptr<PackFile> pPack =
+      PackFile::open(files.writePack(PackCompression::LZ4));
+  CHECK(pPack != nullptr);
+  if (pPack)
+    checkContents(*pPack, files);
+}
+
+void testInvalidSources() {
+  TestFiles files;
+  files.add("Same.txt", {'a'});
+  files.add("Same.txt", {'b'});
+
+  bool threw = false;
+  try {
+    files.writePack(PackCompression::NONE);
+  } catch (const std::runtime_error&) {
+    threw = true;
+  }
+  CHECK(threw);
+
+  std::vector<PackFile::Source> sources = {
+      {"Missing.txt", (getTestDirectory() / "Missing").string()}};
+  std::string path = (getTestDirectory() / "Missing.pak").string();
+  threw = false;
+  try {
+    PackFile::write(path, sources, PackCompression::NONE);
+  } catch (const std::runtime_error&) {
+    threw = true;
+  }
+  CHECK(threw);
+  // The partial pack is cleaned up
+  CHECK(!std::filesystem::exists(path));
+  CHECK(!std::filesystem::exists(path + ".tmp"));
+}
+
+// Corrupts a valid pack and checks that it can no longer be opened
+struct CorruptionCase {
+  const char* name;
+  void (*corrupt)(std::vector<char>& pack);
+};
+
+void testCorruptIndex() {
+  TestFiles files;
+  files.add("A.txt", createCompressible(20000));
+  files.add("B.bin", createIncompressible(3000, 5));
+  files.add("C.txt", createCompressible(500));
+  std::string path = files.writePack(PackCompression::LZ4);
+  const std::vector<char> original = readWholeFile(path);
+
+  // The first entry by hash, to know which one is being corrupted
+  uint32_t compressedIdx = 0;
+  while (readEntry(original, compressedIdx).compression != 1)
+    ++compressedIdx;
+
+  const CorruptionCase cases[] = {
+      {"Magic", [](std::vector<char>& pack) { pack[0] ^= 1; }},
+      {"Version", [](std::vector<char>& pack) { pack[4] ^= 1; }},
+      {"Truncated header", [](std::vector<char>& pack) { pack.resize(8); }},
+      {"Truncated index",
+       [](std::vector<char>& pack) { pack.resize(HEADER_SIZE + 40); }},
+      {"Entry count",
+       [](std::vector<char>& pack) {
+         uint32_t entryCount = 0x10000000;
+         std::memcpy(pack.data() + 8, &entryCount, 4);
+       }},
+      {"Names size",
+       [](std::vector<char>& pack) {
+         uint32_t namesSize = 0xFFFFFFFF;
+         std::memcpy(pack.data() + 12, &namesSize, 4);
+       }},
+      {"Name hash",
+       [](std::vector<char>& pack) {
+         IndexEntryLayout entry = readEntry(pack, 1);
+         entry.nameHash ^= 1;
+         writeEntry(pack, 1, entry);
+       }},
+      {"Name range",
+       [](std::vector<char>& pack) {
+         IndexEntryLayout entry = readEntry(pack, 0);
+         entry.nameLength = 0xFFFFFFF0;
+         writeEntry(pack, 0, entry);
+       }},
+      {"Unsorted",
+       [](std::vector<char>& pack) {
+         IndexEntryLayout first = readEntry(pack, 0);
+         IndexEntryLayout second = readEntry(pack, 1);
+         writeEntry(pack, 0, second);
+         writeEntry(pack, 1, first);
+       }},
+      {"Data past the end",
+       [](std::vector<char>& pack) {
+         IndexEntryLayout entry = readEntry(pack, 2);
+         entry.dataOffset = pack.size() - 1;
+         entry.storedSize = 2;
+         entry.size = 2;
+         writeEntry(pack, 2, entry);
+       }},
+      {"Data offset overflow",
+       [](std::vector<char>& pack) {
+         IndexEntryLayout entry = readEntry(pack, 2);
+         entry.dataOffset = UINT64_MAX - 8;
+         writeEntry(pack, 2, entry);
+       }},
+      {"Unknown compression",
+       [](std::vector<char>& pack) {
+         IndexEntryLayout entry = readEntry(pack, 0);
+         entry.compression = 7;
+         writeEntry(pack, 0, entry);
+       }},
+      {"Stored size of an uncompressed entry",
+       [](std::vector<char>& pack) {
+         for (uint32_t i = 0; i < 3; ++i) {
+           IndexEntryLayout entry = readEntry(pack, i);
+           if (entry.compression == 0) {
+             entry.size = entry.storedSize + 1;
+             writeEntry(pack, i, entry);
+           }
+         }
+       }},
+      {"Implausible uncompressed size",
+       [](std::vector<char>& pack) {
+         for (uint32_t i = 0; i < 3; ++i) {
+           IndexEntryLayout entry = readEntry(pack, i);
+           if (entry.compression == 1) {
+             entry.size = uint64_t(1) << 40;
+             writeEntry(pack, i, entry);
+           }
+         }
+       }},
+  };
+
+  for (const CorruptionCase& corruption : cases) {
+    std::vector<char> pack = original;
+    corruption.corrupt(pack);
+    writeWholeFile(path, pack);
+
+    bool rejected = PackFile::open(path) == nullptr;
+    if (!rejected)
+      std::printf("Corrupt pack was opened: %s\n", corruption.name);
+    CHECK(rejected);
+  }
+
+  // A damaged compressed entry still opens, but fails to read
+  std::vector<char> pack = original;
+  IndexEntryLayout entry = readEntry(pack, compressedIdx);
+  std::string name(
+      pack.data() + HEADER_SIZE + 3 * sizeof(IndexEntryLayout) +
+          entry.nameOffset,
+      entry.nameLength);
+  for (uint64_t i = 0; i < entry.storedSize; i += 7)
+    pack[entry.dataOffset + i] ^= 0x5A;
+  writeWholeFile(path, pack);
+
+  std::unique_ptr<PackFile> pPack = PackFile::open(path);
+  CHECK(pPack != nullptr);
+  if (pPack) {
+    std::vector<char> contents;
+    CHECK(!pPack->read(name, contents));
+  }
+}
+
+// Random damage anywhere in the pack must never be read out of bounds, best
+// run with the address sanitizer
+void testRandomCorruption() {
+  TestFiles files;
+  files.add("A.txt", createCompressible(20000));
+  files.add("B.bin", createIncompressible(3000, 6));
+  files.add("C.txt", createCompressible(500));
+  files.add("D.txt", {});
+  std::string path = files.writePack(PackCompression::LZ4);
+  const std::vector<char> original = readWholeFile(path);
+
+  std::mt19937 rng(7);
+  uint32_t openedCount = 0;
+  for (uint32_t i = 0; i < 500; ++i) {
+    std::vector<char> pack = original;
+    uint32_t flipCount = 1 + rng() % 8;
+    for (uint32_t j = 0; j < flipCount; ++j)
+      pack[rng() % pack.size()] ^= static_cast<char>(1 + rng() % 255);
+    writeWholeFile(path, pack);
+
+    std::unique_ptr<PackFile> pPack = PackFile::open(path);
+    if (!pPack)
+      continue;
+
+    ++openedCount;
+    for (const PackFile::Source& source : files.getSources()) {
+      std::vector<char> contents;
+      pPack->read(source.name, contents);
+      FileBuffer buffer;
+      pPack->read(source.name, buffer);
+    }
+  }
+
+  // Damage to the blobs alone leaves the pack readable
+  CHECK(openedCount > 0);
+}
+} // namespace
+
+int main() {
+  return AltheaTests::runTests({
+      {"RoundTrip", testRoundTrip},
+      {"HashCollisions", testHashCollisions},
+      {"InvalidSources", testInvalidSources},
+      {"CorruptIndex", testCorruptIndex},
+      {"RandomCorruption", testRandomCorruption},
+  });
+}
@@ -0,0 +1,234 @@
+// Compiles render graphs without a device and checks the culled passes, the
+// barriers between passes and the memory shared by transient images.
+
+#include "RenderGraph.h"
+#include "TestUtilities.h"
+
+#include <cstdint>
+#include <stdexcept>
+
+using namespace AltheaEngine;
+
+namespace {
+constexpr VkPipelineStageFlags FRAGMENT = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+constexpr VkPipelineStageFlags COMPUTE = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+
+// Four bytes a pixel, any memory type
+VkMemoryRequirements getMemoryRequirements(const ImageOptions& options) {
+  VkMemoryRequirements requirements{};
+  requirements.size =
+      static_cast<VkDeviceSize>(options.width) * options.height * 4;
+  requirements.alignment = 256;
+  requirements.memoryTypeBits = 0x1;
+  return requirements;
+}
+
+ImageOptions createOptions() {
+  ImageOptions options{};
+  options.width = 256;
+  options.height = 256;
+  return options;
+}
+
+RenderGraphHandle importBackBuffer(RenderGraph& graph) {
+  return graph.importImage(
+      "Back buffer",
+      VK_NULL_HANDLE,
+      VK_NULL_HANDLE,
+      createOptions(),
+      {VK_IMAGE_LAYOUT_UNDEFINED, 0, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT},
+      RenderGraphAccess::present());
+}
+
+const RenderGraphBarrier* findBarrier(
+    const RenderGraphBarrierBatch& batch,
+    RenderGraphHandle resource) {
+  for (const RenderGraphBarrier& barrier : batch.imageBarriers) {
+    if (barrier.resourceIdx == resource.index)
+      return &barrier;
+  }
+
+  return nullptr;
+}
+
+void testCulling() {
+  RenderGraph graph;
+  RenderGraphHandle gBuffer = graph.createImage("GBuffer", createOptions());
+  RenderGraphHandle unused = graph.createImage("Unused", createOptions());
+  RenderGraphHandle backBuffer = importBackBuffer(graph);
+
+  graph.addPass("GBuffer", {}).write(
+      gBuffer,
+      RenderGraphAccess::colorAttachment());
+  graph.addPass("Unused", {})
+      .read(gBuffer, RenderGraphAccess::sampled(FRAGMENT))
+      .write(unused, RenderGraphAccess::colorAttachment());
+  graph.addPass("Debug", {}).setSideEffects();
+  graph.addPass("Lighting", {})
+      .read(gBuffer, RenderGraphAccess::sampled(FRAGMENT))
+      .write(backBuffer, RenderGraphAccess::colorAttachment());
+
+  graph.compile(getMemoryRequirements);
+
+  CHECK(!graph.isPassCulled(0));
+  CHECK(graph.isPassCulled(1));
+  CHECK(!graph.isPassCulled(2));
+  CHECK(!graph.isPassCulled(3));
+  CHECK(graph.getExecutionOrder().size() == 3);
+  CHECK(graph.getStats().culledPassCount == 1);
+  // The culled pass's image is never created
+  CHECK(graph.getStats().transientImageCount == 1);
+
+  RenderGraph invalidGraph;
+  RenderGraphHandle image = invalidGraph.createImage("Image", createOptions());
+  invalidGraph.addPass("Read", {})
+      .read(image, RenderGraphAccess::sampled(FRAGMENT))
+      .setSideEffects();
+
+  bool threw = false;
+  try {
+    invalidGraph.compile(getMemoryRequirements);
+  } catch (const std::runtime_error&) {
+    threw = true;
+  }
+  CHECK(threw);
+}
+
+void testBarriers() {
+  RenderGraph graph;
+  RenderGraphHandle gBuffer = graph.createImage("GBuffer", createOptions());
+  RenderGraphHandle backBuffer = importBackBuffer(graph);
+  RenderGraphHandle args = graph.importBuffer("Args", VK_NULL_HANDLE);
+
+  graph.addPass("GBuffer", {})
+      .write(gBuffer, RenderGraphAccess::colorAttachment())
+      .write(args, RenderGraphAccess::storageWrite(FRAGMENT));
+  graph.addPass("Lighting", {})
+      .read(gBuffer, RenderGraphAccess::sampled(FRAGMENT))
+      .read(args, RenderGraphAccess::indirectArgs())
+      .write(backBuffer, RenderGraphAccess::colorAttachment());
+
+  graph.compile(getMemoryRequirements);
+
+  const RenderGraphBarrierBatch& lighting = graph.getBarriers(1);
+  const RenderGraphBarrier* pGBuffer = findBarrier(lighting, gBuffer);
+  CHECK(pGBuffer != nullptr);
+  if (pGBuffer) {
+    CHECK(pGBuffer->oldLayout == VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+    CHECK(pGBuffer->newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    CHECK(pGBuffer->srcAccessMask == VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT);
+    CHECK(pGBuffer->dstAccessMask == VK_ACCESS_SHADER_READ_BIT);
+  }
+  CHECK(
+      lighting.srcStageMask & VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+  CHECK(lighting.dstStageMask & FRAGMENT);
+
+  // The buffer only needs a memory dependency
+  CHECK(lighting.hasMemoryBarrier);
+  CHECK(lighting.memorySrcAccessMask == VK_ACCESS_SHADER_WRITE_BIT);
+  CHECK(lighting.memoryDstAccessMask == VK_ACCESS_INDIRECT_COMMAND_READ_BIT);
+  CHECK(lighting.dstStageMask & VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT);
+
+  // The back buffer is left ready to present
+  const RenderGraphBarrier* pPresent =
+      findBarrier(graph.getFinalBarriers(), backBuffer);
+  CHECK(pPresent != nullptr);
+  if (pPresent) {
+    CHECK(pPresent->oldLayout == VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+    CHECK(pPresent->newLayout == VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+    CHECK(pPresent->srcAccessMask == VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT);
+  }
+}
+
+// Three images of the same size, the last one lives after the first one is
+// done and is placed in its memory.
+//  0: write A
+//  1: read A, write B
+//  2: read B, write C
+//  3: read and write C, write the back buffer
+struct AliasingGraph {
+  RenderGraph graph;
+  RenderGraphHandle a;
+  RenderGraphHandle b;
+  RenderGraphHandle c;
+
+  AliasingGraph() {
+    a = graph.createImage("A", createOptions());
+    b = graph.createImage("B", createOptions());
+    c = graph.createImage("C", createOptions());
+    RenderGraphHandle backBuffer = importBackBuffer(graph);
+
+    graph.addPass("Write A", {}).write(a, RenderGraphAccess::colorAttachment());
+    graph.addPass("Write B", {})
+        .read(a, RenderGraphAccess::sampled(FRAGMENT))
+        .write(b, RenderGraphAccess::colorAttachment());
+    graph.addPass("Write C", {})
+        .read(b, RenderGraphAccess::sampled(COMPUTE))
+        .write(c, RenderGraphAccess::storageWrite(COMPUTE));
+    graph.addPass("Modify C", {})
+        .readWrite(c, RenderGraphAccess::storageReadWrite(COMPUTE))
+        .write(backBuffer, RenderGraphAccess::colorAttachment());
+
+    graph.compile(getMemoryRequirements);
+  }
+};
+
+void testAliasing() {
+  AliasingGraph aliasing;
+  const RenderGraph& graph = aliasing.graph;
+
+  CHECK(
+      graph.getTransientMemoryIndex(aliasing.a) ==
+      graph.getTransientMemoryIndex(aliasing.c));
+  CHECK(
+      graph.getTransientOffset(aliasing.a) ==
+      graph.getTransientOffset(aliasing.c));
+  CHECK(
+      graph.getTransientOffset(aliasing.a) !=
+      graph.getTransientOffset(aliasing.b));
+
+  const RenderGraphStats& stats = graph.getStats();
+  CHECK(stats.transientImageCount == 3);
+  CHECK(stats.unaliasedMemorySize == 3 * 256 * 256 * 4);
+  CHECK(stats.transientMemorySize == 2 * 256 * 256 * 4);
+
+  // C's first use waits for the last read of A in the same memory
+  const RenderGraphBarrier* pC = findBarrier(graph.getBarriers(2), aliasing.c);
+  CHECK(pC != nullptr);
+  if (pC)
+    CHECK(pC->oldLayout == VK_IMAGE_LAYOUT_UNDEFINED);
+  CHECK(graph.getBarriers(2).srcStageMask & FRAGMENT);
+}
+
+void testPreviousExecution() {
+  AliasingGraph aliasing;
+  const RenderGraph& graph = aliasing.graph;
+
+  // A's first use shares its memory with C, last written by the previous
+  // execution's final pass
+  const RenderGraphBarrierBatch& first = graph.getBarriers(0);
+  const RenderGraphBarrier* pA = findBarrier(first, aliasing.a);
+  CHECK(pA != nullptr);
+  if (pA) {
+    CHECK(pA->oldLayout == VK_IMAGE_LAYOUT_UNDEFINED);
+    CHECK(pA->srcAccessMask & VK_ACCESS_SHADER_WRITE_BIT);
+  }
+  CHECK(first.srcStageMask & COMPUTE);
+  CHECK(!(first.srcStageMask & VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT));
+
+  // B has its own memory and waits for its own last read
+  const RenderGraphBarrierBatch& second = graph.getBarriers(1);
+  CHECK(findBarrier(second, aliasing.b) != nullptr);
+  CHECK(second.srcStageMask & COMPUTE);
+  CHECK(!(second.srcStageMask & VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT));
+}
+} // namespace
+
+int main() {
+  return AltheaTests::runTests({
+      {"Culling", testCulling},
+      {"Barriers", testBarriers},
+      {"Aliasing", testAliasing},
+      {"PreviousExecution", testPreviousExecution},
+  });
+}
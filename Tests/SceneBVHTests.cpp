@@ -0,0 +1,221 @@
+// Checks SceneBVH frustum culling against testing every box individually,
+// before and after refitting the hierarchy.
+
+#include "Frustum.h"
+#include "SceneBVH.h"
+#include "TestUtilities.h"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+using namespace AltheaEngine;
+
+namespace {
+// Boxes of varying sizes scattered through a cube, with a few large ones
+// spanning much of the scene
+std::vector<AABB> createBoxes(uint32_t count, std::mt19937& rng) {
+  std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+  std::uniform_real_distribution<float> size(0.1f, 5.0f);
+  std::uniform_real_distribution<float> largeSize(20.0f, 80.0f);
+
+  std::vector<AABB> boxes(count);
+  for (uint32_t i = 0; i < count; ++i) {
+    glm::vec3 center(position(rng), position(rng), position(rng));
+    glm::vec3 halfExtent = i % 97 == 0
+                               ? glm::vec3(largeSize(rng))
+                               : glm::vec3(size(rng), size(rng), size(rng));
+    boxes[i].min = center - halfExtent;
+    boxes[i].max = center + halfExtent;
+  }
+
+  return boxes;
+}
+
+Frustum createPerspectiveFrustum(std::mt19937& rng) {
+  std::uniform_real_distribution<float> position(-120.0f, 120.0f);
+  std::uniform_real_distribution<float> fov(0.3f, 2.0f);
+  std::uniform_real_distribution<float> farPlane(10.0f, 300.0f);
+
+  glm::vec3 eye(position(rng), position(rng), position(rng));
+  glm::vec3 target(position(rng), position(rng), position(rng));
+  if (glm::length(target - eye) < 1.0f)
+    target = eye + glm::vec3(1.0f, 0.0f, 0.0f);
+  glm::vec3 up = std::abs(glm::normalize(target - eye).y) > 0.99f
+                     ? glm::vec3(1.0f, 0.0f, 0.0f)
+                     : glm::vec3(0.0f, 1.0f, 0.0f);
+
+  glm::mat4 view = glm::lookAt(eye, target, up);
+  glm::mat4 projection =
+      glm::perspective(fov(rng), 16.0f / 9.0f, 0.1f, farPlane(rng));
+  return Frustum::fromViewProjection(projection * view);
+}
+
+Frustum createOrthographicFrustum(std::mt19937& rng) {
+  std::uniform_real_distribution<float> position(-120.0f, 120.0f);
+  std::uniform_real_distribution<float> extent(5.0f, 60.0f);
+
+  glm::vec3 eye(position(rng), position(rng), position(rng));
+  glm::mat4 view = glm::lookAt(
+      eye,
+      glm::vec3(0.0f),
+      std::abs(glm::normalize(eye).y) > 0.99f ? glm::vec3(1.0f, 0.0f, 0.0f)
+                                              : glm::vec3(0.0f, 1.0f, 0.0f));
+  float halfWidth = extent(rng);
+  float halfHeight = extent(rng);
+  glm::mat4 projection = glm::ortho(
+      -halfWidth,
+      halfWidth,
+      -halfHeight,
+      halfHeight,
+      0.0f,
+      glm::length(eye) + 200.0f);
+  return Frustum::fromViewProjection(projection * view);
+}
+
+// The hierarchy and the per-box test add the plane terms in a different
+// order, so boxes touching a plane may legitimately go either way
+bool isNearPlane(const Frustum& frustum, const AABB& box) {
+  for (const glm::vec4& plane : frustum.planes) {
+    glm::vec3 pVertex(
+        plane.x >= 0.0f ? box.max.x : box.min.x,
+        plane.y >= 0.0f ? box.max.y : box.min.y,
+        plane.z >= 0.0f ? box.max.z : box.min.z);
+    if (std::abs(glm::dot(glm::vec3(plane), pVertex) + plane.w) < 1e-3f)
+      return true;
+  }
+
+  return false;
+}
+
+void checkCulling(
+    const SceneBVH& bvh,
+    const std::vector<AABB>& boxes,
+    const Frustum& frustum) {
+  std::vector<uint32_t> visibleItems;
+  bvh.cullFrustum(frustum, visibleItems);
+  std::sort(visibleItems.begin(), visibleItems.end());
+
+  // Every item is reported at most once
+  CHECK(
+      std::adjacent_find(visibleItems.begin(), visibleItems.end()) ==
+      visibleItems.end());
+
+  std::vector<bool> culled(boxes.size(), true);
+  for (uint32_t itemIdx : visibleItems) {
+    CHECK(itemIdx < boxes.size());
+    if (itemIdx < boxes.size())
+      culled[itemIdx] = false;
+  }
+
+  uint32_t mismatchCount = 0;
+  for (uint32_t i = 0; i < boxes.size(); ++i) {
+    bool expectedVisible = frustum.intersectsAABB(boxes[i].min, boxes[i].max);
+    if (expectedVisible == !culled[i])
+      continue;
+
+    if (!isNearPlane(frustum, boxes[i]))
+      ++mismatchCount;
+  }
+
+  CHECK(mismatchCount == 0);
+}
+
+void testEmpty() {
+  SceneBVH bvh;
+  bvh.build(gsl::span<const AABB>());
+  CHECK(bvh.getItemCount() == 0);
+
+  std::mt19937 rng(1);
+  std::vector<uint32_t> visibleItems = {42};
+  bvh.cullFrustum(createPerspectiveFrustum(rng), visibleItems);
+  CHECK(visibleItems.empty());
+}
+
+void testSmallCounts() {
+  // Counts around the leaf size exercise partially filled packets
+  std::mt19937 rng(2);
+  for (uint32_t count = 1; count <= 9; ++count) {
+    std::vector<AABB> boxes = createBoxes(count, rng);
+    SceneBVH bvh;
+    bvh.build(boxes);
+    CHECK(bvh.getItemCount() == count);
+
+    for (uint32_t i = 0; i < 50; ++i)
+      checkCulling(bvh, boxes, createPerspectiveFrustum(rng));
+  }
+}
+
+void testCullFrustum() {
+  std::mt19937 rng(3);
+  std::vector<AABB> boxes = createBoxes(20000, rng);
+  SceneBVH bvh;
+  bvh.build(boxes);
+
+  for (uint32_t i = 0; i < boxes.size(); ++i) {
+    AABB bounds = bvh.getItemBounds(i);
+    CHECK(bounds.min == boxes[i].min && bounds.max == boxes[i].max);
+  }
+
+  for (uint32_t i = 0; i < 200; ++i)
+    checkCulling(bvh, boxes, createPerspectiveFrustum(rng));
+  for (uint32_t i = 0; i < 100; ++i)
+    checkCulling(bvh, boxes, createOrthographicFrustum(rng));
+
+  // Looking away from everything and containing everything
+  glm::mat4 awayView = glm::lookAt(
+      glm::vec3(0.0f, 0.0f, 500.0f),
+      glm::vec3(0.0f, 0.0f, 1000.0f),
+      glm::vec3(0.0f, 1.0f, 0.0f));
+  glm::mat4 projection = glm::perspective(1.0f, 1.0f, 0.1f, 100.0f);
+  Frustum awayFrustum = Frustum::fromViewProjection(projection * awayView);
+  std::vector<uint32_t> visibleItems;
+  bvh.cullFrustum(awayFrustum, visibleItems);
+  CHECK(visibleItems.empty());
+
+  glm::mat4 allView = glm::lookAt(
+      glm::vec3(0.0f, 0.0f, 1000.0f),
+      glm::vec3(0.0f),
+      glm::vec3(0.0f, 1.0f, 0.0f));
+  glm::mat4 allProjection = glm::perspective(1.0f, 1.0f, 0.1f, 3000.0f);
+  bvh.cullFrustum(
+      Frustum::fromViewProjection(allProjection * allView),
+      visibleItems);
+  CHECK(visibleItems.size() == boxes.size());
+}
+
+void testRefit() {
+  std::mt19937 rng(4);
+  std::vector<AABB> boxes = createBoxes(5000, rng);
+  SceneBVH bvh;
+  bvh.build(boxes);
+
+  // Move every box, including across the scene, without rebuilding
+  std::uniform_real_distribution<float> offset(-60.0f, 60.0f);
+  for (uint32_t step = 0; step < 3; ++step) {
+    for (AABB& box : boxes) {
+      glm::vec3 translation(offset(rng), offset(rng), offset(rng));
+      box.min += translation;
+      box.max += translation;
+    }
+
+    bvh.refit(boxes);
+    for (uint32_t i = 0; i < 100; ++i)
+      checkCulling(bvh, boxes, createPerspectiveFrustum(rng));
+  }
+}
+} // namespace
+
+int main() {
+  return AltheaTests::runTests({
+      {"Empty", testEmpty},
+      {"SmallCounts", testSmallCounts},
+      {"CullFrustum", testCullFrustum},
+      {"Refit", testRefit},
+  });
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+// Minimal checks shared by the headless test executables. A test executable
+// runs all of its tests and returns a non-zero exit code if any check failed,
+// so it can be run directly or through ctest.
+
+#include <cstdio>
+#include <initializer_list>
+
+namespace AltheaTests {
+inline int& getFailureCount() {
+  static int failureCount = 0;
+  return failureCount;
+}
+
+struct TestCase {
+  const char* name;
+  void (*run)();
+};
+
+inline int runTests(std::initializer_list<TestCase> tests) {
+  for (const TestCase& test : tests) {
+    int previousFailureCount = getFailureCount();
+    test.run();
+    std::printf(
+        "%s %s\n",
+        getFailureCount() == previousFailureCount ? "PASS" : "FAIL",
+        test.name);
+  }
+
+  return getFailureCount() == 0 ? 0 : 1;
+}
+} // namespace AltheaTests
+
+#define CHECK(condition)                                                       \
+  do {                                                                         \
+    if (!(condition)) {                                                        \
+      std::printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition);\
+      ++AltheaTests::getFailureCount();                                        \
+    }                                                                          \
+  } while (false)
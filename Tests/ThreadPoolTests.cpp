@@ -0,0 +1,188 @@
+// Checks the thread pool's scheduling: tasks submitted from within tasks,
+// stealing, sleeping workers being woken up, nested and throwing parallel
+// loops, and queued tasks being run before the pool is destroyed.
+
+#include "ThreadPool.h"
+#include "TestUtilities.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace AltheaEngine;
+
+namespace {
+// Waits without running any tasks on the calling thread, unlike
+// ThreadPool::waitUntil, so only the workers can make progress
+template <typename Predicate>
+bool waitFor(Predicate isDone) {
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  while (!isDone()) {
+    if (std::chrono::steady_clock::now() > deadline)
+      return false;
+    std::this_thread::sleep_for(std::chrono::microseconds(100));
+  }
+
+  return true;
+}
+
+void testNestedSubmit() {
+  ThreadPool pool(4);
+
+  constexpr uint32_t OUTER_COUNT = 32;
+  constexpr uint32_t INNER_COUNT = 32;
+
+  std::atomic<uint32_t> innerRuns{0};
+  std::atomic<uint32_t> submittedFromWorker{0};
+  for (uint32_t i = 0; i < OUTER_COUNT; ++i) {
+    pool.submit([&]() {
+      if (pool.isWorkerThread())
+        ++submittedFromWorker;
+
+      for (uint32_t j = 0; j < INNER_COUNT; ++j)
+        pool.submit([&]() { ++innerRuns; });
+    });
+  }
+
+  CHECK(waitFor([&]() { return innerRuns == OUTER_COUNT * INNER_COUNT; }));
+  CHECK(submittedFromWorker == OUTER_COUNT);
+  CHECK(pool.getStats().tasksExecuted >= OUTER_COUNT * INNER_COUNT);
+}
+
+void testStealing() {
+  ThreadPool pool(4);
+
+  // All of the tasks are queued on one worker, the idle ones have to steal
+  // them to help out
+  constexpr uint32_t TASK_COUNT = 64;
+  std::atomic<uint32_t> runs{0};
+  pool.submit([&]() {
+    for (uint32_t i = 0; i < TASK_COUNT; ++i) {
+      pool.submit([&]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        ++runs;
+      });
+    }
+  });
+
+  CHECK(waitFor([&]() { return runs == TASK_COUNT; }));
+  CHECK(pool.getStats().tasksStolen > 0);
+}
+
+void testParking() {
+  ThreadPool pool(2);
+
+  // Long enough for both workers to run out of spins and go to sleep
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  CHECK(pool.getStats().parks > 0);
+
+  std::atomic<bool> ran{false};
+  pool.submit([&]() { ran = true; });
+  CHECK(waitFor([&]() { return ran.load(); }));
+}
+
+void testNestedParallelFor() {
+  ThreadPool pool(4);
+
+  constexpr uint32_t OUTER_COUNT = 16;
+  constexpr uint32_t INNER_COUNT = 1000;
+
+  std::vector<std::atomic<uint32_t>> visits(OUTER_COUNT * INNER_COUNT);
+  for (std::atomic<uint32_t>& visit : visits)
+    visit = 0;
+
+  pool.parallelFor(OUTER_COUNT, [&](uint32_t begin, uint32_t end) {
+    for (uint32_t i = begin; i < end; ++i) {
+      pool.parallelFor(
+          INNER_COUNT,
+          [&, i](uint32_t innerBegin, uint32_t innerEnd) {
+            for (uint32_t j = innerBegin; j < innerEnd; ++j)
+              ++visits[i * INNER_COUNT + j];
+          },
+          16);
+    }
+  });
+
+  uint32_t wrongCount = 0;
+  for (const std::atomic<uint32_t>& visit : visits) {
+    if (visit != 1)
+      ++wrongCount;
+  }
+  CHECK(wrongCount == 0);
+}
+
+void testParallelForException() {
+  ThreadPool pool(4);
+
+  constexpr uint32_t COUNT = 1000;
+  std::atomic<uint32_t> processed{0};
+
+  bool threw = false;
+  try {
+    pool.parallelFor(COUNT, [&](uint32_t begin, uint32_t end) {
+      for (uint32_t i = begin; i < end; ++i) {
+        if (i == 500)
+          throw std::runtime_error("Index 500");
+        ++processed;
+      }
+    });
+  } catch (const std::runtime_error& e) {
+    threw = std::string(e.what()) == "Index 500";
+  }
+
+  CHECK(threw);
+  // Every other chunk still ran to completion before the rethrow
+  CHECK(processed < COUNT);
+  CHECK(processed >= COUNT / 2);
+
+  // And the pool still works afterwards
+  std::atomic<uint32_t> sum{0};
+  pool.parallelFor(COUNT, [&](uint32_t begin, uint32_t end) {
+    sum += end - begin;
+  });
+  CHECK(sum == COUNT);
+}
+
+void testDestructorDrains() {
+  constexpr uint32_t TASK_COUNT = 1000;
+  std::atomic<uint32_t> runs{0};
+
+  {
+    ThreadPool pool(2);
+
+    // Keeps the workers busy so the rest stays queued until destruction
+    pool.submit([]() {
+      std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    });
+    pool.submit([]() {
+      std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    });
+
+    for (uint32_t i = 0; i < TASK_COUNT; ++i) {
+      pool.submit([&pool, &runs]() {
+        ++runs;
+        // Submitted while the pool is being destroyed
+        pool.submit([&runs]() { ++runs; });
+      });
+    }
+  }
+
+  CHECK(runs == 2 * TASK_COUNT);
+}
+} // namespace
+
+int main() {
+  return AltheaTests::runTests({
+      {"NestedSubmit", testNestedSubmit},
+      {"Stealing", testStealing},
+      {"Parking", testParking},
+      {"NestedParallelFor", testNestedParallelFor},
+      {"ParallelForException", testParallelForException},
+      {"DestructorDrains", testDestructorDrains},
+  });
+}
@@ -0,0 +1,84 @@
+// Packs every file under a content directory into a single PackFile, which
+// the engine mounts in place of the loose files.
+//
+// Usage: AssetPacker <content directory> [--output <pack path>] [--compress]
+//
+// The pack defaults to <content directory>.apak, next to the directory, which
+// is where Application looks for the engine and project Content/ packs.
+//
+// Pass --compress to store entries LZ4 compressed wherever that makes them
+// meaningfully smaller. Already compressed formats, like PNG and JPEG, are
+// left as they are and can still be read in place.
+
+#include "PackFile.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <vector>
+
+using namespace AltheaEngine;
+
+int main(int argc, char** argv) {
+  std::vector<std::string> directories;
+  std::string outputPath;
+  PackCompression compression = PackCompression::NONE;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "--output" && i + 1 < argc)
+      outputPath = argv[++i];
+    else if (arg == "--compress")
+      compression = PackCompression::LZ4;
+    else
+      directories.push_back(arg);
+  }
+
+  if (directories.size() != 1 ||
+      !std::filesystem::is_directory(directories[0])) {
+    std::cout << "Usage: AssetPacker <content directory> "
+                 "[--output <pack path>] [--compress]\n";
+    return 1;
+  }
+
+  std::string directory = directories[0];
+  while (directory.size() > 1 &&
+         (directory.back() == '/' || directory.back() == '\\'))
+    directory.pop_back();
+  if (outputPath.empty())
+    outputPath = directory + ".apak";
+
+  std::error_code errorCode;
+  std::vector<PackFile::Source> sources;
+  uint64_t totalSize = 0;
+  for (const auto& entry :
+       std::filesystem::recursive_directory_iterator(directory)) {
+    if (!entry.is_regular_file())
+      continue;
+
+    // Don't pack an earlier pack written into the directory itself
+    if (std::filesystem::equivalent(entry.path(), outputPath, errorCode))
+      continue;
+
+    PackFile::Source& source = sources.emplace_back();
+    source.name = entry.path().lexically_relative(directory).generic_string();
+    source.path = entry.path().string();
+    totalSize += entry.file_size();
+  }
+
+  try {
+    PackFile::write(outputPath, sources, compression);
+  } catch (const std::exception& e) {
+    std::cout << e.what() << "\n";
+    return 1;
+  }
+
+  std::cout << "Packed " << sources.size() << " files (" << totalSize
+            << " bytes) into " << outputPath << " ("
+            << std::filesystem::file_size(outputPath, errorCode)
+            << " bytes)\n";
+
+  return 0;
+}
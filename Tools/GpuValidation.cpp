@@ -0,0 +1,187 @@
+// Checks the GPU culling and light clustering compute passes against their
+// CPU references on the current device, e.g., lavapipe in CI.
+//
+// Usage: GpuValidation <engine directory> [glTF model]
+//
+// A grid of copies of the model is culled against views in every direction,
+// and randomly placed point lights are assigned to clusters for each view.
+// Exits with a non-zero code if the GPU results differ from the CPU ones.
+// Ray tracing is not needed.
+
+#include "Application.h"
+#include "Camera.h"
+#include "GlobalHeap.h"
+#include "IGameInstance.h"
+#include "IndirectDraws.h"
+#include "IntrusivePtr.h"
+#include "LightClusters.h"
+#include "Model.h"
+#include "PointLight.h"
+#include "SingleTimeCommandBuffer.h"
+
+#include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace AltheaEngine;
+
+namespace {
+constexpr uint32_t MODEL_GRID_SIZE = 4;
+constexpr float MODEL_SPACING = 3.0f;
+constexpr uint32_t LIGHT_COUNT = 512;
+constexpr uint32_t VIEW_COUNT = 8;
+
+class GpuValidation : public IGameInstance {
+public:
+  explicit GpuValidation(std::string modelPath)
+      : m_modelPath(std::move(modelPath)) {}
+
+  void initGame(Application& app) override {}
+  void shutdownGame(Application& app) override {}
+
+  void createRenderState(Application& app) override {
+    SingleTimeCommandBuffer commandBuffer(app);
+    m_heap = GlobalHeap(app);
+
+    // Centered on the origin, so every view sees part of the grid
+    float offset = 0.5f * MODEL_SPACING * (MODEL_GRID_SIZE - 1);
+    for (uint32_t x = 0; x < MODEL_GRID_SIZE; ++x) {
+      for (uint32_t z = 0; z < MODEL_GRID_SIZE; ++z) {
+        glm::vec3 position(
+            MODEL_SPACING * x - offset,
+            0.0f,
+            MODEL_SPACING * z - offset);
+        m_models.emplace_back(
+            app,
+            commandBuffer,
+            m_heap,
+            m_modelPath,
+            glm::translate(glm::mat4(1.0f), position));
+      }
+    }
+
+    m_pIndirectDraws = makeIntrusive<IndirectDraws>(app, m_heap);
+
+    m_pLights = std::make_unique<PointLightCollection>(
+        app,
+        commandBuffer,
+        m_heap,
+        LIGHT_COUNT,
+        false,
+        BufferHandle{});
+
+    // Lights of varying reach, from a few clusters to most of the view
+    std::mt19937 rng(0);
+    std::uniform_real_distribution<float> position(
+        -2.0f * offset,
+        2.0f * offset);
+    std::uniform_real_distribution<float> emission(0.001f, 2.0f);
+    for (uint32_t i = 0; i < LIGHT_COUNT; ++i) {
+      PointLight light{};
+      light.position =
+          glm::vec3(position(rng), 0.25f * position(rng), position(rng));
+      light.emission = glm::vec3(emission(rng));
+      m_pLights->setLight(i, light);
+    }
+  }
+
+  void destroyRenderState(Application& app) override {
+    m_pLights.reset();
+    m_pIndirectDraws = {};
+    m_models.clear();
+    m_heap = {};
+  }
+
+  void tick(Application& app, const FrameContext& frame) override {
+    if (m_validated)
+      return;
+
+    // The frame's buffers are not in use by the GPU while ticking
+    m_pIndirectDraws->update(m_heap, frame, m_models);
+
+    const VkExtent2D& extent = app.getSwapChainExtent();
+    Camera camera(
+        70.0f,
+        static_cast<float>(extent.width) / static_cast<float>(extent.height),
+        0.1f,
+        100.0f);
+    camera.setPosition(glm::vec3(0.0f, 1.0f, 0.0f));
+
+    for (uint32_t view = 0; view < VIEW_COUNT; ++view) {
+      camera.setRotationDegrees(360.0f * view / VIEW_COUNT, -10.0f);
+
+      m_mismatchCount += m_pIndirectDraws->validateGpuCull(
+          app,
+          m_heap,
+          frame,
+          m_models,
+          camera.computeFrustum());
+      m_mismatchCount += m_pLights->getLightClusters().validateGpuBuild(
+          app,
+          m_heap,
+          frame,
+          camera,
+          *m_pLights);
+    }
+
+    std::cout << "Validated " << m_pIndirectDraws->getItemCount()
+              << " draw items in " << m_pIndirectDraws->getBatchCount()
+              << " batches and " << LIGHT_COUNT << " lights from "
+              << VIEW_COUNT << " views on "
+              << app.getPhysicalDeviceProperties().deviceName << ": "
+              << m_mismatchCount << " mismatches\n";
+
+    m_validated = true;
+    glfwSetWindowShouldClose(app.getWindow(), GLFW_TRUE);
+  }
+
+  void draw(
+      Application& app,
+      VkCommandBuffer commandBuffer,
+      const FrameContext& frame) override {}
+
+  bool succeeded() const { return m_validated && m_mismatchCount == 0; }
+
+private:
+  std::string m_modelPath;
+
+  GlobalHeap m_heap;
+  std::vector<Model> m_models;
+  IntrusivePtr<IndirectDraws> m_pIndirectDraws;
+  std::unique_ptr<PointLightCollection> m_pLights;
+
+  bool m_validated = false;
+  uint32_t m_mismatchCount = 0;
+};
+} // namespace
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    std::cout << "Usage: GpuValidation <engine directory> [glTF model]\n";
+    return 1;
+  }
+
+  std::string engineDirectory = argv[1];
+  std::string modelPath = argc > 2
+                              ? argv[2]
+                              : engineDirectory +
+                                    "/Content/Models/DamagedHelmet.glb";
+
+  Application::CreateOptions options{};
+  options.width = 640;
+  options.height = 360;
+
+  Application app("GPU Validation", engineDirectory, engineDirectory, &options);
+  GpuValidation* pGame = app.createGame<GpuValidation>(modelPath);
+  app.run();
+
+  return pGame->succeeded() ? 0 : 1;
+}
@@ -0,0 +1,93 @@
+// Compiles every shader under the engine and project Shaders/ directories,
+// populating the on-disk SPIR-V cache so the first launch skips compilation.
+//
+// Usage: ShaderCachePrewarm <engine directory> [project directory]
+//
+// Only the variant with no extra defines is compiled for each shader,
+// permutations are cached the first time they are built at runtime. Use
+// ShaderVariantPrecompiler to build every declared permutation ahead of time.
+
+#include "Application.h"
+#include "Shader.h"
+#include "ShaderCache.h"
+#include "ShaderCompiler.h"
+#include "ShaderFileWatcher.h"
+#include "ShaderTools.h"
+#include "ThreadPool.h"
+
+#include <shaderc/shaderc.hpp>
+
+#include <cstdint>
+#include <filesystem>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <vector>
+
+using namespace AltheaEngine;
+
+namespace {
+void collectShaders(
+    const std::filesystem::path& directory,
+    std::vector<ShaderBuilder>& builders) {
+  if (!std::filesystem::is_directory(directory))
+    return;
+
+  for (const auto& entry :
+       std::filesystem::recursive_directory_iterator(directory)) {
+    if (!entry.is_regular_file())
+      continue;
+
+    std::optional<shaderc_shader_kind> kind = getShaderKind(entry.path());
+    if (!kind)
+      continue;
+
+    // Starts compiling in the background on the shared thread pool
+    builders.emplace_back(
+        entry.path().string(),
+        *kind,
+        ShaderDefines{},
+        SHADER_LANGUAGE_GLSL);
+  }
+}
+} // namespace
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    std::cout << "Usage: ShaderCachePrewarm <engine directory> "
+                 "[project directory]\n";
+    return 1;
+  }
+
+  GEngineDirectory = argv[1];
+  GProjectDirectory = argc > 2 ? argv[2] : argv[1];
+
+  // Nothing is hot reloaded here
+  ShaderFileWatcher::setEnabled(false);
+
+  std::vector<ShaderBuilder> builders;
+  collectShaders(GEngineDirectory + "/Shaders", builders);
+  if (GProjectDirectory != GEngineDirectory)
+    collectShaders(GProjectDirectory + "/Shaders", builders);
+
+  uint32_t shaderCount = static_cast<uint32_t>(builders.size());
+  uint32_t failureCount = 0;
+  for (const ShaderBuilder& builder : builders) {
+    if (builder.hasErrors()) {
+      ++failureCount;
+      std::cout << builder.getErrors() << "\n";
+    }
+  }
+
+  ShaderCacheStats stats = ShaderCache::getStats();
+  std::cout << "Prewarmed " << shaderCount << " shaders into "
+            << ShaderCache::getDirectory() << " on "
+            << ThreadPool::getShared().getThreadCount() << " threads\n"
+            << "  already cached: " << stats.hits << "\n"
+            << "  stale: " << stats.staleEntries << "\n"
+            << "  written: " << stats.writes << "\n"
+            << "  write failures: " << stats.writeFailures << "\n"
+            << "  compile failures: " << failureCount << "\n";
+
+  return failureCount == 0 && stats.writeFailures == 0 ? 0 : 1;
+}
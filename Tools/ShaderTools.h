@@ -0,0 +1,45 @@
+#pragma once
+
+// Helpers shared by the offline shader tools
+
+#include <shaderc/shaderc.hpp>
+
+#include <filesystem>
+#include <optional>
+#include <string>
+
+inline std::optional<shaderc_shader_kind>
+getShaderKind(const std::filesystem::path& path) {
+  std::string extension = path.extension().string();
+  if (extension == ".vert")
+    return shaderc_vertex_shader;
+  if (extension == ".frag")
+    return shaderc_fragment_shader;
+  if (extension == ".comp")
+    return shaderc_compute_shader;
+  if (extension == ".geom")
+    return shaderc_geometry_shader;
+  if (extension == ".tesc")
+    return shaderc_tess_control_shader;
+  if (extension == ".tese")
+    return shaderc_tess_evaluation_shader;
+  if (extension == ".rgen")
+    return shaderc_raygen_shader;
+  if (extension == ".rmiss")
+    return shaderc_miss_shader;
+  if (extension == ".rchit")
+    return shaderc_closesthit_shader;
+  if (extension == ".rahit")
+    return shaderc_anyhit_shader;
+  if (extension == ".rint")
+    return shaderc_intersection_shader;
+  if (extension == ".rcall")
+    return shaderc_callable_shader;
+  if (extension == ".mesh")
+    return shaderc_mesh_shader;
+  if (extension == ".task")
+    return shaderc_task_shader;
+
+  // Headers (.glsl) and anything else are only compiled through includes
+  return std::nullopt;
+}
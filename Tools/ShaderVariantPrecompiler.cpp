@@ -0,0 +1,256 @@
+// Compiles every declared permutation of every shader under the engine and
+// project Shaders/ directories and packs them into a ShaderVariantArchive, so
+// variants are loaded at runtime without invoking the compiler.
+//
+// Usage: ShaderVariantPrecompiler <engine directory> [project directory]
+//            [--output <archive path>] [--debug-info]
+//
+// Permutations are declared in the shader source with comment directives,
+// each variant is one combination of all of the shader's declared defines:
+//
+//   // #permutation WIREFRAME
+//     Compiled both with and without WIREFRAME defined.
+//   // #permutation BINDLESS_SET=0|1
+//     Compiled once with each value.
+//
+// Pass --debug-info to match applications that generate shader debug info,
+// which includes every debug build of the engine.
+
+#include "Application.h"
+#include "Shader.h"
+#include "ShaderCache.h"
+#include "ShaderCompiler.h"
+#include "ShaderFileWatcher.h"
+#include "ShaderTools.h"
+#include "ShaderVariantArchive.h"
+#include "ThreadPool.h"
+#include "Utilities.h"
+
+#include <shaderc/shaderc.hpp>
+
+#include <cstdint>
+#include <filesystem>
+#include <future>
+#include <iostream>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace AltheaEngine;
+
+namespace {
+// Guards against accidentally declaring an exponential number of variants
+constexpr size_t MAX_VARIANTS_PER_SHADER = 256;
+
+struct PermutationAxis {
+  std::string define;
+  // std::nullopt leaves the define undefined
+  std::vector<std::optional<std::string>> values;
+};
+
+std::vector<PermutationAxis> parsePermutations(
+    const std::string& path,
+    const std::vector<char>& code) {
+  static const std::string directive = "// #permutation";
+
+  std::vector<PermutationAxis> axes;
+  std::istringstream lines(std::string(code.begin(), code.end()));
+  std::string line;
+  while (std::getline(lines, line)) {
+    size_t start = line.find_first_not_of(" \t");
+    if (start == std::string::npos ||
+        line.compare(start, directive.size(), directive) != 0)
+      continue;
+
+    std::istringstream tokens(line.substr(start + directive.size()));
+    std::string token;
+    while (tokens >> token) {
+      PermutationAxis& axis = axes.emplace_back();
+
+      size_t equals = token.find('=');
+      if (equals == std::string::npos) {
+        axis.define = token;
+        axis.values.push_back(std::nullopt);
+        axis.values.push_back("");
+        continue;
+      }
+
+      axis.define = token.substr(0, equals);
+      std::istringstream values(token.substr(equals + 1));
+      std::string value;
+      while (std::getline(values, value, '|'))
+        axis.values.push_back(value);
+
+      if (axis.define.empty() || axis.values.empty()) {
+        throw std::runtime_error(
+            "Invalid permutation \"" + token + "\" in " + path);
+      }
+    }
+  }
+
+  return axes;
+}
+
+std::vector<ShaderDefines> enumerateVariants(
+    const std::string& path,
+    const std::vector<PermutationAxis>& axes) {
+  std::vector<ShaderDefines> variants(1);
+  for (const PermutationAxis& axis : axes) {
+    std::vector<ShaderDefines> expanded;
+    expanded.reserve(variants.size() * axis.values.size());
+    for (const ShaderDefines& variant : variants) {
+      for (const std::optional<std::string>& value : axis.values) {
+        ShaderDefines& defines = expanded.emplace_back(variant);
+        if (value)
+          defines[axis.define] = *value;
+      }
+    }
+
+    if (expanded.size() > MAX_VARIANTS_PER_SHADER) {
+      throw std::runtime_error(
+          path + " declares more than " +
+          std::to_string(MAX_VARIANTS_PER_SHADER) + " permutations");
+    }
+
+    variants = std::move(expanded);
+  }
+
+  return variants;
+}
+
+void collectJobs(
+    const std::string& directory,
+    bool generateDebugInfo,
+    std::vector<ShaderCompileJob>& jobs) {
+  if (!std::filesystem::is_directory(directory))
+    return;
+
+  for (const auto& entry :
+       std::filesystem::recursive_directory_iterator(directory)) {
+    if (!entry.is_regular_file())
+      continue;
+
+    std::optional<shaderc_shader_kind> kind = getShaderKind(entry.path());
+    if (!kind)
+      continue;
+
+    // Spelled the way the engine builds shader paths, since the path is part
+    // of the variant key
+    std::string path =
+        directory + "/" +
+        entry.path().lexically_relative(directory).generic_string();
+    std::vector<char> code = Utilities::readFile(path);
+
+    for (ShaderDefines& defines :
+         enumerateVariants(path, parsePermutations(path, code))) {
+      ShaderCompileJob& job = jobs.emplace_back();
+      job.path = path;
+      job.kind = *kind;
+      job.language = SHADER_LANGUAGE_GLSL;
+      job.defines = std::move(defines);
+      job.code = code;
+      job.generateDebugInfo = generateDebugInfo;
+    }
+  }
+}
+
+std::string describeVariant(const ShaderCompileJob& job) {
+  std::string description = job.path.string();
+  for (const auto& define : job.defines) {
+    description += " -D" + define.first;
+    if (!define.second.empty())
+      description += "=" + define.second;
+  }
+  return description;
+}
+} // namespace
+
+int main(int argc, char** argv) {
+  std::vector<std::string> directories;
+  std::string outputPath;
+  bool generateDebugInfo = false;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "--output" && i + 1 < argc)
+      outputPath = argv[++i];
+    else if (arg == "--debug-info")
+      generateDebugInfo = true;
+    else
+      directories.push_back(arg);
+  }
+
+  if (directories.empty() || directories.size() > 2) {
+    std::cout << "Usage: ShaderVariantPrecompiler <engine directory> "
+                 "[project directory] [--output <archive path>] "
+                 "[--debug-info]\n";
+    return 1;
+  }
+
+  GEngineDirectory = directories[0];
+  GProjectDirectory = directories.size() > 1 ? directories[1] : directories[0];
+  if (outputPath.empty())
+    outputPath = ShaderVariantArchive::getPath();
+
+  // Nothing is hot reloaded here
+  ShaderFileWatcher::setEnabled(false);
+
+  std::vector<ShaderCompileJob> jobs;
+  try {
+    collectJobs(GEngineDirectory + "/Shaders", generateDebugInfo, jobs);
+    if (GProjectDirectory != GEngineDirectory)
+      collectJobs(GProjectDirectory + "/Shaders", generateDebugInfo, jobs);
+  } catch (const std::exception& e) {
+    std::cout << e.what() << "\n";
+    return 1;
+  }
+
+  // Keys must be computed before the jobs are handed off
+  std::vector<ShaderVariantArchive::Variant> variants(jobs.size());
+  std::vector<std::string> descriptions(jobs.size());
+  for (size_t i = 0; i < jobs.size(); ++i) {
+    variants[i].key = ShaderCompiler::computeCacheKey(jobs[i]);
+    descriptions[i] = describeVariant(jobs[i]);
+  }
+
+  std::vector<std::shared_future<ShaderCompileResult>> results =
+      ShaderCompiler::submitBatch(std::move(jobs));
+
+  uint32_t failureCount = 0;
+  for (size_t i = 0; i < results.size(); ++i) {
+    const ShaderCompileResult& result = ShaderCompiler::wait(results[i]);
+    if (!result.succeeded()) {
+      ++failureCount;
+      std::cout << descriptions[i] << ":\n" << result.errors << "\n";
+      continue;
+    }
+
+    ShaderVariantArchive::Variant& variant = variants[i];
+    variant.spirv = result.spirv;
+    for (const std::string& includedFile : result.includedFiles) {
+      variant.includes.push_back(
+          {includedFile,
+           ShaderCache::hashFile(Utilities::readFile(includedFile))});
+    }
+  }
+
+  if (failureCount > 0) {
+    std::cout << failureCount << " of " << variants.size()
+              << " variants failed to compile, no archive was written\n";
+    return 1;
+  }
+
+  try {
+    ShaderVariantArchive::write(outputPath, variants);
+  } catch (const std::exception& e) {
+    std::cout << e.what() << "\n";
+    return 1;
+  }
+
+  std::cout << "Packed " << variants.size() << " shader variants into "
+            << outputPath << " on "
+            << ThreadPool::getShared().getThreadCount() << " threads\n";
+
+  return 0;
+}